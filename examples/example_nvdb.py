@@ -11,7 +11,7 @@
 # Shows how to implement a particle simulation with collision against
 # a NanoVDB signed-distance field. In this example the NanoVDB field
 # is created offline in Houdini. The particle kernel uses the Warp
-# wp.volume_sample_world() method to compute the SDF and normal at a point.
+# wp.volume_sample_grad_world() method to compute the SDF and normal at a point.
 #
 ###########################################################################
 
@@ -25,19 +25,6 @@ import warp.render
 
 wp.init()
 
-@wp.func
-def volume_grad(volume: wp.uint64,
-                p: wp.vec3):
-    
-    eps = 1.e-2
-
-    # compute gradient of the SDF using finite differences
-    dx = wp.volume_sample_world(volume, p + wp.vec3(eps, 0.0, 0.0), wp.Volume.LINEAR) - wp.volume_sample_world(volume, p - wp.vec3(eps, 0.0, 0.0), wp.Volume.LINEAR)
-    dy = wp.volume_sample_world(volume, p + wp.vec3(0.0, eps, 0.0), wp.Volume.LINEAR) - wp.volume_sample_world(volume, p - wp.vec3(0.0, eps, 0.0), wp.Volume.LINEAR)
-    dz = wp.volume_sample_world(volume, p + wp.vec3(0.0, 0.0, eps), wp.Volume.LINEAR) - wp.volume_sample_world(volume, p - wp.vec3(0.0, 0.0, eps), wp.Volume.LINEAR)
-
-    return wp.normalize(wp.vec3(dx, dy, dz))
-
 @wp.kernel
 def simulate(positions: wp.array(dtype=wp.vec3),
             velocities: wp.array(dtype=wp.vec3),
@@ -55,11 +42,13 @@ def simulate(positions: wp.array(dtype=wp.vec3),
     v = v + wp.vec3(0.0, 0.0, -980.0)*dt - v*0.1*dt
     xpred = x + v*dt
 
-    d = wp.volume_sample_world(volume, xpred, wp.Volume.LINEAR)
+    # sample the SDF and its gradient from the same voxels
+    grad = wp.vec3()
+    d = wp.volume_sample_grad_world(volume, xpred, grad)
 
     if (d < margin):
         
-        n = volume_grad(volume, xpred)
+        n = wp.normalize(grad)
         err = d - margin
 
         # mesh collision
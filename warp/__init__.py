@@ -10,4 +10,5 @@ from warp.codegen import *
 from warp.context import *
 from warp.builtins import *
 from warp.tape import *
+from warp.profiler import *
 from warp.utils import *
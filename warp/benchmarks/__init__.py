@@ -0,0 +1,13 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+from . harness import benchmark, run_benchmarks, save_results, load_results, compare_results
+
+from . import bench_sort
+from . import bench_mesh
+from . import bench_hash_grid
+from . import bench_volume
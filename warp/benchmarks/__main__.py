@@ -0,0 +1,59 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+#############################################################################
+# Warp Benchmarks
+#
+# Measures the throughput of the runtime and spatial primitives over a sweep
+# of problem sizes, e.g.:
+#
+#   python -m warp.benchmarks --output base.json
+#   python -m warp.benchmarks --output new.json --compare base.json
+#
+# Exits with a non-zero status if any result regresses by more than the
+# threshold relative to the comparison file.
+#
+##############################################################################
+
+import sys
+import argparse
+
+import numpy as np
+
+import warp as wp
+
+wp.init()
+
+import warp.benchmarks as benchmarks
+
+
+parser = argparse.ArgumentParser(description="Runs the Warp micro-benchmarks")
+parser.add_argument("--device", nargs="*", default=None, help="devices to run on, defaults to all available devices")
+parser.add_argument("--filter", default=None, help="only run benchmarks whose name contains this string")
+parser.add_argument("--max-size", type=int, default=None, help="skip problem sizes above this value")
+parser.add_argument("--warmup", type=int, default=3, help="untimed repetitions before timing")
+parser.add_argument("--repeats", type=int, default=20, help="timed repetitions")
+parser.add_argument("--output", default=None, help="JSON file the results are written to")
+parser.add_argument("--compare", default=None, help="JSON file of a previous run to compare against")
+parser.add_argument("--threshold", type=float, default=0.1, help="relative slowdown of the median time reported as a regression")
+
+args = parser.parse_args()
+
+np.random.seed(42)
+
+results = benchmarks.run_benchmarks(devices=args.device, filter=args.filter, max_size=args.max_size, warmup=args.warmup, repeats=args.repeats)
+
+if (args.output):
+    benchmarks.save_results(args.output, results)
+
+if (args.compare):
+    print()
+    regressions = benchmarks.compare_results(benchmarks.load_results(args.compare), results, threshold=args.threshold)
+
+    if (regressions):
+        print(f"\n{len(regressions)} result(s) regressed by more than {args.threshold*100.0:.0f}%")
+        sys.exit(1)
@@ -0,0 +1,142 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.benchmarks.harness import benchmark
+
+
+sizes = [2**12, 2**16, 2**20]
+
+grid_dim = 128
+
+# points are spread so that each query radius contains this many neighbors on average
+neighbors = 32.0
+
+def make_points(n, device):
+
+    radius = 1.0
+    volume = n*(4.0/3.0*np.pi*radius**3)/neighbors
+    extent = volume**(1.0/3.0)
+
+    points = wp.array(np.random.uniform(0.0, extent, size=(n, 3)).astype(np.float32), dtype=wp.vec3, device=device)
+
+    return points, radius
+
+
+@wp.kernel
+def count_neighbors(grid: wp.uint64,
+                    radius: float,
+                    points: wp.array(dtype=wp.vec3),
+                    counts: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    # order threads by cell
+    i = wp.hash_grid_point_id(grid, tid)
+
+    p = points[i]
+    count = int(0)
+
+    query = wp.hash_grid_query(grid, p, radius)
+    index = int(0)
+
+    while(wp.hash_grid_query_next(query, index)):
+
+        if (wp.length(p - points[index]) <= radius):
+            count += 1
+
+    counts[i] = count
+
+
+@wp.kernel
+def count_list_neighbors(grid: wp.uint64,
+                         neighbors: wp.uint64,
+                         radius: float,
+                         points: wp.array(dtype=wp.vec3),
+                         counts: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    # order threads by cell
+    i = wp.hash_grid_point_id(grid, tid)
+
+    p = points[i]
+    count = int(0)
+
+    query = wp.neighbor_list_query(neighbors, i)
+    index = int(0)
+
+    while(wp.neighbor_list_query_next(query, index)):
+
+        if (wp.length(p - points[index]) <= radius):
+            count += 1
+
+    counts[i] = count
+
+
+@benchmark("hash_grid_build", sizes)
+def hash_grid_build(device, n):
+
+    points, radius = make_points(n, device)
+    grid = wp.HashGrid(grid_dim, grid_dim, grid_dim, device)
+
+    def run():
+        grid.build(points, radius)
+
+    return run, n, n*12
+
+
+@benchmark("hash_grid_query", sizes)
+def hash_grid_query(device, n):
+
+    points, radius = make_points(n, device)
+    counts = wp.zeros(n, dtype=int, device=device)
+
+    grid = wp.HashGrid(grid_dim, grid_dim, grid_dim, device)
+    grid.build(points, radius)
+
+    def run():
+        wp.launch(count_neighbors, dim=n, inputs=[grid.id, radius, points, counts], device=device)
+
+    return run, n, n*(12 + 4)
+
+
+@benchmark("neighbor_list_build", sizes)
+def neighbor_list_build(device, n):
+
+    points, radius = make_points(n, device)
+
+    grid = wp.HashGrid(grid_dim, grid_dim, grid_dim, device)
+    grid.build(points, radius)
+
+    nlist = wp.NeighborList(device)
+
+    def run():
+        nlist.build(grid, points, radius)
+
+    return run, n, n*(12 + 8 + 4 + int(neighbors)*4)
+
+
+@benchmark("neighbor_list_query", sizes)
+def neighbor_list_query(device, n):
+
+    points, radius = make_points(n, device)
+    counts = wp.zeros(n, dtype=int, device=device)
+
+    grid = wp.HashGrid(grid_dim, grid_dim, grid_dim, device)
+    grid.build(points, radius)
+
+    nlist = wp.NeighborList(device)
+    nlist.build(grid, points, radius)
+
+    # neighbor positions are read through the list, the distance test is kept so the work matches hash_grid_query
+    def run():
+        wp.launch(count_list_neighbors, dim=n, inputs=[grid.id, nlist.id, radius, points, counts], device=device)
+
+    return run, n, n*(12 + 4 + 8 + int(neighbors)*4)
@@ -0,0 +1,104 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import math
+
+import numpy as np
+
+import warp as wp
+from warp.benchmarks.harness import benchmark
+
+
+# number of triangles of the mesh that rays are cast against
+query_mesh_size = 2**18
+
+def make_grid_mesh(num_tris, device):
+    """Creates a noisy heightfield over the unit square with at least ``num_tris`` triangles"""
+
+    res = max(1, int(math.ceil(math.sqrt(num_tris/2))))
+
+    x, y = np.meshgrid(np.linspace(0.0, 1.0, res+1), np.linspace(0.0, 1.0, res+1))
+    z = np.random.uniform(0.0, 0.5/res, size=x.shape)
+
+    points_np = np.stack([x.flatten(), y.flatten(), z.flatten()], axis=1).astype(np.float32)
+
+    i, j = np.meshgrid(np.arange(res), np.arange(res))
+    v = (j*(res+1) + i).flatten()
+
+    indices_np = np.stack([v, v+1, v+res+2, v, v+res+2, v+res+1], axis=1).astype(np.int32)
+
+    points = wp.array(points_np, dtype=wp.vec3, device=device)
+    indices = wp.array(indices_np.flatten(), dtype=int, device=device)
+
+    return points, indices
+
+
+@wp.kernel
+def cast_rays(mesh: wp.uint64,
+              starts: wp.array(dtype=wp.vec3),
+              dirs: wp.array(dtype=wp.vec3),
+              hits: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    t = float(0.0)
+    u = float(0.0)
+    v = float(0.0)
+    sign = float(0.0)
+    n = wp.vec3()
+    f = int(0)
+
+    if wp.mesh_query_ray(mesh, starts[tid], dirs[tid], 1.e+6, t, u, v, sign, n, f):
+        hits[tid] = t
+    else:
+        hits[tid] = -1.0
+
+
+@benchmark("mesh_build", [2**10, 2**14, 2**18])
+def mesh_build(device, n):
+
+    points, indices = make_grid_mesh(n, device)
+    mesh = wp.Mesh(points, indices)
+
+    # passing indices always rebuilds the BVH while reusing the mesh allocations
+    def run():
+        mesh.update(indices=indices)
+
+    return run, len(indices)//3, len(points)*12 + len(indices)*4
+
+
+@benchmark("mesh_refit", [2**10, 2**14, 2**18, 2**20])
+def mesh_refit(device, n):
+
+    points, indices = make_grid_mesh(n, device)
+    mesh = wp.Mesh(points, indices)
+
+    def run():
+        mesh.refit()
+
+    return run, len(indices)//3, len(points)*12 + len(indices)*4
+
+
+@benchmark("mesh_query_ray", [2**12, 2**16, 2**20])
+def mesh_query_ray(device, n):
+
+    points, indices = make_grid_mesh(query_mesh_size, device)
+    mesh = wp.Mesh(points, indices)
+
+    # incoherent rays falling onto the heightfield
+    starts_np = np.concatenate([np.random.rand(n, 2), np.ones((n, 1))], axis=1).astype(np.float32)
+    dirs_np = np.concatenate([np.random.uniform(-0.5, 0.5, size=(n, 2)), -np.ones((n, 1))], axis=1)
+    dirs_np = (dirs_np/np.linalg.norm(dirs_np, axis=1, keepdims=True)).astype(np.float32)
+
+    starts = wp.array(starts_np, dtype=wp.vec3, device=device)
+    dirs = wp.array(dirs_np, dtype=wp.vec3, device=device)
+    hits = wp.zeros(n, dtype=float, device=device)
+
+    def run():
+        wp.launch(cast_rays, dim=n, inputs=[mesh.id, starts, dirs, hits], device=device)
+
+    return run, n, n*(12 + 12 + 4)
@@ -0,0 +1,41 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.benchmarks.harness import benchmark
+
+
+sizes = [2**12, 2**16, 2**20, 2**23]
+
+def setup_sort(device, n, keys_np, dtype, key_size):
+
+    # second half of each array is temporary storage
+    keys = wp.array(np.concatenate([keys_np, keys_np]), dtype=dtype, device=device)
+    values = wp.array(np.arange(2*n, dtype=np.int32), dtype=int, device=device)
+
+    # an LSD radix sort does the same passes for sorted input, so repetitions sort in-place
+    def run():
+        wp.sort_pairs(keys, values, n)
+
+    return run, n, n*(key_size + 4)*2
+
+
+@benchmark("sort_pairs_int32", sizes)
+def sort_pairs_int32(device, n):
+    return setup_sort(device, n, np.random.randint(-2**31, 2**31-1, size=n, dtype=np.int32), int, 4)
+
+
+@benchmark("sort_pairs_float32", sizes)
+def sort_pairs_float32(device, n):
+    return setup_sort(device, n, (np.random.rand(n)*2000.0 - 1000.0).astype(np.float32), float, 4)
+
+
+@benchmark("sort_pairs_int64", sizes)
+def sort_pairs_int64(device, n):
+    return setup_sort(device, n, np.random.randint(-2**62, 2**62, size=n, dtype=np.int64), wp.int64, 8)
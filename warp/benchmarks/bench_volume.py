@@ -0,0 +1,94 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import os
+
+import numpy as np
+
+import warp as wp
+from warp.benchmarks.harness import benchmark
+
+
+volume_path = os.path.abspath(os.path.join(os.path.dirname(__file__), "../tests/assets/test_grid.nvdbraw"))
+
+# index space extent of the active voxels in the test grid
+volume_extent = 11.0
+
+# samples taken by each thread of the accessor benchmark
+MARCH_STEPS = wp.constant(16)
+
+sizes = [2**12, 2**16, 2**20]
+
+@wp.kernel
+def index_to_world(volume: wp.uint64,
+                   points: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+    points[tid] = wp.volume_transform(volume, points[tid])
+
+
+@wp.kernel
+def sample_world(volume: wp.uint64,
+                 points: wp.array(dtype=wp.vec3),
+                 values: wp.array(dtype=float)):
+
+    tid = wp.tid()
+    values[tid] = wp.volume_sample_world(volume, points[tid], wp.Volume.LINEAR)
+
+
+@wp.kernel
+def sample_world_accessor(volume: wp.uint64,
+                          points: wp.array(dtype=wp.vec3),
+                          step: wp.vec3,
+                          values: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    # coherent march where consecutive samples mostly hit the cached leaf
+    acc = wp.volume_accessor(volume)
+    p = points[tid]
+    total = float(0.0)
+
+    for s in range(MARCH_STEPS):
+        total = total + wp.volume_sample_world(acc, p + step*float(s), wp.Volume.LINEAR)
+
+    values[tid] = total
+
+
+def setup_volume(device, n):
+
+    volume = wp.Volume(wp.array(np.fromfile(volume_path, dtype=np.byte), device="cpu").to(device))
+
+    points = wp.array(np.random.uniform(-volume_extent, volume_extent, size=(n, 3)).astype(np.float32), dtype=wp.vec3, device=device)
+    wp.launch(index_to_world, dim=n, inputs=[volume.id, points], device=device)
+
+    values = wp.zeros(n, dtype=float, device=device)
+
+    return volume, points, values
+
+
+@benchmark("volume_sample_world", sizes)
+def volume_sample_world(device, n):
+
+    volume, points, values = setup_volume(device, n)
+
+    def run():
+        wp.launch(sample_world, dim=n, inputs=[volume.id, points, values], device=device)
+
+    return run, n, n*(12 + 4)
+
+
+@benchmark("volume_sample_accessor", sizes)
+def volume_sample_accessor(device, n):
+
+    volume, points, values = setup_volume(device, n)
+    step = wp.vec3(0.01, 0.005, 0.0)
+
+    def run():
+        wp.launch(sample_world_accessor, dim=n, inputs=[volume.id, points, step, values], device=device)
+
+    return run, n*MARCH_STEPS.val, n*(12 + 4)
@@ -0,0 +1,241 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import os
+import sys
+import json
+import math
+import time
+import timeit
+import platform
+import subprocess
+
+import warp as wp
+
+
+# all registered benchmarks in registration order
+benchmarks = []
+
+class Benchmark:
+
+    def __init__(self, name, setup, sizes, devices):
+
+        self.name = name
+        self.setup = setup
+        self.sizes = sizes
+        self.devices = devices
+
+
+def benchmark(name: str, sizes, devices=("cpu", "cuda")):
+    """Registers a benchmark
+
+    The decorated function is called as ``setup(device, size)`` once per problem size and must return a tuple
+    ``(run, items, bytes)``, where ``run()`` issues one repetition of the measured work, ``items`` is the number of
+    elements processed per repetition, and ``bytes`` is the minimum number of bytes that must be read or written per repetition.
+
+    Args:
+        name: Unique name of the benchmark
+        sizes: Problem sizes to sweep
+        devices: Devices the benchmark supports
+    """
+
+    def wrapper(setup):
+        benchmarks.append(Benchmark(name, setup, list(sizes), devices))
+        return setup
+
+    return wrapper
+
+
+def time_function(run, device: str, warmup: int, repeats: int):
+    """Returns the time of each repetition of ``run()`` in milliseconds
+
+    CUDA repetitions are timed with events on the current stream so that launch latency on the host
+    is not included, CPU repetitions are timed with a host timer.
+    """
+
+    for i in range(warmup):
+        run()
+
+    wp.synchronize()
+
+    times = []
+
+    if (device != "cpu"):
+
+        events = [(wp.Event(enable_timing=True, device=device), wp.Event(enable_timing=True, device=device)) for i in range(repeats)]
+        stream = wp.get_stream(device)
+
+        for start, end in events:
+            stream.record_event(start)
+            run()
+            stream.record_event(end)
+
+        wp.synchronize()
+
+        for start, end in events:
+            times.append(start.elapsed_time(end))
+
+    else:
+
+        for i in range(repeats):
+            start = timeit.default_timer()
+            run()
+            times.append((timeit.default_timer() - start)*1000.0)
+
+    return times
+
+
+def statistics(times):
+
+    n = len(times)
+    s = sorted(times)
+
+    mean = sum(times)/n
+    median = s[n//2] if n%2 else 0.5*(s[n//2-1] + s[n//2])
+    std = math.sqrt(sum((t-mean)**2 for t in times)/(n-1)) if n > 1 else 0.0
+
+    return { "mean_ms": mean, "median_ms": median, "min_ms": s[0], "max_ms": s[-1], "std_ms": std }
+
+
+def run_benchmarks(devices=None, filter=None, max_size=None, warmup: int=3, repeats: int=20, verbose: bool=True):
+    """Runs all registered benchmarks and returns a list of results
+
+    Args:
+        devices: Devices to run on, defaults to all available devices
+        filter: Optional substring, only benchmarks whose name contains it are run
+        max_size: Optional upper bound on the problem sizes
+        warmup: Number of untimed repetitions issued before timing, these include kernel compilation
+        repeats: Number of timed repetitions
+
+    Returns:
+        A list of dictionaries with the keys ``name``, ``device``, ``size``, ``items``, ``bytes``, ``repeats``,
+        the timing statistics ``mean_ms``, ``median_ms``, ``min_ms``, ``max_ms``, ``std_ms``, and the throughput
+        ``items_per_sec`` and ``gb_per_sec`` computed from the median time
+    """
+
+    if (devices == None):
+        devices = wp.get_devices()
+
+    results = []
+
+    if (verbose):
+        print_header()
+
+    for b in benchmarks:
+
+        if (filter and filter not in b.name):
+            continue
+
+        for device in devices:
+
+            # benchmarks list device kinds, each CUDA device is run separately
+            if (device.split(":")[0] not in b.devices or not wp.is_device_available(device)):
+                continue
+
+            for size in b.sizes:
+
+                if (max_size and size > max_size):
+                    continue
+
+                run, items, bytes = b.setup(device, size)
+
+                times = time_function(run, device, warmup, repeats)
+
+                r = { "name": b.name, "device": device, "size": size, "items": items, "bytes": bytes, "repeats": repeats }
+                r.update(statistics(times))
+
+                seconds = r["median_ms"]/1000.0
+
+                r["items_per_sec"] = items/seconds if seconds > 0.0 else 0.0
+                r["gb_per_sec"] = bytes/seconds/1.0e9 if seconds > 0.0 else 0.0
+
+                results.append(r)
+
+                if (verbose):
+                    print_result(r)
+
+                # release the benchmark's buffers before the next size is allocated
+                del run
+
+    return results
+
+
+def print_header():
+    print(f"{'benchmark':28} {'device':6} {'size':>10} {'median (ms)':>12} {'std (ms)':>10} {'items/s':>12} {'GB/s':>8}")
+
+
+def print_result(r):
+    print(f"{r['name']:28} {r['device']:6} {r['size']:10} {r['median_ms']:12.4f} {r['std_ms']:10.4f} {r['items_per_sec']:12.4g} {r['gb_per_sec']:8.2f}")
+
+
+def get_commit():
+
+    try:
+        root = os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+        return subprocess.check_output(["git", "rev-parse", "HEAD"], cwd=root, stderr=subprocess.DEVNULL).decode("utf-8").strip()
+    except:
+        return None
+
+
+def save_results(path: str, results):
+    """Writes results to a JSON file together with information about the environment they were measured in"""
+
+    report = {
+        "version": wp.config.version,
+        "commit": get_commit(),
+        "timestamp": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "platform": platform.platform(),
+        "python": platform.python_version(),
+        "cpu_threads": wp.get_cpu_threads(),
+        "results": results
+    }
+
+    with open(path, "w") as f:
+        json.dump(report, f, indent=2)
+
+
+def load_results(path: str):
+
+    with open(path, "r") as f:
+        return json.load(f)["results"]
+
+
+def compare_results(baseline, results, threshold: float=0.1, verbose: bool=True):
+    """Compares the median times of matching (name, device, size) entries
+
+    Args:
+        baseline: Results of the reference run, e.g.: from :func:`load_results`
+        results: Results of the run being tested
+        threshold: Relative slowdown of the median time above which a result counts as a regression
+
+    Returns:
+        The list of ``(result, ratio)`` pairs that regressed, where ratio is the new median time over the baseline median time
+    """
+
+    reference = { (r["name"], r["device"], r["size"]): r for r in baseline }
+
+    regressions = []
+
+    if (verbose):
+        print(f"{'benchmark':28} {'device':6} {'size':>10} {'base (ms)':>12} {'new (ms)':>12} {'ratio':>8}")
+
+    for r in results:
+
+        b = reference.get((r["name"], r["device"], r["size"]))
+        if (b == None or b["median_ms"] <= 0.0):
+            continue
+
+        ratio = r["median_ms"]/b["median_ms"]
+
+        regressed = ratio > 1.0 + threshold
+        if (regressed):
+            regressions.append((r, ratio))
+
+        if (verbose):
+            print(f"{r['name']:28} {r['device']:6} {r['size']:10} {b['median_ms']:12.4f} {r['median_ms']:12.4f} {ratio:8.3f}{'  regression' if regressed else ''}")
+
+    return regressions
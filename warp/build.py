@@ -10,6 +10,7 @@ import os
 import sys
 import imp
 import subprocess
+import time
 import ctypes
 import _ctypes
 
@@ -117,31 +118,268 @@ def find_cuda():
     return cuda_home
     
 
-# builds cuda->ptx using NVRTC
-def build_cuda(cu_path, ptx_path, config="release", force=False):
+# nvrtcResult returned for unknown options, e.g.: an architecture newer than nvrtc
+NVRTC_ERROR_INVALID_OPTION = 5
+
+# virtual architecture used when CUBIN compilation is disabled or unavailable
+PTX_FALLBACK_ARCH = 52
+
+# builds cuda->ptx/cubin using NVRTC
+def build_cuda(cu_path, output_path, arch, ptx=False, config="release"):
 
     src_file = open(cu_path)
     src = src_file.read().encode('utf-8')
     src_file.close()
 
     inc_path = os.path.dirname(cu_path).encode('utf-8')
-    ptx_path = ptx_path.encode('utf-8')
 
-    err = warp.context.runtime.core.cuda_compile_program(src, inc_path, False, warp.config.verbose, ptx_path)
+    err = warp.context.runtime.core.cuda_compile_program(src, inc_path, arch, False, warp.config.verbose, ptx, output_path.encode('utf-8'))
+
+    # nvrtc older than the device does not recognize its architecture, fall back to PTX that the driver can JIT
+    if (err == NVRTC_ERROR_INVALID_OPTION and not ptx):
+
+        print(f"Warp: NVRTC cannot target sm_{arch}, falling back to PTX for compute_{PTX_FALLBACK_ARCH}")
+        err = warp.context.runtime.core.cuda_compile_program(src, inc_path, PTX_FALLBACK_ARCH, False, warp.config.verbose, True, output_path.encode('utf-8'))
+
     if (err):
         raise Exception("CUDA build failed")
 
-# load ptx to a CUDA runtime module    
-def load_cuda(ptx_path):
+# load a PTX or CUBIN image to a CUDA runtime module
+def load_cuda(path):
 
-    module = warp.context.runtime.core.cuda_load_module(ptx_path.encode('utf-8'))
+    module = warp.context.runtime.core.cuda_load_module(path.encode('utf-8'))
     return module
 
 
+# temporary output path that is unique to this process
+def temp_path(path):
+    return f"{path}.{os.getpid()}.tmp"
+
+# moves a file into place atomically so that other processes never observe partial outputs,
+# on Windows the destination can't be replaced while it is loaded, but since cache entries
+# are named by their content key an existing destination is identical and is kept
+def commit_file(src_path, dest_path):
+
+    try:
+        os.replace(src_path, dest_path)
+    except OSError:
+        if (not os.path.exists(dest_path)):
+            raise
+
+        os.remove(src_path)
+
+def write_file_atomic(path, data):
+
+    tmp = temp_path(path)
+
+    try:
+        with open(tmp, "w") as f:
+            f.write(data)
+
+        commit_file(tmp, path)
+
+    except:
+        # don't leave a partial temporary behind
+        if (os.path.exists(tmp)):
+            os.remove(tmp)
+        raise
+
+
+class CacheLock:
+    """Inter-process lock for a kernel cache entry, so that processes sharing a cache
+    directory build each entry once and the others wait for the result.
+
+    The lock is an advisory OS lock on a file next to the entry (``flock()`` on POSIX, ``msvcrt.locking()``
+    on Windows), it is released by the OS if its owner crashes so a lock is never left behind. The
+    file itself is kept, removing it would let another process lock a new file while the old one is held.
+    """
+
+    def __init__(self, path, poll_interval=0.05):
+        self.path = path
+        self.poll_interval = poll_interval
+        self.file = None
+
+    def __enter__(self):
+
+        self.file = open(self.path, "a+")
+
+        try:
+            if (os.name == 'nt'):
+
+                import msvcrt
+
+                # a blocking lock gives up after 10 seconds, so poll instead
+                while True:
+                    try:
+                        self.file.seek(0)
+                        msvcrt.locking(self.file.fileno(), msvcrt.LK_NBLCK, 1)
+                        break
+                    except OSError:
+                        time.sleep(self.poll_interval)
+            else:
+
+                import fcntl
+                fcntl.flock(self.file.fileno(), fcntl.LOCK_EX)
+
+        except:
+            self.file.close()
+            self.file = None
+            raise
+
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+
+        try:
+            if (os.name == 'nt'):
+                import msvcrt
+                self.file.seek(0)
+                msvcrt.locking(self.file.fileno(), msvcrt.LK_UNLCK, 1)
+            else:
+                import fcntl
+                fcntl.flock(self.file.fileno(), fcntl.LOCK_UN)
+        finally:
+            self.file.close()
+            self.file = None
+
+
+# lanes per batch of the SIMD instruction sets CPU kernels can be vectorized for, i.e.: floats per register
+simd_widths = { "avx2": 8, "avx512": 16, "neon": 4 }
+
+# compiler flags per instruction set
+simd_flags_gcc = { "avx2": "-mavx2 -mfma", "avx512": "-mavx512f -mavx512vl -mavx512dq -mfma", "neon": "" }
+simd_flags_msvc = { "avx2": "/arch:AVX2", "avx512": "/arch:AVX512", "neon": "" }
+
+def find_cpu_simd():
+    """Returns the widest SIMD instruction set supported by the host, or None"""
+
+    import platform
+
+    machine = platform.machine().lower()
+
+    # NEON is part of the baseline of 64-bit ARM
+    if (machine in ("arm64", "aarch64")):
+        return "neon"
+
+    if (machine not in ("x86_64", "amd64", "x64")):
+        return None
+
+    try:
+        if (os.name == 'nt'):
+
+            # PF_AVX512F_INSTRUCTIONS_AVAILABLE, PF_AVX2_INSTRUCTIONS_AVAILABLE
+            if (ctypes.windll.kernel32.IsProcessorFeaturePresent(41)):
+                return "avx512"
+            if (ctypes.windll.kernel32.IsProcessorFeaturePresent(40)):
+                return "avx2"
+
+        elif (sys.platform == "darwin"):
+
+            features = subprocess.check_output("sysctl -n machdep.cpu.leaf7_features", shell=True).decode().upper().split()
+
+            if ("AVX512F" in features):
+                return "avx512"
+            if ("AVX2" in features):
+                return "avx2"
+
+        else:
+
+            with open("/proc/cpuinfo") as f:
+                for line in f:
+                    if (line.startswith("flags")):
+                        flags = line.split()
+
+                        if ("avx512f" in flags and "avx512vl" in flags and "avx512dq" in flags):
+                            return "avx512"
+                        if ("avx2" in flags and "fma" in flags):
+                            return "avx2"
+
+                        break
+    except:
+        pass
+
+    return None
+
+def resolve_cpu_simd(simd):
+    """Maps a ``cpu_simd`` option to an instruction set, ``auto`` selects the widest one supported by the host"""
+
+    if (simd == None):
+        return None
+
+    if (simd == "auto"):
+        return find_cpu_simd()
+
+    if (simd not in simd_widths):
+        raise RuntimeError(f"Unknown CPU SIMD instruction set '{simd}', expected one of {list(simd_widths.keys())} or 'auto'")
+
+    return simd
+
 def quote(path):
     return "\"" + path + "\""
 
-def build_dll(cpp_path, cu_path, dll_path, config="release", force=False):
+def host_compile_flags(config="release", simd=None):
+    """Returns the C++ compiler and the flags :func:`build_dll` compiles with for a build configuration
+    and instruction set, kernel cache keys hash these so a change of flags never reuses a stale binary"""
+
+    import pathlib
+    nanovdb_home = (pathlib.Path(__file__).parent.parent / "_build/host-deps/nanovdb/include")
+
+    if os.name == 'nt':
+
+        compiler = "cl.exe"
+
+        if (config == "debug"):
+            cpp_flags = f'/MTd /Zi /Od /D "_DEBUG" /D "WP_CPU" /D "_ITERATOR_DEBUG_LEVEL=0" /I"{nanovdb_home}"'
+        elif (config == "release"):
+            cpp_flags = f'/Ox /D "NDEBUG" /D "WP_CPU" /D "_ITERATOR_DEBUG_LEVEL=0" /fp:fast /I"{nanovdb_home}"'
+        else:
+            raise RuntimeError("Unrecognized build configuration (debug, release), got: {}".format(config))
+
+        if (simd):
+            cpp_flags += f" {simd_flags_msvc[simd]} /openmp:experimental"
+
+    else:
+
+        compiler = "g++"
+
+        if (config == "debug"):
+            cpp_flags = "-O0 -g -D_DEBUG -DWP_CPU -fPIC -pthread --std=c++11"
+        elif (config == "release"):
+            cpp_flags = "-O3 -DNDEBUG -DWP_CPU  -fPIC -pthread --std=c++11"
+        else:
+            raise RuntimeError("Unrecognized build configuration (debug, release), got: {}".format(config))
+
+        # only the simd pragmas are enabled, no OpenMP runtime is linked, and
+        # math functions can only be vectorized if they don't set errno
+        if (simd):
+            cpp_flags += f" {simd_flags_gcc[simd]} -fopenmp-simd -fno-math-errno"
+
+    return compiler, cpp_flags
+
+# version banners of compilers by command, queried once per process
+host_compiler_versions = {}
+
+def host_compiler_version(compiler):
+    """Returns the version banner of a C++ compiler, or an empty string if it can't be run"""
+
+    if (compiler not in host_compiler_versions):
+
+        # cl.exe prints its banner to stderr when run without arguments
+        cmd = compiler if os.name == 'nt' else f"{compiler} --version"
+
+        try:
+            result = subprocess.run(cmd, shell=True, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+            lines = result.stdout.decode(errors="replace").splitlines()
+            version = lines[0].strip() if lines else ""
+        except:
+            version = ""
+
+        host_compiler_versions[compiler] = version
+
+    return host_compiler_versions[compiler]
+
+# simd is the instruction set for the vectorized loops of generated kernels, see resolve_cpu_simd()
+def build_dll(cpp_path, cu_path, dll_path, config="release", force=False, simd=None):
 
     cuda_home = warp.config.cuda_path
     cuda_cmd = None
@@ -151,6 +389,8 @@ def build_dll(cpp_path, cu_path, dll_path, config="release", force=False):
     warp_home = warp_home_path.resolve()
     nanovdb_home = (warp_home_path.parent / "_build/host-deps/nanovdb/include")
 
+    compiler, cpp_flags = host_compile_flags(config, simd)
+
     if (cu_path != None and cuda_home == None):
         print("CUDA toolchain not found, skipping CUDA build")
     
@@ -198,22 +438,11 @@ def build_dll(cpp_path, cu_path, dll_path, config="release", force=False):
 
         cpp_out = cpp_path + ".obj"
 
-        if (config == "debug"):
-            cpp_flags = f'/MTd /Zi /Od /D "_DEBUG" /D "WP_CPU" /D "_ITERATOR_DEBUG_LEVEL=0" /I"{nanovdb_home}"'
-            ld_flags = '/DEBUG /dll'
-            ld_inputs = []
-
-        elif (config == "release"):
-            cpp_flags = f'/Ox /D "NDEBUG" /D "WP_CPU" /D "_ITERATOR_DEBUG_LEVEL=0" /fp:fast /I"{nanovdb_home}"'
-            ld_flags = '/dll'
-            ld_inputs = []
-
-        else:
-            raise RuntimeError("Unrecognized build configuration (debug, release), got: {}".format(config))
-
+        ld_flags = '/DEBUG /dll' if config == "debug" else '/dll'
+        ld_inputs = []
 
         with ScopedTimer("build", active=warp.config.verbose):
-            cpp_cmd = 'cl.exe {cflags} -c "{cpp_path}" /Fo"{cpp_out}"'.format(cflags=cpp_flags, cpp_out=cpp_out, cpp_path=cpp_path)
+            cpp_cmd = '{compiler} {cflags} -c "{cpp_path}" /Fo"{cpp_out}"'.format(compiler=compiler, cflags=cpp_flags, cpp_out=cpp_out, cpp_path=cpp_path)
             run_cmd(cpp_cmd)
 
             ld_inputs.append(quote(cpp_out))
@@ -241,19 +470,11 @@ def build_dll(cpp_path, cu_path, dll_path, config="release", force=False):
 
         cpp_out = cpp_path + ".o"
 
-        if (config == "debug"):
-            cpp_flags = "-O0 -g -D_DEBUG -DWP_CPU -fPIC --std=c++11"
-            ld_flags = "-D_DEBUG"
-            ld_inputs = []
-
-        if (config == "release"):
-            cpp_flags = "-O3 -DNDEBUG -DWP_CPU  -fPIC --std=c++11"
-            ld_flags = "-DNDEBUG"
-            ld_inputs = []
-
+        ld_flags = "-D_DEBUG" if config == "debug" else "-DNDEBUG"
+        ld_inputs = []
 
         with ScopedTimer("build", active=warp.config.verbose):
-            build_cmd = 'g++ {cflags} -c "{cpp_path}" -o "{cpp_out}"'.format(cflags=cpp_flags, cpp_out=cpp_out, cpp_path=cpp_path)
+            build_cmd = '{compiler} {cflags} -c "{cpp_path}" -o "{cpp_out}"'.format(compiler=compiler, cflags=cpp_flags, cpp_out=cpp_out, cpp_path=cpp_path)
             run_cmd(build_cmd)
 
             ld_inputs.append(quote(cpp_out))
@@ -276,7 +497,7 @@ def build_dll(cpp_path, cu_path, dll_path, config="release", force=False):
                 ld_inputs.append('-L"{cuda_home}/lib64" -lcudart -lnvrtc'.format(cuda_home=cuda_home))
 
         with ScopedTimer("link", active=warp.config.verbose):
-            link_cmd = "g++ -shared -Wl,-rpath,'$ORIGIN' -o '{dll_path}' {inputs}".format(cuda_home=cuda_home, inputs=' '.join(ld_inputs), dll_path=dll_path)            
+            link_cmd = "g++ -shared -pthread -Wl,-rpath,'$ORIGIN' -o '{dll_path}' {inputs}".format(cuda_home=cuda_home, inputs=' '.join(ld_inputs), dll_path=dll_path)            
             run_cmd(link_cmd)
 
     
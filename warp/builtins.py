@@ -358,6 +358,15 @@ add_builtin("mesh_query_ray", input_types={"id": uint64, "start": vec3, "dir": v
    :param normal: Returns the face normal
    :param face: Returns the index of the hit face""")
 
+add_builtin("mesh_query_ray_any", input_types={"id": uint64, "start": vec3, "dir": vec3, "max_t": float}, value_type=bool, group="Geometry",
+    doc="""Returns ``True`` if the ray hits any face of the mesh with identifier `id` at a distance < ``max_t``.
+   Traversal stops at the first hit found, which makes this cheaper than :func:`mesh_query_ray` for occlusion tests.
+
+   :param id: The mesh identifier
+   :param start: The start point of the ray
+   :param dir: The ray direction (should be normalized)
+   :param max_t: The maximum distance along the ray to check for intersections""")
+
 add_builtin("mesh_query_aabb", input_types={"id": uint64, "lower": vec3, "upper": vec3}, value_type=mesh_query_aabb_t, group="Geometry",
     doc="""Construct an axis-aligned bounding box query against a mesh object. This query can be used to iterate over all triangles
    inside a volume. Returns an object that is used to track state during mesh traversal.
@@ -376,6 +385,12 @@ add_builtin("mesh_eval_position", input_types={"id": uint64, "face": int, "bary_
 add_builtin("mesh_eval_velocity", input_types={"id": uint64, "face": int, "bary_u": float, "bary_v": float}, value_type=vec3, group="Geometry",
     doc="""Evaluates the velocity on the mesh given a face index, and barycentric coordinates.""")
 
+add_builtin("mesh_bounds_lower", input_types={"id": uint64}, value_type=vec3, group="Geometry",
+    doc="""Returns the lower corner of the bounding box of the mesh with identifier `id` as of its last update.""")
+
+add_builtin("mesh_bounds_upper", input_types={"id": uint64}, value_type=vec3, group="Geometry",
+    doc="""Returns the upper corner of the bounding box of the mesh with identifier `id` as of its last update.""")
+
 add_builtin("hash_grid_query", input_types={"id": uint64, "point": vec3, "max_dist": float}, value_type=hash_grid_query_t, group="Geometry",
     doc="""Construct a point query against a hash grid. This query can be used to iterate over all neighboring points withing a 
    fixed radius from the query point. Returns an object that is used to track state during neighbor traversal.""")
@@ -388,6 +403,17 @@ add_builtin("hash_grid_point_id", input_types={"id": uint64, "index": int}, valu
     doc="""Return the index of a point in the grid, this can be used to re-order threads such that grid 
    traversal occurs in a spatially coherent order.""")
 
+add_builtin("neighbor_list_query", input_types={"id": uint64, "point": int}, value_type=neighbor_list_query_t, group="Geometry",
+    doc="""Construct a query over the neighbors of a point in the neighbor list with identifier ``id``. Neighbors were found
+   when the list was built, so iterating over them does not visit hash grid cells or test distances.""")
+
+add_builtin("neighbor_list_query_next", input_types={"query": neighbor_list_query_t, "index": int}, value_type=bool, group="Geometry",
+    doc="""Move to the next neighbor in the neighbor list query. The index of the current neighbor is stored in ``index``, returns ``False``
+   if there are no more neighbors.""")
+
+add_builtin("neighbor_list_count", input_types={"id": uint64, "point": int}, value_type=int, group="Geometry",
+    doc="""Return the number of neighbors of a point in the neighbor list with identifier ``id``.""")
+
 #---------------------------------
 # Volumes 
 
@@ -399,6 +425,34 @@ add_builtin("volume_sample_local", input_types={"id": uint64, "uvw": vec3, "samp
 add_builtin("volume_lookup", input_types={"id": uint64, "i": int, "j": int, "k": int}, value_type=float, group="Volumes",
     doc="""Returns the value of voxel with coordinates ``i``, ``j``, ``k``, if the voxel at this index does not exist this function returns the background value""")
 
+add_builtin("volume_sample_grad_world", input_types={"id": uint64, "xyz": vec3, "grad": vec3}, value_type=float, group="Volumes",
+    doc="""Trilinearly sample the scalar volume given by ``id`` at the world-space point ``xyz``, the world-space gradient of the interpolated value is returned in ``grad``.
+   Both are computed from the same eight voxel fetches.""")
+add_builtin("volume_sample_grad_local", input_types={"id": uint64, "uvw": vec3, "grad": vec3}, value_type=float, group="Volumes",
+    doc="""Trilinearly sample the scalar volume given by ``id`` at the volume local-space point ``uvw``, the local-space gradient of the interpolated value is returned in ``grad``.""")
+
+add_builtin("volume_sample_world_v", input_types={"id": uint64, "xyz": vec3, "sampling_mode": int}, value_type=vec3, group="Volumes",
+    doc="""Sample the vector volume given by ``id`` at the world-space point ``xyz``. Interpolation should be ``wp.Volume.CLOSEST``, or ``wp.Volume.LINEAR.``""")
+add_builtin("volume_sample_local_v", input_types={"id": uint64, "uvw": vec3, "sampling_mode": int}, value_type=vec3, group="Volumes",
+    doc="""Sample the vector volume given by ``id`` at the volume local-space point ``uvw``. Interpolation should be ``wp.Volume.CLOSEST``, or ``wp.Volume.LINEAR.``""")
+add_builtin("volume_lookup_v", input_types={"id": uint64, "i": int, "j": int, "k": int}, value_type=vec3, group="Volumes",
+    doc="""Returns the vector value of voxel with coordinates ``i``, ``j``, ``k``, if the voxel at this index does not exist this function returns the background value""")
+add_builtin("volume_lookup_i", input_types={"id": uint64, "i": int, "j": int, "k": int}, value_type=int, group="Volumes",
+    doc="""Returns the integer value of voxel with coordinates ``i``, ``j``, ``k`` of an int32 volume, if the voxel at this index does not exist this function returns the background value""")
+
+add_builtin("volume_accessor", input_types={"id": uint64}, value_type=volume_accessor_t, group="Volumes",
+    doc="""Construct a read accessor for the volume given by ``id``. The accessor caches the most recently visited tree nodes, 
+   passing it in place of ``id`` to the volume sampling and lookup functions lets spatially coherent samples, e.g.: along a ray, skip the traversal from the root.""")
+
+for key, value_type in (("volume_sample_world", float), ("volume_sample_local", float), ("volume_sample_world_v", vec3), ("volume_sample_local_v", vec3)):
+    add_builtin(key, input_types={"accessor": volume_accessor_t, "xyz" if "world" in key else "uvw": vec3, "sampling_mode": int}, value_type=value_type, group="Volumes", hidden=True)
+
+for key in ("volume_sample_grad_world", "volume_sample_grad_local"):
+    add_builtin(key, input_types={"accessor": volume_accessor_t, "xyz" if "world" in key else "uvw": vec3, "grad": vec3}, value_type=float, group="Volumes", hidden=True)
+
+for key, value_type in (("volume_lookup", float), ("volume_lookup_v", vec3), ("volume_lookup_i", int)):
+    add_builtin(key, input_types={"accessor": volume_accessor_t, "i": int, "j": int, "k": int}, value_type=value_type, group="Volumes", hidden=True)
+
 add_builtin("volume_transform", input_types={"id": uint64, "uvw": vec3}, value_type=vec3, group="Volumes",
     doc="""Transform a point defined in volume local-space to world space given the volume's intrinsic affine transformation.""")
 add_builtin("volume_transform_inv", input_types={"id": uint64, "xyz": vec3}, value_type=vec3, group="Volumes",
@@ -465,7 +519,8 @@ class PrintFunc:
 # helpers
 add_builtin("tid", input_types={}, value_type=int, group="Utility",
     doc="""Return the current thread id. Note that this is the *global* index of the thread in the range [0, dim) 
-   where dim is the parameter passed to kernel launch.""")
+   where dim is the parameter passed to kernel launch. For multi-dimensional launches this is the row-major
+   linear index of the thread, in this case tid() must be called from the kernel rather than a user function.""")
 
 @builtin("copy", input_types={}, hidden=True, group="Utility")
 class CopyFunc:
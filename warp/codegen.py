@@ -50,6 +50,26 @@ builtin_operators[ast.LtE] = "<="
 builtin_operators[ast.Eq] = "=="
 builtin_operators[ast.NotEq] = "!="
 
+# builtins that prevent the forward pass of a kernel from being vectorized across threads
+simd_unsafe_builtins = set(["atomic_add", "atomic_sub", "print", "printf", "expect_eq", "expect_near"])
+
+
+def simd_safe(adj, visited=None):
+    """Returns True if the forward pass of adj, including the user functions it calls, may run in SIMD batches"""
+
+    if (visited == None):
+        visited = set()
+
+    if (id(adj) in visited):
+        return True
+
+    visited.add(id(adj))
+
+    if (not adj.simd_safe):
+        return False
+
+    return all(simd_safe(f.adj, visited) for f in adj.user_calls)
+
 
 class Var:
     def __init__(self, label, type, requires_grad=False, constant=None):
@@ -83,9 +103,10 @@ class Var:
 class Adjoint:
 
 
-    def __init__(adj, func):
+    def __init__(adj, func, is_kernel=False):
 
         adj.func = func
+        adj.is_kernel = is_kernel      # kernels may be launched over a multi-dimensional grid
 
         adj.symbols = {}     # map from symbols to adjoint variables
         adj.variables = []   # list of local variables (in order)
@@ -94,6 +115,9 @@ class Adjoint:
         adj.cond = None                # condition variable if in branch
         adj.return_var = None          # return type for function or kernel
 
+        adj.simd_safe = True           # false if the body calls builtins that lanes of a SIMD batch cannot execute concurrently
+        adj.user_calls = []            # user functions called from the body, see simd_safe()
+
         # build AST from function object
         adj.source = inspect.getsource(func)
         
@@ -242,6 +266,22 @@ class Adjoint:
             else:
                 func = resolved_func
 
+        # atomics may conflict between lanes of a batch, dense builtins and user functions read
+        # the thread index through the scheduler, and prints must stay in thread order
+        if (func.key in simd_unsafe_builtins or func.key.startswith("dense_") or (func.key == "tid" and not adj.is_kernel)):
+            adj.simd_safe = False
+
+        if (hasattr(func, "adj") and func not in adj.user_calls):
+            adj.user_calls.append(func)
+
+        # inside kernels the thread index is computed once in the prologue from the launch bounds
+        if (func.key == "tid" and adj.is_kernel):
+
+            output = adj.add_var(int)
+            adj.add_forward("var_{} = var_idx;".format(output))
+
+            return output
+
         # expression (zero output), e.g.: void do_something();
         if (func.value_type(inputs) == None):
 
@@ -893,6 +933,12 @@ cpu_module_header = '''
 
 using namespace wp;
 
+// receives the core runtime's thread pool, when not set kernels execute serially
+extern "C" WP_API void cpu_set_scheduler(void* scheduler)
+{
+    s_cpu_scheduler = (cpu_scheduler_t)(scheduler);
+}
+
 '''
 
 cuda_module_header = '''
@@ -968,42 +1014,114 @@ cuda_module_template = '''
 
 extern "C" {{
 
-// Python entry points
-WP_API void {name}_cuda_forward(void* stream, {forward_args})
+// Python entry points, launched with the same block layout as cuda_launch_kernel(),
+// a block_dim of 0 selects the default size
+WP_API void {name}_cuda_forward(void* stream, int block_dim, {forward_args})
 {{
-    {name}_cuda_kernel_forward<<<(dim + 256 - 1) / 256, 256, 0, (cudaStream_t)stream>>>({forward_params});
+    if (dim.size == 0)
+        return;
+
+    unsigned int block[3];
+    unsigned int grid[3];
+
+    wp::launch_geometry(dim.shape, dim.ndim, block_dim, block, grid);
+
+    {name}_cuda_kernel_forward<<<dim3(grid[0], grid[1], grid[2]), dim3(block[0], block[1], block[2]), 0, (cudaStream_t)stream>>>({forward_params});
 }}
 
-WP_API void {name}_cuda_backward(void* stream, {reverse_args})
+WP_API void {name}_cuda_backward(void* stream, int block_dim, {reverse_args})
 {{
-    {name}_cuda_kernel_backward<<<(dim + 256 - 1) / 256, 256, 0, (cudaStream_t)stream>>>({reverse_params});
+    if (dim.size == 0)
+        return;
+
+    unsigned int block[3];
+    unsigned int grid[3];
+
+    wp::launch_geometry(dim.shape, dim.ndim, block_dim, block, grid);
+
+    {name}_cuda_kernel_backward<<<dim3(grid[0], grid[1], grid[2]), dim3(block[0], block[1], block[2]), 0, (cudaStream_t)stream>>>({reverse_params});
 }}
 
 }} // extern C
 
 '''
 
+cpu_kernel_simd_template = '''
+
+static inline void {name}_cpu_kernel_forward(int var_idx, {forward_args})
+{{
+    {forward_body}
+}}
+
+void {name}_cpu_kernel_backward({reverse_args})
+{{
+    {reverse_body}
+}}
+
+'''
+
 cpu_module_template = '''
 
 // Python CPU entry points
 WP_API void {name}_cpu_forward({forward_args})
 {{
-    for (int i=0; i < dim; ++i)
+    cpu_launch(dim.size, [&](int i)
     {{
         s_threadIdx = i;
 
         {name}_cpu_kernel_forward({forward_params});
-    }}
+    }});
 }}
 
 WP_API void {name}_cpu_backward({reverse_args})
 {{
-    for (int i=0; i < dim; ++i)
+    cpu_launch(dim.size, [&](int i)
     {{
         s_threadIdx = i;
 
         {name}_cpu_kernel_backward({reverse_params});
-    }}
+    }});
+}}
+
+'''
+
+# the forward pass is issued in batches of {width} consecutive threads, full
+# batches are a single loop the compiler vectorizes across threads with
+# masked control flow, the backward pass accumulates adjoints with atomics
+# and runs one thread per call
+cpu_module_simd_template = '''
+
+// Python CPU entry points
+WP_API void {name}_cpu_forward({forward_args})
+{{
+    const int num_batches = (dim.size + {width} - 1) / {width};
+
+    cpu_launch(num_batches, [&](int batch)
+    {{
+        const int begin = batch*{width};
+
+        if (begin + {width} <= dim.size)
+        {{
+            #pragma omp simd
+            for (int lane=0; lane < {width}; ++lane)
+                {name}_cpu_kernel_forward(begin + lane, {forward_params});
+        }}
+        else
+        {{
+            for (int i=begin; i < dim.size; ++i)
+                {name}_cpu_kernel_forward(i, {forward_params});
+        }}
+    }});
+}}
+
+WP_API void {name}_cpu_backward({reverse_args})
+{{
+    cpu_launch(dim.size, [&](int i)
+    {{
+        s_threadIdx = i;
+
+        {name}_cpu_kernel_backward({reverse_params});
+    }});
 }}
 
 '''
@@ -1013,9 +1131,9 @@ cuda_module_header_template = '''
 extern "C" {{
 
 // Python CUDA entry points
-WP_API void {name}_cuda_forward(void* stream, {forward_args});
+WP_API void {name}_cuda_forward(void* stream, int block_dim, {forward_args});
 
-WP_API void {name}_cuda_backward(void* stream, {reverse_args});
+WP_API void {name}_cuda_backward(void* stream, int block_dim, {reverse_args});
 
 }} // extern C
 '''
@@ -1070,7 +1188,7 @@ def codegen_func_forward_body(adj, device='cpu', indent=4):
     return "".join([indent_block + l for l in body])
 
 
-def codegen_func_forward(adj, func_type='kernel', device='cpu'):
+def codegen_func_forward(adj, func_type='kernel', device='cpu', simd=False):
     s = ""
 
     # primal vars
@@ -1089,12 +1207,16 @@ def codegen_func_forward(adj, func_type='kernel', device='cpu'):
     s += "    // forward\n"
 
     if device == 'cpu':
+        # batched kernels receive the thread index as an argument
+        if func_type == 'kernel' and not simd:
+            s += "    int var_idx = wp::launch_index(dim);\n"
+
         s += codegen_func_forward_body(adj, device=device, indent=4)
 
     elif device == 'cuda':
         if func_type == 'kernel':
-            s += "    int var_idx = blockDim.x * blockIdx.x + threadIdx.x;\n"
-            s += "    if (var_idx < dim) {\n"
+            s += "    int var_idx = wp::launch_index(dim);\n"
+            s += "    if (var_idx < dim.size) {\n"
 
             s += codegen_func_forward_body(adj, device=device, indent=8)
 
@@ -1149,11 +1271,14 @@ def codegen_func_reverse(adj, func_type='kernel', device='cpu'):
         s += "    " + var.ctype() + " adj_" + str(var.label) + " = 0;\n"
 
     if device == 'cpu':
+        if func_type == 'kernel':
+            s += "    int var_idx = wp::launch_index(dim);\n"
+
         s += codegen_func_reverse_body(adj, device=device, indent=4)
     elif device == 'cuda':
         if func_type == 'kernel':
-            s += "    int var_idx = blockDim.x * blockIdx.x + threadIdx.x;\n"
-            s += "    if (var_idx < dim) {\n"
+            s += "    int var_idx = wp::launch_index(dim);\n"
+            s += "    if (var_idx < dim.size) {\n"
             s += codegen_func_reverse_body(adj, device=device, indent=8)
             s += "    }\n"
         else:
@@ -1214,12 +1339,15 @@ def codegen_func(adj, device='cpu'):
     return s
 
 
-def codegen_kernel(kernel, device='cpu'):
+def codegen_kernel(kernel, device='cpu', simd_width=0):
 
     adj = kernel.adj
 
-    forward_args = "int dim"
-    reverse_args = "int dim"
+    # only kernels whose threads are independent are batched
+    simd = (device == 'cpu' and simd_width > 0 and simd_safe(adj))
+
+    forward_args = "wp::launch_bounds_t dim"
+    reverse_args = "wp::launch_bounds_t dim"
 
     # forward args
     sep = ","
@@ -1235,11 +1363,13 @@ def codegen_kernel(kernel, device='cpu'):
         sep = ", "
 
     # codegen body
-    forward_body = codegen_func_forward(adj, func_type='kernel', device=device)
+    forward_body = codegen_func_forward(adj, func_type='kernel', device=device, simd=simd)
     reverse_body = codegen_func_reverse(adj, func_type='kernel', device=device)
 
 
-    if device == 'cpu':
+    if simd:
+        template = cpu_kernel_simd_template
+    elif device == 'cpu':
         template = cpu_kernel_template
     elif device == 'cuda':
         template = cuda_kernel_template
@@ -1255,12 +1385,14 @@ def codegen_kernel(kernel, device='cpu'):
     return s
 
 
-def codegen_module(kernel, device='cpu'):
+def codegen_module(kernel, device='cpu', simd_width=0):
 
     adj = kernel.adj
 
+    simd = (device == 'cpu' and simd_width > 0 and simd_safe(adj))
+
     # build forward signature
-    forward_args = "int dim"
+    forward_args = "wp::launch_bounds_t dim"
     forward_params = "dim"
 
     sep = ","
@@ -1290,7 +1422,9 @@ def codegen_module(kernel, device='cpu'):
 
         sep = ", "
 
-    if device == 'cpu':
+    if simd:
+        template = cpu_module_simd_template
+    elif device == 'cpu':
         template = cpu_module_template
     elif device == 'cuda':
         template = cuda_module_template
@@ -1298,6 +1432,7 @@ def codegen_module(kernel, device='cpu'):
         raise ValueError("Device {} is not supported".format(device))
 
     s = template.format(name=kernel.key,
+                        width=simd_width,
                         forward_args=indent(forward_args),
                         reverse_args=indent(reverse_args),
                         forward_params=indent(forward_params, 3),
@@ -1310,7 +1445,7 @@ def codegen_module_decl(kernel, device='cpu'):
     adj = kernel.adj
 
     # build forward signature
-    forward_args = "int dim"
+    forward_args = "wp::launch_bounds_t dim"
     forward_params = "dim"
 
     sep = ","
@@ -24,3 +24,13 @@ verbose = False
 host_compiler = None    # user can specify host compiler here, otherwise will attempt to find one automatically
 
 cache_kernels = True
+kernel_cache_dir = None # directory of compiled kernels, may be shared by many processes, if None the WARP_CACHE_PATH env var is used, otherwise warp/bin
+cuda_output = "cubin"   # "cubin" compiles kernels for the architecture of the device, "ptx" compiles for compute_52 and JIT compiles at load time
+targets = None          # targets that modules are compiled for by default, e.g.: ["cuda"], if None modules are compiled for all available targets
+build_threads = 0       # number of threads used to compile modules concurrently, 0 will use one per hardware thread
+
+cache_allocations = True # if true array memory will be returned to a size-bucketed pool on free and reused by later allocations
+
+cpu_parallel = True     # if true CPU launches will be distributed across a pool of worker threads
+cpu_threads = 0         # number of threads used for CPU launches (including the launching thread), 0 will use all hardware threads
+cpu_simd = None         # instruction set CPU kernels are vectorized for, "avx2", "avx512", "neon", or "auto" for the best one the host supports, if None each call of a CPU kernel runs one thread
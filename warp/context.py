@@ -11,6 +11,8 @@ import sys
 import inspect
 import hashlib
 import ctypes
+import threading
+import concurrent.futures
 
 from typing import Tuple
 from typing import List
@@ -23,6 +25,7 @@ from warp.utils import *
 import warp.codegen
 import warp.build
 import warp.config
+import warp.profiler
 
 # represents either a built-in or user-defined function
 class Function:
@@ -58,10 +61,11 @@ class Kernel:
         self.forward_cpu = None
         self.backward_cpu = None
         
-        self.forward_cuda = None
-        self.backward_cuda = None
+        # CUDA entry points per device ordinal as (forward, backward, forward_block_dim, backward_block_dim)
+        # tuples, the default block sizes are queried from the occupancy calculator after load
+        self.cuda_hooks = {}
 
-        self.adj = warp.codegen.Adjoint(func)
+        self.adj = warp.codegen.Adjoint(func, is_kernel=True)
 
         if (module):
             module.register_kernel(self)
@@ -70,7 +74,6 @@ class Kernel:
     def hook(self):
 
         dll = self.module.dll
-        cuda = self.module.cuda
 
         if (dll):
 
@@ -80,13 +83,42 @@ class Kernel:
             except:
                 print(f"Could not load CPU methods for kernel {self.key}")
 
-        if (cuda):
+        # functions are looked up in the module loaded on each device
+        for ordinal, cuda in self.module.cuda_modules.items():
+
+            if (ordinal in self.cuda_hooks):
+                continue
 
             try:
-                self.forward_cuda = runtime.core.cuda_get_kernel(self.module.cuda, (self.key + "_cuda_kernel_forward").encode('utf-8'))
-                self.backward_cuda = runtime.core.cuda_get_kernel(self.module.cuda, (self.key + "_cuda_kernel_backward").encode('utf-8'))
+                with ScopedDevice(runtime.cuda_devices[ordinal]):
+
+                    forward = runtime.core.cuda_get_kernel(cuda, (self.key + "_cuda_kernel_forward").encode('utf-8'))
+                    backward = runtime.core.cuda_get_kernel(cuda, (self.key + "_cuda_kernel_backward").encode('utf-8'))
+
+                    self.cuda_hooks[ordinal] = (forward,
+                                                backward,
+                                                runtime.core.cuda_get_kernel_block_dim(forward),
+                                                runtime.core.cuda_get_kernel_block_dim(backward))
             except:
-                print(f"Could not load CUDA methods for kernel {self.key}")
+                print(f"Could not load CUDA methods for kernel {self.key} on device {runtime.cuda_devices[ordinal]}")
+
+    def is_bound(self, device):
+        """Returns whether the kernel's entry points for ``device`` are loaded, ``device`` must be a canonical device name"""
+
+        if (device == "cpu"):
+            return self.forward_cpu != None
+        else:
+            return get_device_ordinal(device) in self.cuda_hooks
+
+    def get_cuda_function(self, device, adjoint=False):
+        """Returns the ``(function, block_dim)`` pair of the forward or backward entry point loaded on a CUDA device"""
+
+        forward, backward, forward_block_dim, backward_block_dim = self.cuda_hooks[get_device_ordinal(device)]
+
+        if (adjoint):
+            return (backward, backward_block_dim)
+        else:
+            return (forward, forward_block_dim)
 
 
 #----------------------
@@ -151,6 +183,53 @@ def get_module(m):
 # creates a hash of the function to use for checking
 # build cache
 
+# serializes code generation, which shares state between modules, while builds run concurrently
+codegen_lock = threading.RLock()
+
+def get_build_threads():
+
+    if (warp.config.build_threads > 0):
+        return warp.config.build_threads
+
+    return os.cpu_count() or 1
+
+# runs (module, task) build tasks on a thread pool, compilers release the GIL (host compiler
+# processes and nvrtc calls) so builds of different modules and targets overlap, modules
+# whose builds fail are marked, after all tasks completed the first failure is raised, or
+# if an errors list is given every (module, exception) failure is appended to it instead
+def run_build_tasks(tasks, errors=None):
+
+    if (len(tasks) == 0):
+        return
+
+    failures = []
+
+    if (len(tasks) == 1):
+        module, task = tasks[0]
+        try:
+            module.build_target(*task)
+        except Exception as e:
+            module.build_failed = True
+            failures.append((module, e))
+
+    else:
+        with concurrent.futures.ThreadPoolExecutor(max_workers=min(len(tasks), get_build_threads())) as executor:
+
+            futures = { executor.submit(module.build_target, *task): module for module, task in tasks }
+
+            for future in concurrent.futures.as_completed(futures):
+                try:
+                    future.result()
+                except Exception as e:
+                    futures[future].build_failed = True
+                    failures.append((futures[future], e))
+
+    if (errors is not None):
+        errors.extend(failures)
+    elif (len(failures)):
+        raise failures[0][1]
+
+
 class Module:
 
     def __init__(self, name):
@@ -160,13 +239,23 @@ class Module:
         self.functions = {}
 
         self.dll = None
-        self.cuda = None
+
+        # loaded CUDA modules per device ordinal, and per CUDA binary the ordinals it is loaded on
+        self.cuda_modules = {}
+        self.cuda_targets = {}
 
         self.loaded = False
         self.build_failed = False
+        self.adjoints_built = False
 
         self.options = {"max_unroll": 16,
-                        "mode": warp.config.mode}
+                        "mode": warp.config.mode,
+                        "cpu_parallel": warp.config.cpu_parallel,
+                        "cpu_simd": warp.config.cpu_simd,
+                        "targets": warp.config.targets}
+
+        # instruction set the CPU kernels are vectorized for, resolved in prepare_build()
+        self.cpu_simd = None
 
     def register_kernel(self, kernel):
 
@@ -177,11 +266,15 @@ class Module:
             if (self.dll):
                 warp.build.unload_dll(self.dll)
 
-            if (self.cuda):
-                runtime.core.cuda_unload_module(self.cuda)
-                
+            for ordinal, cuda in self.cuda_modules.items():
+                with ScopedDevice(runtime.cuda_devices[ordinal]):
+                    runtime.core.cuda_unload_module(cuda)
+
+            for k in self.kernels.values():
+                k.cuda_hooks = {}
+
             self.dll = None
-            self.cuda = None
+            self.cuda_modules = {}
             self.loaded = False
 
         # register new kernel
@@ -207,6 +300,11 @@ class Module:
 
         # configuration parameters
         for k in sorted(self.options.keys()):
+
+            # targets select which binaries are built but don't change their contents
+            if (k == "targets"):
+                continue
+
             s = f"{k}={self.options[k]}"
             h.update(bytes(s, 'utf-8'))
         
@@ -215,153 +313,215 @@ class Module:
 
         return h.digest()
 
-    def load(self):
+    def load_cpu(self, dll_path):
 
-        # early out to avoid repeatedly attemping to rebuild
-        if (self.build_failed == True):
-            return False
+        self.dll = warp.build.load_dll(dll_path)
 
-        with ScopedTimer(f"Module {self.name} load"):
+        # hand the core runtime's thread pool to the module so launches are split across threads
+        if (self.dll and self.options["cpu_parallel"]):
+            self.dll.cpu_set_scheduler(ctypes.cast(runtime.core.cpu_parallel_for, ctypes.c_void_p))
 
-            enable_cpu = warp.is_cpu_available()
-            enable_cuda = warp.is_cuda_available()
+    # key over everything that affects a compiled binary, cache entries are named by it so they
+    # never go stale and processes sharing a cache directory only ever write identical files
+    def cache_key(self, module_hash, *args):
 
-            module_name = "wp_" + self.name
+        h = hashlib.sha256(module_hash)
 
-            include_path = os.path.dirname(os.path.realpath(__file__))
-            build_path = os.path.join(os.path.dirname(os.path.realpath(__file__)), "bin")
-            gen_path = os.path.join(os.path.dirname(os.path.realpath(__file__)), "gen")
+        # fields are length prefixed so that different splits of the same characters give different keys
+        for a in (warp.config.version,) + args:
+            b = bytes(str(a), 'utf-8')
+            h.update(len(b).to_bytes(8, 'little'))
+            h.update(b)
 
-            cache_path = os.path.join(build_path, module_name + ".hash")
-            module_path = os.path.join(build_path, module_name)
+        return h.hexdigest()[:16]
 
-            ptx_path = module_path + ".ptx"
+    def build_adjoints(self):
 
-            if (os.name == 'nt'):
-                dll_path = module_path + ".dll"
-            else:
-                dll_path = module_path + ".so"
+        for func in self.functions.values():
+
+            func.adj.build(builtin_functions, self.functions, self.options)
+
+            # complete the function return type after we have analyzed it (inferred from return statement in ast)
+            def wrap(adj):
+                def value_type(args):
+                    if (adj.return_var):
+                        return adj.return_var.type
+                    else:
+                        return None
+
+                return value_type
+
+            func.value_type = wrap(func.adj)
+
+        for kernel in self.kernels.values():
+            kernel.adj.build(builtin_functions, self.functions, self.options)
+
+    def codegen(self, device):
+
+        if (device == "cpu"):
+            source = warp.codegen.cpu_module_header
+        else:
+            source = warp.codegen.cuda_module_header
 
-            if (os.path.exists(build_path) == False):
-                os.mkdir(build_path)
+        # functions
+        for func in self.functions.values():
+            source += warp.codegen.codegen_func(func.adj, device=device)
+
+        simd_width = warp.build.simd_widths[self.cpu_simd] if (device == "cpu" and self.cpu_simd) else 0
+
+        # kernels, each kernel gets an entry point in the module
+        for kernel in self.kernels.values():
+
+            if (device == "cpu"):
+                source += warp.codegen.codegen_module_decl(kernel, device="cpu")
 
-            # test cache
-            module_hash = self.hash_module()
+            source += warp.codegen.codegen_kernel(kernel, device=device, simd_width=simd_width)
+            source += warp.codegen.codegen_module(kernel, device=device, simd_width=simd_width)
 
-            if warp.config.cache_kernels and os.path.exists(cache_path):
+        return source
 
-                f = open(cache_path, 'rb')
-                cache_hash = f.read()
-                f.close()
+    # builds output_path unless a valid cache entry exists, sources are only generated when building,
+    # may be called concurrently for different targets and modules from the build thread pool
+    def build_target(self, device, output_path, source_path, build_func):
 
-                if (cache_hash == module_hash):
-                    
-                    if (warp.config.verbose):
-                        print("Warp: Using cached kernels for module {}".format(self.name))
-                        
-                    if (enable_cpu):
-                        self.dll = warp.build.load_dll(dll_path)
-                        
-                        if (self.dll == None):
-                            raise Exception(f"Could not load dll from cache {dll_path}")
+        with warp.build.CacheLock(output_path + ".lock"):
 
-                    if (enable_cuda):
-                        self.cuda = warp.build.load_cuda(ptx_path)
+            # another process may have built the entry while we waited for the lock
+            if (warp.config.cache_kernels and os.path.exists(output_path)):
 
-                        if (self.cuda == None):
-                            raise Exception(f"Could not load ptx from cache path: {ptx_path}")
+                if (warp.config.verbose):
+                    print(f"Warp: Using cached {device} kernels for module {self.name}")
 
-                    self.loaded = True
-                    return
+                return
 
             if (warp.config.verbose):
-                print("Warp: Rebuilding kernels for module {}".format(self.name))
+                print(f"Warp: Rebuilding {device} kernels for module {self.name}")
 
+            # code generation is not thread-safe, only the compilers run concurrently
+            with codegen_lock:
 
-            # generate kernel source
-            if (enable_cpu):
-                cpp_path = os.path.join(gen_path, module_name + ".cpp")
-                cpp_source = warp.codegen.cpu_module_header
-            
-            if (enable_cuda):
-                cu_path = os.path.join(gen_path, module_name + ".cu")
-                cu_source = warp.codegen.cuda_module_header
+                if (not self.adjoints_built):
+                    self.build_adjoints()
+                    self.adjoints_built = True
 
-            # kernels
-            entry_points = []
+                warp.build.write_file_atomic(source_path, self.codegen(device))
 
-            # functions
-            for name, func in self.functions.items():
-            
-                func.adj.build(builtin_functions, self.functions, self.options)
-                
-                if (enable_cpu):
-                    cpp_source += warp.codegen.codegen_func(func.adj, device="cpu")
+            tmp_path = warp.build.temp_path(output_path)
+            build_func(source_path, tmp_path)
 
-                if (enable_cuda):
-                    cu_source += warp.codegen.codegen_func(func.adj, device="cuda")
+            warp.build.commit_file(tmp_path, output_path)
 
-                # complete the function return type after we have analyzed it (inferred from return statement in ast)
-                def wrap(adj):
-                    def value_type(args):
-                        if (adj.return_var):
-                            return adj.return_var.type
-                        else:
-                            return None
+    def get_targets(self):
 
-                    return value_type
+        targets = self.options["targets"] or ("cpu", "cuda")
 
-                func.value_type = wrap(func.adj)
+        enable_cpu = warp.is_cpu_available() and "cpu" in targets
+        enable_cuda = warp.is_cuda_available() and "cuda" in targets
 
+        return enable_cpu, enable_cuda
 
-            # kernels
-            for kernel in self.kernels.values():
+    # returns the build tasks of the module as (device, output_path, source_path, build_func) tuples
+    def prepare_build(self):
 
-                kernel.adj.build(builtin_functions, self.functions, self.options)
+        enable_cpu, enable_cuda = self.get_targets()
 
-                # each kernel gets an entry point in the module
-                if (enable_cpu):
-                    entry_points.append(kernel.func.__name__ + "_cpu_forward")
-                    entry_points.append(kernel.func.__name__ + "_cpu_backward")
+        module_name = "wp_" + self.name
 
-                    cpp_source += warp.codegen.codegen_module_decl(kernel, device="cpu")
-                    cpp_source += warp.codegen.codegen_kernel(kernel, device="cpu")
-                    cpp_source += warp.codegen.codegen_module(kernel, device="cpu")
+        cache_path = get_kernel_cache_dir()
+        gen_path = os.path.join(os.path.dirname(os.path.realpath(__file__)), "gen")
 
-                if (enable_cuda):                
-                    entry_points.append(kernel.func.__name__ + "_cuda_forward")
-                    entry_points.append(kernel.func.__name__ + "_cuda_backward")
+        os.makedirs(cache_path, exist_ok=True)
+        os.makedirs(gen_path, exist_ok=True)
 
-                    cu_source += warp.codegen.codegen_kernel(kernel, device="cuda")
-                    cu_source += warp.codegen.codegen_module(kernel, device="cuda")
+        module_hash = self.hash_module()
+        self.adjoints_built = False
 
+        tasks = []
 
-            # write cpp sources
-            if (enable_cpu):
-                cpp_file = open(cpp_path, "w")
-                cpp_file.write(cpp_source)
-                cpp_file.close()
+        if (enable_cpu):
+
+            cpu_simd = warp.build.resolve_cpu_simd(self.options["cpu_simd"])
+            self.cpu_simd = cpu_simd
+
+            cpu_compiler, cpu_flags = warp.build.host_compile_flags(self.options["mode"], cpu_simd)
+            cpu_key = self.cache_key(module_hash, "cpu", cpu_compiler, warp.build.host_compiler_version(cpu_compiler), cpu_flags, cpu_simd)
+            dll_path = os.path.join(cache_path, f"{module_name}_{cpu_key}" + (".dll" if os.name == 'nt' else ".so"))
+            cpp_path = os.path.join(gen_path, f"{module_name}_{cpu_key}.cpp")
+
+            def build_cpu(src, out):
+                with ScopedTimer(f"Compile x86 {self.name}", active=warp.config.verbose):
+                    warp.build.build_dll(src, None, out, config=self.options["mode"], force=True, simd=cpu_simd)
+
+            tasks.append(("cpu", dll_path, cpp_path, build_cpu))
+
+        self.cuda_targets = {}
+
+        if (enable_cuda):
+
+            cuda_ptx = (warp.config.cuda_output == "ptx")
+
+            # one binary per distinct architecture, loaded on every device of that architecture
+            for ordinal in range(len(runtime.cuda_devices)):
+
+                cuda_arch = warp.build.PTX_FALLBACK_ARCH if cuda_ptx else runtime.core.cuda_get_device_arch(ordinal)
+
+                cuda_key = self.cache_key(module_hash, "cuda", cuda_arch, cuda_ptx, runtime.core.nvrtc_get_version())
+                cuda_path = os.path.join(cache_path, f"{module_name}_{cuda_key}" + (".ptx" if cuda_ptx else ".cubin"))
+                cu_path = os.path.join(gen_path, f"{module_name}_{cuda_key}.cu")
+
+                if (cuda_path in self.cuda_targets):
+                    self.cuda_targets[cuda_path].append(ordinal)
+                    continue
+
+                self.cuda_targets[cuda_path] = [ordinal]
+
+                def build_cuda(src, out, cuda_arch=cuda_arch):
+                    with ScopedTimer(f"Compile CUDA {self.name} (sm_{cuda_arch})", active=warp.config.verbose):
+                        warp.build.build_cuda(src, out, cuda_arch, ptx=cuda_ptx, config=self.options["mode"])
+
+                tasks.append(("cuda", cuda_path, cu_path, build_cuda))
+
+        return tasks
+
+    # loads built binaries, CUDA modules must be loaded from the thread that owns the contexts
+    def finish_load(self, tasks):
+
+        for device, output_path, source_path, build_func in tasks:
+
+            if (device == "cpu"):
+                self.load_cpu(output_path)
+
+                if (self.dll == None):
+                    raise Exception(f"Could not load dll from cache {output_path}")
+
+            else:
+                for ordinal in self.cuda_targets[output_path]:
+
+                    with ScopedDevice(runtime.cuda_devices[ordinal]):
+                        cuda = warp.build.load_cuda(output_path)
+
+                    if (cuda == None):
+                        raise Exception(f"Could not load CUDA module from cache path: {output_path} on device {runtime.cuda_devices[ordinal]}")
+
+                    self.cuda_modules[ordinal] = cuda
+
+        self.loaded = True
+
+    def load(self):
+
+        # early out to avoid repeatedly attemping to rebuild
+        if (self.build_failed == True):
+            return False
+
+        with ScopedTimer(f"Module {self.name} load"):
 
-            # write cuda sources
-            if (enable_cuda):
-                cu_file = open(cu_path, "w")
-                cu_file.write(cu_source)
-                cu_file.close()
-        
             try:
-                
-                if (enable_cpu):
-                    with ScopedTimer("Compile x86", active=warp.config.verbose):
-                        warp.build.build_dll(cpp_path, None, dll_path, config=self.options["mode"])
+                tasks = self.prepare_build()
 
-                if (enable_cuda):
-                    with ScopedTimer("Compile CUDA", active=warp.config.verbose):
-                        warp.build.build_cuda(cu_path, ptx_path, config=self.options["mode"])
+                # CPU and CUDA targets are compiled concurrently
+                run_build_tasks([(self, t) for t in tasks])
 
-                # update cached output
-                f = open(cache_path, 'wb')
-                f.write(module_hash)
-                f.close()
+                self.finish_load(tasks)
 
             except Exception as e:
 
@@ -370,13 +530,6 @@ class Module:
                 print(e)
                 raise(e)
 
-            if (enable_cpu):
-                self.dll = warp.build.load_dll(dll_path)
-
-            if (enable_cuda):
-                self.cuda = warp.build.load_cuda(ptx_path)
-
-            self.loaded = True
             return True
 
 #-------------------------------------------
@@ -386,38 +539,149 @@ class Module:
 # on size to avoid hitting the system allocator
 class Allocator:
 
-    def __init__(self, alloc_func, free_func):
+    # allocations of at least this size are rounded up to a fraction of their
+    # power-of-two size, smaller allocations are rounded up to the minimum block
+    min_block_size = 256
+    bins_per_octave = 4
+
+    def __init__(self, alloc_func, free_func, caching=True):
 
         # map from sizes to array of allocs
         self.alloc_func = alloc_func
         self.free_func = free_func
 
-        # map from size->list[allocs]
+        self.caching = caching
+
+        # map from size->list[(alloc, fence)]
         self.pool = {}
 
+        # blocks handed out while the cache was bypassed, these are returned to the system on free
+        self.uncached = set()
+
+        self.reset_stats()
+
     def __del__(self):
         self.clear()       
 
+    @staticmethod
+    def block_size(size_in_bytes):
+
+        if size_in_bytes <= Allocator.min_block_size:
+            return Allocator.min_block_size
+
+        # round up to one of bins_per_octave sizes between consecutive powers of two
+        step = max(Allocator.min_block_size, (1 << (size_in_bytes.bit_length()-1))//Allocator.bins_per_octave)
+        return ((size_in_bytes + step - 1)//step)*step
+
+    def reset_stats(self):
+
+        self.bytes_in_use = 0       # bytes in blocks handed out to arrays
+        self.bytes_requested = 0    # bytes requested by arrays currently alive
+        self.bytes_cached = 0       # bytes in blocks waiting in the pool
+        self.high_water_mark = 0    # peak of bytes_in_use + bytes_cached
+        self.num_hits = 0
+        self.num_misses = 0
+
+    def bypass(self):
+        """True if allocations should currently go to the system rather than the pool"""
+        return False
+
+    def fence(self, streams=None):
+        """Returns an object marking the point at which a block is freed, passed to wait() before the block is reused
+
+        Args:
+            streams: The :class:`Stream` objects the block was used on, see :attr:`warp.array.streams`
+        """
+        return None
+
+    def wait(self, fence):
+        """Orders work that uses a reused block after the work issued before it was freed"""
+        pass
+
+    def release(self, fence):
+        """Called when the block of a fence is reused or returned to the system"""
+        pass
+
     def alloc(self, size_in_bytes):
-        
-        p = self.alloc_func(size_in_bytes)
+
+        if not self.caching or size_in_bytes == 0:
+            return self.alloc_func(size_in_bytes)
+
+        if self.bypass():
+            p = self.alloc_func(size_in_bytes)
+            if p != None:
+                self.uncached.add(p)
+            return p
+
+        block = Allocator.block_size(size_in_bytes)
+        blocks = self.pool.get(block)
+
+        if blocks:
+            p, fence = blocks.pop()
+            self.wait(fence)
+            self.release(fence)
+            self.bytes_cached -= block
+            self.num_hits += 1
+        else:
+            p = self.alloc_func(block)
+
+            # return cached memory to the system and retry once before failing
+            if p == None and self.bytes_cached > 0:
+                self.trim()
+                p = self.alloc_func(block)
+
+            if p == None:
+                return None
+
+            self.num_misses += 1
+
+        self.bytes_in_use += block
+        self.bytes_requested += size_in_bytes
+        self.high_water_mark = max(self.high_water_mark, self.bytes_in_use + self.bytes_cached)
+
         return p
 
-        # if size_in_bytes in self.pool and len(self.pool[size_in_bytes]) > 0:            
-        #     return self.pool[size_in_bytes].pop()
-        # else:
-        #     return self.alloc_func(size_in_bytes)
+    def free(self, addr, size_in_bytes, streams=None):
 
-    def free(self, addr, size_in_bytes):
+        if not self.caching or size_in_bytes == 0:
+            self.free_func(ctypes.cast(addr, ctypes.c_void_p))
+            return
 
-        addr = ctypes.cast(addr, ctypes.c_void_p)
-        self.free_func(addr)
-        return
+        if addr in self.uncached:
+            self.uncached.remove(addr)
+            self.free_func(ctypes.cast(addr, ctypes.c_void_p))
+            return
+
+        # cached blocks are returned to the pool rather than the system, this keeps
+        # frees inside a CUDA graph capture from issuing driver calls
+        block = Allocator.block_size(size_in_bytes)
+
+        if block not in self.pool:
+            self.pool[block] = [(addr, self.fence(streams)),]
+        else:
+            self.pool[block].append((addr, self.fence(streams)))
+
+        self.bytes_in_use -= block
+        self.bytes_requested -= size_in_bytes
+        self.bytes_cached += block
+
+    def stats(self):
+        """Returns a dictionary of allocator statistics in bytes, ``fragmentation`` is 
+        the fraction of in-use block memory lost to rounding up to block sizes
+        """        
+
+        if self.bytes_in_use > 0:
+            fragmentation = 1.0 - self.bytes_requested/self.bytes_in_use
+        else:
+            fragmentation = 0.0
 
-        # if size_in_bytes not in self.pool:
-        #     self.pool[size_in_bytes] = [addr,]
-        # else:
-        #     self.pool[size_in_bytes].append(addr)
+        return {"bytes_in_use": self.bytes_in_use,
+                "bytes_requested": self.bytes_requested,
+                "bytes_cached": self.bytes_cached,
+                "high_water_mark": self.high_water_mark,
+                "fragmentation": fragmentation,
+                "num_hits": self.num_hits,
+                "num_misses": self.num_misses}
 
     def print(self):
         
@@ -429,13 +693,308 @@ class Allocator:
 
         print(f"total size: {total_size}")
 
+    def trim(self, max_cached_bytes=0):
+        """Release cached blocks back to the system until at most max_cached_bytes remain, largest blocks first"""
+
+        for block in sorted(self.pool.keys(), reverse=True):
+
+            blocks = self.pool[block]
+
+            while blocks and self.bytes_cached > max_cached_bytes:
+                addr, fence = blocks.pop()
+                self.free_func(ctypes.cast(addr, ctypes.c_void_p))
+                self.release(fence)
+                self.bytes_cached -= block
+
+            if not blocks:
+                del self.pool[block]
 
     def clear(self):
         for s in self.pool.values():
-            for a in s:
-                self.free_func(a)
+            for a, fence in s:
+                self.free_func(ctypes.cast(a, ctypes.c_void_p))
+                self.release(fence)
         
         self.pool = {}
+        self.bytes_cached = 0
+
+
+class DeviceAllocator(Allocator):
+    """Caching allocator of a CUDA device, a block is reused only after the work issued before its free to
+    each stream that used it, and the cache is bypassed during graph capture
+
+    Args:
+        runtime: The runtime owning the allocator
+        ordinal: Ordinal of the CUDA device
+    """
+
+    def __init__(self, runtime, ordinal, alloc_func, free_func, caching=True):
+
+        self.runtime = runtime
+        self.ordinal = ordinal
+
+        # recycled events, recording and waiting on an event does not require creating one per free
+        self.events = []
+
+        super().__init__(alloc_func, free_func, caching)
+
+    def __del__(self):
+        super().__del__()
+
+        for e in self.events:
+            self.runtime.core.cuda_event_destroy(e)
+
+        self.events = []
+
+    def bypass(self):
+        # blocks cached before a capture may still be in use by work that is
+        # not part of the graph, allocations during capture go to the driver
+        return self.runtime.capturing
+
+    def end_capture(self):
+        """Fences the blocks freed during a capture, these are ordered after the work issued once the capture ends"""
+
+        for blocks in self.pool.values():
+            for addr, fence in blocks:
+                for i, (stream, event) in enumerate(fence):
+                    if event is None:
+                        fence[i] = (stream, self.record(stream))
+
+    def record(self, stream):
+
+        # recording an event during capture would add it to the graph
+        if self.runtime.capturing:
+            return None
+
+        core = self.runtime.core
+
+        if self.events:
+            event = self.events.pop()
+        else:
+            core.cuda_set_device(self.ordinal)
+            event = core.cuda_event_create(False)
+            core.cuda_set_device(self.runtime.cuda_ordinal)
+
+        core.cuda_event_record(event, stream.handle)
+
+        return event
+
+    def fence(self, streams=None):
+
+        # the block may still be in use on the current stream and on any stream an array used it on,
+        # the fence holds one (stream, event) pair for each of them, referencing the Stream objects
+        # keeps their handles alive until the fence is released
+        current = self.runtime.streams[self.ordinal]
+
+        used = [current]
+        if streams:
+            used.extend(s for s in streams if s.handle != current.handle)
+
+        return [(s, self.record(s)) for s in used]
+
+    def wait(self, fence):
+
+        if fence is None:
+            return
+
+        # work on the same stream is already ordered after the free
+        current = self.runtime.streams[self.ordinal].handle
+
+        for stream, event in fence:
+            if current != stream.handle and event is not None:
+                self.runtime.core.cuda_stream_wait_event(current, event)
+
+    def release(self, fence):
+
+        if fence is None:
+            return
+
+        for stream, event in fence:
+            if event is not None:
+                self.events.append(event)
+
+class Event:
+    """A CUDA event, used to synchronize streams or to time work on the device
+
+    Args:
+        enable_timing: Whether the event records timestamps for :func:`Event.elapsed_time`
+        device: The CUDA device the event is created on, events can only be recorded on streams of the same device
+    """
+
+    def __init__(self, enable_timing: bool=False, device: str="cuda"):
+
+        self.device = get_device(device) if runtime.cuda_devices else None
+
+        with ScopedDevice(self.device):
+            self.handle = runtime.core.cuda_event_create(enable_timing)
+
+    def __del__(self):
+        if self.handle:
+            with ScopedDevice(self.device):
+                runtime.core.cuda_event_destroy(self.handle)
+
+    def synchronize(self):
+        """Block the calling thread until the work captured by the event has completed"""
+        runtime.core.cuda_event_synchronize(self.handle)
+
+    def elapsed_time(self, end) -> float:
+        """Returns the time in milliseconds between this event and ``end``, both events must be created with ``enable_timing=True``"""
+        return runtime.core.cuda_event_elapsed_time(self.handle, end.handle)
+
+
+class Stream:
+    """A CUDA stream, work issued to different streams may execute concurrently
+
+    Arrays must not be accessed on one stream while another stream is
+    writing to them, use :func:`Stream.wait_event` or :func:`Stream.wait_stream` to order work between streams.
+    Streams belong to a CUDA device, work issued while a stream is current must be on that device. Streams of
+    different devices may be ordered with events, e.g.: ``s1.wait_event(s0.record_event())``.
+
+    Args:
+        device: The CUDA device the stream is created on
+    """
+
+    def __init__(self, handle=None, device: str="cuda"):
+
+        # streams wrapping an existing handle (e.g.: the default stream) do not own it
+        if handle is not None:
+            self.handle = handle
+            self.owner = False
+            self.device = device
+        else:
+            self.device = get_device(device) if runtime.cuda_devices else None
+
+            with ScopedDevice(self.device):
+                self.handle = runtime.core.cuda_stream_create()
+            self.owner = True
+
+    def __del__(self):
+        if self.owner and self.handle:
+            with ScopedDevice(self.device):
+                runtime.core.cuda_stream_destroy(self.handle)
+
+    def record_event(self, event: Event=None) -> Event:
+        """Record an event on the stream, a new event is created on the stream's device if none is given"""
+
+        if event is None:
+            event = Event(device=self.device)
+
+        runtime.core.cuda_event_record(event.handle, self.handle)
+        return event
+
+    def wait_event(self, event: Event):
+        """Make future work on this stream wait until ``event`` has completed, does not block the calling thread"""
+        runtime.core.cuda_stream_wait_event(self.handle, event.handle)
+
+    def wait_stream(self, other):
+        """Make future work on this stream wait for all work currently issued to ``other``"""
+        self.wait_event(other.record_event())
+
+    def synchronize(self):
+        """Block the calling thread until all work on the stream has completed"""
+        runtime.core.cuda_stream_synchronize(self.handle)
+
+
+class ReadbackBuffer:
+    """Copies a ``cuda`` array back to the host asynchronously through a ring of pinned buffers
+
+    Each :func:`push` issues a device to host copy into the next buffer and returns immediately, :func:`pop` waits
+    for the oldest outstanding copy and returns its contents. With the default two buffers the readback of one
+    simulation step overlaps the launches of the next, e.g.: ::
+
+        readback = wp.ReadbackBuffer(n, dtype=wp.vec3)
+
+        for i in range(num_frames):
+            simulate()
+            readback.push(state.particle_q)
+
+            if i > 0:
+                export(readback.pop())
+
+    A producer that pushes faster than it pops falls back to synchronous copies into host arrays, at most
+    ``max_ready`` of them are kept and a :func:`push` beyond that limit raises rather than growing host memory
+    without bound, pop the outstanding copies or use more buffers to keep the readback non-blocking.
+
+    Args:
+        n: Number of elements in each buffer
+        dtype: Type of each element
+        num_buffers: Number of copies that may be in flight at once
+        max_ready: Number of completed copies that may be held beyond the buffers while waiting for :func:`pop`
+    """
+
+    def __init__(self, n: int, dtype=float, num_buffers: int=2, max_ready: int=16):
+
+        if num_buffers < 1:
+            raise RuntimeError("ReadbackBuffer requires at least one buffer")
+
+        self.max_ready = max_ready
+
+        self.buffers = [empty(n, dtype=dtype, device="cpu", pinned=True) for i in range(num_buffers)]
+        self.events = {}
+
+        # ring of buffer indices with copies in flight, oldest first
+        self.pending = []
+        self.next = 0
+
+        # completed copies moved out of their buffer by a push that needed it, older than any pending copy
+        self.ready = []
+
+    def push(self, src: warp.array, stream: Stream=None):
+        """Enqueue a copy of ``src`` on ``stream`` (or the current stream)
+
+        If all buffers are in flight this waits for the oldest copy and moves its contents to a host array
+        owned by this object before the buffer is reused, so no copy is lost and :func:`pop` still returns it.
+        Raises if ``max_ready`` copies have already been moved out this way and not popped.
+        """
+
+        if len(self.pending) == len(self.buffers):
+
+            if len(self.ready) >= self.max_ready:
+                raise RuntimeError(f"ReadbackBuffer.push() would hold more than {self.max_ready} completed copies, pop() them before pushing more")
+
+            i, event = self.pending.pop(0)
+            event.synchronize()
+
+            self.ready.append(self.buffers[i].numpy().copy())
+
+        i = self.next
+        self.next = (self.next + 1)%len(self.buffers)
+
+        copy(self.buffers[i], src, stream=stream)
+
+        # the copy is issued on the source device, events are created per device on first use
+        stream = stream or runtime.streams[get_device_ordinal(src.device)]
+
+        event = self.events.get((i, stream.device))
+        if event is None:
+            event = Event(device=stream.device)
+            self.events[(i, stream.device)] = event
+
+        stream.record_event(event)
+
+        self.pending.append((i, event))
+
+    def pop(self):
+        """Wait for the oldest outstanding copy and return it as a NumPy array
+
+        Copies are returned in the order they were pushed, the result aliases a pinned buffer that is reused by later
+        pushes unless the copy had already been moved out of its buffer by :func:`push`.
+        """
+
+        if self.ready:
+            return self.ready.pop(0)
+
+        if not self.pending:
+            raise RuntimeError("ReadbackBuffer.pop() called with no copies in flight")
+
+        i, event = self.pending.pop(0)
+        event.synchronize()
+
+        return self.buffers[i].numpy()
+
+    def __len__(self):
+        return len(self.ready) + len(self.pending)
+
 
 class Runtime:
 
@@ -472,49 +1031,123 @@ class Runtime:
         # setup c-types for warp.dll
         self.core.alloc_host.restype = ctypes.c_void_p
         self.core.alloc_device.restype = ctypes.c_void_p
+        self.core.alloc_pinned.restype = ctypes.c_void_p
+        self.core.free_pinned.argtypes = [ctypes.c_void_p]
         
         self.core.mesh_create_host.restype = ctypes.c_uint64
-        self.core.mesh_create_host.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+        self.core.mesh_create_host.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
 
         self.core.mesh_create_device.restype = ctypes.c_uint64
-        self.core.mesh_create_device.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+        self.core.mesh_create_device.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_int]
 
         self.core.mesh_destroy_host.argtypes = [ctypes.c_uint64]
         self.core.mesh_destroy_device.argtypes = [ctypes.c_uint64]
 
         self.core.mesh_refit_host.argtypes = [ctypes.c_uint64]
         self.core.mesh_refit_device.argtypes = [ctypes.c_uint64]
+        self.core.mesh_refit_partial_host.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_int]
+        self.core.mesh_refit_partial_device.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_int]
 
-        self.core.hash_grid_create_host.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+        self.core.mesh_update_host.restype = ctypes.c_bool
+        self.core.mesh_update_host.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_bool, ctypes.c_int, ctypes.c_int, ctypes.c_float]
+        self.core.mesh_update_device.restype = ctypes.c_bool
+        self.core.mesh_update_device.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int, ctypes.c_bool, ctypes.c_int, ctypes.c_int, ctypes.c_float]
+
+        self.core.mesh_query_rays_host.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_bool, ctypes.c_bool, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+        self.core.mesh_query_rays_device.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_bool, ctypes.c_bool, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p]
+
+        self.core.hash_grid_create_host.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_bool]
         self.core.hash_grid_create_host.restype = ctypes.c_uint64
         self.core.hash_grid_destroy_host.argtypes = [ctypes.c_uint64]
         self.core.hash_grid_update_host.argtypes = [ctypes.c_uint64, ctypes.c_float, ctypes.c_void_p, ctypes.c_int]
         self.core.hash_grid_reserve_host.argtypes = [ctypes.c_uint64, ctypes.c_int]
+        self.core.hash_grid_permute_host.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_bool]
+        self.core.hash_grid_set_ordered_host.argtypes = [ctypes.c_uint64, ctypes.c_bool]
 
-        self.core.hash_grid_create_device.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int]
+        self.core.hash_grid_create_device.argtypes = [ctypes.c_int, ctypes.c_int, ctypes.c_int, ctypes.c_bool]
         self.core.hash_grid_create_device.restype = ctypes.c_uint64
         self.core.hash_grid_destroy_device.argtypes = [ctypes.c_uint64]
         self.core.hash_grid_update_device.argtypes = [ctypes.c_uint64, ctypes.c_float, ctypes.c_void_p, ctypes.c_int]
         self.core.hash_grid_reserve_device.argtypes = [ctypes.c_uint64, ctypes.c_int]
-
-        self.core.volume_create_host.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+        self.core.hash_grid_permute_device.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_bool]
+        self.core.hash_grid_set_ordered_device.argtypes = [ctypes.c_uint64, ctypes.c_bool]
+
+        self.core.neighbor_list_create_host.argtypes = [ctypes.c_int]
+        self.core.neighbor_list_create_host.restype = ctypes.c_uint64
+        self.core.neighbor_list_destroy_host.argtypes = [ctypes.c_uint64]
+        self.core.neighbor_list_build_host.argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_float]
+        self.core.neighbor_list_max_displacement_host.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_int]
+        self.core.neighbor_list_max_displacement_host.restype = ctypes.c_float
+        self.core.neighbor_list_get_info_host.argtypes = [ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int)]
+
+        self.core.neighbor_list_create_device.argtypes = [ctypes.c_int]
+        self.core.neighbor_list_create_device.restype = ctypes.c_uint64
+        self.core.neighbor_list_destroy_device.argtypes = [ctypes.c_uint64]
+        self.core.neighbor_list_build_device.argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_float]
+        self.core.neighbor_list_max_displacement_device.argtypes = [ctypes.c_uint64, ctypes.c_void_p, ctypes.c_int]
+        self.core.neighbor_list_max_displacement_device.restype = ctypes.c_float
+        self.core.neighbor_list_get_info_device.argtypes = [ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_int)]
+
+        self.core.volume_create_host.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_bool]
         self.core.volume_create_host.restype = ctypes.c_uint64
+        self.core.volume_load_host.argtypes = [ctypes.c_char_p]
+        self.core.volume_load_host.restype = ctypes.c_uint64
         self.core.volume_get_buffer_info_host.argtypes = [ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_uint64)]
         self.core.volume_destroy_host.argtypes = [ctypes.c_uint64]
+        self.core.volume_create_level_set_host.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_float]
+        self.core.volume_create_level_set_host.restype = ctypes.c_uint64
 
-        self.core.volume_create_device.argtypes = [ctypes.c_void_p, ctypes.c_uint64]
+        self.core.volume_create_device.argtypes = [ctypes.c_void_p, ctypes.c_uint64, ctypes.c_bool]
         self.core.volume_create_device.restype = ctypes.c_uint64
+        self.core.volume_load_device.argtypes = [ctypes.c_char_p, ctypes.c_uint64]
+        self.core.volume_load_device.restype = ctypes.c_uint64
         self.core.volume_get_buffer_info_device.argtypes = [ctypes.c_uint64, ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_uint64)]
         self.core.volume_destroy_device.argtypes = [ctypes.c_uint64]
+        self.core.volume_create_level_set_device.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_float, ctypes.c_float]
+        self.core.volume_create_level_set_device.restype = ctypes.c_uint64
 
         # load CUDA entry points on supported platforms
         self.core.cuda_check_device.restype = ctypes.c_uint64
         self.core.cuda_get_context.restype = ctypes.c_void_p
         self.core.cuda_get_stream.restype = ctypes.c_void_p
+        self.core.cuda_set_stream.argtypes = [ctypes.c_void_p]
+        self.core.cuda_stream_create.restype = ctypes.c_void_p
+        self.core.cuda_stream_destroy.argtypes = [ctypes.c_void_p]
+        self.core.cuda_stream_synchronize.argtypes = [ctypes.c_void_p]
+        self.core.cuda_stream_wait_event.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        self.core.cuda_event_create.argtypes = [ctypes.c_bool]
+        self.core.cuda_event_create.restype = ctypes.c_void_p
+        self.core.cuda_event_destroy.argtypes = [ctypes.c_void_p]
+        self.core.cuda_event_record.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        self.core.cuda_event_synchronize.argtypes = [ctypes.c_void_p]
+        self.core.cuda_event_elapsed_time.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+        self.core.cuda_event_elapsed_time.restype = ctypes.c_float
+
+        self.core.nvtx_init.argtypes = []
+        self.core.nvtx_init.restype = ctypes.c_bool
+        self.core.nvtx_range_push.argtypes = [ctypes.c_char_p]
+        self.core.nvtx_range_pop.argtypes = []
         self.core.cuda_graph_end_capture.restype = ctypes.c_void_p
+        self.core.cuda_graph_launch.argtypes = [ctypes.c_void_p]
+        self.core.cuda_graph_destroy.argtypes = [ctypes.c_void_p]
+        self.core.cuda_graph_get_kernel_count.argtypes = [ctypes.c_void_p]
+        self.core.cuda_graph_get_kernel_count.restype = ctypes.c_int
+        self.core.cuda_graph_get_kernel.argtypes = [ctypes.c_void_p, ctypes.c_int]
+        self.core.cuda_graph_get_kernel.restype = ctypes.c_void_p
+        self.core.cuda_graph_set_kernel_params.argtypes = [ctypes.c_void_p, ctypes.c_int, ctypes.POINTER(ctypes.c_void_p)]
+        self.core.cuda_graph_set_kernel_params.restype = ctypes.c_bool
+        self.core.cuda_device_get_count.restype = ctypes.c_int
+        self.core.cuda_get_device.restype = ctypes.c_int
+        self.core.cuda_set_device.argtypes = [ctypes.c_int]
+        self.core.cuda_get_device_name.argtypes = [ctypes.c_int]
         self.core.cuda_get_device_name.restype = ctypes.c_char_p
+        self.core.cuda_get_device_arch.argtypes = [ctypes.c_int]
+        self.core.cuda_get_device_arch.restype = ctypes.c_int
+        self.core.memcpy_peer.argtypes = [ctypes.c_int, ctypes.c_void_p, ctypes.c_int, ctypes.c_void_p, ctypes.c_size_t]
+        self.core.nvrtc_get_version.argtypes = []
+        self.core.nvrtc_get_version.restype = ctypes.c_int
 
-        self.core.cuda_compile_program.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_bool, ctypes.c_bool, ctypes.c_char_p]
+        self.core.cuda_compile_program.argtypes = [ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int, ctypes.c_bool, ctypes.c_bool, ctypes.c_bool, ctypes.c_char_p]
         self.core.cuda_compile_program.restype = ctypes.c_size_t
 
         self.core.cuda_load_module.argtypes = [ctypes.c_char_p]
@@ -525,9 +1158,33 @@ class Runtime:
         self.core.cuda_get_kernel.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
         self.core.cuda_get_kernel.restype = ctypes.c_void_p
         
-        self.core.cuda_launch_kernel.argtypes = [ctypes.c_void_p, ctypes.c_size_t, ctypes.POINTER(ctypes.c_void_p)]
+        self.core.cuda_get_kernel_block_dim.argtypes = [ctypes.c_void_p]
+        self.core.cuda_get_kernel_block_dim.restype = ctypes.c_int
+
+        self.core.cuda_launch_kernel.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_int), ctypes.c_int, ctypes.c_int, ctypes.POINTER(ctypes.c_void_p)]
         self.core.cuda_launch_kernel.restype = ctypes.c_size_t
 
+        self.core.cuda_launch_kernels.argtypes = [ctypes.POINTER(ctypes.c_void_p), ctypes.POINTER(ctypes.c_int), ctypes.POINTER(ctypes.c_void_p), ctypes.c_int]
+        self.core.cuda_launch_kernels.restype = ctypes.c_size_t
+
+        for suffix in ["_host", "_device"]:
+            getattr(self.core, "array_sum" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+            getattr(self.core, "array_inner" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+            getattr(self.core, "array_min" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+            getattr(self.core, "array_max" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+            getattr(self.core, "array_argmin" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+            getattr(self.core, "array_argmax" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+            getattr(self.core, "array_scan" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int, ctypes.c_bool]
+            getattr(self.core, "sort_pairs" + suffix).argtypes = [ctypes.c_uint64, ctypes.c_uint64, ctypes.c_int, ctypes.c_int]
+
+        self.core.cuda_mempool_enabled.restype = ctypes.c_bool
+        self.core.cuda_mempool_trim.argtypes = [ctypes.c_size_t]
+        self.core.cuda_mempool_get_stats.argtypes = [ctypes.POINTER(ctypes.c_uint64)]*4
+
+        self.core.cpu_parallel_for.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_int, ctypes.c_int]
+        self.core.cpu_set_num_threads.argtypes = [ctypes.c_int]
+        self.core.cpu_get_num_threads.restype = ctypes.c_int
+
         self.core.init.restype = ctypes.c_int
         
         error = self.core.init()
@@ -535,6 +1192,8 @@ class Runtime:
         if (error > 0):
             raise Exception("Warp Initialization failed, CUDA not found")
 
+        self.core.cpu_set_num_threads(warp.config.cpu_threads)
+
         # allocation functions, these are function local to 
         # force other classes to go through the allocator objects
         def alloc_host(num_bytes):
@@ -544,22 +1203,61 @@ class Runtime:
         def free_host(ptr):
             self.core.free_host(ctypes.cast(ptr, ctypes.POINTER(ctypes.c_int)))
 
-        def alloc_device(num_bytes):
-            ptr = self.core.alloc_device(ctypes.c_size_t(num_bytes))
+        def alloc_pinned(num_bytes):
+            ptr = self.core.alloc_pinned(ctypes.c_size_t(num_bytes))
             return ptr
 
-        def free_device(ptr):
-            # must be careful to not call any globals here
-            # since this may be called during destruction / shutdown
-            # even ctypes module may no longer exist
-            self.core.free_device(ptr)
+        def free_pinned(ptr):
+            self.core.free_pinned(ptr)
+
+        # device allocations are made on the allocator's device, the current device is restored afterwards
+        def make_device_allocator(ordinal):
+
+            def alloc_device(num_bytes):
+                self.core.cuda_set_device(ordinal)
+                ptr = self.core.alloc_device(ctypes.c_size_t(num_bytes))
+                self.core.cuda_set_device(self.cuda_ordinal)
+                return ptr
+
+            def free_device(ptr):
+                # must be careful to not call any globals here
+                # since this may be called during destruction / shutdown
+                # even ctypes module may no longer exist
+                self.core.cuda_set_device(ordinal)
+                self.core.free_device(ptr)
+                self.core.cuda_set_device(self.cuda_ordinal)
+
+            return DeviceAllocator(self, ordinal, alloc_device, free_device, caching=warp.config.cache_allocations)
+
+        self.host_allocator = Allocator(alloc_host, free_host, caching=warp.config.cache_allocations)
+        self.pinned_allocator = Allocator(alloc_pinned, free_pinned, caching=warp.config.cache_allocations)
+
+        # CUDA devices are named cuda:<ordinal>, "cuda" refers to the current device, see set_device()
+        self.cuda_devices = ["cuda:" + str(i) for i in range(self.core.cuda_device_get_count())]
+        self.cuda_ordinal = self.core.cuda_get_device()
+
+        # per device contexts, allocators, and streams, indexed by ordinal
+        self.cuda_contexts = []
+        self.device_allocators = []
+        self.default_streams = []
 
-        self.host_allocator = Allocator(alloc_host, free_host)
-        self.device_allocator = Allocator(alloc_device, free_device)
+        for i, name in enumerate(self.cuda_devices):
 
-        # save context
-        self.cuda_device = self.core.cuda_get_context()
-        self.cuda_stream = self.core.cuda_get_stream()
+            self.core.cuda_set_device(i)
+
+            self.cuda_contexts.append(self.core.cuda_get_context())
+            self.device_allocators.append(make_device_allocator(i))
+            self.default_streams.append(Stream(handle=self.core.cuda_get_stream(), device=name))
+
+        self.core.cuda_set_device(self.cuda_ordinal)
+
+        # allocator of every device by name
+        self.allocators = dict(zip(self.cuda_devices, self.device_allocators))
+        self.allocators["cpu"] = self.host_allocator
+
+        # current stream of each device, the handle of the null stream is NULL (0) on platforms without CUDA
+        self.streams = list(self.default_streams)
+        self.null_stream = Stream(handle=0)
 
         # initialize host build env
         if (warp.config.host_compiler == None):
@@ -568,7 +1266,11 @@ class Runtime:
         # print device and version information
         print("Warp initialized:")
         print("   Version: {}".format(warp.config.version))
-        print("   Using CUDA device: {}".format(self.core.cuda_get_device_name().decode()))
+        if (self.cuda_devices):
+            for i, name in enumerate(self.cuda_devices):
+                print("   Using CUDA device {}: {}".format(name, self.core.cuda_get_device_name(i).decode()))
+        else:
+            print("   Using CUDA device: Not supported")
         
         if (warp.config.host_compiler):
             print("   Using CPU compiler: {}".format(warp.config.host_compiler.rstrip()))
@@ -577,14 +1279,40 @@ class Runtime:
 
         # global tape
         self.tape = None
+        self.profiler = None
+        self.capturing = False
 
-    def verify_device(self):
+    @property
+    def stream(self):
+        """The current stream of the current CUDA device"""
 
-        if warp.config.verify_cuda:
+        if (self.cuda_ordinal < 0):
+            return self.null_stream
 
-            context = self.core.cuda_get_context()
-            if (context != self.cuda_device):
-                raise RuntimeError("Unexpected CUDA device, original {} current: {}".format(self.cuda_device, context))
+        return self.streams[self.cuda_ordinal]
+
+    @property
+    def default_stream(self):
+        """The default stream of the current CUDA device"""
+
+        if (self.cuda_ordinal < 0):
+            return self.null_stream
+
+        return self.default_streams[self.cuda_ordinal]
+
+    def set_cuda_device(self, ordinal):
+
+        if (ordinal != self.cuda_ordinal):
+            self.core.cuda_set_device(ordinal)
+            self.cuda_ordinal = ordinal
+
+    def verify_device(self):
+
+        if warp.config.verify_cuda:
+
+            context = self.core.cuda_get_context()
+            if (context != self.cuda_contexts[self.cuda_ordinal]):
+                raise RuntimeError("Unexpected CUDA context for device {}, original {} current: {}".format(self.cuda_devices[self.cuda_ordinal], self.cuda_contexts[self.cuda_ordinal], context))
 
             err = self.core.cuda_check_device()
             if (err != 0):
@@ -597,19 +1325,19 @@ def is_cpu_available():
     return warp.config.host_compiler != None
 
 def is_cuda_available():
-    return runtime.cuda_device != None
+    return len(runtime.cuda_devices) > 0
 
 def is_device_available(device):
-    return device in wp.get_devices()
+    return get_device(device) in get_devices()
 
 def get_devices():
-    """Returns a list of device strings supported by in this environment.
+    """Returns a list of device strings supported by in this environment, CUDA devices are listed as ``cuda:<ordinal>``
     """
     devices = []
     if (is_cpu_available()):
         devices.append("cpu")
-    if (is_cuda_available()):
-        devices.append("cuda")
+
+    devices.extend(runtime.cuda_devices)
 
     return devices
 
@@ -623,15 +1351,66 @@ def get_preferred_device():
     else:
         return None
 
+def get_cuda_device_count() -> int:
+    """Returns the number of CUDA devices"""
+
+    return len(runtime.cuda_devices)
+
+def get_device(device: str="cuda") -> str:
+    """Returns the canonical name of a device, either ``cpu`` or ``cuda:<ordinal>``
+
+    The alias ``cuda`` resolves to the current CUDA device, see :func:`set_device`. Arrays, meshes, and other
+    resources store the canonical name of the device they were created on.
+    """
+
+    if (device == "cpu" or device in runtime.allocators):
+        return device
+
+    if (device == "cuda"):
+
+        if (runtime.cuda_ordinal < 0):
+            raise RuntimeError("Trying to use a CUDA device without GPU support")
+
+        return runtime.cuda_devices[runtime.cuda_ordinal]
+
+    raise RuntimeError(f"Unknown device '{device}', available devices are {get_devices()}")
+
+def get_device_ordinal(device: str) -> int:
+    """Returns the ordinal of a CUDA device, or -1 for ``cpu``"""
+
+    device = get_device(device)
+
+    if (device == "cpu"):
+        return -1
 
-def zeros(n: int, dtype=float, device: str="cpu", requires_grad: bool=False)-> warp.array:
+    return int(device[5:])
+
+def set_device(device: str):
+    """Makes a CUDA device current, work on the ``cuda`` device alias is issued to it
+
+    Each device keeps its own current stream, see :func:`set_stream`.
+
+    Args:
+        device: A CUDA device name, e.g.: ``cuda:1``
+    """
+
+    ordinal = get_device_ordinal(device)
+
+    if (ordinal < 0):
+        raise RuntimeError(f"set_device() expects a CUDA device, got '{device}'")
+
+    runtime.set_cuda_device(ordinal)
+
+
+def zeros(n: int, dtype=float, device: str="cpu", requires_grad: bool=False, pinned: bool=False)-> warp.array:
     """Return a zero-initialized array
 
     Args:
         n: Number of elements
         dtype: Type of each element, e.g.: warp.vec3, warp.mat33, etc
-        device: Device that array will live on
+        device: Device that array will live on, ``cuda`` allocates on the current CUDA device
         requires_grad: Whether the array will be tracked for back propagation
+        pinned: Whether ``cpu`` arrays are allocated in page-locked memory, this allows copies to and from ``cuda`` arrays to run asynchronously
 
     Returns:
         A warp.array object representing the allocation                
@@ -640,27 +1419,32 @@ def zeros(n: int, dtype=float, device: str="cpu", requires_grad: bool=False)-> w
     if runtime == None:
         raise RuntimeError("Warp not initialized, call wp.init() before use")
 
-    if device != "cpu" and device != "cuda":
-        raise RuntimeError(f"Trying to allocate array on unknown device {device}")
-
-    if device == "cuda" and not is_cuda_available():
-        raise RuntimeError("Trying to allocate CUDA buffer without GPU support")
+    device = get_device(device)
 
     num_bytes = n*warp.types.type_size_in_bytes(dtype)
 
     if device == "cpu":
-        ptr = runtime.host_allocator.alloc(num_bytes) 
+        allocator = runtime.pinned_allocator if pinned else runtime.host_allocator
+        ptr = allocator.alloc(num_bytes) 
         runtime.core.memset_host(ctypes.cast(ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(num_bytes))
 
-    elif device == "cuda":
-        ptr = runtime.device_allocator.alloc(num_bytes)
-        runtime.core.memset_device(ctypes.cast(ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(num_bytes))
+    else:
+        ptr = runtime.allocators[device].alloc(num_bytes)
+
+        with ScopedDevice(device):
+            runtime.core.memset_device(ctypes.cast(ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(num_bytes))
 
     if (ptr == None and num_bytes > 0):
         raise RuntimeError("Memory allocation failed on device: {} for {} bytes".format(device, num_bytes))
     else:
         # construct array
-        return warp.types.array(dtype=dtype, length=n, capacity=num_bytes, ptr=ptr, device=device, owner=True, requires_grad=requires_grad)
+        arr = warp.types.array(dtype=dtype, length=n, capacity=num_bytes, ptr=ptr, device=device, owner=True, requires_grad=requires_grad, pinned=(pinned and device == "cpu"))
+
+        # the memset is issued on the current stream
+        if device != "cpu":
+            arr.streams.add(get_stream(device))
+
+        return arr
 
 def zeros_like(src: warp.array) -> warp.array:
     """Return a zero-initialized array with the same type and dimension of another array
@@ -672,7 +1456,7 @@ def zeros_like(src: warp.array) -> warp.array:
         A warp.array object representing the allocation
     """
 
-    arr = zeros(len(src), dtype=src.dtype, device=src.device, requires_grad=src.requires_grad)
+    arr = zeros(len(src), dtype=src.dtype, device=src.device, requires_grad=src.requires_grad, pinned=src.pinned)
     return arr
 
 def clone(src: warp.array) -> warp.array:
@@ -685,12 +1469,12 @@ def clone(src: warp.array) -> warp.array:
         A warp.array object representing the allocation
     """
 
-    dest = empty(len(src), dtype=src.dtype, device=src.device, requires_grad=src.requires_grad)
+    dest = empty(len(src), dtype=src.dtype, device=src.device, requires_grad=src.requires_grad, pinned=src.pinned)
     copy(dest, src)
 
     return dest
 
-def empty(n: int, dtype=float, device:str="cpu", requires_grad:bool=False) -> warp.array:
+def empty(n: int, dtype=float, device:str="cpu", requires_grad:bool=False, pinned:bool=False) -> warp.array:
     """Returns an uninitialized array
 
     Args:
@@ -698,13 +1482,14 @@ def empty(n: int, dtype=float, device:str="cpu", requires_grad:bool=False) -> wa
         dtype: Type of each element, e.g.: `warp.vec3`, `warp.mat33`, etc
         device: Device that array will live on
         requires_grad: Whether the array will be tracked for back propagation
+        pinned: Whether ``cpu`` arrays are allocated in page-locked memory, see :func:`zeros`
 
     Returns:
         A warp.array object representing the allocation
     """
 
     # todo: implement uninitialized allocation
-    return zeros(n, dtype, device, requires_grad=requires_grad)  
+    return zeros(n, dtype, device, requires_grad=requires_grad, pinned=pinned)  
 
 def empty_like(src: warp.array, requires_grad:bool=False) -> warp.array:
     """Return an uninitialized array with the same type and dimension of another array
@@ -716,7 +1501,7 @@ def empty_like(src: warp.array, requires_grad:bool=False) -> warp.array:
     Returns:
         A warp.array object representing the allocation
     """
-    arr = empty(len(src), dtype=src.dtype, device=src.device, requires_grad=requires_grad)
+    arr = empty(len(src), dtype=src.dtype, device=src.device, requires_grad=requires_grad, pinned=src.pinned)
     return arr
 
 
@@ -725,28 +1510,148 @@ def from_numpy(arr, dtype, device="cpu", requires_grad=False):
     return warp.array(data=arr, dtype=dtype, device=device, requires_grad=requires_grad)
 
 
-def launch(kernel, dim: int, inputs:List, outputs:List=[], adj_inputs:List=[], adj_outputs:List=[], device:str="cpu", adjoint=False):
+# kernel launch dimensions, must match wp::launch_bounds_t in native/builtin.h
+class launch_bounds_t(ctypes.Structure):
+    _fields_ = [("shape", ctypes.c_int*3),
+                ("ndim", ctypes.c_int),
+                ("size", ctypes.c_int)]
+
+    def __init__(self, dim):
+
+        if isinstance(dim, int):
+            dim = (dim,)
+
+        dim = tuple(dim)
+
+        if len(dim) < 1 or len(dim) > 3:
+            raise RuntimeError(f"Launch dimensions must have between 1 and 3 entries, got {dim}")
+
+        # the size is computed on Python ints, the native launch bounds are 32-bit
+        size = 1
+        for d in dim:
+            if (d < 0):
+                raise RuntimeError(f"Launch dimensions must not be negative, got {dim}")
+            size *= int(d)
+
+        if (size > 2**31 - 1):
+            raise RuntimeError(f"Launch dimensions {dim} give {size} threads, at most {2**31 - 1} are supported")
+
+        self.ndim = len(dim)
+        self.size = size
+
+        for i in range(3):
+            self.shape[i] = dim[i] if i < self.ndim else 1
+
+
+# ctypes structures wrapping vector and matrix types, see pack_arg()
+value_arg_types = {}
+
+def pack_arg(kernel, i, a, device):
+    """Converts the argument ``a`` for parameter ``i`` of ``kernel`` to the ctypes value passed to the kernel entry point"""
+
+    arg_type = kernel.adj.args[i].type
+
+    if (isinstance(arg_type, warp.types.array)):
+
+        if (a is None):
+            
+            # allow for NULL arrays
+            return ctypes.c_int64(0)
+
+        else:
+
+            # check for array value
+            if (isinstance(a, warp.types.array) == False):
+                raise RuntimeError(f"Passing non-array value with type {type(a)} to array argument: '{kernel.adj.args[i].label}'")
+            
+            # check subtype
+            if (a.dtype != arg_type.dtype):
+                raise RuntimeError("Array dtype {} does not match kernel signature {} for param: {}".format(a.dtype, arg_type.dtype, kernel.adj.args[i].label))
+
+            # check device
+            if (a.device != device):
+                raise RuntimeError("Launching kernel on device={} where input array is on device={}. Arrays must live on the same device".format(device, a.device))
+
+            if(a.ptr == None):                            
+                return ctypes.c_int64(0)
+            else:
+                return ctypes.c_int64(a.ptr)
+
+    # try to convert to a value type (vec3, mat33, etc)
+    elif issubclass(arg_type, ctypes.Array):
+
+        # force conversion to ndarray first (handles tuple / list, Gf.Vec3 case)
+        a = np.array(a)
+
+        # flatten to 1D array
+        v = a.flatten()
+        if (len(v) != arg_type._length_):
+            raise RuntimeError(f"Kernel parameter {kernel.adj.args[i].label} has incorrect value length {len(v)}, expected {arg_type._length_}")
+
+        # wrap the arg_type (which is an ctypes.Array) in a structure
+        # to ensure parameter is passed to the .dll by value rather than reference
+        value_arg = value_arg_types.get(arg_type)
+        if (value_arg == None):
+
+            class ValueArg(ctypes.Structure):
+                _fields_ = [ ('value', arg_type)]
+
+            value_arg = ValueArg
+            value_arg_types[arg_type] = value_arg
+
+        x = value_arg()
+        for j in range(arg_type._length_):
+            x.value[j] = v[j]
+
+        return x
+
+    else:
+        try:
+            # try to pack as a scalar type
+            return arg_type._type_(a)
+        except:
+            raise RuntimeError(f"Unable to pack kernel parameter type {type(a)} for param {kernel.adj.args[i].label}, expected {arg_type}")
+
+
+def record_stream(args, device):
+    """Adds the current stream of ``device`` to the streams used by the arrays in ``args``, the allocator
+    fences the blocks of arrays freed later on each of them"""
+
+    stream = get_stream(device)
+
+    for a in args:
+        if isinstance(a, warp.types.array):
+            a.streams.add(stream)
+
+
+def launch(kernel, dim, inputs:List, outputs:List=[], adj_inputs:List=[], adj_outputs:List=[], device:str="cpu", adjoint=False, block_dim:int=0, stream:Stream=None):
     """Launch a Warp kernel on the target device
 
     Kernel launches are asynchronous with respect to the calling Python thread. 
 
     Args:
         kernel: The name of a Warp kernel function, decorated with the @warp.kernel decorator
-        dim: The number of threads to launch the kernel with
+        dim: The number of threads to launch the kernel with, either an int or a tuple of up to 3 ints for a multi-dimensional launch
         inputs: The input parameters to the kernel
         outputs: The output parameters (optional)
         adj_inputs: The adjoint inputs (optional)
         adj_outputs: The adjoint outputs (optional)
         device: The device to launch on
         adjoint: Whether to run forward or backward pass (typically use False)
+        block_dim: The number of threads per block for CUDA launches, 0 selects a size based on the kernel's occupancy
+        stream: The stream to launch on for CUDA devices, defaults to the current stream
     """
 
+    device = get_device(device)
+
     assert(is_device_available(device))
 
     if (warp.config.print_launches):
         print(f"kernel: {kernel.key} dim: {dim} inputs: {inputs} outputs: {outputs} device: {device}")
 
-    if (dim > 0):
+    bounds = launch_bounds_t(dim)
+
+    if (bounds.size > 0):
 
         # delay load modules
         if (kernel.module.loaded == False):
@@ -754,132 +1659,509 @@ def launch(kernel, dim: int, inputs:List, outputs:List=[], adj_inputs:List=[], a
             if (success == False):
                 return
 
-        # first param is the number of threads
+        # first param is the launch bounds, passed by value
         params = []
-        params.append(ctypes.c_long(dim))
+        params.append(bounds)
+
+        fwd_args = inputs + outputs
+        adj_args = adj_inputs + adj_outputs
+
+        if (len(fwd_args)) != (len(kernel.adj.args)): 
+            raise RuntimeError(f"Unable to launch kernel '{kernel.key}', passed {len(fwd_args)} args but kernel requires {len(kernel.adj.args)}")
 
         # converts arguments to kernel's expected ctypes and packs into params
-        def pack_args(args, params):
+        for i, a in enumerate(fwd_args):
+            params.append(pack_arg(kernel, i, a, device))
 
-            for i, a in enumerate(args):
+        for i, a in enumerate(adj_args):
+            params.append(pack_arg(kernel, i, a, device))
 
-                arg_type = kernel.adj.args[i].type
+        # late bind
+        if (not kernel.is_bound(device)):
+            kernel.hook()
 
-                if (isinstance(arg_type, warp.types.array)):
+        if (not kernel.is_bound(device)):
+            raise RuntimeError(f"Kernel '{kernel.key}' was not compiled for device '{device}', check the targets option of module '{kernel.module.name}'")
 
-                    if (a is None):
-                        
-                        # allow for NULL arrays
-                        params.append(ctypes.c_int64(0))
+        # run kernel
+        if device == 'cpu':
 
-                    else:
+            profile = runtime.profiler.begin(kernel.key, device, dim) if runtime.profiler else None
 
-                        # check for array value
-                        if (isinstance(a, warp.types.array) == False):
-                            raise RuntimeError(f"Passing non-array value with type {type(a)} to array argument: '{kernel.adj.args[i].label}'")
-                        
-                        # check subtype
-                        if (a.dtype != arg_type.dtype):
-                            raise RuntimeError("Array dtype {} does not match kernel signature {} for param: {}".format(a.dtype, arg_type.dtype, kernel.adj.args[i].label))
-
-                        # check device
-                        if (a.device != device):
-                            raise RuntimeError("Launching kernel on device={} where input array is on device={}. Arrays must live on the same device".format(device, a.device))
-            
-                        if(a.ptr == None):                            
-                            params.append(ctypes.c_int64(0))
-                        else:
-                            params.append(ctypes.c_int64(a.ptr))
+            if (adjoint):
+                kernel.backward_cpu(*params)
+            else:
+                kernel.forward_cpu(*params)
 
-                # try to convert to a value type (vec3, mat33, etc)
-                elif issubclass(arg_type, ctypes.Array):
+            if (profile):
+                runtime.profiler.end(profile)
 
-                    # force conversion to ndarray first (handles tuple / list, Gf.Vec3 case)
-                    a = np.array(a)
+        
+        else:
 
-                    # flatten to 1D array
-                    v = a.flatten()
-                    if (len(v) != arg_type._length_):
-                        raise RuntimeError(f"Kernel parameter {kernel.adj.args[i].label} has incorrect value length {len(v)}, expected {arg_type._length_}")
+            kernel_args = [ctypes.c_void_p(ctypes.addressof(x)) for x in params]
+            kernel_params = (ctypes.c_void_p * len(kernel_args))(*kernel_args)
 
-                    # wrap the arg_type (which is an ctypes.Array) in a structure
-                    # to ensure parameter is passed to the .dll by value rather than reference
-                    class ValueArg(ctypes.Structure):
-                        _fields_ = [ ('value', arg_type)]
+            if (block_dim < 0 or block_dim > 1024):
+                raise RuntimeError(f"Invalid block_dim {block_dim} for kernel '{kernel.key}', must be in the range [0, 1024]")
 
-                    x = ValueArg()
-                    for i in range(arg_type._length_):
-                        x.value[i] = v[i]
+            func, default_block_dim = kernel.get_cuda_function(device, adjoint)
 
-                    params.append(x)
+            with ScopedDevice(device), ScopedStream(stream):
 
-                else:
-                    try:
-                        # try to pack as a scalar type
-                        params.append(arg_type._type_(a))
-                    except:
-                        raise RuntimeError(f"Unable to pack kernel parameter type {type(a)} for param {kernel.adj.args[i].label}, expected {arg_type}")
+                # events are recorded on the launch stream so they bracket only this kernel
+                profile = runtime.profiler.begin(kernel.key, device, dim) if runtime.profiler else None
 
+                runtime.core.cuda_launch_kernel(func, bounds.shape, bounds.ndim, block_dim or default_block_dim, kernel_params)
 
-        fwd_args = inputs + outputs
-        adj_args = adj_inputs + adj_outputs
+                if (profile):
+                    runtime.profiler.end(profile)
 
-        if (len(fwd_args)) != (len(kernel.adj.args)): 
-            raise RuntimeError(f"Unable to launch kernel '{kernel.key}', passed {len(fwd_args)} args but kernel requires {len(kernel.adj.args)}")
+                record_stream(fwd_args, device)
+                record_stream(adj_args, device)
+
+                try:
+                    runtime.verify_device()            
+                except Exception as e:
+                    print(f"Error launching kernel: {kernel.key} on device {device}")
+                    raise e
+
+    # record on tape if one is active
+    if (runtime.tape):
+        runtime.tape.record(kernel, dim, inputs, outputs, device)
+
+class Launch:
+    """A kernel launch whose arguments are validated and packed once, so that it can be issued repeatedly with low overhead
+
+    :func:`launch` converts every argument to its ctypes representation on each call, which can dominate the cost of
+    launching many small kernels. A ``Launch`` performs the same checks and conversions when it is constructed,
+    later calls to :meth:`launch` pass the packed parameters straight to the kernel. Arguments that change between
+    launches are patched in-place with :meth:`set_param`, e.g.: ::
+
+        step = wp.Launch(integrate, dim=n, inputs=[x, v, dt], device="cuda")
+
+        for i in range(100):
+            step.set_param("dt", dt*0.5)
+            step.launch()
+
+    Arrays passed to a ``Launch`` are kept alive by it, calling :meth:`set_param` with another array only repacks its pointer.
+    The arguments are the same as for :func:`launch`.
+    """
+
+    def __init__(self, kernel, dim, inputs:List, outputs:List=[], adj_inputs:List=[], adj_outputs:List=[], device:str="cpu", adjoint=False, block_dim:int=0, stream:Stream=None):
+
+        device = get_device(device)
 
-        pack_args(fwd_args, params)
-        pack_args(adj_args, params)
+        assert(is_device_available(device))
+
+        if (block_dim < 0 or block_dim > 1024):
+            raise RuntimeError(f"Invalid block_dim {block_dim} for kernel '{kernel.key}', must be in the range [0, 1024]")
+
+        self.kernel = kernel
+        self.device = device
+        self.adjoint = adjoint
+        self.stream = stream
+
+        self.inputs = list(inputs)
+        self.outputs = list(outputs)
+        self.adj_args = list(adj_inputs) + list(adj_outputs)
+
+        if (len(self.inputs) + len(self.outputs) != len(kernel.adj.args)):
+            raise RuntimeError(f"Unable to launch kernel '{kernel.key}', passed {len(self.inputs) + len(self.outputs)} args but kernel requires {len(kernel.adj.args)}")
+
+        if (kernel.module.loaded == False):
+            if (kernel.module.load() == False):
+                raise RuntimeError(f"Unable to launch kernel '{kernel.key}', module '{kernel.module.name}' failed to load")
 
         # late bind
-        if (kernel.forward_cpu == None or kernel.forward_cuda == None):
+        if (not kernel.is_bound(device)):
             kernel.hook()
 
-        # run kernel
-        if device == 'cpu':
+        if (not kernel.is_bound(device)):
+            raise RuntimeError(f"Kernel '{kernel.key}' was not compiled for device '{device}', check the targets option of module '{kernel.module.name}'")
 
-            if (adjoint):
-                kernel.backward_cpu(*params)
-            else:
-                kernel.forward_cpu(*params)
+        if (device != "cpu"):
+            self.func, default_block_dim = kernel.get_cuda_function(device, adjoint)
+            self.block_dim = block_dim or default_block_dim
 
-        
-        elif device == "cuda":
+        self.arg_index = { arg.label: i for i, arg in enumerate(kernel.adj.args) }
 
-            kernel_args = [ctypes.c_void_p(ctypes.addressof(x)) for x in params]
-            kernel_params = (ctypes.c_void_p * len(kernel_args))(*kernel_args)
+        # first param is the launch bounds, the kernel parameters point at the params so that patching them in-place needs no repacking
+        self.dim = dim
+        self.bounds = launch_bounds_t(dim)
+        self.params = [self.bounds]
+
+        for i, a in enumerate(self.inputs + self.outputs):
+            self.params.append(pack_arg(kernel, i, a, device))
+
+        for i, a in enumerate(self.adj_args):
+            self.params.append(pack_arg(kernel, i, a, device))
+
+        if (device != "cpu"):
+            kernel_args = [ctypes.c_void_p(ctypes.addressof(x)) for x in self.params]
+            self.kernel_params = (ctypes.c_void_p * len(kernel_args))(*kernel_args)
+
+    def get_index(self, key):
+
+        if isinstance(key, str):
+            if (key not in self.arg_index):
+                raise RuntimeError(f"Kernel '{self.kernel.key}' has no parameter named '{key}'")
+
+            return self.arg_index[key]
+        else:
+            return key
+
+    def patch(self, param, i, value):
+
+        x = pack_arg(self.kernel, i, value, self.device)
+        ctypes.memmove(ctypes.addressof(self.params[param]), ctypes.addressof(x), ctypes.sizeof(x))
+
+    def set_param(self, key, value):
+        """Replaces the value of a kernel argument
+
+        Args:
+            key: The name of the parameter in the kernel signature, or its index
+            value: The new value, arrays must have the same dtype and live on the same device as the launch
+        """
+
+        i = self.get_index(key)
+
+        self.patch(1 + i, i, value)
+
+        if (i < len(self.inputs)):
+            self.inputs[i] = value
+        else:
+            self.outputs[i - len(self.inputs)] = value
+
+    def set_adj_param(self, key, value):
+        """Replaces the value of an adjoint argument, see :meth:`set_param`"""
+
+        i = self.get_index(key)
+
+        if (i >= len(self.adj_args)):
+            raise RuntimeError(f"Launch of kernel '{self.kernel.key}' was created without adjoint arguments")
+
+        self.patch(1 + len(self.kernel.adj.args) + i, i, value)
+        self.adj_args[i] = value
+
+    def set_dim(self, dim):
+        """Changes the launch dimensions"""
+
+        bounds = launch_bounds_t(dim)
+        ctypes.memmove(ctypes.addressof(self.bounds), ctypes.addressof(bounds), ctypes.sizeof(bounds))
+
+        self.dim = dim
+
+    def launch(self):
+        """Issues the kernel with the current arguments"""
+
+        kernel = self.kernel
+        device = self.device
+
+        if (warp.config.print_launches):
+            print(f"kernel: {kernel.key} dim: {self.dim} inputs: {self.inputs} outputs: {self.outputs} device: {device}")
+
+        if (self.bounds.size > 0):
+
+            if device == "cpu":
+
+                profile = runtime.profiler.begin(kernel.key, device, self.dim) if runtime.profiler else None
+
+                if (self.adjoint):
+                    kernel.backward_cpu(*self.params)
+                else:
+                    kernel.forward_cpu(*self.params)
+
+                if (profile):
+                    runtime.profiler.end(profile)
 
-            if (adjoint):
-                runtime.core.cuda_launch_kernel(kernel.backward_cuda, dim, kernel_params)
             else:
-                runtime.core.cuda_launch_kernel(kernel.forward_cuda, dim, kernel_params)
 
-            try:
-                runtime.verify_device()            
-            except Exception as e:
-                print(f"Error launching kernel: {kernel.key} on device {device}")
-                raise e
+                with ScopedDevice(device), ScopedStream(self.stream):
+
+                    profile = runtime.profiler.begin(kernel.key, device, self.dim) if runtime.profiler else None
+
+                    runtime.core.cuda_launch_kernel(self.func, self.bounds.shape, self.bounds.ndim, self.block_dim, self.kernel_params)
+
+                    if (profile):
+                        runtime.profiler.end(profile)
+
+                    record_stream(self.inputs, device)
+                    record_stream(self.outputs, device)
+                    record_stream(self.adj_args, device)
+
+                    try:
+                        runtime.verify_device()            
+                    except Exception as e:
+                        print(f"Error launching kernel: {kernel.key} on device {device}")
+                        raise e
+
+        # record on tape if one is active
+        if (runtime.tape):
+            runtime.tape.record(kernel, self.dim, self.inputs, self.outputs, device)
+
+
+class LaunchSequence:
+    """A list of :class:`Launch` objects that are replayed in order
+
+    Consecutive CUDA launches on the same device are issued to the device's current stream with a single native call,
+    the streams of the individual launches are ignored. Arguments patched on the launches with :meth:`Launch.set_param` or
+    :meth:`Launch.set_dim` are picked up by the next replay. While a :class:`Profiler` or :class:`Tape` is active
+    launches are issued one at a time so that each is recorded.
+
+    Args:
+        launches: The launches to replay
+    """
+
+    def __init__(self, launches: List[Launch]):
+
+        self.launches = list(launches)
+
+        # groups of consecutive CUDA launches on one device, or a single CPU launch
+        self.batches = []
+
+        i = 0
+        while i < len(self.launches):
+
+            device = self.launches[i].device
+
+            if (device == "cpu"):
+                self.batches.append((self.launches[i], None))
+                i += 1
+                continue
+
+            j = i
+            while j < len(self.launches) and self.launches[j].device == device:
+                j += 1
+
+            batch = self.launches[i:j]
+
+            kernels = (ctypes.c_void_p * len(batch))(*[l.func for l in batch])
+            block_dims = (ctypes.c_int * len(batch))(*[l.block_dim for l in batch])
+            args = (ctypes.c_void_p * len(batch))(*[ctypes.addressof(l.kernel_params) for l in batch])
+
+            self.batches.append((batch, (kernels, block_dims, args)))
+            i = j
+
+    def launch(self, stream: Stream=None):
+        """Replays the launches in order
+
+        Args:
+            stream: The stream to issue CUDA launches on, defaults to the current stream of each launch's device,
+                    if given all CUDA launches must be on the stream's device
+        """
+
+        if (runtime.profiler or runtime.tape or warp.config.print_launches):
+
+            for l in self.launches:
+                l.launch()
+
+            return
+
+        if (stream is not None):
+            for batch, packed in self.batches:
+                if (packed != None and get_device_ordinal(batch[0].device) != get_device_ordinal(stream.device)):
+                    raise RuntimeError(f"LaunchSequence.launch() was given a stream of device '{stream.device}' but kernel '{batch[0].kernel.key}' is launched on '{batch[0].device}'")
+
+        with ScopedStream(stream):
+
+            for batch, packed in self.batches:
+
+                if (packed == None):
+                    batch.launch()
+                    continue
+
+                with ScopedDevice(batch[0].device):
+
+                    # the caching allocator fences blocks freed later on the stream the batch is issued to
+                    for l in batch:
+                        record_stream(l.inputs, l.device)
+                        record_stream(l.outputs, l.device)
+                        record_stream(l.adj_args, l.device)
+
+                    kernels, block_dims, args = packed
+                    runtime.core.cuda_launch_kernels(kernels, block_dims, args, len(batch))
+
+                    try:
+                        runtime.verify_device()            
+                    except Exception as e:
+                        print(f"Error launching kernels: {', '.join(l.kernel.key for l in batch)}")
+                        raise e
 
-    # record on tape if one is active
-    if (runtime.tape):
-        runtime.tape.record(kernel, dim, inputs, outputs, device)
 
 def synchronize():
     """Manually synchronize the calling CPU thread with any outstanding CUDA work
 
     This method allows the host application code to ensure that any kernel launches
-    or memory copies have completed.
+    or memory copies have completed on all streams of all devices.
     """
 
     runtime.core.synchronize()
 
 
+def get_stream(device: str="cuda") -> Stream:
+    """Returns the current stream of a CUDA device, CUDA launches, copies, and native operations (e.g.: mesh refits, hash grid builds) on the device are issued to it"""
+
+    if (device == "cuda" and runtime.cuda_ordinal < 0):
+        return runtime.null_stream
+
+    return runtime.streams[get_device_ordinal(device)]
+
+
+def set_stream(stream: Stream):
+    """Make ``stream`` the current stream of its device, passing None restores the default stream of the current device"""
+
+    if stream is None:
+        stream = runtime.default_stream
+
+    if (stream.device == None):
+        return
+
+    ordinal = get_device_ordinal(stream.device)
+
+    runtime.streams[ordinal] = stream
+
+    with ScopedDevice(stream.device):
+        runtime.core.cuda_set_stream(stream.handle)
+
+
+def set_cpu_threads(num_threads: int):
+    """Set the number of threads used to execute kernels launched on ``cpu`` devices
+
+    Args:
+        num_threads: Total number of threads including the launching thread, 1 executes launches serially and 0 uses all hardware threads
+    """
+
+    runtime.core.cpu_set_num_threads(num_threads)
+
+
+def get_cpu_threads() -> int:
+    """Returns the number of threads used to execute kernels launched on ``cpu`` devices
+    """
+
+    return runtime.core.cpu_get_num_threads()
+
+
+def get_memory_stats(device: str="cuda") -> Dict[str, Any]:
+    """Returns allocation statistics for a device
+
+    Includes the caching allocator's counters (``bytes_in_use``, ``bytes_cached``, ``high_water_mark``,
+    ``fragmentation``, ``num_hits``, ``num_misses``), and for ``cuda`` devices using stream-ordered 
+    allocation the driver memory pool's current and peak ``pool_used`` / ``pool_reserved`` bytes.
+
+    Args:
+        device: The device to query, either ``cpu``, a CUDA device, or ``pinned`` for page-locked host memory
+    """
+
+    if device == "cpu":
+        return runtime.host_allocator.stats()
+
+    if device == "pinned":
+        return runtime.pinned_allocator.stats()
+
+    device = get_device(device)
+
+    stats = runtime.allocators[device].stats()
+
+    with ScopedDevice(device):
+
+        if not runtime.core.cuda_mempool_enabled():
+            return stats
+
+        values = [ctypes.c_uint64(0) for i in range(4)]
+        runtime.core.cuda_mempool_get_stats(*[ctypes.byref(v) for v in values])
+
+        stats["pool_used"] = values[0].value
+        stats["pool_used_high"] = values[1].value
+        stats["pool_reserved"] = values[2].value
+        stats["pool_reserved_high"] = values[3].value
+
+    return stats
+
+
+def trim_memory(device: str="cuda", max_cached_bytes: int=0):
+    """Release memory cached by the allocator back to the system
+
+    Must not be called during CUDA graph capture.
+
+    Args:
+        device: The device whose cache should be trimmed, either ``cpu`` (including pinned memory) or a CUDA device
+        max_cached_bytes: The number of bytes the allocator may keep cached
+    """
+
+    if device == "cpu":
+        runtime.host_allocator.trim(max_cached_bytes)
+        runtime.pinned_allocator.trim(max_cached_bytes)
+    else:
+        device = get_device(device)
+
+        runtime.allocators[device].trim(max_cached_bytes)
+        
+        # release memory held by the driver pool after the stream-ordered frees complete
+        with ScopedDevice(device):
+            runtime.core.cuda_mempool_trim(ctypes.c_size_t(0))
+
+
+def get_kernel_cache_dir() -> str:
+    """Returns the directory where compiled kernels are cached.
+
+    This is ``warp.config.kernel_cache_dir`` if set, otherwise the ``WARP_CACHE_PATH`` environment variable,
+    otherwise the ``bin`` directory of the Warp package. The directory may be shared by many processes,
+    entries are written atomically and each entry is built once, other processes wait for it to complete.
+    """
+
+    if (warp.config.kernel_cache_dir):
+        return os.path.abspath(warp.config.kernel_cache_dir)
+
+    if (os.environ.get("WARP_CACHE_PATH")):
+        return os.path.abspath(os.environ["WARP_CACHE_PATH"])
+
+    return os.path.join(os.path.dirname(os.path.realpath(__file__)), "bin")
+
 def force_load():
     """Force all user-defined kernels to be compiled
+
+    Modules are built concurrently on a pool of ``warp.config.build_threads`` threads,
+    with the CPU and CUDA targets of each module compiled in parallel. A module that fails
+    to build does not prevent the others from loading, all failures are reported together
+    in a single exception once every module has been attempted.
     """
 
-    for m in user_modules.values():
-        if (m.loaded == False):
-            m.load()
+    modules = [m for m in user_modules.values() if (m.loaded == False and m.build_failed == False)]
+
+    # (module, exception) of every failed module in the order they failed
+    errors = []
+
+    with ScopedTimer("Module build", active=warp.config.verbose):
+
+        tasks = []
+        for m in modules:
+            try:
+                tasks.extend([(m, t) for t in m.prepare_build()])
+            except Exception as e:
+                m.build_failed = True
+                errors.append((m, e))
+
+        run_build_tasks([(m, t) for m, t in tasks if not m.build_failed], errors)
+
+        # modules are loaded serially from this thread which owns the CUDA context
+        for m in modules:
+
+            if (m.build_failed):
+                continue
+
+            try:
+                m.finish_load([task for module, task in tasks if module is m])
+            except Exception as e:
+                m.build_failed = True
+                errors.append((m, e))
+
+    if (len(errors)):
+
+        for m, e in errors:
+            print(f"Module {m.name} failed to load: {e}")
+
+        raise RuntimeError(f"{len(errors)} of {len(modules)} modules failed to load: " + ", ".join(m.name for m, e in errors)) from errors[0][1]
 
 def set_module_options(options: Dict[str, Any]):
     """Set options for the current module.
@@ -889,6 +2171,13 @@ def set_module_options(options: Dict[str, Any]):
 
     * **mode**: The compilation mode to use, can be "debug", or "release", defaults to the value of ``warp.config.mode``.
     * **max_unroll**: The maximum fixed-size loop to unroll (default 16)
+    * **cpu_parallel**: Whether CPU launches are split across the runtime's worker threads, defaults to the value of ``warp.config.cpu_parallel``.
+      Disable for kernels that rely on a serial execution order.
+    * **cpu_simd**: Instruction set the forward pass of CPU kernels is vectorized for, ``"avx2"``, ``"avx512"``, ``"neon"``, or ``"auto"``
+      for the best one the host supports, defaults to the value of ``warp.config.cpu_simd``. Kernels that use atomics, dense matrix
+      builtins, or printing are compiled one thread per call.
+    * **targets**: List of targets the module is compiled for, e.g.: ``["cuda"]`` to skip the host compiler in CUDA-only deployments,
+      defaults to the value of ``warp.config.targets``, where None selects every available target.
 
     Args:
 
@@ -912,8 +2201,9 @@ def get_module_options() -> Dict[str, Any]:
 def capture_begin():
     """Begin capture of a CUDA graph
 
-    Captures all subsequent kernel launches and memory operations on CUDA devices.
-    This can be used to record large numbers of kernels and replay them with low-overhead.
+    Captures all subsequent kernel launches and memory operations on the current stream of the current CUDA device.
+    This can be used to record large numbers of kernels and replay them with low-overhead. Graphs are always launched
+    on the device they were captured on.
     """
 
     if warp.config.verify_cuda == True:
@@ -924,6 +2214,7 @@ def capture_begin():
     force_load()
 
     runtime.core.cuda_graph_begin_capture()
+    runtime.capturing = True
 
 def capture_end()->int:
     """Ends the capture of a CUDA graph
@@ -933,6 +2224,10 @@ def capture_end()->int:
     """
 
     graph = runtime.core.cuda_graph_end_capture()
+    runtime.capturing = False
+
+    for allocator in runtime.device_allocators:
+        allocator.end_capture()
     
     if graph == None:
         raise RuntimeError("Error occured during CUDA graph capture. This could be due to an unintended allocation or CPU/GPU synchronization event.")
@@ -949,35 +2244,258 @@ def capture_launch(graph: int):
     runtime.core.cuda_graph_launch(ctypes.c_void_p(graph))
 
 
-def copy(dest: warp.array, src: warp.array):
+def copy(dest: warp.array, src: warp.array, stream: Stream=None):
     """Copy array contents from src to dest
 
     Args:
         dest: Destination array, must be at least as big as source buffer
         src: Source array
+        stream: The stream to issue CUDA copies on, defaults to the current stream of the device involved
 
+    Arrays on two different CUDA devices are copied peer-to-peer, the copy is issued on the destination device's
+    stream after prior work on the source device's stream, and later work on the source device waits for it.
     """
 
+    if (stream and (src.device != "cpu" or dest.device != "cpu")):
+        with ScopedStream(stream):
+            copy(dest, src)
+        return
+
     src_bytes = src.length*type_size_in_bytes(src.dtype)
     dst_bytes = dest.length*type_size_in_bytes(dest.dtype)
 
     if (src_bytes > dst_bytes):
         raise RuntimeError(f"Trying to copy source buffer with size ({src_bytes}) > dest buffer ({dst_bytes})")
 
-    if (src.device == "cpu" and dest.device == "cuda"):
-        runtime.core.memcpy_h2d(ctypes.c_void_p(dest.ptr), ctypes.c_void_p(src.ptr), ctypes.c_size_t(src_bytes))
+    # copies are issued on the current stream of the CUDA device involved, or of the destination for peer copies
+    if (src.device == "cpu" and dest.device == "cpu"):
+        kind = "h2h"
+        device = "cpu"
+    elif (src.device == "cpu"):
+        kind = "h2d"
+        device = dest.device
+    elif (dest.device == "cpu"):
+        kind = "d2h"
+        device = src.device
+    elif (src.device == dest.device):
+        kind = "d2d"
+        device = dest.device
+    else:
+        kind = "peer"
+        device = dest.device
 
-    elif (src.device == "cuda" and dest.device == "cpu"):
-        runtime.core.memcpy_d2h(ctypes.c_void_p(dest.ptr), ctypes.c_void_p(src.ptr), ctypes.c_size_t(src_bytes))
+    if (kind == "peer"):
+        args = (ctypes.c_int(get_device_ordinal(dest.device)), ctypes.c_void_p(dest.ptr), ctypes.c_int(get_device_ordinal(src.device)), ctypes.c_void_p(src.ptr), ctypes.c_size_t(src_bytes))
+    else:
+        args = (ctypes.c_void_p(dest.ptr), ctypes.c_void_p(src.ptr), ctypes.c_size_t(src_bytes))
 
-    elif (src.device == "cpu" and dest.device == "cpu"):
-        runtime.core.memcpy_h2h(ctypes.c_void_p(dest.ptr), ctypes.c_void_p(src.ptr), ctypes.c_size_t(src_bytes))
+    memcpy_func = getattr(runtime.core, "memcpy_" + kind)
 
-    elif (src.device == "cuda" and dest.device == "cuda"):
-        runtime.core.memcpy_d2d(ctypes.c_void_p(dest.ptr), ctypes.c_void_p(src.ptr), ctypes.c_size_t(src_bytes))
+    with ScopedDevice(device):
+
+        if (runtime.profiler):
+            with warp.profiler.ScopedProfile("memcpy_" + kind, device, bytes=src_bytes, category="memcpy"):
+                memcpy_func(*args)
+        else:
+            memcpy_func(*args)
+
+        # peer copies are issued on the destination device, later work on the source device already waits for them
+        if (kind == "peer"):
+            record_stream((dest,), device)
+        elif (device != "cpu"):
+            record_stream((dest, src), device)
+
+
+# element type codes for the native reductions, see wp::ReduceType in reduce.h
+def reduce_type(dtype):
+
+    if warp.types.types_equal(dtype, int):
+        return 0
+    elif warp.types.types_equal(dtype, float):
+        return 1
+    elif dtype == warp.types.vec3:
+        return 2
+    else:
+        raise RuntimeError(f"Array reductions do not support arrays of type {dtype}, supported types are int, float, and vec3")
+
+def reduce_launch(name, arrays, out, out_dtype, *args):
+
+    device = arrays[0].device
+
+    for a in arrays:
+        if a.device != device:
+            raise RuntimeError(f"{name}() arrays must be on the same device, got {a.device} and {device}")
+
+    if out.device != device:
+        raise RuntimeError(f"{name}() output must be on the same device as its inputs ({device}), got {out.device}")
+
+    # the native reductions write elements of out_dtype, any other output would be over or under written
+    if not warp.types.types_equal(out.dtype, out_dtype) or len(out) < 1:
+        raise RuntimeError(f"{name}() output must be an array of at least one {out_dtype.__name__} element, got {len(out)} elements of {out.dtype.__name__}")
+
+    if device == "cpu":
+        func = getattr(runtime.core, name + "_host")
+    else:
+        func = getattr(runtime.core, name + "_device")
     
+    with ScopedDevice(device):
+        func(*[ctypes.c_uint64(a.ptr or 0) for a in arrays], ctypes.c_uint64(out.ptr), ctypes.c_int(len(arrays[0])), ctypes.c_int(reduce_type(arrays[0].dtype)), *args)
+
+    return out
+
+def array_sum(a: warp.array, out: warp.array=None) -> warp.array:
+    """Computes the sum of all elements of an array
+
+    The result is written to a single element array on the same device as the input, 
+    for ``cuda`` arrays the reduction is asynchronous and does not synchronize the device.
+
+    Args:
+        a: Input array of int, float, or vec3 elements
+        out: Optional single element output array with the same dtype as ``a``
+
+    Returns:
+        The output array
+    """
+
+    if out == None:
+        out = zeros(1, dtype=a.dtype, device=a.device)
+
+    return reduce_launch("array_sum", [a], out, a.dtype)
+
+def array_inner(a: warp.array, b: warp.array, out: warp.array=None) -> warp.array:
+    """Computes the inner product sum(dot(a[i], b[i])) of two arrays, see :func:`array_sum`
+
+    Args:
+        a: Input array of int, float, or vec3 elements
+        b: Input array with the same dtype and length as ``a``
+        out: Optional single element output array, with dtype float for vec3 inputs
+    """
+
+    if not warp.types.types_equal(a.dtype, b.dtype) or len(a) != len(b):
+        raise RuntimeError("array_inner() arrays must have matching types and lengths")
+
+    out_dtype = float if a.dtype == warp.types.vec3 else a.dtype
+
+    if out == None:
+        out = zeros(1, dtype=out_dtype, device=a.device)
+
+    return reduce_launch("array_inner", [a, b], out, out_dtype)
+
+def array_min(a: warp.array, out: warp.array=None) -> warp.array:
+    """Computes the minimum of a non-empty array, component-wise for vector types, see :func:`array_sum`
+    """
+
+    if len(a) == 0:
+        raise RuntimeError("array_min() of empty array")
+
+    if out == None:
+        out = empty(1, dtype=a.dtype, device=a.device)
+
+    return reduce_launch("array_min", [a], out, a.dtype)
+
+def array_max(a: warp.array, out: warp.array=None) -> warp.array:
+    """Computes the maximum of a non-empty array, component-wise for vector types, see :func:`array_sum`
+    """
+
+    if len(a) == 0:
+        raise RuntimeError("array_max() of empty array")
+
+    if out == None:
+        out = empty(1, dtype=a.dtype, device=a.device)
+
+    return reduce_launch("array_max", [a], out, a.dtype)
+
+def array_argmin(a: warp.array, out: warp.array=None) -> warp.array:
+    """Computes the index of the minimum element of a non-empty int or float array, see :func:`array_sum`
+
+    The output is a single element int array.
+    """
+
+    if len(a) == 0:
+        raise RuntimeError("array_argmin() of empty array")
+
+    if a.dtype == warp.types.vec3:
+        raise RuntimeError("array_argmin() is only supported for int and float arrays")
+
+    if out == None:
+        out = empty(1, dtype=int, device=a.device)
+
+    return reduce_launch("array_argmin", [a], out, int)
+
+def array_argmax(a: warp.array, out: warp.array=None) -> warp.array:
+    """Computes the index of the maximum element of a non-empty int or float array, see :func:`array_sum`
+
+    The output is a single element int array.
+    """
+
+    if len(a) == 0:
+        raise RuntimeError("array_argmax() of empty array")
+
+    if a.dtype == warp.types.vec3:
+        raise RuntimeError("array_argmax() is only supported for int and float arrays")
+
+    if out == None:
+        out = empty(1, dtype=int, device=a.device)
+
+    return reduce_launch("array_argmax", [a], out, int)
+
+def array_scan(a: warp.array, out: warp.array=None, inclusive: bool=True) -> warp.array:
+    """Computes the prefix sum of an array
+
+    Args:
+        a: Input array of int, float, or vec3 elements
+        out: Optional output array with the same dtype and length as ``a``, may be ``a`` itself for an in-place scan
+        inclusive: If True element i of the result includes a[i], otherwise the scan is exclusive
+
+    Returns:
+        The output array
+    """
+
+    if out == None:
+        out = empty(len(a), dtype=a.dtype, device=a.device)
+
+    if not warp.types.types_equal(a.dtype, out.dtype) or len(out) < len(a):
+        raise RuntimeError("array_scan() output must have the same type and at least the length of the input")
+
+    return reduce_launch("array_scan", [a], out, a.dtype, ctypes.c_bool(inclusive))
+
+
+def sort_pairs(keys: warp.array, values: warp.array, count: int):
+    """Sorts the first ``count`` (key, value) pairs by key using a radix sort, the sort is stable
+
+    Both arrays must have a length of at least ``2*count``, the second half is used as temporary storage and is overwritten.
+
+    Args:
+        keys: Array of int32, float32, or int64 keys
+        values: Array of int32 values, typically indices into another array
+        count: Number of pairs to sort
+    """
+
+    if warp.types.types_equal(keys.dtype, int):
+        key_type = 0
+    elif warp.types.types_equal(keys.dtype, float):
+        key_type = 1
+    elif keys.dtype == warp.types.int64:
+        key_type = 2
     else:
-        raise RuntimeError("Unexpected source and destination combination")
+        raise RuntimeError(f"sort_pairs() does not support keys of type {keys.dtype}, supported types are int32, float32, and int64")
+
+    if not warp.types.types_equal(values.dtype, int):
+        raise RuntimeError(f"sort_pairs() values must be of type int32, got {values.dtype}")
+
+    if keys.device != values.device:
+        raise RuntimeError(f"sort_pairs() arrays must be on the same device, got {keys.device} and {values.device}")
+
+    if len(keys) < 2*count or len(values) < 2*count:
+        raise RuntimeError(f"sort_pairs() arrays must have a length of at least 2*count ({2*count}), got {len(keys)} and {len(values)}")
+
+    with warp.profiler.ScopedProfile("sort_pairs", keys.device, dim=count, category="sort"):
+
+        if keys.device == "cpu":
+            runtime.core.sort_pairs_host(ctypes.c_uint64(keys.ptr), ctypes.c_uint64(values.ptr), ctypes.c_int(count), ctypes.c_int(key_type))
+        else:
+            with ScopedDevice(keys.device):
+                runtime.core.sort_pairs_device(ctypes.c_uint64(keys.ptr), ctypes.c_uint64(values.ptr), ctypes.c_int(count), ctypes.c_int(key_type))
 
 
 def type_str(t):
@@ -1073,6 +2591,45 @@ def print_builtins(file):
 
 # ensures that correct CUDA is set for the guards lifetime
 # restores the previous CUDA context on exit
+class ScopedStream:
+    """Makes a stream current on its device for the duration of a ``with`` block, a stream of None leaves the current stream unchanged"""
+
+    def __init__(self, stream: Stream):
+        self.stream = stream
+
+    def __enter__(self):
+        if self.stream:
+            self.saved = get_stream(self.stream.device) if self.stream.device else None
+            set_stream(self.stream)
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if self.stream:
+            set_stream(self.saved)
+
+
+class ScopedDevice:
+    """Makes a CUDA device current for the duration of a ``with`` block, see :func:`set_device`
+
+    Passing ``cpu`` or None leaves the current device unchanged, e.g.: ::
+
+        with wp.ScopedDevice("cuda:1"):
+            a = wp.zeros(n, dtype=float, device="cuda")
+            wp.launch(kernel, dim=n, inputs=[a], device="cuda")
+    """
+
+    def __init__(self, device: str):
+        self.ordinal = get_device_ordinal(device) if device else -1
+
+    def __enter__(self):
+        if self.ordinal >= 0:
+            self.saved = runtime.cuda_ordinal
+            runtime.set_cuda_device(self.ordinal)
+
+    def __exit__(self, exc_type, exc_value, traceback):
+        if self.ordinal >= 0:
+            runtime.set_cuda_device(self.saved)
+
+
 class ScopedCudaGuard:
 
     def __init__(self):
@@ -415,8 +415,45 @@ CUDA_CALLABLE inline bool unot(const bool& b) { return !b; }
 CUDA_CALLABLE inline void adj_unot(const bool& b, bool& adj_b, const bool& adj_ret) { }
 
 
-// for single thread CPU only
-static int s_threadIdx;
+#if !defined(__CUDACC__)
+
+// CPU thread index, each worker of the CPU scheduler keeps its own copy
+static thread_local int s_threadIdx;
+
+// CPU launches are distributed across threads by the scheduler
+// in the core runtime (see cpu_parallel_for() in warp.cpp), generated
+// modules receive a pointer to it at load time via. cpu_set_scheduler()
+typedef void (*cpu_task_t)(void* ctx, int begin, int end);
+typedef void (*cpu_scheduler_t)(cpu_task_t task, void* ctx, int dim, int grain);
+
+static cpu_scheduler_t s_cpu_scheduler;
+
+template <typename Func>
+inline void cpu_task_range(void* ctx, int begin, int end)
+{
+    Func& f = *(Func*)(ctx);
+
+    for (int i=begin; i < end; ++i)
+        f(i);
+}
+
+// executes f(i) for i in [0, dim), in parallel if a scheduler is present
+template <typename Func>
+inline void cpu_launch(int dim, Func f)
+{
+    if (s_cpu_scheduler)
+    {
+        // grain of 0 lets the scheduler pick a chunk size
+        s_cpu_scheduler(&cpu_task_range<Func>, &f, dim, 0);
+    }
+    else
+    {
+        for (int i=0; i < dim; ++i)
+            f(i);
+    }
+}
+
+#endif // !__CUDACC__
 
 inline CUDA_CALLABLE int tid()
 {
@@ -427,14 +464,154 @@ inline CUDA_CALLABLE int tid()
 #endif
 }
 
+// kernel launch dimensions, must match launch_bounds_t in warp/context.py
+struct launch_bounds_t
+{
+    int shape[3];   // extent of each dimension, unused dimensions are 1
+    int ndim;
+    int size;       // total number of threads, product of shape
+};
+
+// returns the row-major linear index of the current thread, on the
+// device multi-dimensional launches map the last dimension to x, threads
+// outside the launch bounds return bounds.size
+inline CUDA_CALLABLE int launch_index(const launch_bounds_t& bounds)
+{
+#ifdef __CUDACC__
+    const int x = blockDim.x * blockIdx.x + threadIdx.x;
+
+    if (bounds.ndim <= 1)
+        return x;
+
+    const int y = blockDim.y * blockIdx.y + threadIdx.y;
+
+    if (bounds.ndim == 2)
+    {
+        if (x < bounds.shape[1] && y < bounds.shape[0])
+            return y*bounds.shape[1] + x;
+    }
+    else
+    {
+        const int z = blockDim.z * blockIdx.z + threadIdx.z;
+
+        if (x < bounds.shape[2] && y < bounds.shape[1] && z < bounds.shape[0])
+            return (z*bounds.shape[1] + y)*bounds.shape[2] + x;
+    }
+
+    return bounds.size;
+#else
+    return s_threadIdx;
+#endif
+}
+
+// threads per block of CUDA launches that do not specify a size
+const int LAUNCH_DEFAULT_BLOCK_DIM = 256;
+
+// thread block and grid extents of a CUDA launch, every launch path goes through this
+// so that the layout always matches launch_index(), multi-dimensional blocks are
+// tiled with the last (fastest varying) dimension mapped to x
+inline CUDA_CALLABLE void launch_geometry(const int* shape, int ndim, int block_dim, unsigned int block[3], unsigned int grid[3])
+{
+    if (block_dim <= 0)
+        block_dim = LAUNCH_DEFAULT_BLOCK_DIM;
+
+    unsigned int extent[3] = { 1, 1, 1 };
+
+    block[0] = 1;
+    block[1] = 1;
+    block[2] = 1;
+
+    if (ndim <= 1)
+    {
+        block[0] = block_dim;
+
+        extent[0] = shape[0];
+    }
+    else if (ndim == 2)
+    {
+        block[0] = block_dim < 16 ? block_dim : 16;
+        block[1] = block_dim/block[0];
+
+        extent[0] = shape[1];
+        extent[1] = shape[0];
+    }
+    else
+    {
+        block[0] = block_dim < 8 ? block_dim : 8;
+        block[1] = block_dim/block[0] < 8 ? block_dim/block[0] : 8;
+        block[2] = block_dim/(block[0]*block[1]);
+
+        extent[0] = shape[2];
+        extent[1] = shape[1];
+        extent[2] = shape[0];
+    }
+
+    for (int i=0; i < 3; ++i)
+        grid[i] = (extent[i] + block[i] - 1)/block[i];
+}
+
+#if defined(WP_CPU)
+
+// CPU kernels may run concurrently on multiple threads, so atomics are
+// implemented as a compare-and-swap loop on the integer representation
+template <int size> struct cpu_atomic_word;
+
+#if defined(_MSC_VER)
+
+template <> struct cpu_atomic_word<4> { typedef long type; };
+template <> struct cpu_atomic_word<8> { typedef __int64 type; };
+
+extern "C" long _InterlockedCompareExchange(long volatile* dest, long exchange, long comparand);
+extern "C" __int64 _InterlockedCompareExchange64(__int64 volatile* dest, __int64 exchange, __int64 comparand);
+
+inline long cpu_atomic_cas(volatile long* dest, long expected, long desired) { return _InterlockedCompareExchange(dest, desired, expected); }
+inline __int64 cpu_atomic_cas(volatile __int64* dest, __int64 expected, __int64 desired) { return _InterlockedCompareExchange64(dest, desired, expected); }
+
+#else
+
+template <> struct cpu_atomic_word<4> { typedef int32_t type; };
+template <> struct cpu_atomic_word<8> { typedef int64_t type; };
+
+template <typename Word>
+inline Word cpu_atomic_cas(volatile Word* dest, Word expected, Word desired) { return __sync_val_compare_and_swap(dest, expected, desired); }
+
+#endif
+
+template<typename T>
+inline T cpu_atomic_add(T* buf, T value)
+{
+    static_assert(sizeof(T) == 4 || sizeof(T) == 8, "CPU atomic_add() only supports 32 and 64-bit types");
+
+    typedef typename cpu_atomic_word<sizeof(T)>::type Word;
+
+    union Value { T t; Word w; };
+
+    volatile Word* dest = (volatile Word*)(buf);
+
+    Value expected;
+    expected.w = *dest;
+
+    for (;;)
+    {
+        Value desired;
+        desired.t = expected.t + value;
+
+        const Word prev = cpu_atomic_cas(dest, expected.w, desired.w);
+        if (prev == expected.w)
+            return expected.t;
+
+        // another thread modified the value, retry with the latest
+        expected.w = prev;
+    }
+}
+
+#endif // WP_CPU
 
 template<typename T>
 inline CUDA_CALLABLE T atomic_add(T* buf, T value)
 {
 #if defined(WP_CPU)
-    T old = buf[0];
-    buf[0] += value;
-    return old;
+    return cpu_atomic_add(buf, value);
 #elif defined(WP_CUDA)
     return atomicAdd(buf, value);
 #endif
@@ -456,6 +633,7 @@ inline CUDA_CALLABLE T atomic_add(T* buf, T value)
 #include "mesh.h"
 #include "svd.h"
 #include "hashgrid.h"
+#include "neighborlist.h"
 #include "rand.h"
 #include "noise.h"
 #include "volume.h"
@@ -501,11 +679,7 @@ inline CUDA_CALLABLE void adj_load(T* buf, int index, T* adj_buf, int& adj_index
     // allow NULL buffers for case where gradients are not required
     if (adj_buf) {
 
-#if defined(WP_CPU)
-        adj_buf[index] += adj_output;  // does not need to be atomic if single-threaded
-#elif defined(WP_CUDA)
         atomic_add(adj_buf, index, adj_output);
-#endif
 
     }
 }
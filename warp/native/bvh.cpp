@@ -6,6 +6,7 @@
  * license agreement from NVIDIA CORPORATION is strictly prohibited.
  */
 
+#include "warp.h"
 #include "bvh.h"
 
 #include <vector>
@@ -18,26 +19,90 @@ namespace wp
 
 /////////////////////////////////////////////////////////////////////////////////////////////
 
-class MedianBVHBuilder
+// top down builder, each range of items is split in two by the selected method. Every subtree
+// of k items occupies exactly 2k-1 consecutive nodes in depth first order, so node indices
+// are known before children are built and large subtrees can be built as independent tasks
+class TopDownBVHBuilder
 {	
 public:
 
-    void build(BVH& bvh, const bounds3* items, int n);
+    void build(BVH& bvh, const bounds3* items, int n, int method);
 
 private:
 
-    bounds3 calc_bounds(const bounds3* bounds, const int* indices, int start, int end);
+    struct Task
+    {
+        int start;
+        int end;
+        int depth;
+        int parent;
+        int node_index;
+    };
+
+    void calc_bounds(const bounds3* bounds, const int* indices, int start, int end, bounds3& range_bounds, bounds3& centroid_bounds, bool parallel);
 
     int partition_median(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds);
     int partition_midpoint(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds);
-    int partition_sah(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds);
+    int partition_sah(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds, bounds3 centroid_bounds, bool parallel);
+
+    void build_recursive(BVH& bvh, const bounds3* bounds, int* indices, int start, int end, int depth, int parent, int node_index, int& max_depth, std::vector<Task>* tasks);
 
-    int build_recursive(BVH& bvh, const bounds3* bounds, int* indices, int start, int end, int depth, int parent);
+    int method;
+
+    // ranges at most this size are deferred to the parallel task phase
+    int task_size;
 };
 
+// number of bins per axis used to evaluate SAH split candidates
+const int kSAHBins = 32;
+
+// ranges with at least this many items compute bounds and bins with the CPU thread pool,
+// only used while splitting the top of the tree, nested launches would run serially anyway
+const int kParallelRange = 64*1024;
+
+// smallest subtree that is built as a separate task
+const int kMinTaskSize = 1024;
+
+// SAH trees can be arbitrarily deep for clustered inputs, below this depth median splits
+// are used instead so the tree always fits the BVH_QUERY_STACK_SIZE traversal stack
+const int kMaxSAHDepth = 32;
+
+struct SAHBin
+{
+    bounds3 bounds;
+    int count;
+
+    SAHBin() : count(0) {}
+};
+
+inline int sah_bin_index(float centroid, float lower, float scale)
+{
+    const int b = int((centroid-lower)*scale);
+    return b < kSAHBins ? b : kSAHBins-1;
+}
+
+// splits [0, n) into chunks for the thread pool, or a single chunk for small ranges
+inline int range_num_chunks(int n, bool parallel)
+{
+    if (!parallel || n < kParallelRange)
+        return 1;
+
+    const int max_chunks = cpu_get_num_threads()*4;
+    const int num_chunks = n/(kParallelRange/4);
+
+    return num_chunks < max_chunks ? num_chunks : max_chunks;
+}
+
+inline void range_chunk(int chunk, int num_chunks, int start, int end, int& begin, int& last)
+{
+    const int64_t n = end-start;
+    begin = start + int((n*chunk)/num_chunks);
+    last = start + int((n*(chunk+1))/num_chunks);
+}
+
 //////////////////////////////////////////////////////////////////////
 
-void MedianBVHBuilder::build(BVH& bvh, const bounds3* items, int n)
+void TopDownBVHBuilder::build(BVH& bvh, const bounds3* items, int n, int m)
 {
     memset(&bvh, 0, sizeof(BVH));
 
@@ -59,18 +124,64 @@ void MedianBVHBuilder::build(BVH& bvh, const bounds3* items, int n)
     for (int i=0; i < n; ++i)
         indices[i] = i;
 
-    build_recursive(bvh, items, &indices[0], 0, n, 0, -1);
+    method = m;
+    task_size = std::max(kMinTaskSize, n/(cpu_get_num_threads()*8));
+
+    // split the top of the tree serially until subtrees are small enough to balance across threads
+    std::vector<Task> tasks;
+    int max_depth = 0;
+
+    build_recursive(bvh, items, &indices[0], 0, n, 0, -1, 0, max_depth, &tasks);
+
+    std::vector<int> task_depths(tasks.size(), 0);
+
+    cpu_launch(int(tasks.size()), [&](int i)
+    {
+        const Task& t = tasks[i];
+        build_recursive(bvh, items, &indices[0], t.start, t.end, t.depth, t.parent, t.node_index, task_depths[i], NULL);
+    });
+
+    for (size_t i=0; i < tasks.size(); ++i)
+        max_depth = std::max(max_depth, task_depths[i]);
+
+    bvh.num_nodes = bvh.max_nodes;
+    bvh.max_depth = max_depth;
 }
 
 
-bounds3 MedianBVHBuilder::calc_bounds(const bounds3* bounds, const int* indices, int start, int end)
+void TopDownBVHBuilder::calc_bounds(const bounds3* bounds, const int* indices, int start, int end, bounds3& range_bounds, bounds3& centroid_bounds, bool parallel)
 {
-    bounds3 u;
+    const int num_chunks = range_num_chunks(end-start, parallel);
+
+    std::vector<bounds3> partials(2*num_chunks);
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, last;
+        range_chunk(chunk, num_chunks, start, end, begin, last);
+
+        bounds3 u, c;
+
+        for (int i=begin; i < last; ++i)
+        {
+            const bounds3& b = bounds[indices[i]];
+
+            u = bounds_union(u, b);
+            c.add_point(b.center());
+        }
+
+        partials[chunk*2+0] = u;
+        partials[chunk*2+1] = c;
+    });
 
-    for (int i=start; i < end; ++i)
-        u = bounds_union(u, bounds[indices[i]]);
+    range_bounds = bounds3();
+    centroid_bounds = bounds3();
 
-    return u;
+    for (int chunk=0; chunk < num_chunks; ++chunk)
+    {
+        range_bounds = bounds_union(range_bounds, partials[chunk*2+0]);
+        centroid_bounds = bounds_union(centroid_bounds, partials[chunk*2+1]);
+    }
 }
 
 struct PartitionPredicateMedian
@@ -87,7 +198,7 @@ struct PartitionPredicateMedian
 };
 
 
-int MedianBVHBuilder::partition_median(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds)
+int TopDownBVHBuilder::partition_median(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds)
 {
     assert(end-start >= 2);
 
@@ -117,7 +228,7 @@ struct PartitionPredictateMidPoint
 };
 
 
-int MedianBVHBuilder::partition_midpoint(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds)
+int TopDownBVHBuilder::partition_midpoint(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds)
 {
     assert(end-start >= 2);
 
@@ -139,72 +250,159 @@ int MedianBVHBuilder::partition_midpoint(const bounds3* bounds, int* indices, in
     return k;
 }
 
-int MedianBVHBuilder::partition_sah(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds)
+struct PartitionPredicateBin
+{
+    PartitionPredicateBin(const bounds3* bounds, int a, float l, float s, int b) : bounds(bounds), axis(a), lower(l), scale(s), bin(b) {}
+
+    bool operator()(int index) const
+    {
+        return sah_bin_index(bounds[index].center()[axis], lower, scale) <= bin;
+    }
+
+    const bounds3* bounds;
+    int axis;
+    float lower;
+    float scale;
+    int bin;
+};
+
+// bins item centroids on all three axes and picks the bin boundary with the lowest SAH cost,
+// cost is O(n) per node with no sorting or allocation in the common (small range) case
+int TopDownBVHBuilder::partition_sah(const bounds3* bounds, int* indices, int start, int end, bounds3 range_bounds, bounds3 centroid_bounds, bool parallel)
 {
     assert(end-start >= 2);
 
-    int n = end-start;
-    vec3 edges = range_bounds.edges();
+    const vec3 lower = centroid_bounds.lower;
+    const vec3 edges = centroid_bounds.edges();
 
-    int longestAxis = longest_axis(edges);
+    vec3 scale;
+    for (int axis=0; axis < 3; ++axis)
+        scale[axis] = edges[axis] > 0.0f ? kSAHBins/edges[axis] : 0.0f;
 
-    // sort along longest axis
-    std::sort(&indices[0]+start, &indices[0]+end, PartitionPredicateMedian(&bounds[0], longestAxis));
+    const int num_chunks = range_num_chunks(end-start, parallel);
 
-    // total area for range from [0, split]
-    std::vector<float> left_areas(n);
-    // total area for range from (split, end]
-    std::vector<float> right_areas(n);
+    SAHBin local_bins[3*kSAHBins];
+    std::vector<SAHBin> chunk_bins(num_chunks > 1 ? num_chunks*3*kSAHBins : 0);
 
-    bounds3 left;
-    bounds3 right;
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, last;
+        range_chunk(chunk, num_chunks, start, end, begin, last);
 
-    // build cumulative bounds and area from left and right
-    for (int i=0; i < n; ++i)
+        SAHBin* bins = num_chunks > 1 ? &chunk_bins[chunk*3*kSAHBins] : local_bins;
+
+        for (int i=begin; i < last; ++i)
+        {
+            const bounds3& b = bounds[indices[i]];
+            const vec3 c = b.center();
+
+            for (int axis=0; axis < 3; ++axis)
+            {
+                SAHBin& bin = bins[axis*kSAHBins + sah_bin_index(c[axis], lower[axis], scale[axis])];
+
+                bin.bounds = bounds_union(bin.bounds, b);
+                bin.count++;
+            }
+        }
+    });
+
+    if (num_chunks > 1)
     {
-        left = bounds_union(left, bounds[indices[start+i]]);
-        right = bounds_union(right, bounds[indices[end-i-1]]);
+        for (int chunk=0; chunk < num_chunks; ++chunk)
+        {
+            for (int i=0; i < 3*kSAHBins; ++i)
+            {
+                const SAHBin& bin = chunk_bins[chunk*3*kSAHBins + i];
 
-        left_areas[i] = left.area();
-        right_areas[n-i-1] = right.area();
+                local_bins[i].bounds = bounds_union(local_bins[i].bounds, bin.bounds);
+                local_bins[i].count += bin.count;
+            }
+        }
     }
 
-    float invTotalArea = 1.0f/range_bounds.area();
-
-    // find split point i that minimizes area(left[i]) + area(right[i])
-    int minSplit = 0;
-    float minCost = FLT_MAX;
+    int best_axis = -1;
+    int best_bin = 0;
+    float best_cost = FLT_MAX;
 
-    for (int i=0; i < n; ++i)
+    for (int axis=0; axis < 3; ++axis)
     {
-        float pBelow = left_areas[i]*invTotalArea;
-        float pAbove = right_areas[i]*invTotalArea;
+        // all centroids coincide along this axis
+        if (scale[axis] == 0.0f)
+            continue;
+
+        const SAHBin* bins = &local_bins[axis*kSAHBins];
 
-        float cost = pBelow*i + pAbove*(n-i);
+        // sweep from the right to find the area and count above each boundary
+        float right_areas[kSAHBins];
+        int right_counts[kSAHBins];
 
-        if (cost < minCost)
+        bounds3 right;
+        int count = 0;
+
+        for (int i=kSAHBins-1; i > 0; --i)
         {
-            minCost = cost;
-            minSplit = i;
+            right = bounds_union(right, bins[i].bounds);
+            count += bins[i].count;
+
+            right_areas[i] = right.area();
+            right_counts[i] = count;
+        }
+
+        bounds3 left;
+        count = 0;
+
+        // boundary i lies between bins i and i+1
+        for (int i=0; i < kSAHBins-1; ++i)
+        {
+            left = bounds_union(left, bins[i].bounds);
+            count += bins[i].count;
+
+            if (count == 0 || right_counts[i+1] == 0)
+                continue;
+
+            const float cost = left.area()*count + right_areas[i+1]*right_counts[i+1];
+
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best_axis = axis;
+                best_bin = i;
+            }
         }
     }
 
-    return start + minSplit + 1;
+    // degenerate range, every centroid is identical
+    if (best_axis == -1)
+        return (start+end)/2;
+
+    int* upper = std::partition(indices+start, indices+end, PartitionPredicateBin(&bounds[0], best_axis, lower[best_axis], scale[best_axis], best_bin));
+
+    return int(upper-indices);
 }
 
-int MedianBVHBuilder::build_recursive(BVH& bvh, const bounds3* bounds, int* indices, int start, int end, int depth, int parent)
+void TopDownBVHBuilder::build_recursive(BVH& bvh, const bounds3* bounds, int* indices, int start, int end, int depth, int parent, int node_index, int& max_depth, std::vector<Task>* tasks)
 {
     assert(start < end);
 
     const int n = end-start;
-    const int node_index = bvh.num_nodes++;
 
-    assert(node_index < bvh.max_nodes);
+    assert(node_index + 2*n-1 <= bvh.max_nodes);
+
+    if (tasks && n <= task_size)
+    {
+        Task t = { start, end, depth, parent, node_index };
+        tasks->push_back(t);
+        return;
+    }
+
+    if (depth > max_depth)
+        max_depth = depth;
 
-    if (depth > bvh.max_depth)
-        bvh.max_depth = depth;
+    // tasks are already running on the thread pool
+    const bool parallel = tasks != NULL;
 
-    bounds3 b = calc_bounds(bounds, indices, start, end);
+    bounds3 b, c;
+    calc_bounds(bounds, indices, start, end, b, c, parallel);
     
     const int kMaxItemsPerLeaf = 1;
 
@@ -216,25 +414,30 @@ int MedianBVHBuilder::build_recursive(BVH& bvh, const bounds3* bounds, int* indi
     }
     else    
     {
-        //int split = partition_midpoint(bounds, indices, start, end, b);
-        int split = partition_median(bounds, indices, start, end, b);
-        //int split = partition_sah(bounds, indices, start, end, b);
+        int split;
+
+        if (method == BVH_BUILDER_MEDIAN || depth >= kMaxSAHDepth)
+            split = partition_median(bounds, indices, start, end, b);
+        else
+            split = partition_sah(bounds, indices, start, end, b, c, parallel);
 
         if (split == start || split == end)
         {
             // partitioning failed, split down the middle
             split = (start+end)/2;
         }
+
+        // left subtree immediately follows this node, right subtree follows the left one
+        const int left_child = node_index + 1;
+        const int right_child = node_index + 2*(split-start);
     
-        int left_child = build_recursive(bvh, bounds, indices, start, split, depth+1, node_index);
-        int right_child = build_recursive(bvh, bounds, indices, split, end, depth+1, node_index);
+        build_recursive(bvh, bounds, indices, start, split, depth+1, node_index, left_child, max_depth, tasks);
+        build_recursive(bvh, bounds, indices, split, end, depth+1, node_index, right_child, max_depth, tasks);
         
         bvh.node_lowers[node_index] = make_node(b.lower, left_child, false);
         bvh.node_uppers[node_index] = make_node(b.upper, right_child, false);
         bvh.node_parents[node_index] = parent;
     }
-
-    return node_index;
 }
 
 class LinearBVHBuilderCPU
@@ -256,7 +459,7 @@ private:
 
     bounds3 calc_bounds(const bounds3* bounds, const KeyIndexPair* keys, int start, int end);
     int find_split(const KeyIndexPair* pairs, int start, int end);
-    int build_recursive(BVH& bvh, const KeyIndexPair* keys, const bounds3* bounds, int start, int end, int depth);
+    int build_recursive(BVH& bvh, const KeyIndexPair* keys, const bounds3* bounds, int start, int end, int depth, int parent);
 
 };
 
@@ -269,11 +472,15 @@ void LinearBVHBuilderCPU::build(BVH& bvh, const bounds3* items, int n)
 
 	bvh.node_lowers = new BVHPackedNodeHalf[bvh.max_nodes];
 	bvh.node_uppers = new BVHPackedNodeHalf[bvh.max_nodes];
+	bvh.node_parents = new int[bvh.max_nodes];
 	bvh.num_nodes = 0;
 
 	// root is always in first slot for top down builders
 	bvh.root = 0;
 
+	if (n == 0)
+		return;
+
 	std::vector<KeyIndexPair> keys;
 	keys.reserve(n);
 
@@ -302,9 +509,7 @@ void LinearBVHBuilderCPU::build(BVH& bvh, const bounds3* items, int n)
 	// sort by key
 	std::sort(keys.begin(), keys.end());
 
-	build_recursive(bvh, &keys[0], items,  0, n, 0);
-
-	printf("Created BVH for %d items with %d nodes, max depth of %d\n", n, bvh.num_nodes, bvh.max_depth);
+	build_recursive(bvh, &keys[0], items,  0, n, 0, -1);
 }
 
 
@@ -348,7 +553,7 @@ inline int LinearBVHBuilderCPU::find_split(const KeyIndexPair* pairs, int start,
 	return start;
 }
 
-int LinearBVHBuilderCPU::build_recursive(BVH& bvh, const KeyIndexPair* keys, const bounds3* bounds, int start, int end, int depth)
+int LinearBVHBuilderCPU::build_recursive(BVH& bvh, const KeyIndexPair* keys, const bounds3* bounds, int start, int end, int depth, int parent)
 {
 	assert(start < end);
 
@@ -368,16 +573,18 @@ int LinearBVHBuilderCPU::build_recursive(BVH& bvh, const KeyIndexPair* keys, con
 	{
 		bvh.node_lowers[nodeIndex] = make_node(b.lower, keys[start].index, true);
 		bvh.node_uppers[nodeIndex] = make_node(b.upper, keys[start].index, false);
+		bvh.node_parents[nodeIndex] = parent;
 	}
 	else
 	{
 		int split = find_split(keys, start, end);
 		
-		int leftChild = build_recursive(bvh, keys, bounds, start, split, depth+1);
-		int rightChild = build_recursive(bvh, keys, bounds, split, end, depth+1);
+		int leftChild = build_recursive(bvh, keys, bounds, start, split, depth+1, nodeIndex);
+		int rightChild = build_recursive(bvh, keys, bounds, split, end, depth+1, nodeIndex);
 			
 		bvh.node_lowers[nodeIndex] = make_node(b.lower, leftChild, false);
 		bvh.node_uppers[nodeIndex] = make_node(b.upper, rightChild, false);		
+		bvh.node_parents[nodeIndex] = parent;
 	}
 
 	return nodeIndex;
@@ -385,24 +592,82 @@ int LinearBVHBuilderCPU::build_recursive(BVH& bvh, const KeyIndexPair* keys, con
 
 
 
-// create only happens on host currently, use bvh_clone() to transfer BVH To device
-BVH bvh_create(const bounds3* bounds, int num_bounds)
+// create a BVH on host, see bvh_create_device() for building directly on the device
+BVH bvh_create(const bounds3* bounds, int num_bounds, int builder)
 {
     BVH bvh;
     memset(&bvh, 0, sizeof(bvh));
 
-    MedianBVHBuilder builder;
-    //LinearBVHBuilderCPU builder;
-    builder.build(bvh, bounds, num_bounds);
+    if (builder == BVH_BUILDER_LINEAR)
+    {
+        LinearBVHBuilderCPU b;
+        b.build(bvh, bounds, num_bounds);
+    }
+    else
+    {
+        TopDownBVHBuilder b;
+        b.build(bvh, bounds, num_bounds, builder);
+    }
+
+    bvh.num_items = num_bounds;
+
+    if (bvh.num_nodes)
+    {
+        bvh.node_counts = new int[bvh.max_nodes];
+        bvh.item_nodes = new int[num_bounds];
+
+        memset(bvh.node_counts, 0, sizeof(int)*bvh.max_nodes);
+
+        // builders emit one item per leaf
+        for (int i=0; i < bvh.num_nodes; ++i)
+        {
+            if (bvh.node_lowers[i].b)
+                bvh.item_nodes[bvh.node_lowers[i].i] = i;
+        }
+    }
 
     return bvh;
 }
 
+void bvh_rebuild_host(BVH& bvh, const bounds3* bounds, int num_bounds, int builder)
+{
+    if (num_bounds == 0)
+    {
+        bvh_destroy_host(bvh);
+        bvh.num_items = 0;
+        return;
+    }
+
+    const bool wide = bvh.wide_nodes != NULL;
+
+    // host builders allocate exactly, so build a new tree and swap it in
+    BVH rebuilt = bvh_create(bounds, num_bounds, builder);
+
+    if (wide)
+        bvh_create_wide_host(rebuilt);
+
+    bvh_destroy_host(bvh);
+    bvh = rebuilt;
+}
+
 void bvh_destroy_host(BVH& bvh)
 {
     delete[] bvh.node_lowers;
     delete[] bvh.node_uppers;
     delete[] bvh.node_parents;
+    delete[] bvh.node_counts;
+    delete[] bvh.item_nodes;
+    delete[] bvh.wide_nodes;
+    delete[] bvh.wide_sources;
+    delete[] bvh.node_wide;
+
+    bvh.node_parents = NULL;
+    bvh.node_counts = NULL;
+    bvh.item_nodes = NULL;
+    bvh.wide_nodes = NULL;
+    bvh.wide_sources = NULL;
+    bvh.node_wide = NULL;
+    bvh.num_wide_nodes = 0;
 
     bvh.node_lowers = 0;
     bvh.node_uppers = 0;
@@ -416,6 +681,10 @@ void bvh_destroy_device(BVH& bvh)
     free_device(bvh.node_uppers); bvh.node_uppers = NULL;
     free_device(bvh.node_parents); bvh.node_parents = NULL;
     free_device(bvh.node_counts); bvh.node_counts = NULL;
+    free_device(bvh.item_nodes); bvh.item_nodes = NULL;
+    free_device(bvh.wide_nodes); bvh.wide_nodes = NULL;
+    free_device(bvh.wide_sources); bvh.wide_sources = NULL;
+    free_device(bvh.node_wide); bvh.node_wide = NULL;
 }
 
 
@@ -427,55 +696,356 @@ BVH bvh_clone(const BVH& bvh_host)
     bvh_device.node_uppers = (BVHPackedNodeHalf*)alloc_device(sizeof(BVHPackedNodeHalf)*bvh_host.max_nodes);
     bvh_device.node_parents = (int*)alloc_device(sizeof(int)*bvh_host.max_nodes);
     bvh_device.node_counts = (int*)alloc_device(sizeof(int)*bvh_host.max_nodes);
+    bvh_device.item_nodes = (int*)alloc_device(sizeof(int)*bvh_host.num_items);
 
     // copy host data to device
     memcpy_h2d(bvh_device.node_lowers, bvh_host.node_lowers, sizeof(BVHPackedNodeHalf)*bvh_host.max_nodes);
     memcpy_h2d(bvh_device.node_uppers, bvh_host.node_uppers, sizeof(BVHPackedNodeHalf)*bvh_host.max_nodes);
     memcpy_h2d(bvh_device.node_parents, bvh_host.node_parents, sizeof(int)*bvh_host.max_nodes);
+    memcpy_h2d(bvh_device.item_nodes, bvh_host.item_nodes, sizeof(int)*bvh_host.num_items);
+    memset_device(bvh_device.node_counts, 0, sizeof(int)*bvh_host.max_nodes);
+
+    if (bvh_host.wide_nodes)
+    {
+        bvh_device.wide_nodes = (BVHWideNode*)alloc_device(sizeof(BVHWideNode)*bvh_host.num_wide_nodes);
+        bvh_device.wide_sources = (int*)alloc_device(sizeof(int)*(1+BVH_WIDE_WIDTH)*bvh_host.num_wide_nodes);
+        bvh_device.node_wide = (int*)alloc_device(sizeof(int)*bvh_host.max_nodes);
+
+        memcpy_h2d(bvh_device.wide_nodes, bvh_host.wide_nodes, sizeof(BVHWideNode)*bvh_host.num_wide_nodes);
+        memcpy_h2d(bvh_device.wide_sources, bvh_host.wide_sources, sizeof(int)*(1+BVH_WIDE_WIDTH)*bvh_host.num_wide_nodes);
+        memcpy_h2d(bvh_device.node_wide, bvh_host.node_wide, sizeof(int)*bvh_host.max_nodes);
+    }
 
     return bvh_device;
 }
 
-void bvh_refit_recursive(BVH& bvh, int index, const bounds3* bounds)
+namespace
+{
+
+// smallest number of nodes assigned to a thread by the host refit
+const int kMinRefitChunk = 16*1024;
+
+// partial refits touching more than 1/kPartialRefitRatio of the items fall back to a full refit
+const int kPartialRefitRatio = 8;
+
+inline void bvh_refit_leaf(BVH& bvh, int index, const bounds3* bounds)
+{
+    const int item = bvh.node_lowers[index].i;
+
+    (vec3&)bvh.node_lowers[index] = bounds[item].lower;
+    (vec3&)bvh.node_uppers[index] = bounds[item].upper;
+}
+
+// sets inner node bounds to the union of its children, returns false if they did not change
+inline bool bvh_refit_inner(BVH& bvh, int index)
 {
     BVHPackedNodeHalf& lower = bvh.node_lowers[index];
     BVHPackedNodeHalf& upper = bvh.node_uppers[index];
 
-    if (lower.b)
+    const int left_index = lower.i;
+    const int right_index = upper.i;
+
+    const vec3 new_lower = min((vec3&)bvh.node_lowers[left_index], (vec3&)bvh.node_lowers[right_index]);
+    const vec3 new_upper = max((vec3&)bvh.node_uppers[left_index], (vec3&)bvh.node_uppers[right_index]);
+
+    const bool changed = !(new_lower == (vec3&)lower && new_upper == (vec3&)upper);
+
+    (vec3&)lower = new_lower;
+    (vec3&)upper = new_upper;
+
+    return changed;
+}
+
+} // anonymous namespace
+
+// bottom-up like bvh_refit_kernel, leaves are split into contiguous node ranges across threads and
+// the second child to reach a parent computes its bounds, so each inner node is visited exactly once
+void bvh_refit_host(BVH& bvh, const bounds3* b)
+{
+    if (bvh.num_nodes == 0)
+        return;
+
+    const int max_chunks = cpu_get_num_threads()*4;
+    const int num_chunks = std::max(1, std::min(max_chunks, bvh.num_nodes/kMinRefitChunk));
+
+    cpu_launch(num_chunks, [&](int chunk)
     {
-        const int leaf_index = lower.i;
+        int begin, end;
+        range_chunk(chunk, num_chunks, 0, bvh.num_nodes, begin, end);
+
+        for (int i=begin; i < end; ++i)
+        {
+            if (!bvh.node_lowers[i].b)
+                continue;
+
+            bvh_refit_leaf(bvh, i, b);
 
-        (vec3&)lower = bounds[leaf_index].lower;
-        (vec3&)upper = bounds[leaf_index].upper;
+            int index = i;
+
+            for (;;)
+            {
+                const int parent = bvh.node_parents[index];
+                if (parent == -1)
+                    break;
+
+                // CAS is a full barrier so the sibling's bounds are visible to the second thread
+                if (cpu_atomic_add(&bvh.node_counts[parent], 1) == 0)
+                    break;
+
+                // leave the counter cleared for the next refit
+                bvh.node_counts[parent] = 0;
+                bvh_refit_inner(bvh, parent);
+
+                index = parent;
+            }
+        }
+    });
+
+    if (bvh.wide_nodes)
+        bvh_refit_wide_host(bvh);
+}
+
+// items are processed one at a time, each walks up until an ancestor's bounds stop changing,
+// which keeps the tree consistent after every item so no synchronization between paths is needed
+void bvh_refit_partial_host(BVH& bvh, const int* items, int num_items, const bounds3* b)
+{
+    if (bvh.num_nodes == 0 || num_items <= 0)
+        return;
+
+    if (num_items*kPartialRefitRatio > bvh.num_items)
+    {
+        bvh_refit_host(bvh, b);
+        return;
+    }
+
+    std::vector<int> dirty_wide;
+
+    for (int i=0; i < num_items; ++i)
+    {
+        int index = bvh.item_nodes[items[i]];
+
+        bvh_refit_leaf(bvh, index, b);
+
+        for (;;)
+        {
+            if (bvh.node_wide)
+                dirty_wide.push_back(bvh.node_wide[index]);
+
+            const int parent = bvh.node_parents[index];
+            if (parent == -1 || !bvh_refit_inner(bvh, parent))
+                break;
+
+            index = parent;
+        }
+    }
+
+    if (bvh.wide_nodes)
+    {
+        // requantize each affected wide node once, after all its children are final
+        std::sort(dirty_wide.begin(), dirty_wide.end());
+        dirty_wide.erase(std::unique(dirty_wide.begin(), dirty_wide.end()), dirty_wide.end());
+
+        for (size_t i=0; i < dirty_wide.size(); ++i)
+        {
+            const int w = dirty_wide[i];
+            if (w >= 0)
+                bvh_wide_encode(bvh.node_lowers, bvh.node_uppers, bvh.wide_sources + w*(1+BVH_WIDE_WIDTH), bvh.wide_nodes[w]);
+        }
+    }
+}
+
+namespace
+{
+
+inline float node_area(const BVH& bvh, int index)
+{
+    const BVHPackedNodeHalf& l = bvh.node_lowers[index];
+    const BVHPackedNodeHalf& u = bvh.node_uppers[index];
+
+    return bounds3(vec3(l.x, l.y, l.z), vec3(u.x, u.y, u.z)).area();
+}
+
+// emits the wide node for binary node index in depth first order, returns its wide index,
+// depth is the number of wide levels below and including this node
+int bvh_collapse_recursive(const BVH& bvh, int index, std::vector<BVHWideNode>& nodes, std::vector<int>& sources, int& depth)
+{
+    int children[BVH_WIDE_WIDTH];
+    int num_children = 0;
+
+    if (bvh.node_lowers[index].b)
+    {
+        // single leaf tree
+        children[num_children++] = index;
     }
     else
     {
-        int left_index = lower.i;
-        int right_index = upper.i;
+        children[num_children++] = bvh.node_lowers[index].i;
+        children[num_children++] = bvh.node_uppers[index].i;
+
+        // open the inner child with the largest surface area until the node is full
+        while (num_children < BVH_WIDE_WIDTH)
+        {
+            int best = -1;
+            float best_area = -1.0f;
+
+            for (int c=0; c < num_children; ++c)
+            {
+                if (!bvh.node_lowers[children[c]].b)
+                {
+                    const float area = node_area(bvh, children[c]);
+                    if (area > best_area)
+                    {
+                        best = c;
+                        best_area = area;
+                    }
+                }
+            }
+
+            if (best == -1)
+                break;
+
+            const int opened = children[best];
+            children[best] = bvh.node_lowers[opened].i;
+            children[num_children++] = bvh.node_uppers[opened].i;
+        }
+    }
 
-        bvh_refit_recursive(bvh, left_index, bounds);
-        bvh_refit_recursive(bvh, right_index, bounds);
+    const int wide_index = int(nodes.size());
+    nodes.push_back(BVHWideNode());
 
-        // compute union of children
-        const vec3& left_lower = (vec3&)bvh.node_lowers[left_index];
-        const vec3& left_upper = (vec3&)bvh.node_uppers[left_index];
+    sources.push_back(index);
+    for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+        sources.push_back(c < num_children ? children[c] : -1);
 
-        const vec3& right_lower = (vec3&)bvh.node_lowers[right_index];
-        const vec3& right_upper = (vec3&)bvh.node_uppers[right_index];
+    uint32_t wide_children[BVH_WIDE_WIDTH];
+    int child_depth = 0;
 
-        // union of child bounds
-        vec3 new_lower = min(left_lower, right_lower);
-        vec3 new_upper = max(left_upper, right_upper);
-        
-        // write new BVH nodes
-        (vec3&)lower = new_lower;
-        (vec3&)upper = new_upper;
+    for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+    {
+        if (c >= num_children)
+            wide_children[c] = BVH_WIDE_EMPTY;
+        else if (bvh.node_lowers[children[c]].b)
+            wide_children[c] = uint32_t(bvh.node_lowers[children[c]].i) | BVH_WIDE_LEAF;
+        else
+        {
+            int d = 0;
+            wide_children[c] = uint32_t(bvh_collapse_recursive(bvh, children[c], nodes, sources, d));
+            child_depth = std::max(child_depth, d);
+        }
     }
+
+    depth = child_depth + 1;
+
+    // recursion may have reallocated the node array
+    for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+        nodes[wide_index].children[c] = wide_children[c];
+
+    return wide_index;
 }
 
-void bvh_refit_host(BVH& bvh, const bounds3* b)
+} // anonymous namespace
+
+float bvh_sah_cost_host(const BVH& bvh)
+{
+    if (bvh.num_nodes == 0)
+        return 0.0f;
+
+    const int max_chunks = cpu_get_num_threads()*4;
+    const int num_chunks = std::max(1, std::min(max_chunks, bvh.num_nodes/kMinRefitChunk));
+
+    std::vector<double> partials(num_chunks, 0.0);
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        range_chunk(chunk, num_chunks, 0, bvh.num_nodes, begin, end);
+
+        double sum = 0.0;
+        for (int i=begin; i < end; ++i)
+            sum += node_area(bvh, i);
+
+        partials[chunk] = sum;
+    });
+
+    double total = 0.0;
+    for (int i=0; i < num_chunks; ++i)
+        total += partials[i];
+
+    const float root_area = node_area(bvh, bvh.root);
+
+    return root_area > 0.0f ? float(total/root_area) : 0.0f;
+}
+
+void bvh_destroy_wide_host(BVH& bvh)
+{
+    delete[] bvh.wide_nodes;
+    delete[] bvh.wide_sources;
+    delete[] bvh.node_wide;
+
+    bvh.wide_nodes = NULL;
+    bvh.wide_sources = NULL;
+    bvh.node_wide = NULL;
+    bvh.num_wide_nodes = 0;
+}
+
+void bvh_create_wide_host(BVH& bvh)
+{
+    bvh_destroy_wide_host(bvh);
+
+    if (bvh.num_nodes == 0)
+        return;
+
+    std::vector<BVHWideNode> nodes;
+    std::vector<int> sources;
+
+    nodes.reserve(bvh.num_nodes/2+1);
+    sources.reserve((bvh.num_nodes/2+1)*(1+BVH_WIDE_WIDTH));
+
+    int depth = 0;
+    bvh_collapse_recursive(bvh, bvh.root, nodes, sources, depth);
+
+    // wide traversals pop one entry and push at most BVH_WIDE_WIDTH per level, trees whose worst case
+    // does not fit the fixed query stack keep only the binary nodes, which every query falls back to
+    if ((BVH_WIDE_WIDTH-1)*depth + 1 > BVH_WIDE_QUERY_STACK_SIZE)
+        return;
+
+    bvh.num_wide_nodes = int(nodes.size());
+    bvh.wide_nodes = new BVHWideNode[nodes.size()];
+    bvh.wide_sources = new int[sources.size()];
+
+    std::copy(nodes.begin(), nodes.end(), bvh.wide_nodes);
+    std::copy(sources.begin(), sources.end(), bvh.wide_sources);
+
+    // every binary node is a child of at most one wide node
+    bvh.node_wide = new int[bvh.max_nodes];
+    std::fill(bvh.node_wide, bvh.node_wide + bvh.max_nodes, -1);
+
+    for (int i=0; i < bvh.num_wide_nodes; ++i)
+    {
+        for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+        {
+            const int child = bvh.wide_sources[i*(1+BVH_WIDE_WIDTH) + 1 + c];
+            if (child >= 0)
+                bvh.node_wide[child] = i;
+        }
+    }
+
+    bvh_refit_wide_host(bvh);
+}
+
+void bvh_refit_wide_host(BVH& bvh)
 {
-    bvh_refit_recursive(bvh, 0, b);
+    const int max_chunks = cpu_get_num_threads()*4;
+    const int num_chunks = std::max(1, std::min(max_chunks, bvh.num_wide_nodes/kMinRefitChunk));
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        range_chunk(chunk, num_chunks, 0, bvh.num_wide_nodes, begin, end);
+
+        for (int i=begin; i < end; ++i)
+            bvh_wide_encode(bvh.node_lowers, bvh.node_uppers, bvh.wide_sources + i*(1+BVH_WIDE_WIDTH), bvh.wide_nodes[i]);
+    });
 }
 
 
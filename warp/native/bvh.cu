@@ -8,6 +8,7 @@
 
 #include "warp.h"
 #include "bvh.h"
+#include "sort.h"
 
 #include <vector>
 #include <algorithm>
@@ -15,6 +16,10 @@
 #include <cuda.h>
 #include <cuda_runtime_api.h>
 
+#define THRUST_IGNORE_CUB_VERSION_CHECK
+
+#include <cub/cub.cuh>
+
 namespace wp
 {
 
@@ -59,6 +64,9 @@ __global__ void bvh_refit_kernel(int n, const int* __restrict__ parents, int* __
             // then update its bounds and move onto the the next parent in the hierarchy
             if (finished == 1)
             {
+                // leave the counter cleared for the next (partial) refit
+                child_count[parent] = 0;
+
                 const int left_child = lowers[parent].i;
                 const int right_child = uppers[parent].i;
 
@@ -105,7 +113,497 @@ void bvh_refit_device(BVH& bvh, const bounds3* b)
     // clear child counters
     memset_device(bvh.node_counts, 0, sizeof(int)*bvh.max_nodes);
 
-    wp_launch_device(bvh_refit_kernel, bvh.max_nodes, (bvh.max_nodes, bvh.node_parents, bvh.node_counts, bvh.node_lowers, bvh.node_uppers, b));
+    wp_launch_device(bvh_refit_kernel, bvh.num_nodes, (bvh.num_nodes, bvh.node_parents, bvh.node_counts, bvh.node_lowers, bvh.node_uppers, b));
+
+    if (bvh.wide_nodes)
+        bvh_refit_wide_device(bvh);
+}
+
+// first pass of a partial refit, claims each node on the dirty paths once and counts the
+// number of dirty children of every inner node, duplicate items stop at the claimed leaf
+__global__ void bvh_refit_partial_claim(int n, const int* __restrict__ items, const int* __restrict__ item_nodes, const int* __restrict__ parents, int* __restrict__ child_count)
+{
+    const int tid = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (tid < n)
+    {
+        int index = item_nodes[items[tid]];
+
+        for (;;)
+        {
+            if (atomicOr(&child_count[index], BVH_REFIT_CLAIMED) & BVH_REFIT_CLAIMED)
+                return;
+
+            const int parent = parents[index];
+            if (parent == -1)
+                return;
+
+            atomicAdd(&child_count[parent], 1);
+            index = parent;
+        }
+    }
+}
+
+// second pass, same as bvh_refit_kernel except that parents wait for their dirty children only,
+// counters and claims are cleared on the way up
+__global__ void bvh_refit_partial_kernel(int n, const int* __restrict__ items, const int* __restrict__ item_nodes, const int* __restrict__ parents, int* __restrict__ child_count, BVHPackedNodeHalf* __restrict__ lowers, BVHPackedNodeHalf* __restrict__ uppers, const bounds3* bounds)
+{
+    const int tid = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (tid < n)
+    {
+        int index = item_nodes[items[tid]];
+
+        // only one thread per leaf continues
+        if (!(atomicAnd(&child_count[index], ~BVH_REFIT_CLAIMED) & BVH_REFIT_CLAIMED))
+            return;
+
+        const int leaf_index = lowers[index].i;
+        const bounds3& b = bounds[leaf_index];
+
+        make_node(lowers+index, b.lower, leaf_index, true);
+        make_node(uppers+index, b.upper, 0, false);
+
+        for (;;)
+        {
+            const int parent = parents[index];
+            if (parent == -1)
+                return;
+
+            __threadfence();
+
+            const int remaining = atomicSub(&child_count[parent], 1) & ~BVH_REFIT_CLAIMED;
+            if (remaining != 1)
+                return;
+
+            // last dirty child, both children are final
+            atomicAnd(&child_count[parent], ~BVH_REFIT_CLAIMED);
+
+            const int left_child = lowers[parent].i;
+            const int right_child = uppers[parent].i;
+
+            vec3 lower = min(vec3(lowers[left_child].x, lowers[left_child].y, lowers[left_child].z),
+                             vec3(lowers[right_child].x, lowers[right_child].y, lowers[right_child].z));
+
+            vec3 upper = max(vec3(uppers[left_child].x, uppers[left_child].y, uppers[left_child].z),
+                             vec3(uppers[right_child].x, uppers[right_child].y, uppers[right_child].z));
+
+            make_node(lowers+parent, lower, left_child, false);
+            make_node(uppers+parent, upper, right_child, false);
+
+            index = parent;
+        }
+    }
+}
+
+// requantizes the wide nodes holding any node on the path from each dirty leaf to the root,
+// nodes shared by several paths are encoded more than once with identical results
+__global__ void bvh_refit_partial_wide_kernel(int n, const int* __restrict__ items, const int* __restrict__ item_nodes, const int* __restrict__ parents, const int* __restrict__ node_wide,
+                                              const BVHPackedNodeHalf* __restrict__ lowers, const BVHPackedNodeHalf* __restrict__ uppers, const int* __restrict__ sources, BVHWideNode* __restrict__ nodes)
+{
+    const int tid = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (tid < n)
+    {
+        for (int index = item_nodes[items[tid]]; index != -1; index = parents[index])
+        {
+            const int w = node_wide[index];
+            if (w >= 0)
+                bvh_wide_encode(lowers, uppers, sources + w*(1+BVH_WIDE_WIDTH), nodes[w]);
+        }
+    }
+}
+
+void bvh_refit_partial_device(BVH& bvh, const int* items, int num_items, const bounds3* b)
+{
+    if (bvh.num_nodes == 0 || num_items <= 0)
+        return;
+
+    wp_launch_device(bvh_refit_partial_claim, num_items, (num_items, items, bvh.item_nodes, bvh.node_parents, bvh.node_counts));
+    wp_launch_device(bvh_refit_partial_kernel, num_items, (num_items, items, bvh.item_nodes, bvh.node_parents, bvh.node_counts, bvh.node_lowers, bvh.node_uppers, b));
+
+    if (bvh.wide_nodes)
+        wp_launch_device(bvh_refit_partial_wide_kernel, num_items, (num_items, items, bvh.item_nodes, bvh.node_parents, bvh.node_wide, bvh.node_lowers, bvh.node_uppers, bvh.wide_sources, bvh.wide_nodes));
+}
+
+// wide nodes only read refit binary nodes, so all of them can be requantized independently
+__global__ void bvh_refit_wide_kernel(int n, const BVHPackedNodeHalf* __restrict__ lowers, const BVHPackedNodeHalf* __restrict__ uppers, const int* __restrict__ sources, BVHWideNode* __restrict__ nodes)
+{
+    const int index = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (index < n)
+        bvh_wide_encode(lowers, uppers, sources + index*(1+BVH_WIDE_WIDTH), nodes[index]);
+}
+
+void bvh_refit_wide_device(BVH& bvh)
+{
+    wp_launch_device(bvh_refit_wide_kernel, bvh.num_wide_nodes, (bvh.num_wide_nodes, bvh.node_lowers, bvh.node_uppers, bvh.wide_sources, bvh.wide_nodes));
+}
+
+void bvh_destroy_wide_device(BVH& bvh)
+{
+    free_device(bvh.wide_nodes); bvh.wide_nodes = NULL;
+    free_device(bvh.wide_sources); bvh.wide_sources = NULL;
+    free_device(bvh.node_wide); bvh.node_wide = NULL;
+    bvh.num_wide_nodes = 0;
+}
+
+void bvh_create_wide_device(BVH& bvh)
+{
+    bvh_destroy_wide_device(bvh);
+
+    if (bvh.num_nodes == 0)
+        return;
+
+    // collapse is a serial top down pass, read back the binary nodes and run it on the host
+    BVH bvh_host;
+    memset(&bvh_host, 0, sizeof(BVH));
+
+    bvh_host.num_nodes = bvh.num_nodes;
+    bvh_host.max_nodes = bvh.num_nodes;
+    bvh_host.root = bvh.root;
+    bvh_host.node_lowers = new BVHPackedNodeHalf[bvh.num_nodes];
+    bvh_host.node_uppers = new BVHPackedNodeHalf[bvh.num_nodes];
+
+    memcpy_d2h(bvh_host.node_lowers, bvh.node_lowers, sizeof(BVHPackedNodeHalf)*bvh.num_nodes);
+    memcpy_d2h(bvh_host.node_uppers, bvh.node_uppers, sizeof(BVHPackedNodeHalf)*bvh.num_nodes);
+    check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+
+    bvh_create_wide_host(bvh_host);
+
+    // the tree is too deep for the wide traversal stack
+    if (!bvh_host.wide_nodes)
+    {
+        bvh_destroy_host(bvh_host);
+        return;
+    }
+
+    bvh.num_wide_nodes = bvh_host.num_wide_nodes;
+    bvh.wide_nodes = (BVHWideNode*)alloc_device(sizeof(BVHWideNode)*bvh.num_wide_nodes);
+    bvh.wide_sources = (int*)alloc_device(sizeof(int)*(1+BVH_WIDE_WIDTH)*bvh.num_wide_nodes);
+
+    memcpy_h2d(bvh.wide_nodes, bvh_host.wide_nodes, sizeof(BVHWideNode)*bvh.num_wide_nodes);
+    memcpy_h2d(bvh.wide_sources, bvh_host.wide_sources, sizeof(int)*(1+BVH_WIDE_WIDTH)*bvh.num_wide_nodes);
+
+    bvh.node_wide = (int*)alloc_device(sizeof(int)*bvh.max_nodes);
+    memcpy_h2d(bvh.node_wide, bvh_host.node_wide, sizeof(int)*bvh.num_nodes);
+
+    // uploads may read directly from the host arrays
+    check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+
+    bvh_destroy_host(bvh_host);
+}
+
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// Linear BVH builder (Karras 2012), the hierarchy is emitted directly from the sorted Morton 
+// codes so the build never leaves the device, internal nodes occupy [0, n-1), leaves [n-1, 2n-1)
+
+struct BoundsUnion
+{
+    __device__ inline bounds3 operator()(const bounds3& a, const bounds3& b) const { return bounds_union(a, b); }
+};
+
+__global__ void compute_morton_codes(const bounds3* __restrict__ item_bounds, const bounds3* __restrict__ total_bounds, int n, int* __restrict__ keys, int* __restrict__ indices)
+{
+    const int index = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (index < n)
+    {
+        bounds3 total = *total_bounds;
+
+        // ensure non-zero edge length in all dimensions
+        total.expand(0.001f);
+
+        vec3 edges = total.edges();
+        vec3 center = item_bounds[index].center();
+        vec3 local = cw_div(center-total.lower, edges);
+
+        keys[index] = morton3<1024>(local.x, local.y, local.z);
+        indices[index] = index;
+    }
+}
+
+// length of the common prefix between keys i and j, duplicate keys are
+// disambiguated by their index so every internal node has a unique split
+__device__ inline int key_delta(const int* __restrict__ keys, int n, int i, int j)
+{
+    if (j < 0 || j >= n)
+        return -1;
+
+    const int a = keys[i];
+    const int b = keys[j];
+
+    if (a == b)
+        return 32 + __clz(i^j);
+    else
+        return __clz(a^b);
+}
+
+__global__ void build_hierarchy(int n, const int* __restrict__ keys, const int* __restrict__ indices, int* __restrict__ parents, BVHPackedNodeHalf* __restrict__ lowers, BVHPackedNodeHalf* __restrict__ uppers)
+{
+    const int index = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (index >= n)
+        return;
+
+    const int leaf_offset = n-1;
+
+    // emit leaf, bounds are filled in by the refit
+    make_node(lowers+leaf_offset+index, vec3(), indices[index], true);
+    make_node(uppers+leaf_offset+index, vec3(), 0, false);
+
+    if (index == 0)
+        parents[0] = -1;
+
+    if (index >= n-1)
+        return;
+
+    // determine direction of the range covered by this internal node
+    const int d = (key_delta(keys, n, index, index+1) - key_delta(keys, n, index, index-1)) >= 0 ? 1 : -1;
+
+    // upper bound on the range length
+    const int delta_min = key_delta(keys, n, index, index-d);
+
+    int l_max = 2;
+    while (key_delta(keys, n, index, index + l_max*d) > delta_min)
+        l_max *= 2;
+
+    // binary search for the other end of the range
+    int l = 0;
+    for (int t=l_max/2; t >= 1; t /= 2)
+    {
+        if (key_delta(keys, n, index, index + (l+t)*d) > delta_min)
+            l += t;
+    }
+
+    const int j = index + l*d;
+    const int delta_node = key_delta(keys, n, index, j);
+
+    // binary search for the split position
+    int s = 0;
+    int t = l;
+    do
+    {
+        t = (t+1)/2;
+
+        if (key_delta(keys, n, index, index + (s+t)*d) > delta_node)
+            s += t;
+    }
+    while (t > 1);
+
+    const int split = index + s*d + min(d, 0);
+
+    const int first = min(index, j);
+    const int last = max(index, j);
+
+    const int left_child = (first == split) ? leaf_offset + split : split;
+    const int right_child = (last == split+1) ? leaf_offset + split + 1 : split + 1;
+
+    make_node(lowers+index, vec3(), left_child, false);
+    make_node(uppers+index, vec3(), right_child, false);
+
+    parents[left_child] = index;
+    parents[right_child] = index;
+}
+
+__global__ void compute_item_nodes(int n, const BVHPackedNodeHalf* __restrict__ lowers, int* __restrict__ item_nodes)
+{
+    const int index = blockDim.x*blockIdx.x + threadIdx.x;
+
+    if (index < n && lowers[index].b)
+        item_nodes[lowers[index].i] = index;
+}
+
+namespace
+{
+
+void bvh_alloc_device(BVH& bvh, int max_items)
+{
+    bvh.max_nodes = 2*max_items-1;
+
+    bvh.node_lowers = (BVHPackedNodeHalf*)alloc_device(sizeof(BVHPackedNodeHalf)*bvh.max_nodes);
+    bvh.node_uppers = (BVHPackedNodeHalf*)alloc_device(sizeof(BVHPackedNodeHalf)*bvh.max_nodes);
+    bvh.node_parents = (int*)alloc_device(sizeof(int)*bvh.max_nodes);
+    bvh.node_counts = (int*)alloc_device(sizeof(int)*bvh.max_nodes);
+    bvh.item_nodes = (int*)alloc_device(sizeof(int)*max_items);
+
+    memset_device(bvh.node_counts, 0, sizeof(int)*bvh.max_nodes);
+}
+
+void bvh_free_device(BVH& bvh)
+{
+    free_device(bvh.node_lowers); bvh.node_lowers = NULL;
+    free_device(bvh.node_uppers); bvh.node_uppers = NULL;
+    free_device(bvh.node_parents); bvh.node_parents = NULL;
+    free_device(bvh.node_counts); bvh.node_counts = NULL;
+    free_device(bvh.item_nodes); bvh.item_nodes = NULL;
+
+    bvh.max_nodes = 0;
+}
+
+// builds the linear hierarchy into already allocated node arrays
+void bvh_build_device(BVH& bvh, const bounds3* bounds, int n)
+{
+    bvh.num_nodes = 2*n-1;
+    bvh.num_items = n;
+    bvh.root = 0;
+
+    // not measured for the linear hierarchy, clear any depth left by a previous host build
+    bvh.max_depth = 0;
+
+    // radix sort requires double buffered keys and values
+    int* keys = (int*)alloc_device(sizeof(int)*n*2);
+    int* indices = (int*)alloc_device(sizeof(int)*n*2);
+    bounds3* total_bounds = (bounds3*)alloc_device(sizeof(bounds3));
+
+    // total bounds of all items, stays on device
+    size_t reduce_temp_size = 0;
+    cub::DeviceReduce::Reduce(NULL, reduce_temp_size, bounds, total_bounds, n, BoundsUnion(), bounds3(), (cudaStream_t)cuda_get_stream());
+
+    void* reduce_temp = alloc_device(reduce_temp_size);
+    cub::DeviceReduce::Reduce(reduce_temp, reduce_temp_size, bounds, total_bounds, n, BoundsUnion(), bounds3(), (cudaStream_t)cuda_get_stream());
+
+    wp_launch_device(compute_morton_codes, n, (bounds, total_bounds, n, keys, indices));
+
+    radix_sort_pairs_device(keys, indices, n);
+
+    wp_launch_device(build_hierarchy, n, (n, keys, indices, bvh.node_parents, bvh.node_lowers, bvh.node_uppers));
+    wp_launch_device(compute_item_nodes, bvh.num_nodes, (bvh.num_nodes, bvh.node_lowers, bvh.item_nodes));
+
+    // compute node bounds bottom-up
+    bvh_refit_device(bvh, bounds);
+
+    free_device(reduce_temp);
+    free_device(total_bounds);
+    free_device(indices);
+    free_device(keys);
+}
+
+struct NodeArea
+{
+    const BVHPackedNodeHalf* lowers;
+    const BVHPackedNodeHalf* uppers;
+
+    __device__ inline float operator()(int i) const
+    {
+        return bounds3(vec3(lowers[i].x, lowers[i].y, lowers[i].z), vec3(uppers[i].x, uppers[i].y, uppers[i].z)).area();
+    }
+};
+
+} // anonymous namespace
+
+BVH bvh_create_device(const bounds3* bounds, int num_bounds)
+{
+    BVH bvh;
+    memset(&bvh, 0, sizeof(BVH));
+
+    if (num_bounds == 0)
+        return bvh;
+
+    bvh_alloc_device(bvh, num_bounds);
+    bvh_build_device(bvh, bounds, num_bounds);
+
+    return bvh;
+}
+
+void bvh_rebuild_device(BVH& bvh, const bounds3* bounds, int num_bounds, int builder)
+{
+    const bool wide = bvh.wide_nodes != NULL;
+
+    bvh_destroy_wide_device(bvh);
+
+    if (num_bounds == 0)
+    {
+        bvh.num_nodes = 0;
+        bvh.num_items = 0;
+        return;
+    }
+
+    if (2*num_bounds-1 > bvh.max_nodes)
+    {
+        bvh_free_device(bvh);
+        bvh_alloc_device(bvh, num_bounds*3/2);
+    }
+
+    if (builder == BVH_BUILDER_LINEAR)
+    {
+        bvh_build_device(bvh, bounds, num_bounds);
+    }
+    else
+    {
+        // same host round-trip as mesh_create_device()
+        std::vector<bounds3> bounds_host(num_bounds);
+        memcpy_d2h(bounds_host.data(), bounds, sizeof(bounds3)*num_bounds);
+        check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+
+        BVH bvh_host = bvh_create(bounds_host.data(), num_bounds, builder);
+
+        memcpy_h2d(bvh.node_lowers, bvh_host.node_lowers, sizeof(BVHPackedNodeHalf)*bvh_host.num_nodes);
+        memcpy_h2d(bvh.node_uppers, bvh_host.node_uppers, sizeof(BVHPackedNodeHalf)*bvh_host.num_nodes);
+        memcpy_h2d(bvh.node_parents, bvh_host.node_parents, sizeof(int)*bvh_host.num_nodes);
+        memcpy_h2d(bvh.item_nodes, bvh_host.item_nodes, sizeof(int)*num_bounds);
+
+        bvh.num_nodes = bvh_host.num_nodes;
+        bvh.num_items = num_bounds;
+        bvh.max_depth = bvh_host.max_depth;
+        bvh.root = bvh_host.root;
+
+        // uploads may read directly from the host arrays
+        check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+        bvh_destroy_host(bvh_host);
+    }
+
+    if (wide)
+        bvh_create_wide_device(bvh);
+}
+
+// divides the sum of node areas by the area of the root
+__global__ void bvh_sah_cost_kernel(const float* total, const BVHPackedNodeHalf* lowers, const BVHPackedNodeHalf* uppers, int root, float* cost)
+{
+    const float root_area = bounds3(vec3(lowers[root].x, lowers[root].y, lowers[root].z), vec3(uppers[root].x, uppers[root].y, uppers[root].z)).area();
+
+    *cost = root_area > 0.0f ? *total/root_area : 0.0f;
+}
+
+void bvh_sah_cost_device_async(const BVH& bvh, float* temp, float* cost)
+{
+    if (bvh.num_nodes == 0)
+    {
+        memset_device(temp, 0, sizeof(float));
+        memcpy_d2h(cost, temp, sizeof(float));
+        return;
+    }
+
+    cudaStream_t stream = (cudaStream_t)cuda_get_stream();
+
+    NodeArea op = { bvh.node_lowers, bvh.node_uppers };
+    cub::TransformInputIterator<float, NodeArea, cub::CountingInputIterator<int> > iter(cub::CountingInputIterator<int>(0), op);
+
+    size_t temp_size = 0;
+    check_cuda(cub::DeviceReduce::Sum(NULL, temp_size, iter, temp, bvh.num_nodes, stream));
+
+    void* reduce_temp = alloc_device(temp_size);
+    check_cuda(cub::DeviceReduce::Sum(reduce_temp, temp_size, iter, temp, bvh.num_nodes, stream));
+    free_device(reduce_temp);
+
+    // the reduction total is replaced by the cost in-place
+    bvh_sah_cost_kernel<<<1, 1, 0, stream>>>(temp, bvh.node_lowers, bvh.node_uppers, bvh.root, temp);
+
+    memcpy_d2h(cost, temp, sizeof(float));
+}
+
+float bvh_sah_cost_device(const BVH& bvh)
+{
+    float* temp = (float*)alloc_device(sizeof(float));
+    float cost = 0.0f;
+
+    bvh_sah_cost_device_async(bvh, temp, &cost);
+    check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+
+    free_device(temp);
+
+    return cost;
 }
 
 } // namespace wp
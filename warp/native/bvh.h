@@ -103,6 +103,10 @@ CUDA_CALLABLE inline bounds3 bounds_intersection(const bounds3& a, const bounds3
 }
 
 
+// size of the traversal stack used by BVH queries, depth first traversal of a binary
+// tree needs at most one entry per level plus one
+#define BVH_QUERY_STACK_SIZE 64
+
 struct BVHPackedNodeHalf
 {
 	float x;
@@ -112,23 +116,93 @@ struct BVHPackedNodeHalf
 	unsigned int b : 1;
 };
 
+// 4-wide nodes collapsed from the binary hierarchy, child bounds are quantized to 8 bits per axis
+// relative to the node bounds and rounded outwards, so one 64 byte load fetches all children
+#define BVH_WIDE_WIDTH 4
+
+// entries of BVHWideNode::children, anything else is the index of an inner wide node
+#define BVH_WIDE_LEAF 0x80000000u
+#define BVH_WIDE_EMPTY 0xffffffffu
+
+// wide traversal pushes up to BVH_WIDE_WIDTH-1 extra entries per level, collapsing roughly halves the depth,
+// trees that could overflow the stack are not collapsed, see bvh_create_wide_host()
+#define BVH_WIDE_QUERY_STACK_SIZE (BVH_QUERY_STACK_SIZE*3/2)
+
+// claim flag stored in node_counts by the device partial refit, the low bits count dirty children
+#define BVH_REFIT_CLAIMED 0x10000
+
+struct BVHWideNode
+{
+	vec3 origin;
+	vec3 scale;
+
+	// quantized child bounds, [axis][child]
+	uint8_t lower[3][BVH_WIDE_WIDTH];
+	uint8_t upper[3][BVH_WIDE_WIDTH];
+
+	// children are packed at the front, empty slots are at the end
+	uint32_t children[BVH_WIDE_WIDTH];
+};
+
 struct BVH
 {
     BVHPackedNodeHalf* node_lowers;
     BVHPackedNodeHalf* node_uppers;
 
-	// used for fast refits
+	// used for fast refits, counters are zero between refits
 	int* node_parents;
 	int* node_counts;
+
+	// leaf node of each item, used for partial refits
+	int* item_nodes;
+	int num_items;
+
+	// optional wide layout used for queries, NULL if not created, root is always node 0
+	BVHWideNode* wide_nodes;
+
+	// binary node of each wide node followed by the binary nodes of its children (-1 if empty),
+	// the binary nodes are still refit and wide bounds are then requantized from them
+	int* wide_sources;
+	int num_wide_nodes;
+
+	// wide node that holds each binary node as a child (-1 if none), used for partial refits
+	int* node_wide;
 	
+	// depth of the deepest leaf, only computed by the host builders, a linear (Morton) tree
+	// built on the device leaves it at 0 since measuring it would require a readback
 	int max_depth;
-	int max_nodes;
+	int max_nodes;		// allocated, may exceed num_nodes after a device rebuild
     int num_nodes;
 
 	int root;
 };
 
-BVH bvh_create(const bounds3* bounds, int num_bounds);
+// construction methods in order of decreasing tree quality, must match warp/types.py
+enum BVHBuilder
+{
+    BVH_BUILDER_SAH = 0,        // binned surface area heuristic
+    BVH_BUILDER_MEDIAN = 1,     // object median along the longest axis
+    BVH_BUILDER_LINEAR = 2      // Morton codes, fastest to build
+};
+
+BVH bvh_create(const bounds3* bounds, int num_bounds, int builder=BVH_BUILDER_SAH);
+
+// build a linear BVH from device-side bounds without host synchronization
+BVH bvh_create_device(const bounds3* bounds, int num_bounds);
+
+// rebuild for a new set of items, keeps the wide layout if present, the device version only
+// reallocates node arrays (with 1.5x headroom) when they are too small for the new item count
+void bvh_rebuild_host(BVH& bvh, const bounds3* bounds, int num_bounds, int builder=BVH_BUILDER_SAH);
+void bvh_rebuild_device(BVH& bvh, const bounds3* bounds, int num_bounds, int builder=BVH_BUILDER_LINEAR);
+
+// surface area heuristic cost (sum of node areas over root area), refits that move
+// primitives far from where they were built increase it, the device version synchronizes
+float bvh_sah_cost_host(const BVH& bvh);
+float bvh_sah_cost_device(const BVH& bvh);
+
+// enqueues the cost computation on the current stream and copies it to cost (e.g.: pinned
+// host memory) without synchronizing, temp is device memory for a single float
+void bvh_sah_cost_device_async(const BVH& bvh, float* temp, float* cost);
 
 void bvh_destroy_host(BVH& bvh);
 void bvh_destroy_device(BVH& bvh);
@@ -136,9 +210,27 @@ void bvh_destroy_device(BVH& bvh);
 void bvh_refit_host(BVH& bvh, const bounds3* bounds);
 void bvh_refit_device(BVH& bvh, const bounds3* bounds);
 
+// refit only the ancestors of the given items, bounds of all other items must be unchanged since the last refit,
+// items live on the same device as the BVH and may contain duplicates
+void bvh_refit_partial_host(BVH& bvh, const int* items, int num_items, const bounds3* bounds);
+void bvh_refit_partial_device(BVH& bvh, const int* items, int num_items, const bounds3* bounds);
+
 // copy host BVH to device
 BVH bvh_clone(const BVH& bvh_host);
 
+// collapse the binary hierarchy into the wide layout, the device version
+// reads back the topology and uploads the wide nodes once
+void bvh_create_wide_host(BVH& bvh);
+void bvh_create_wide_device(BVH& bvh);
+
+// free the wide layout, queries and refits then use the binary nodes only
+void bvh_destroy_wide_host(BVH& bvh);
+void bvh_destroy_wide_device(BVH& bvh);
+
+// requantize the wide nodes from refit binary nodes, called by bvh_refit_host/device()
+void bvh_refit_wide_host(BVH& bvh);
+void bvh_refit_wide_device(BVH& bvh);
+
 
 
 CUDA_CALLABLE inline BVHPackedNodeHalf make_node(const vec3& bound, int child, bool leaf)
@@ -163,6 +255,54 @@ CUDA_CALLABLE inline void make_node(volatile BVHPackedNodeHalf* n, const vec3& b
     n->b = (unsigned int)(leaf?1:0);
 }
 
+// quantizes bounds of the children listed in sources[1..BVH_WIDE_WIDTH] relative to those of sources[0]
+CUDA_CALLABLE inline void bvh_wide_encode(const BVHPackedNodeHalf* lowers, const BVHPackedNodeHalf* uppers, const int* sources, BVHWideNode& node)
+{
+	const vec3 lower = vec3(lowers[sources[0]].x, lowers[sources[0]].y, lowers[sources[0]].z);
+	const vec3 upper = vec3(uppers[sources[0]].x, uppers[sources[0]].y, uppers[sources[0]].z);
+
+	// padding covers rounding in the decode (which may be fused on the device) so children never shrink
+	vec3 pad;
+	for (int a=0; a < 3; ++a)
+		pad[a] = (fabsf(lower[a]) + fabsf(upper[a]))*1.e-6f + 1.e-30f;
+
+	node.origin = lower - pad;
+	node.scale = (upper - lower + 2.0f*pad)*(1.0f/255.0f);
+
+	for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+	{
+		const int child = sources[1+c];
+
+		for (int a=0; a < 3; ++a)
+		{
+			if (child < 0)
+			{
+				// inverted so the slot never overlaps anything
+				node.lower[a][c] = 255;
+				node.upper[a][c] = 0;
+				continue;
+			}
+
+			const float child_lower = (&lowers[child].x)[a];
+			const float child_upper = (&uppers[child].x)[a];
+
+			const float inv_scale = 1.0f/node.scale[a];
+
+			const float ql = floorf((child_lower - pad[a] - node.origin[a])*inv_scale);
+			const float qu = ceilf((child_upper + pad[a] - node.origin[a])*inv_scale);
+
+			node.lower[a][c] = uint8_t(clamp(ql, 0.0f, 255.0f));
+			node.upper[a][c] = uint8_t(clamp(qu, 0.0f, 255.0f));
+		}
+	}
+}
+
+CUDA_CALLABLE inline void bvh_wide_decode(const BVHWideNode& node, int c, vec3& lower, vec3& upper)
+{
+	lower = node.origin + cw_mul(vec3(float(node.lower[0][c]), float(node.lower[1][c]), float(node.lower[2][c])), node.scale);
+	upper = node.origin + cw_mul(vec3(float(node.upper[0][c]), float(node.upper[1][c]), float(node.upper[2][c])), node.scale);
+}
+
 CUDA_CALLABLE inline int clz(int x)
 {
     int n;
@@ -9,16 +9,15 @@
 #include "warp.h"
 #include "hashgrid.h"
 #include "sort.h"
+#include "registry.h"
 #include "string.h"
 
 using namespace wp;
 
-#include <map>
-
 namespace 
 {
-    // host-side copy of mesh descriptors, maps GPU mesh address (id) to a CPU desc
-    std::map<uint64_t, HashGrid> g_hash_grid_descriptors;
+    // host-side copy of hash grid descriptors, maps GPU grid address (id) to a CPU desc
+    DescriptorRegistry<HashGrid> g_hash_grid_descriptors;
 
 } // anonymous namespace
 
@@ -26,35 +25,58 @@ namespace
 namespace wp
 {
 
-bool hash_grid_get_descriptor(uint64_t id, HashGrid& grid)
+Descriptor<HashGrid>* hash_grid_get_descriptor(uint64_t id)
 {
-    const auto& iter = g_hash_grid_descriptors.find(id);
-    if (iter == g_hash_grid_descriptors.end())
-        return false;
-    else
-        grid = iter->second;
-        return true;
+    return g_hash_grid_descriptors.find(id);
 }
 
-void hash_grid_add_descriptor(uint64_t id, const HashGrid& grid)
+Descriptor<HashGrid>* hash_grid_add_descriptor(uint64_t id, const HashGrid& grid)
 {
-    g_hash_grid_descriptors[id] = grid;
+    return g_hash_grid_descriptors.insert(id, grid);
 }
 
 void hash_grid_rem_descriptor(uint64_t id)
 {
     g_hash_grid_descriptors.erase(id);
-
 }
 
 // implemented in hashgrid.cu
 void hash_grid_rebuild_device(const HashGrid& grid, const wp::vec3* points, int num_points);
+void hash_grid_permute_device(const HashGrid& grid, void* dest, const void* src, int element_size, bool inverse);
+
+// sparse tables are kept at most half full
+int hash_grid_table_size(int max_points)
+{
+    int size = 1;
+    while (size < 2*max_points)
+        size *= 2;
+
+    return size;
+}
 
 } // namespace wp
 
 
+namespace
+{
+
+// returns the slot for key, inserting it if the cell has not been seen before
+int hash_grid_insert_host(HashGrid& grid, uint64_t key)
+{
+    int slot = hash_grid_slot(grid, key);
+
+    while (grid.cell_keys[slot] != HASH_GRID_EMPTY && grid.cell_keys[slot] != key)
+        slot = (slot + 1) & (grid.table_size-1);
+
+    grid.cell_keys[slot] = key;
+    return slot;
+}
+
+} // anonymous namespace
+
+
 // host methods
-uint64_t hash_grid_create_host(int dim_x, int dim_y, int dim_z)
+uint64_t hash_grid_create_host(int dim_x, int dim_y, int dim_z, bool sparse)
 {
     HashGrid* grid = new HashGrid();
     memset(grid, 0, sizeof(HashGrid));
@@ -62,10 +84,15 @@ uint64_t hash_grid_create_host(int dim_x, int dim_y, int dim_z)
     grid->dim_x = dim_x;
     grid->dim_y = dim_y;
     grid->dim_z = dim_z;
+    grid->sparse = sparse;
 
-    const int num_cells = dim_x*dim_y*dim_z;   
-    grid->cell_starts = (int*)alloc_host(num_cells*sizeof(int));
-    grid->cell_ends = (int*)alloc_host(num_cells*sizeof(int));
+    // sparse cell arrays are sized by the number of points in reserve()
+    if (!sparse)
+    {
+        const int num_cells = dim_x*dim_y*dim_z;   
+        grid->cell_starts = (int*)alloc_host(num_cells*sizeof(int));
+        grid->cell_ends = (int*)alloc_host(num_cells*sizeof(int));
+    }
 
     return (uint64_t)(grid);
 }
@@ -77,6 +104,8 @@ void hash_grid_destroy_host(uint64_t id)
     free_host(grid->point_ids);
     free_host(grid->point_cells);
     free_host(grid->cell_starts);
+    free_host(grid->cell_ends);
+    free_host(grid->cell_keys);
 
     delete grid;
 }
@@ -95,6 +124,18 @@ void hash_grid_reserve_host(uint64_t id, int num_points)
         grid->point_ids = (int*)alloc_host(2*num_to_alloc*sizeof(int));    // *2 for auxilliary radix buffers
 
         grid->max_points = num_to_alloc;
+
+        if (grid->sparse)
+        {
+            free_host(grid->cell_starts);
+            free_host(grid->cell_ends);
+            free_host(grid->cell_keys);
+
+            grid->table_size = hash_grid_table_size(num_to_alloc);
+            grid->cell_starts = (int*)alloc_host(grid->table_size*sizeof(int));
+            grid->cell_ends = (int*)alloc_host(grid->table_size*sizeof(int));
+            grid->cell_keys = (uint64_t*)alloc_host(grid->table_size*sizeof(uint64_t));
+        }
     }
 
     grid->num_points = num_points;
@@ -108,18 +149,37 @@ void hash_grid_update_host(uint64_t id, float cell_width, const wp::vec3* points
 
     grid->cell_width = cell_width;
     grid->cell_width_inv = 1.0f / cell_width;
+    grid->ordered = false;
+
+    int num_cells;
 
     // calculate cell for each position
-    for (int i=0; i < num_points; ++i)
+    if (grid->sparse)
     {
-        grid->point_cells[i] = hash_grid_index(*grid, points[i]);
-        grid->point_ids[i] = i;
+        memset(grid->cell_keys, 0xff, sizeof(uint64_t) * grid->table_size);
+
+        for (int i=0; i < num_points; ++i)
+        {
+            grid->point_cells[i] = hash_grid_insert_host(*grid, hash_grid_key(*grid, points[i]));
+            grid->point_ids[i] = i;
+        }
+
+        num_cells = grid->table_size;
+    }
+    else
+    {
+        for (int i=0; i < num_points; ++i)
+        {
+            grid->point_cells[i] = hash_grid_index(*grid, points[i]);
+            grid->point_ids[i] = i;
+        }
+
+        num_cells = grid->dim_x * grid->dim_y * grid->dim_z;
     }
     
     // sort indices
     radix_sort_pairs_host(grid->point_cells, grid->point_ids, num_points);
 
-    const int num_cells = grid->dim_x * grid->dim_y * grid->dim_z;
     memset(grid->cell_starts, 0, sizeof(int) * num_cells);
     memset(grid->cell_ends, 0, sizeof(int) * num_cells);
 
@@ -149,8 +209,33 @@ void hash_grid_update_host(uint64_t id, float cell_width, const wp::vec3* points
 	}
 }
 
+void hash_grid_permute_host(uint64_t id, void* dest, const void* src, int element_size, bool inverse)
+{
+    const HashGrid* grid = (const HashGrid*)(id);
+
+    char* d = (char*)dest;
+    const char* s = (const char*)src;
+
+    // gather into cell order, or scatter back to the order points were given in
+    cpu_launch(grid->num_points, [&](int i)
+    {
+        const int j = grid->point_ids[i];
+
+        if (inverse)
+            memcpy(d + size_t(j)*element_size, s + size_t(i)*element_size, element_size);
+        else
+            memcpy(d + size_t(i)*element_size, s + size_t(j)*element_size, element_size);
+    });
+}
+
+void hash_grid_set_ordered_host(uint64_t id, bool ordered)
+{
+    HashGrid* grid = (HashGrid*)(id);
+    grid->ordered = ordered;
+}
+
 // device methods
-uint64_t hash_grid_create_device(int dim_x, int dim_y, int dim_z)
+uint64_t hash_grid_create_device(int dim_x, int dim_y, int dim_z, bool sparse)
 {
     HashGrid grid;
     memset(&grid, 0, sizeof(HashGrid));
@@ -158,29 +243,37 @@ uint64_t hash_grid_create_device(int dim_x, int dim_y, int dim_z)
     grid.dim_x = dim_x;
     grid.dim_y = dim_y;
     grid.dim_z = dim_z;
+    grid.sparse = sparse;
 
-    const int num_cells = dim_x*dim_y*dim_z;   
-    grid.cell_starts = (int*)alloc_device(num_cells*sizeof(int));
-    grid.cell_ends = (int*)alloc_device(num_cells*sizeof(int));
+    // sparse cell arrays are sized by the number of points in reserve()
+    if (!sparse)
+    {
+        const int num_cells = dim_x*dim_y*dim_z;   
+        grid.cell_starts = (int*)alloc_device(num_cells*sizeof(int));
+        grid.cell_ends = (int*)alloc_device(num_cells*sizeof(int));
+    }
 
     // upload to device
     HashGrid* grid_device = (HashGrid*)(alloc_device(sizeof(HashGrid)));
-    memcpy_h2d(grid_device, &grid, sizeof(HashGrid));
 
     uint64_t grid_id = (uint64_t)(grid_device);
-    hash_grid_add_descriptor(grid_id, grid);
+    descriptor_upload(grid_id, *hash_grid_add_descriptor(grid_id, grid));
 
     return grid_id;
 }
 
 void hash_grid_destroy_device(uint64_t id)
 {
-    HashGrid grid;
-    if (hash_grid_get_descriptor(id, grid))
+    Descriptor<HashGrid>* d = hash_grid_get_descriptor(id);
+    if (d)
     {
+        const HashGrid& grid = d->host;
+
         free_device(grid.point_ids);
         free_device(grid.point_cells);
         free_device(grid.cell_starts);
+        free_device(grid.cell_ends);
+        free_device(grid.cell_keys);
 
         free_device((HashGrid*)id);
         
@@ -188,66 +281,96 @@ void hash_grid_destroy_device(uint64_t id)
     }
 }
 
+namespace
+{
 
-void hash_grid_reserve_device(uint64_t id, int num_points)
+// grows the point and cell arrays of the host descriptor, returns true if they were reallocated
+bool hash_grid_reserve_descriptor(HashGrid& grid, int num_points)
 {
-    HashGrid grid;
+    if (num_points <= grid.max_points)
+        return false;
+
+    free_device(grid.point_cells);
+    free_device(grid.point_ids);
+    
+    const int num_to_alloc = num_points*3/2;
+    grid.point_cells = (int*)alloc_device(2*num_to_alloc*sizeof(int));  // *2 for auxilliary radix buffers
+    grid.point_ids = (int*)alloc_device(2*num_to_alloc*sizeof(int));    // *2 for auxilliary radix buffers
+    grid.max_points = num_to_alloc;
 
-    if (hash_grid_get_descriptor(id, grid))
+    if (grid.sparse)
     {
-        if (num_points > grid.max_points)
-        {
-            free_device(grid.point_cells);
-            free_device(grid.point_ids);
-            
-            const int num_to_alloc = num_points*3/2;
-            grid.point_cells = (int*)alloc_device(2*num_to_alloc*sizeof(int));  // *2 for auxilliary radix buffers
-            grid.point_ids = (int*)alloc_device(2*num_to_alloc*sizeof(int));    // *2 for auxilliary radix buffers
-            grid.max_points = num_to_alloc;
-
-            // ensure we pre-size our sort routine to avoid
-            // allocations during graph capture
-            radix_sort_reserve(num_to_alloc);
-
-            // update device side grid descriptor, todo: this is
-            // slightly redundant since it is performed again
-            // inside hash_grid_update_device(), but since
-            // reserve can be called from Python we need to make 
-            // sure it is consistent
-            memcpy_h2d((HashGrid*)id, &grid, sizeof(HashGrid));
-
-            // update host side grid descriptor
-            hash_grid_add_descriptor(id, grid);
-        }
+        free_device(grid.cell_starts);
+        free_device(grid.cell_ends);
+        free_device(grid.cell_keys);
+
+        grid.table_size = hash_grid_table_size(num_to_alloc);
+        grid.cell_starts = (int*)alloc_device(grid.table_size*sizeof(int));
+        grid.cell_ends = (int*)alloc_device(grid.table_size*sizeof(int));
+        grid.cell_keys = (uint64_t*)alloc_device(grid.table_size*sizeof(uint64_t));
     }
+
+    // ensure we pre-size our sort routine to avoid
+    // allocations during graph capture
+    radix_sort_reserve(num_to_alloc);
+
+    return true;
 }
 
-void hash_grid_update_device(uint64_t id, float cell_width, const wp::vec3* points, int num_points)
+} // anonymous namespace
+
+void hash_grid_reserve_device(uint64_t id, int num_points)
 {
-    
-    // ensure we have enough memory reserved for update
-    // this must be done before retrieving the descriptor
-    // below since it may update it
-    hash_grid_reserve_device(id, num_points);
+    Descriptor<HashGrid>* d = hash_grid_get_descriptor(id);
+
+    // reserve can be called from Python so the device side
+    // descriptor is updated here as well as in hash_grid_update_device()
+    if (d && hash_grid_reserve_descriptor(d->host, num_points))
+        descriptor_upload(id, *d);
+}
 
-    // host grid must be static so that we can
-    // perform host->device memcpy from this variable
-    // and have it safely recorded inside CUDA graphs
-    static HashGrid grid;
+void hash_grid_update_device(uint64_t id, float cell_width, const wp::vec3* points, int num_points)
+{
+    Descriptor<HashGrid>* d = hash_grid_get_descriptor(id);
 
-    if (hash_grid_get_descriptor(id, grid))
+    if (d)
     {
+        HashGrid& grid = d->host;
+
+        // ensure we have enough memory reserved for update, the
+        // descriptor is uploaded once below
+        hash_grid_reserve_descriptor(grid, num_points);
+
         grid.num_points = num_points;
         grid.cell_width = cell_width;
         grid.cell_width_inv = 1.0f / cell_width;
+        grid.ordered = false;
 
         hash_grid_rebuild_device(grid, points, num_points);
 
-        // update device side grid descriptor
-        memcpy_h2d((HashGrid*)id, &grid, sizeof(HashGrid));
+        // the upload reads the grid's pinned staging copy, which
+        // stays valid for replays of captured graphs
+        descriptor_upload(id, *d);
+    }
+}
+
+void hash_grid_permute_device(uint64_t id, void* dest, const void* src, int element_size, bool inverse)
+{
+    Descriptor<HashGrid>* d = hash_grid_get_descriptor(id);
 
-        // update host side grid descriptor
-        hash_grid_add_descriptor(id, grid);
+    if (d)
+        wp::hash_grid_permute_device(d->host, dest, src, element_size, inverse);
+}
+
+void hash_grid_set_ordered_device(uint64_t id, bool ordered)
+{
+    Descriptor<HashGrid>* d = hash_grid_get_descriptor(id);
+
+    if (d)
+    {
+        d->host.ordered = ordered;
+
+        descriptor_upload(id, *d);
     }
 }
 
@@ -261,6 +384,11 @@ void hash_grid_rebuild_device(const HashGrid& grid, const wp::vec3* points, int
 
 }
 
+void hash_grid_permute_device(const HashGrid& grid, void* dest, const void* src, int element_size, bool inverse)
+{
+
+}
+
 } // namespace wp
 
 #endif // __APPLE__
\ No newline at end of file
@@ -24,6 +24,32 @@ __global__ void compute_cell_indices(HashGrid grid, const wp::vec3* points, int
     }
 }
 
+// inserts each point's cell into the open addressing table, the slot becomes the point's cell id
+__global__ void compute_sparse_cell_indices(HashGrid grid, const wp::vec3* points, int num_points)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < num_points)
+    {
+        const uint64_t key = hash_grid_key(grid, points[tid]);
+
+        int slot = hash_grid_slot(grid, key);
+
+        while (true)
+        {
+            const uint64_t prev = atomicCAS((unsigned long long*)&grid.cell_keys[slot], (unsigned long long)HASH_GRID_EMPTY, (unsigned long long)key);
+
+            if (prev == HASH_GRID_EMPTY || prev == key)
+                break;
+
+            slot = (slot + 1) & (grid.table_size-1);
+        }
+
+        grid.point_cells[tid] = slot;
+        grid.point_ids[tid] = tid;
+    }
+}
+
 __global__ void compute_cell_offsets(int* cell_starts, int* cell_ends, const int* point_cells, int num_points)
 {
     const int tid = blockIdx.x*blockDim.x + threadIdx.x;
@@ -54,13 +80,59 @@ __global__ void compute_cell_offsets(int* cell_starts, int* cell_ends, const int
 	}    
 }
 
+// one thread per word so that both sides of the permutation are accessed in contiguous runs
+template <typename T>
+__global__ void permute_elements(const int* point_ids, T* dest, const T* src, int words_per_element, int num_words, bool inverse)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < num_words)
+    {
+        const int i = tid/words_per_element;
+        const int w = tid - i*words_per_element;
+        const int j = point_ids[i];
+
+        if (inverse)
+            dest[j*words_per_element + w] = src[i*words_per_element + w];
+        else
+            dest[i*words_per_element + w] = src[j*words_per_element + w];
+    }
+}
+
+void hash_grid_permute_device(const wp::HashGrid& grid, void* dest, const void* src, int element_size, bool inverse)
+{
+    if (element_size%4 == 0)
+    {
+        const int words = element_size/4;
+        wp_launch_device(wp::permute_elements<uint32_t>, grid.num_points*words, (grid.point_ids, (uint32_t*)dest, (const uint32_t*)src, words, grid.num_points*words, inverse));
+    }
+    else
+    {
+        wp_launch_device(wp::permute_elements<uint8_t>, grid.num_points*element_size, (grid.point_ids, (uint8_t*)dest, (const uint8_t*)src, element_size, grid.num_points*element_size, inverse));
+    }
+}
+
 void hash_grid_rebuild_device(const wp::HashGrid& grid, const wp::vec3* points, int num_points)
 {
-    wp_launch_device(wp::compute_cell_indices, num_points, (grid, points, num_points));
+    int num_cells;
+
+    if (grid.sparse)
+    {
+        // rebuild cost is proportional to the number of points rather than the grid volume
+        memset_device(grid.cell_keys, -1, sizeof(uint64_t) * grid.table_size);
+
+        wp_launch_device(wp::compute_sparse_cell_indices, num_points, (grid, points, num_points));
+
+        num_cells = grid.table_size;
+    }
+    else
+    {
+        wp_launch_device(wp::compute_cell_indices, num_points, (grid, points, num_points));
+
+        num_cells = grid.dim_x * grid.dim_y * grid.dim_z;
+    }
     
     radix_sort_pairs_device(grid.point_cells, grid.point_ids, num_points);
-
-    const int num_cells = grid.dim_x * grid.dim_y * grid.dim_z;
     
     memset_device(grid.cell_starts, 0, sizeof(int) * num_cells);    
     memset_device(grid.cell_ends, 0, sizeof(int) * num_cells);
@@ -19,8 +19,8 @@ struct HashGrid
     int* point_cells;   // cell id of a point
     int* point_ids;     // index to original point
     
-    int* cell_starts;   // start index of a range of indices belonging to a cell, dim_x*dim_y*dim_z in length
-    int* cell_ends;     // end index of a range of indices belonging to a cell, dim_x*dim_y*dim_z in length
+    int* cell_starts;   // start index of a range of indices belonging to a cell, dim_x*dim_y*dim_z (or table_size if sparse) in length
+    int* cell_ends;     // end index of a range of indices belonging to a cell, dim_x*dim_y*dim_z (or table_size if sparse) in length
 
     int dim_x;
     int dim_y;
@@ -28,8 +28,19 @@ struct HashGrid
 
     int num_points;
     int max_points;
+
+    // sparse grids store only occupied cells in an open addressing hash table, a cell's
+    // id is its slot in the table, so no memory (or rebuild cost) is proportional to the grid volume
+    int sparse;
+    int table_size;         // power of two, at least twice max_points
+    uint64_t* cell_keys;    // key of the cell stored in each slot, or HASH_GRID_EMPTY
+
+    // set once point attributes have been permuted into cell order, queries then return sorted indices directly
+    int ordered;
 };
 
+#define HASH_GRID_EMPTY 0xffffffffffffffffull
+
 // convert a virtual (world) cell coordinate to a physical one
 CUDA_CALLABLE inline int hash_grid_index(const HashGrid& grid, int x, int y, int z)
 {
@@ -65,6 +76,88 @@ CUDA_CALLABLE inline int hash_grid_index(const HashGrid& grid, const vec3& p)
                            int(p.z*grid.cell_width_inv));
 }
 
+// sparse grids pack each virtual cell coordinate into 21 bits of the key, cells outside
+// of [HASH_GRID_COORD_MIN, HASH_GRID_COORD_MAX] are clamped to the boundary cell
+#define HASH_GRID_COORD_MIN (-(1<<20))
+#define HASH_GRID_COORD_MAX ((1<<20)-1)
+
+CUDA_CALLABLE inline int hash_grid_clamp(int x)
+{
+    return min(max(x, HASH_GRID_COORD_MIN), HASH_GRID_COORD_MAX);
+}
+
+// virtual cell coordinate of a sparse grid, clamped before conversion so large positions do not overflow
+CUDA_CALLABLE inline int hash_grid_coord(float x)
+{
+    return int(min(max(x, float(HASH_GRID_COORD_MIN)), float(HASH_GRID_COORD_MAX)));
+}
+
+// unique key of a virtual cell for sparse grids, the 63 bits used by the coordinates leave
+// the top bit clear so a key never equals HASH_GRID_EMPTY
+CUDA_CALLABLE inline uint64_t hash_grid_key(int x, int y, int z)
+{
+    const int origin = 1<<20;
+
+    x = hash_grid_clamp(x) + origin;
+    y = hash_grid_clamp(y) + origin;
+    z = hash_grid_clamp(z) + origin;
+
+    return (uint64_t(x) << 42) | (uint64_t(y) << 21) | uint64_t(z);
+}
+
+CUDA_CALLABLE inline uint64_t hash_grid_key(const HashGrid& grid, const vec3& p)
+{
+    return hash_grid_key(hash_grid_coord(p.x*grid.cell_width_inv), 
+                         hash_grid_coord(p.y*grid.cell_width_inv),
+                         hash_grid_coord(p.z*grid.cell_width_inv));
+}
+
+// first slot to probe for a key, uses the MurmurHash3 finalizer to spread neighboring cells
+CUDA_CALLABLE inline int hash_grid_slot(const HashGrid& grid, uint64_t key)
+{
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+
+    return int(key & uint64_t(grid.table_size-1));
+}
+
+// returns the slot containing key, or -1 if the cell is empty
+CUDA_CALLABLE inline int hash_grid_find(const HashGrid& grid, uint64_t key)
+{
+    if (grid.table_size == 0)
+        return -1;
+
+    int slot = hash_grid_slot(grid, key);
+
+    // table is at most half full so probe sequences are short and always reach an empty slot
+    for (int i=0; i < grid.table_size; ++i)
+    {
+        const uint64_t k = grid.cell_keys[slot];
+
+        if (k == key)
+            return slot;
+        
+        if (k == HASH_GRID_EMPTY)
+            return -1;
+
+        slot = (slot + 1) & (grid.table_size-1);
+    }
+
+    return -1;
+}
+
+// returns the id of a virtual cell, or -1 if a sparse grid has no points in it
+CUDA_CALLABLE inline int hash_grid_cell(const HashGrid& grid, int x, int y, int z)
+{
+    if (grid.sparse)
+        return hash_grid_find(grid, hash_grid_key(x, y, z));
+    else
+        return hash_grid_index(grid, x, y, z);
+}
+
 // stores state required to traverse neighboring cells of a point
 struct hash_grid_query_t
 {
@@ -97,22 +190,40 @@ CUDA_CALLABLE inline hash_grid_query_t hash_grid_query(uint64_t id, wp::vec3 pos
     query.grid = *(const HashGrid*)(id);
 
     // convert coordinate to grid
-    query.x_start = int((pos.x-radius)*query.grid.cell_width_inv);
-    query.y_start = int((pos.y-radius)*query.grid.cell_width_inv);
-    query.z_start = int((pos.z-radius)*query.grid.cell_width_inv);
-
-    // do not want to visit any cells more than once, so limit large radius offset to one pass over each dimension
-    query.x_end = min(int((pos.x+radius)*query.grid.cell_width_inv), query.x_start + query.grid.dim_x-1);
-    query.y_end = min(int((pos.y+radius)*query.grid.cell_width_inv), query.y_start + query.grid.dim_y-1);
-    query.z_end = min(int((pos.z+radius)*query.grid.cell_width_inv), query.z_start + query.grid.dim_z-1);
+    if (query.grid.sparse)
+    {
+        // clamped like the keys of the cells so that the boundary cell is visited once
+        query.x_start = hash_grid_coord((pos.x-radius)*query.grid.cell_width_inv);
+        query.y_start = hash_grid_coord((pos.y-radius)*query.grid.cell_width_inv);
+        query.z_start = hash_grid_coord((pos.z-radius)*query.grid.cell_width_inv);
+
+        query.x_end = hash_grid_coord((pos.x+radius)*query.grid.cell_width_inv);
+        query.y_end = hash_grid_coord((pos.y+radius)*query.grid.cell_width_inv);
+        query.z_end = hash_grid_coord((pos.z+radius)*query.grid.cell_width_inv);
+    }
+    else
+    {
+        query.x_start = int((pos.x-radius)*query.grid.cell_width_inv);
+        query.y_start = int((pos.y-radius)*query.grid.cell_width_inv);
+        query.z_start = int((pos.z-radius)*query.grid.cell_width_inv);
+
+        query.x_end = int((pos.x+radius)*query.grid.cell_width_inv);
+        query.y_end = int((pos.y+radius)*query.grid.cell_width_inv);
+        query.z_end = int((pos.z+radius)*query.grid.cell_width_inv);
+
+        // dense grids wrap, do not want to visit any cells more than once, so limit large radius offset to one pass over each dimension
+        query.x_end = min(query.x_end, query.x_start + query.grid.dim_x-1);
+        query.y_end = min(query.y_end, query.y_start + query.grid.dim_y-1);
+        query.z_end = min(query.z_end, query.z_start + query.grid.dim_z-1);
+    }
 
     query.x = query.x_start;
     query.y = query.y_start;
     query.z = query.z_start;
 
-    const int cell = hash_grid_index(query.grid, query.x, query.y, query.z);
-    query.cell_index = query.grid.cell_starts[cell];
-    query.cell_end = query.grid.cell_ends[cell];
+    const int cell = hash_grid_cell(query.grid, query.x, query.y, query.z);
+    query.cell_index = cell >= 0 ? query.grid.cell_starts[cell] : 0;
+    query.cell_end = cell >= 0 ? query.grid.cell_ends[cell] : 0;
 
     return query;
 }
@@ -127,7 +238,8 @@ CUDA_CALLABLE inline bool hash_grid_query_next(hash_grid_query_t& query, int& in
         if (query.cell_index < query.cell_end)
         {
             // write output index
-            index = grid.point_ids[query.cell_index++];            
+            index = grid.ordered ? query.cell_index : grid.point_ids[query.cell_index];
+            query.cell_index++;
             return true;
         }
         else
@@ -152,10 +264,10 @@ CUDA_CALLABLE inline bool hash_grid_query_next(hash_grid_query_t& query, int& in
             }
 
             // update cell pointers
-            const int cell = hash_grid_index(grid, query.x, query.y, query.z);
+            const int cell = hash_grid_cell(grid, query.x, query.y, query.z);
 
-            query.cell_index = grid.cell_starts[cell];
-            query.cell_end = grid.cell_ends[cell];        
+            query.cell_index = cell >= 0 ? grid.cell_starts[cell] : 0;
+            query.cell_end = cell >= 0 ? grid.cell_ends[cell] : 0;
         }
     }
 }
@@ -163,7 +275,7 @@ CUDA_CALLABLE inline bool hash_grid_query_next(hash_grid_query_t& query, int& in
 CUDA_CALLABLE inline int hash_grid_point_id(uint64_t id, int& index)
 {
     const HashGrid* grid = (const HashGrid*)(id);
-    return grid->point_ids[index];
+    return grid->ordered ? index : grid->point_ids[index];
 }
 
 CUDA_CALLABLE inline void adj_hash_grid_query(uint64_t id, wp::vec3 pos, float radius, uint64_t& adj_id, wp::vec3& adj_pos, float& adj_radius, hash_grid_query_t& adj_res) {}
@@ -8,15 +8,18 @@
 
 #include "mesh.h"
 #include "bvh.h"
+#include "sort.h"
+#include "registry.h"
 
-using namespace wp;
+#include <vector>
+#include <algorithm>
 
-#include <map>
+using namespace wp;
 
 namespace 
 {
     // host-side copy of mesh descriptors, maps GPU mesh address (id) to a CPU desc
-    std::map<uint64_t, Mesh> g_mesh_descriptors;
+    DescriptorRegistry<Mesh> g_mesh_descriptors;
 
 } // anonymous namespace
 
@@ -24,107 +27,78 @@ namespace
 namespace wp
 {
 
-bool mesh_get_descriptor(uint64_t id, Mesh& mesh)
+Descriptor<Mesh>* mesh_get_descriptor(uint64_t id)
 {
-    const auto& iter = g_mesh_descriptors.find(id);
-    if (iter == g_mesh_descriptors.end())
-        return false;
-    else
-        mesh = iter->second;
-        return true;
+    return g_mesh_descriptors.find(id);
 }
 
-void mesh_add_descriptor(uint64_t id, const Mesh& mesh)
+Descriptor<Mesh>* mesh_add_descriptor(uint64_t id, const Mesh& mesh)
 {
-    g_mesh_descriptors[id] = mesh;
+    return g_mesh_descriptors.insert(id, mesh);
 }
 
 void mesh_rem_descriptor(uint64_t id)
 {
     g_mesh_descriptors.erase(id);
-
 }
 
 } // namespace wp
 
-uint64_t mesh_create_host(vec3* points, vec3* velocities, int* indices, int num_points, int num_tris)
+namespace
 {
-    Mesh* m = new Mesh();
-
-    m->points = points;
-    m->velocities = velocities;
-    m->indices = indices;
-
-    m->num_points = num_points;
-    m->num_tris = num_tris;
-
-    m->bounds = new bounds3[num_tris];
-
-    for (int i=0; i < num_tris; ++i)
-    {
-        m->bounds[i].add_point(points[indices[i*3+0]]);
-        m->bounds[i].add_point(points[indices[i*3+1]]);
-        m->bounds[i].add_point(points[indices[i*3+2]]);
-    }
 
-    m->bvh = bvh_create(m->bounds, num_tris);
+// smallest number of triangles assigned to a thread when recomputing bounds
+const int kMinBoundsChunk = 16*1024;
 
-    return (uint64_t)m;
+inline void mesh_compute_bounds(Mesh& m, int i)
+{
+    m.bounds[i] = bounds3();
+    m.bounds[i].add_point(m.points[m.indices[i*3+0]]);
+    m.bounds[i].add_point(m.points[m.indices[i*3+1]]);
+    m.bounds[i].add_point(m.points[m.indices[i*3+2]]);
 }
 
-uint64_t mesh_create_device(vec3* points, vec3* velocities, int* indices, int num_points, int num_tris)
+void mesh_compute_bounds_host(Mesh& m)
 {
-    Mesh mesh;
+    const int num_chunks = std::max(1, std::min(cpu_get_num_threads()*4, m.num_tris/kMinBoundsChunk));
 
-    mesh.points = points;
-    mesh.velocities = velocities;
-    mesh.indices = indices;
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        range_chunk(chunk, num_chunks, 0, m.num_tris, begin, end);
 
-    mesh.num_points = num_points;
-    mesh.num_tris = num_tris;
+        for (int i=begin; i < end; ++i)
+            mesh_compute_bounds(m, i);
+    });
+}
 
-    {
-        // todo: BVH creation only on CPU at the moment so temporarily bring all the data back to host
-        vec3* points_host = (vec3*)alloc_host(sizeof(vec3)*num_points);
-        int* indices_host = (int*)alloc_host(sizeof(int)*num_tris*3);
-        bounds3* bounds_host = (bounds3*)alloc_host(sizeof(bounds3)*num_tris);
+} // anonymous namespace
 
-        memcpy_d2h(points_host, points, sizeof(vec3)*num_points);
-        memcpy_d2h(indices_host, indices, sizeof(int)*num_tris*3);
-        synchronize();
+uint64_t mesh_create_host(vec3* points, vec3* velocities, int* indices, int num_points, int num_tris, int bvh_builder, int bvh_width)
+{
+    Mesh* m = new Mesh();
 
-        for (int i=0; i < num_tris; ++i)
-        {
-            bounds_host[i] = bounds3();
-            bounds_host[i].add_point(points_host[indices_host[i*3+0]]);
-            bounds_host[i].add_point(points_host[indices_host[i*3+1]]);
-            bounds_host[i].add_point(points_host[indices_host[i*3+2]]);
-        }
+    m->points = points;
+    m->velocities = velocities;
+    m->indices = indices;
 
-        BVH bvh_host = bvh_create(bounds_host, num_tris);
-        BVH bvh_device = bvh_clone(bvh_host);
+    m->num_points = num_points;
+    m->num_tris = num_tris;
+    m->max_tris = num_tris;
 
-        bvh_destroy_host(bvh_host);
+    m->bounds = new bounds3[num_tris];
 
-        // save gpu-side copy of bounds
-        mesh.bounds = (bounds3*)alloc_device(sizeof(bounds3)*num_tris);
-        memcpy_h2d(mesh.bounds, bounds_host, sizeof(bounds3)*num_tris);
+    mesh_compute_bounds_host(*m);
 
-        free_host(points_host);
-        free_host(indices_host);
-        free_host(bounds_host);
+    m->bvh = bvh_create(m->bounds, num_tris, bvh_builder);
 
-        mesh.bvh = bvh_device;
-    }
+    if (bvh_width == BVH_WIDE_WIDTH)
+        bvh_create_wide_host(m->bvh);
 
-    Mesh* mesh_device = (Mesh*)alloc_device(sizeof(Mesh));
-    memcpy_h2d(mesh_device, &mesh, sizeof(Mesh));
-    
-    // save descriptor
-    uint64_t mesh_id = (uint64_t)mesh_device;
-    mesh_add_descriptor(mesh_id, mesh);
+    m->bvh_width = bvh_width;
+    m->bvh_cost = bvh_sah_cost_host(m->bvh);
 
-    return mesh_id;
+    return (uint64_t)m;
 }
 
 void mesh_destroy_host(uint64_t id)
@@ -139,39 +113,153 @@ void mesh_destroy_host(uint64_t id)
 
 void mesh_destroy_device(uint64_t id)
 {
-    Mesh mesh;
-    if (mesh_get_descriptor(id, mesh))
+    Descriptor<Mesh>* d = mesh_get_descriptor(id);
+    if (d)
     {    
-        bvh_destroy_device(mesh.bvh);
-        free_device(mesh.bounds);
+        bvh_destroy_device(d->host.bvh);
+        free_device(d->host.bounds);
+        free_device(d->host.bvh_cost_temp);
+        free_pinned(d->host.bvh_cost_readback);
+
+        if (d->host.bvh_cost_event)
+            cuda_event_destroy(d->host.bvh_cost_event);
+
         free_device((Mesh*)id);
 
         mesh_rem_descriptor(id);
     }
 }
 
+
 void mesh_refit_host(uint64_t id)
 {
     Mesh* m = (Mesh*)(id);
 
-    for (int i=0; i < m->num_tris; ++i)
+    mesh_compute_bounds_host(*m);
+
+    bvh_refit_host(m->bvh, m->bounds);
+}
+
+// same topology is refit and only rebuilt once the SAH cost exceeds rebuild_ratio times the cost at the last
+// build (rebuild_ratio <= 0 never rebuilds), new topology is always rebuilt, returns true if the BVH was rebuilt
+bool mesh_update_host(uint64_t id, vec3* points, vec3* velocities, int* indices, int num_points, int num_tris, bool topology_changed, int bvh_builder, int bvh_width, float rebuild_ratio)
+{
+    Mesh* m = (Mesh*)(id);
+
+    bool rebuild = topology_changed || num_tris != m->num_tris;
+
+    m->points = points;
+    m->velocities = velocities;
+    m->indices = indices;
+    m->num_points = num_points;
+
+    if (num_tris > m->max_tris)
     {
-        m->bounds[i] = bounds3();
-        m->bounds[i].add_point(m->points[m->indices[i*3+0]]);
-        m->bounds[i].add_point(m->points[m->indices[i*3+1]]);
-        m->bounds[i].add_point(m->points[m->indices[i*3+2]]);
+        delete[] m->bounds;
+
+        m->max_tris = num_tris*3/2;
+        m->bounds = new bounds3[m->max_tris];
     }
 
-    bvh_refit_host(m->bvh, m->bounds);
+    m->num_tris = num_tris;
+
+    mesh_compute_bounds_host(*m);
+
+    if (!rebuild)
+    {
+        bvh_refit_host(m->bvh, m->bounds);
+
+        rebuild = rebuild_ratio > 0.0f && bvh_sah_cost_host(m->bvh) > rebuild_ratio*m->bvh_cost;
+    }
+
+    // dropped before a rebuild, which would otherwise collapse the new tree again
+    if (bvh_width != BVH_WIDE_WIDTH && m->bvh.wide_nodes)
+        bvh_destroy_wide_host(m->bvh);
+
+    if (rebuild)
+    {
+        bvh_rebuild_host(m->bvh, m->bounds, num_tris, bvh_builder);
+
+        if (bvh_width == BVH_WIDE_WIDTH && !m->bvh.wide_nodes)
+            bvh_create_wide_host(m->bvh);
+
+        m->bvh_cost = bvh_sah_cost_host(m->bvh);
+    }
+    else if (bvh_width != m->bvh_width && bvh_width == BVH_WIDE_WIDTH)
+    {
+        bvh_create_wide_host(m->bvh);
+    }
+
+    m->bvh_width = bvh_width;
+
+    return rebuild;
 }
 
+void mesh_refit_partial_host(uint64_t id, int* faces, int num_faces)
+{
+    Mesh* m = (Mesh*)(id);
+
+    for (int i=0; i < num_faces; ++i)
+        mesh_compute_bounds(*m, faces[i]);
+
+    bvh_refit_partial_host(m->bvh, faces, num_faces, m->bounds);
+}
+
+void mesh_query_rays_host(uint64_t id, vec3* starts, vec3* dirs, int num_rays, float max_t, bool any_hit, bool sort_rays,
+                          float* t, int* faces, float* u, float* v, vec3* normals)
+{
+    if (num_rays <= 0)
+        return;
+
+    const Mesh& m = *(Mesh*)(id);
+
+    if (!sort_rays || m.bvh.num_nodes == 0)
+    {
+        cpu_launch(num_rays, [&](int i)
+        {
+            mesh_query_ray_batch(m, i, starts, dirs, max_t, any_hit, t, faces, u, v, normals);
+        });
+
+        return;
+    }
+
+    // rays are traced in key order, second half of the buffers is scratch for the sort
+    std::vector<int> keys(num_rays*2);
+    std::vector<int> order(num_rays*2);
+
+    cpu_launch(num_rays, [&](int i)
+    {
+        keys[i] = mesh_ray_sort_key(m, starts[i], dirs[i]);
+        order[i] = i;
+    });
+
+    radix_sort_pairs_host(keys.data(), order.data(), num_rays);
+
+    cpu_launch(num_rays, [&](int i)
+    {
+        mesh_query_ray_batch(m, order[i], starts, dirs, max_t, any_hit, t, faces, u, v, normals);
+    });
+}
 
 // stubs for non-CUDA platforms
 #if __APPLE__
 
+uint64_t mesh_create_device(vec3* points, vec3* velocities, int* indices, int num_points, int num_tris, int bvh_builder, int bvh_width) { return 0; }
+
 void mesh_refit_device(uint64_t id)
 {
 }
 
+void mesh_refit_partial_device(uint64_t id, int* faces, int num_faces)
+{
+}
+
+bool mesh_update_device(uint64_t id, vec3* points, vec3* velocities, int* indices, int num_points, int num_tris, bool topology_changed, int bvh_builder, int bvh_width, float rebuild_ratio) { return false; }
+
+void mesh_query_rays_device(uint64_t id, vec3* starts, vec3* dirs, int num_rays, float max_t, bool any_hit, bool sort_rays,
+                            float* t, int* faces, float* u, float* v, vec3* normals)
+{
+}
+
 
 #endif // __APPLE_
\ No newline at end of file
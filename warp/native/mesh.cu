@@ -9,6 +9,10 @@
 #include "warp.h"
 #include "mesh.h"
 #include "bvh.h"
+#include "sort.h"
+#include "registry.h"
+
+#include <vector>
 
 namespace wp
 {
@@ -35,15 +39,114 @@ __global__ void compute_triangle_bounds(int n, const vec3* points, const int* in
     }
 }
 
+__global__ void compute_triangle_bounds_indexed(int n, const int* faces, const vec3* points, const int* indices, bounds3* b)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < n)
+    {
+        const int f = faces[tid];
+
+        vec3 p = points[indices[f*3 + 0]];
+        vec3 q = points[indices[f*3 + 1]];
+        vec3 r = points[indices[f*3 + 2]];
+
+        vec3 lower = min(min(p, q), r);
+        vec3 upper = max(max(p, q), r);
+
+        b[f] = bounds3(lower, upper);
+    }
+}
+
+__global__ void mesh_ray_sort_keys(Mesh mesh, int n, const vec3* starts, const vec3* dirs, int* keys, int* order)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < n)
+    {
+        keys[tid] = mesh_ray_sort_key(mesh, starts[tid], dirs[tid]);
+        order[tid] = tid;
+    }
+}
+
+// order may be NULL in which case thread i traces ray i
+__global__ void mesh_query_rays_kernel(Mesh mesh, int n, const int* order, const vec3* starts, const vec3* dirs, float max_t, bool any_hit,
+                                       float* t, int* faces, float* u, float* v, vec3* normals)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < n)
+        mesh_query_ray_batch(mesh, order ? order[tid] : tid, starts, dirs, max_t, any_hit, t, faces, u, v, normals);
+}
+
 } // namespace wp
 
+uint64_t mesh_create_device(wp::vec3* points, wp::vec3* velocities, int* indices, int num_points, int num_tris, int bvh_builder, int bvh_width)
+{
+    wp::Mesh mesh;
+    memset(&mesh, 0, sizeof(wp::Mesh));
+
+    mesh.points = points;
+    mesh.velocities = velocities;
+    mesh.indices = indices;
+
+    mesh.num_points = num_points;
+    mesh.num_tris = num_tris;
+    mesh.max_tris = num_tris;
+
+    // triangle bounds are always computed on device
+    mesh.bounds = (wp::bounds3*)alloc_device(sizeof(wp::bounds3)*num_tris);
+    wp_launch_device(wp::compute_triangle_bounds, num_tris, (num_tris, points, indices, mesh.bounds));
+
+    if (bvh_builder == wp::BVH_BUILDER_LINEAR)
+    {
+        // linear BVH is built on device, no host round-trip
+        mesh.bvh = wp::bvh_create_device(mesh.bounds, num_tris);
+
+        if (bvh_width == BVH_WIDE_WIDTH)
+            wp::bvh_create_wide_device(mesh.bvh);
+    }
+    else
+    {
+        // higher quality builders run on the host, bounds are read back and the tree uploaded
+        std::vector<wp::bounds3> bounds(num_tris);
+        memcpy_d2h(bounds.data(), mesh.bounds, sizeof(wp::bounds3)*num_tris);
+        check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+
+        wp::BVH bvh_host = wp::bvh_create(bounds.data(), num_tris, bvh_builder);
+
+        if (bvh_width == BVH_WIDE_WIDTH)
+            wp::bvh_create_wide_host(bvh_host);
+
+        mesh.bvh = wp::bvh_clone(bvh_host);
+
+        // clone() copies asynchronously from the host tree
+        check_cuda(cudaStreamSynchronize((cudaStream_t)cuda_get_stream()));
+        wp::bvh_destroy_host(bvh_host);
+    }
+
+    // baseline for the rebuild heuristic in mesh_update_device()
+    mesh.bvh_cost = wp::bvh_sah_cost_device(mesh.bvh);
+    mesh.bvh_width = bvh_width;
+
+    wp::Mesh* mesh_device = (wp::Mesh*)alloc_device(sizeof(wp::Mesh));
+    
+    // save descriptor
+    uint64_t mesh_id = (uint64_t)mesh_device;
+    wp::descriptor_upload(mesh_id, *wp::mesh_add_descriptor(mesh_id, mesh));
+
+    return mesh_id;
+}
+
 void mesh_refit_device(uint64_t id)
 {
 
     // recompute triangle bounds
-    wp::Mesh m;
-    if (mesh_get_descriptor(id, m))
+    wp::Descriptor<wp::Mesh>* d = wp::mesh_get_descriptor(id);
+    if (d)
     {
+        wp::Mesh& m = d->host;
+
         wp_launch_device(wp::compute_triangle_bounds, m.num_tris, (m.num_tris, m.points, m.indices, m.bounds));
 
         bvh_refit_device(m.bvh, m.bounds);
@@ -51,3 +154,137 @@ void mesh_refit_device(uint64_t id)
 
 }
 
+bool mesh_update_device(uint64_t id, wp::vec3* points, wp::vec3* velocities, int* indices, int num_points, int num_tris, bool topology_changed, int bvh_builder, int bvh_width, float rebuild_ratio)
+{
+    wp::Descriptor<wp::Mesh>* d = wp::mesh_get_descriptor(id);
+    if (!d)
+        return false;
+
+    wp::Mesh& m = d->host;
+
+    bool rebuild = topology_changed || num_tris != m.num_tris;
+
+    m.points = points;
+    m.velocities = velocities;
+    m.indices = indices;
+    m.num_points = num_points;
+
+    if (num_tris > m.max_tris)
+    {
+        free_device(m.bounds);
+
+        m.max_tris = num_tris*3/2;
+        m.bounds = (wp::bounds3*)alloc_device(sizeof(wp::bounds3)*m.max_tris);
+    }
+
+    m.num_tris = num_tris;
+
+    wp_launch_device(wp::compute_triangle_bounds, num_tris, (num_tris, points, indices, m.bounds));
+
+    if (!rebuild)
+    {
+        wp::bvh_refit_device(m.bvh, m.bounds);
+
+        // the cost of an earlier refit is used once it has arrived on the host so that updates do not
+        // wait on the device, the heuristic is skipped during capture since rebuilds are not captured
+        if (rebuild_ratio > 0.0f && !cuda_is_capturing())
+        {
+            if (m.bvh_cost_pending && cudaEventQuery((cudaEvent_t)m.bvh_cost_event) == cudaSuccess)
+            {
+                rebuild = *m.bvh_cost_readback > rebuild_ratio*m.bvh_cost;
+                m.bvh_cost_pending = false;
+            }
+
+            if (!rebuild && !m.bvh_cost_pending)
+            {
+                if (!m.bvh_cost_event)
+                {
+                    m.bvh_cost_temp = (float*)alloc_device(sizeof(float));
+                    m.bvh_cost_readback = (float*)alloc_pinned(sizeof(float));
+                    m.bvh_cost_event = cuda_event_create(false);
+                }
+
+                wp::bvh_sah_cost_device_async(m.bvh, m.bvh_cost_temp, m.bvh_cost_readback);
+                cuda_event_record(m.bvh_cost_event, cuda_get_stream());
+
+                m.bvh_cost_pending = true;
+            }
+        }
+    }
+
+    // dropped before a rebuild, which would otherwise collapse the new tree again
+    if (bvh_width != BVH_WIDE_WIDTH && m.bvh.wide_nodes)
+        wp::bvh_destroy_wide_device(m.bvh);
+
+    if (rebuild)
+    {
+        // node arrays and the descriptor are reused, the mesh id stays valid
+        wp::bvh_rebuild_device(m.bvh, m.bounds, num_tris, bvh_builder);
+
+        if (bvh_width == BVH_WIDE_WIDTH && !m.bvh.wide_nodes)
+            wp::bvh_create_wide_device(m.bvh);
+
+        m.bvh_cost = wp::bvh_sah_cost_device(m.bvh);
+
+        // a readback still in flight measured the previous tree
+        m.bvh_cost_pending = false;
+    }
+    else if (bvh_width != m.bvh_width && bvh_width == BVH_WIDE_WIDTH)
+    {
+        wp::bvh_create_wide_device(m.bvh);
+    }
+
+    m.bvh_width = bvh_width;
+
+    // kernels read the descriptor through the id so it is updated in-place
+    wp::descriptor_upload(id, *d);
+
+    return rebuild;
+}
+
+void mesh_refit_partial_device(uint64_t id, int* faces, int num_faces)
+{
+    wp::Descriptor<wp::Mesh>* d = wp::mesh_get_descriptor(id);
+    if (d && num_faces > 0)
+    {
+        wp::Mesh& m = d->host;
+
+        wp_launch_device(wp::compute_triangle_bounds_indexed, num_faces, (num_faces, faces, m.points, m.indices, m.bounds));
+
+        bvh_refit_partial_device(m.bvh, faces, num_faces, m.bounds);
+    }
+}
+
+void mesh_query_rays_device(uint64_t id, wp::vec3* starts, wp::vec3* dirs, int num_rays, float max_t, bool any_hit, bool sort_rays,
+                            float* t, int* faces, float* u, float* v, wp::vec3* normals)
+{
+    if (num_rays <= 0)
+        return;
+
+    wp::Descriptor<wp::Mesh>* d = wp::mesh_get_descriptor(id);
+    if (!d)
+        return;
+
+    const wp::Mesh& m = d->host;
+
+    int* order = NULL;
+    int* keys = NULL;
+
+    if (sort_rays && m.bvh.num_nodes)
+    {
+        // second half of the buffers is scratch for the sort
+        keys = (int*)alloc_device(sizeof(int)*num_rays*2);
+        order = (int*)alloc_device(sizeof(int)*num_rays*2);
+
+        wp_launch_device(wp::mesh_ray_sort_keys, num_rays, (m, num_rays, starts, dirs, keys, order));
+        radix_sort_pairs_device(keys, order, num_rays);
+    }
+
+    wp_launch_device(wp::mesh_query_rays_kernel, num_rays, (m, num_rays, order, starts, dirs, max_t, any_hit, t, faces, u, v, normals));
+
+    if (order)
+    {
+        free_device(keys);
+        free_device(order);
+    }
+}
@@ -29,6 +29,22 @@ struct Mesh
     int num_points;
     int num_tris;
 
+	// capacity of the bounds array, grown by 1.5x when updates add triangles
+	int max_tris;
+
+	// SAH cost of the BVH when it was last built, see mesh_update_host()
+	float bvh_cost;
+
+	// device meshes read the cost of a refit back asynchronously, the rebuild heuristic
+	// of a later update uses it once bvh_cost_event has completed, see mesh_update_device()
+	float* bvh_cost_temp;		// device
+	float* bvh_cost_readback;	// pinned host
+	void* bvh_cost_event;
+	bool bvh_cost_pending;
+
+	// branching factor requested by the last build or update
+	int bvh_width;
+
     BVH bvh;
 };
 
@@ -45,6 +61,255 @@ CUDA_CALLABLE inline float distance_to_aabb_sq(const vec3& p, const vec3& lower,
 	return length_sq(p-cp);
 }
 
+// ray test against the bounds of a binary node
+CUDA_CALLABLE inline bool bvh_intersect_ray_node(const BVH& bvh, int index, const vec3& start, const vec3& rcp_dir, float& t)
+{
+	BVHPackedNodeHalf lower = bvh.node_lowers[index];
+	BVHPackedNodeHalf upper = bvh.node_uppers[index];
+
+	// todo: switch to robust ray-aabb, or expand bounds in build stage
+	const float eps = 1.e-3f;
+
+	t = 0.0f;
+	return intersect_ray_aabb(start, rcp_dir, vec3(lower.x-eps, lower.y-eps, lower.z-eps), vec3(upper.x+eps, upper.y+eps, upper.z+eps), t);
+}
+
+// closest point test against a single face for the wide traversal, skips slivers like mesh_query_point()
+CUDA_CALLABLE inline void mesh_query_point_face(const Mesh& mesh, int face, const vec3& point, float& min_dist_sq, int& min_face, float& min_v, float& min_w, float& min_inside)
+{
+	int i = mesh.indices[face*3+0];
+	int j = mesh.indices[face*3+1];
+	int k = mesh.indices[face*3+2];
+
+	vec3 p = mesh.points[i];
+	vec3 q = mesh.points[j];
+	vec3 r = mesh.points[k];
+
+	vec3 e0 = q-p;
+	vec3 e1 = r-p;
+	vec3 e2 = r-q;
+	vec3 normal = cross(e0, e1);
+
+	// sliver detection
+	if (length(normal)/(dot(e0,e0) + dot(e1,e1) + dot(e2,e2)) < 1.e-6f)
+		return;
+
+	float v, w;
+	vec3 c = closest_point_to_triangle(p, q, r, point, v, w);
+
+	float angle = dot(normal, point-c);
+	float dist_sq = length_sq(c-point);
+
+	if (dist_sq < min_dist_sq)
+	{
+		min_dist_sq = dist_sq;
+		min_v = v;
+		min_w = w;
+		min_face = face;
+		min_inside = sign(angle);
+	}
+	else if (dist_sq == min_dist_sq)
+	{
+		// equally close faces, inside if any of them enclose the point
+		if (angle < 0.0f)
+			min_inside = -1.0f;
+	}
+}
+
+// inserts child into the list of children to visit, kept in order of decreasing key so the
+// closest child is pushed last and popped first
+CUDA_CALLABLE inline void bvh_wide_insert_child(int* children, float* keys, int& count, int child, float key)
+{
+	int k = count++;
+	while (k > 0 && keys[k-1] < key)
+	{
+		children[k] = children[k-1];
+		keys[k] = keys[k-1];
+		--k;
+	}
+
+	children[k] = child;
+	keys[k] = key;
+}
+
+CUDA_CALLABLE inline bool mesh_query_point_wide(const Mesh& mesh, const vec3& point, float max_dist, float& inside, int& face, float& u, float& v)
+{
+	int stack[BVH_WIDE_QUERY_STACK_SIZE];
+	float stack_dist_sq[BVH_WIDE_QUERY_STACK_SIZE];
+
+	stack[0] = 0;
+	stack_dist_sq[0] = 0.0f;
+
+	int count = 1;
+
+	float min_dist_sq = max_dist*max_dist;
+	int min_face = -1;
+	float min_v = 0.0f;
+	float min_w = 0.0f;
+	float min_inside = 1.0f;
+
+	while (count)
+	{
+		--count;
+
+		// a closer face may have been found since the node was pushed
+		if (stack_dist_sq[count] > min_dist_sq)
+			continue;
+
+		const BVHWideNode node = mesh.bvh.wide_nodes[stack[count]];
+
+		int inner[BVH_WIDE_WIDTH];
+		float inner_dist_sq[BVH_WIDE_WIDTH];
+		int num_inner = 0;
+
+		for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+		{
+			const uint32_t child = node.children[c];
+			if (child == BVH_WIDE_EMPTY)
+				break;
+
+			vec3 lower, upper;
+			bvh_wide_decode(node, c, lower, upper);
+
+			const float dist_sq = distance_to_aabb_sq(point, lower, upper);
+			if (dist_sq > min_dist_sq)
+				continue;
+
+			if (child & BVH_WIDE_LEAF)
+				mesh_query_point_face(mesh, int(child & ~BVH_WIDE_LEAF), point, min_dist_sq, min_face, min_v, min_w, min_inside);
+			else
+				bvh_wide_insert_child(inner, inner_dist_sq, num_inner, int(child), dist_sq);
+		}
+
+		for (int c=0; c < num_inner; ++c)
+		{
+			stack[count] = inner[c];
+			stack_dist_sq[count] = inner_dist_sq[c];
+			count++;
+		}
+	}
+
+	// check if we found a point, and write outputs
+	if (min_dist_sq < max_dist*max_dist)
+	{
+		u = 1.0f - min_v - min_w;
+		v = min_v;
+		face = min_face;
+		inside = min_inside;
+		
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+CUDA_CALLABLE inline bool mesh_query_ray_wide(const Mesh& mesh, const vec3& start, const vec3& dir, float max_t, float& t, float& u, float& v, float& sign, vec3& normal, int& face)
+{
+	int stack[BVH_WIDE_QUERY_STACK_SIZE];
+	float stack_t[BVH_WIDE_QUERY_STACK_SIZE];
+
+	stack[0] = 0;
+	stack_t[0] = 0.0f;
+
+	int count = 1;
+
+	vec3 rcp_dir = vec3(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
+
+	float min_t = max_t;
+	int min_face = -1;
+	float min_u = 0.0f;
+	float min_v = 0.0f;
+	float min_sign = 1.0f;
+	vec3 min_normal;
+
+	// same bounds expansion as mesh_query_ray()
+	const float eps = 1.e-3f;
+
+	while (count)
+	{
+		--count;
+
+		if (stack_t[count] >= min_t)
+			continue;
+
+		const BVHWideNode node = mesh.bvh.wide_nodes[stack[count]];
+
+		int inner[BVH_WIDE_WIDTH];
+		float inner_t[BVH_WIDE_WIDTH];
+		int num_inner = 0;
+
+		for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+		{
+			const uint32_t child = node.children[c];
+			if (child == BVH_WIDE_EMPTY)
+				break;
+
+			vec3 lower, upper;
+			bvh_wide_decode(node, c, lower, upper);
+
+			float box_t = 0.0f;
+			bool hit = intersect_ray_aabb(start, rcp_dir, lower - vec3(eps), upper + vec3(eps), box_t);
+
+			if (!hit || box_t >= min_t)
+				continue;
+
+			if (child & BVH_WIDE_LEAF)
+			{
+				const int f = int(child & ~BVH_WIDE_LEAF);
+
+				vec3 p = mesh.points[mesh.indices[f*3+0]];
+				vec3 q = mesh.points[mesh.indices[f*3+1]];
+				vec3 r = mesh.points[mesh.indices[f*3+2]];
+
+				float tri_t, tri_u, tri_v, tri_w, tri_sign;
+				vec3 n;
+
+				if (intersect_ray_tri_woop(start, dir, p, q, r, tri_t, tri_u, tri_v, tri_w, tri_sign, &n))
+				{
+					if (tri_t < min_t && tri_t >= 0.0f)
+					{
+						min_t = tri_t;
+						min_face = f;
+						min_u = tri_u;
+						min_v = tri_v;
+						min_sign = tri_sign;
+						min_normal = n;
+					}
+				}
+			}
+			else
+			{
+				bvh_wide_insert_child(inner, inner_t, num_inner, int(child), box_t);
+			}
+		}
+
+		for (int c=0; c < num_inner; ++c)
+		{
+			stack[count] = inner[c];
+			stack_t[count] = inner_t[c];
+			count++;
+		}
+	}
+
+	if (min_t < max_t)
+	{
+		u = min_u;
+		v = min_v;
+		sign = min_sign;
+		t = min_t;
+		normal = normalize(min_normal);
+		face = min_face;
+
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
 
 
 // these can be called inside kernels so need to be inline
@@ -55,7 +320,7 @@ CUDA_CALLABLE inline vec3 mesh_query_point_old(uint64_t id, const vec3& point, f
 	if (mesh.bvh.num_nodes == 0)
 		return vec3();
 
-	int stack[32];
+	int stack[BVH_QUERY_STACK_SIZE];
     stack[0] = mesh.bvh.root;
 
 	int count = 1;
@@ -154,15 +419,18 @@ CUDA_CALLABLE inline bool mesh_query_point(uint64_t id, const vec3& point, float
 	if (mesh.bvh.num_nodes == 0)
 		return false;
 
-	int stack[32];
+	if (mesh.bvh.wide_nodes)
+		return mesh_query_point_wide(mesh, point, max_dist, inside, face, u, v);
+
+	int stack[BVH_QUERY_STACK_SIZE];
     stack[0] = mesh.bvh.root;
 
 	int count = 1;
 
 	float min_dist_sq = max_dist*max_dist;
-	int min_face;
-	float min_v;
-	float min_w;
+	int min_face = -1;
+	float min_v = 0.0f;
+	float min_w = 0.0f;
 	float min_inside = 1.0f;
 
 	int tests = 0;
@@ -372,67 +640,98 @@ CUDA_CALLABLE inline bool mesh_query_ray(uint64_t id, const vec3& start, const v
 	if (mesh.bvh.num_nodes == 0)
 		return false;
 
-    int stack[32];
+	if (mesh.bvh.wide_nodes)
+		return mesh_query_ray_wide(mesh, start, dir, max_t, t, u, v, sign, normal, face);
+
+    int stack[BVH_QUERY_STACK_SIZE];
+	float stack_t[BVH_QUERY_STACK_SIZE];
+
 	stack[0] = mesh.bvh.root;
+	stack_t[0] = 0.0f;
 	int count = 1;
 
 	vec3 rcp_dir = vec3(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
 
 	float min_t = max_t;
-	int min_face;
-	float min_u;
-	float min_v;
+	int min_face = -1;
+	float min_u = 0.0f;
+	float min_v = 0.0f;
 	float min_sign = 1.0f;
 	vec3 min_normal;
 
 	while (count)
 	{
-		const int nodeIndex = stack[--count];
+		--count;
+
+		// a closer hit may have been found since the node was pushed
+		if (stack_t[count] >= min_t)
+			continue;
+
+		const int nodeIndex = stack[count];
 
 		BVHPackedNodeHalf lower = mesh.bvh.node_lowers[nodeIndex];
 		BVHPackedNodeHalf upper = mesh.bvh.node_uppers[nodeIndex];
 
-		// todo: switch to robust ray-aabb, or expand bounds in build stage
-		float eps = 1.e-3f;
-		float t = 0.0f;
-		bool hit = intersect_ray_aabb(start, rcp_dir, vec3(lower.x-eps, lower.y-eps, lower.z-eps), vec3(upper.x+eps, upper.y+eps, upper.z+eps), t);
-
-		if (hit && t < min_t)
-		{
-			const int left_index = lower.i;
-			const int right_index = upper.i;
+		const int left_index = lower.i;
+		const int right_index = upper.i;
 
-			if (lower.b)
-			{	
-				// compute closest point on tri
-				int i = mesh.indices[left_index*3+0];
-				int j = mesh.indices[left_index*3+1];
-				int k = mesh.indices[left_index*3+2];
+		if (lower.b)
+		{	
+			// compute closest point on tri
+			int i = mesh.indices[left_index*3+0];
+			int j = mesh.indices[left_index*3+1];
+			int k = mesh.indices[left_index*3+2];
 
-				vec3 p = mesh.points[i];
-				vec3 q = mesh.points[j];
-				vec3 r = mesh.points[k];
+			vec3 p = mesh.points[i];
+			vec3 q = mesh.points[j];
+			vec3 r = mesh.points[k];
 
-				float t, u, v, w, sign;
-				vec3 n;
-				
-				if (intersect_ray_tri_woop(start, dir, p, q, r, t, u, v, w, sign, &n))
+			float t, u, v, w, sign;
+			vec3 n;
+			
+			if (intersect_ray_tri_woop(start, dir, p, q, r, t, u, v, w, sign, &n))
+			{
+				if (t < min_t && t >= 0.0f)
 				{
-					if (t < min_t && t >= 0.0f)
-					{
-						min_t = t;
-						min_face = left_index;
-						min_u = u;
-						min_v = v;
-						min_sign = sign;
-						min_normal = n;
-					}
+					min_t = t;
+					min_face = left_index;
+					min_u = u;
+					min_v = v;
+					min_sign = sign;
+					min_normal = n;
 				}
 			}
-			else
+		}
+		else
+		{
+			// test both children and visit the nearer one first
+			float left_t, right_t;
+			const bool left_hit = bvh_intersect_ray_node(mesh.bvh, left_index, start, rcp_dir, left_t) && left_t < min_t;
+			const bool right_hit = bvh_intersect_ray_node(mesh.bvh, right_index, start, rcp_dir, right_t) && right_t < min_t;
+
+			if (left_hit && right_hit)
 			{
-				stack[count++] = left_index;
-				stack[count++] = right_index;
+				const bool left_first = left_t <= right_t;
+
+				stack[count] = left_first ? right_index : left_index;
+				stack_t[count] = left_first ? right_t : left_t;
+				count++;
+
+				stack[count] = left_first ? left_index : right_index;
+				stack_t[count] = left_first ? left_t : right_t;
+				count++;
+			}
+			else if (left_hit)
+			{
+				stack[count] = left_index;
+				stack_t[count] = left_t;
+				count++;
+			}
+			else if (right_hit)
+			{
+				stack[count] = right_index;
+				stack_t[count] = right_t;
+				count++;
 			}
 		}
 	}
@@ -464,6 +763,181 @@ CUDA_CALLABLE inline void adj_mesh_query_ray(
 	// nop
 }
 
+// returns the first hit found in [0, max_t) in traversal order, not necessarily the closest one
+CUDA_CALLABLE inline bool mesh_query_ray_any_hit(const Mesh& mesh, const vec3& start, const vec3& dir, float max_t, float& t, int& face)
+{
+	if (mesh.bvh.num_nodes == 0)
+		return false;
+
+	vec3 rcp_dir = vec3(1.0f/dir.x, 1.0f/dir.y, 1.0f/dir.z);
+
+	// wide and binary traversals both keep entries that already passed their bounds test
+	int stack[BVH_WIDE_QUERY_STACK_SIZE];
+	int count = 1;
+
+	if (mesh.bvh.wide_nodes)
+	{
+		stack[0] = 0;
+
+		while (count)
+		{
+			const uint32_t entry = uint32_t(stack[--count]);
+
+			if (entry & BVH_WIDE_LEAF)
+			{
+				const int f = int(entry & ~BVH_WIDE_LEAF);
+
+				float tri_t, tri_u, tri_v, tri_w, tri_sign;
+				vec3 n;
+
+				if (intersect_ray_tri_woop(start, dir, mesh.points[mesh.indices[f*3+0]], mesh.points[mesh.indices[f*3+1]], mesh.points[mesh.indices[f*3+2]], tri_t, tri_u, tri_v, tri_w, tri_sign, &n))
+				{
+					if (tri_t < max_t && tri_t >= 0.0f)
+					{
+						t = tri_t;
+						face = f;
+						return true;
+					}
+				}
+
+				continue;
+			}
+
+			const BVHWideNode node = mesh.bvh.wide_nodes[entry];
+
+			for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+			{
+				const uint32_t child = node.children[c];
+				if (child == BVH_WIDE_EMPTY)
+					break;
+
+				vec3 lower, upper;
+				bvh_wide_decode(node, c, lower, upper);
+
+				const float eps = 1.e-3f;
+				float box_t;
+
+				if (intersect_ray_aabb(start, rcp_dir, lower - vec3(eps), upper + vec3(eps), box_t) && box_t < max_t)
+					stack[count++] = int(child);
+			}
+		}
+	}
+	else
+	{
+		float root_t;
+		if (!bvh_intersect_ray_node(mesh.bvh, mesh.bvh.root, start, rcp_dir, root_t) || root_t >= max_t)
+			return false;
+
+		stack[0] = mesh.bvh.root;
+
+		while (count)
+		{
+			const int nodeIndex = stack[--count];
+
+			BVHPackedNodeHalf lower = mesh.bvh.node_lowers[nodeIndex];
+			BVHPackedNodeHalf upper = mesh.bvh.node_uppers[nodeIndex];
+
+			if (lower.b)
+			{
+				const int f = lower.i;
+
+				float tri_t, tri_u, tri_v, tri_w, tri_sign;
+				vec3 n;
+
+				if (intersect_ray_tri_woop(start, dir, mesh.points[mesh.indices[f*3+0]], mesh.points[mesh.indices[f*3+1]], mesh.points[mesh.indices[f*3+2]], tri_t, tri_u, tri_v, tri_w, tri_sign, &n))
+				{
+					if (tri_t < max_t && tri_t >= 0.0f)
+					{
+						t = tri_t;
+						face = f;
+						return true;
+					}
+				}
+			}
+			else
+			{
+				float child_t;
+
+				if (bvh_intersect_ray_node(mesh.bvh, lower.i, start, rcp_dir, child_t) && child_t < max_t)
+					stack[count++] = lower.i;
+
+				if (bvh_intersect_ray_node(mesh.bvh, upper.i, start, rcp_dir, child_t) && child_t < max_t)
+					stack[count++] = upper.i;
+			}
+		}
+	}
+
+	return false;
+}
+
+// cheaper occlusion test, returns true if the ray hits any face closer than max_t
+CUDA_CALLABLE inline bool mesh_query_ray_any(uint64_t id, const vec3& start, const vec3& dir, float max_t)
+{
+	float t;
+	int face;
+
+	return mesh_query_ray_any_hit(mesh_get(id), start, dir, max_t, t, face);
+}
+
+CUDA_CALLABLE inline void adj_mesh_query_ray_any(uint64_t id, const vec3& start, const vec3& dir, float max_t,
+												 uint64_t adj_id, vec3& adj_start, vec3& adj_dir, float& adj_max_t, bool adj_ret)
+{
+	// nop
+}
+
+// Morton code of the ray direction followed by its origin relative to the mesh bounds, rays
+// with nearby keys visit similar nodes so sorting by key improves coherence within a warp
+CUDA_CALLABLE inline int mesh_ray_sort_key(const Mesh& mesh, const vec3& start, const vec3& dir)
+{
+	vec3 lower, upper;
+
+	if (mesh.bvh.wide_nodes)
+	{
+		lower = mesh.bvh.wide_nodes[0].origin;
+		upper = lower + mesh.bvh.wide_nodes[0].scale*255.0f;
+	}
+	else
+	{
+		const BVHPackedNodeHalf& l = mesh.bvh.node_lowers[mesh.bvh.root];
+		const BVHPackedNodeHalf& u = mesh.bvh.node_uppers[mesh.bvh.root];
+
+		lower = vec3(l.x, l.y, l.z);
+		upper = vec3(u.x, u.y, u.z);
+	}
+
+	const vec3 edges = max(upper-lower, vec3(1.e-6f));
+	const vec3 local = cw_div(start-lower, edges);
+	const vec3 d = normalize(dir)*0.5f + vec3(0.5f);
+
+	return int((morton3<32>(d.x, d.y, d.z) << 15) | morton3<32>(local.x, local.y, local.z));
+}
+
+// casts ray i of a batch, null outputs are skipped and misses write face = -1 and t = max_t
+CUDA_CALLABLE inline void mesh_query_ray_batch(const Mesh& mesh, int i, const vec3* starts, const vec3* dirs, float max_t, bool any_hit,
+											   float* t, int* faces, float* bary_u, float* bary_v, vec3* normals)
+{
+	float hit_t = max_t;
+	float hit_u = 0.0f;
+	float hit_v = 0.0f;
+	float hit_sign;
+	vec3 hit_normal;
+	int hit_face = -1;
+
+	if (mesh.bvh.num_nodes != 0)
+	{
+		if (any_hit)
+			mesh_query_ray_any_hit(mesh, starts[i], dirs[i], max_t, hit_t, hit_face);
+		else
+			mesh_query_ray((uint64_t)&mesh, starts[i], dirs[i], max_t, hit_t, hit_u, hit_v, hit_sign, hit_normal, hit_face);
+	}
+
+	if (t) t[i] = hit_t;
+	if (faces) faces[i] = hit_face;
+	if (bary_u) bary_u[i] = hit_u;
+	if (bary_v) bary_v[i] = hit_v;
+	if (normals) normals[i] = hit_normal;
+}
+
 // stores state required to traverse the BVH nodes that 
 // overlap with a query AABB.
 struct mesh_query_aabb_t
@@ -477,8 +951,8 @@ struct mesh_query_aabb_t
 
     // Mesh Id
     Mesh mesh;
-	// BVH traversal stack:
-	int stack[32];
+	// BVH traversal stack, holds wide node entries (see BVHWideNode::children) for wide BVHs
+	int stack[BVH_WIDE_QUERY_STACK_SIZE];
 	int count;
 
     // inputs
@@ -517,6 +991,13 @@ CUDA_CALLABLE inline mesh_query_aabb_t mesh_query_aabb(
     query.input_lower = lower;
     query.input_upper = upper;
 
+	// wide traversal starts from the root in mesh_query_aabb_next()
+	if (mesh.bvh.wide_nodes)
+	{
+		query.stack[0] = 0;
+		return query;
+	}
+
     wp::bounds3 input_bounds(query.input_lower, query.input_upper);
 	
     // Navigate through the bvh, find the first overlapping leaf node.
@@ -563,9 +1044,52 @@ CUDA_CALLABLE inline void adj_mesh_query_aabb(uint64_t id, const vec3& lower, co
 
 }
 
+CUDA_CALLABLE inline bool mesh_query_aabb_next_wide(mesh_query_aabb_t& query, int& index)
+{
+	const wp::bounds3 input_bounds(query.input_lower, query.input_upper);
+
+	while (query.count)
+	{
+		const uint32_t entry = uint32_t(query.stack[--query.count]);
+
+		if (entry & BVH_WIDE_LEAF)
+		{
+			const int f = int(entry & ~BVH_WIDE_LEAF);
+
+			// quantized bounds are conservative, confirm against the exact face bounds
+			if (!input_bounds.overlaps(query.mesh.bounds[f]))
+				continue;
+
+			query.face = f;
+			index = f;
+			return true;
+		}
+
+		const BVHWideNode node = query.mesh.bvh.wide_nodes[entry];
+
+		for (int c=0; c < BVH_WIDE_WIDTH; ++c)
+		{
+			const uint32_t child = node.children[c];
+			if (child == BVH_WIDE_EMPTY)
+				break;
+
+			vec3 lower, upper;
+			bvh_wide_decode(node, c, lower, upper);
+
+			if (input_bounds.overlaps(bounds3(lower, upper)))
+				query.stack[query.count++] = int(child);
+		}
+	}
+
+	return false;
+}
+
 CUDA_CALLABLE inline bool mesh_query_aabb_next(mesh_query_aabb_t& query, int& index)
 {
     Mesh mesh = query.mesh;
+
+	if (mesh.bvh.wide_nodes)
+		return mesh_query_aabb_next_wide(query, index);
 	
 	wp::bounds3 input_bounds(query.input_lower, query.input_upper);
     // Navigate through the bvh, find the first overlapping leaf node.
@@ -682,9 +1206,41 @@ CUDA_CALLABLE inline void adj_mesh_eval_position(uint64_t id, int tri, float v,
 CUDA_CALLABLE inline void adj_mesh_eval_velocity(uint64_t id, int tri, float v, float w,
 												 uint64_t&, int&, float&, float&, const vec3&) {}
 
+// bounds of the BVH root, current as of the last mesh update, the binary
+// nodes are refit even when queries use the wide layout
+CUDA_CALLABLE inline vec3 mesh_bounds_lower(uint64_t id)
+{
+	Mesh mesh = mesh_get(id);
+
+	if (mesh.bvh.num_nodes == 0)
+		return vec3();
+
+	const BVHPackedNodeHalf& l = mesh.bvh.node_lowers[mesh.bvh.root];
+
+	return vec3(l.x, l.y, l.z);
+}
+
+CUDA_CALLABLE inline vec3 mesh_bounds_upper(uint64_t id)
+{
+	Mesh mesh = mesh_get(id);
+
+	if (mesh.bvh.num_nodes == 0)
+		return vec3();
+
+	const BVHPackedNodeHalf& u = mesh.bvh.node_uppers[mesh.bvh.root];
+
+	return vec3(u.x, u.y, u.z);
+}
+
+CUDA_CALLABLE inline void adj_mesh_bounds_lower(uint64_t id, uint64_t& adj_id, const vec3& adj_ret) {}
+CUDA_CALLABLE inline void adj_mesh_bounds_upper(uint64_t id, uint64_t& adj_id, const vec3& adj_ret) {}
+
+
+// host-side descriptors of device meshes, see registry.h
+template <typename T> struct Descriptor;
 
-bool mesh_get_descriptor(uint64_t id, Mesh& mesh);
-void mesh_add_descriptor(uint64_t id, const Mesh& mesh);
+Descriptor<Mesh>* mesh_get_descriptor(uint64_t id);
+Descriptor<Mesh>* mesh_add_descriptor(uint64_t id, const Mesh& mesh);
 void mesh_rem_descriptor(uint64_t id);
 
 
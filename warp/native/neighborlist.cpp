@@ -0,0 +1,329 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include "warp.h"
+#include "neighborlist.h"
+#include "reduce.h"
+#include "registry.h"
+#include "string.h"
+#include "limits.h"
+
+#include <algorithm>
+
+using namespace wp;
+
+namespace
+{
+    // host-side copy of neighbor list descriptors, maps GPU list address (id) to a CPU desc
+    DescriptorRegistry<NeighborList> g_neighbor_list_descriptors;
+
+    // capacity of the indices with 1.5x headroom, limited to the range of the int offsets
+    int neighbor_list_capacity(int64_t num_neighbors)
+    {
+        return int(std::min(num_neighbors*3/2, int64_t(INT_MAX)));
+    }
+
+} // anonymous namespace
+
+
+namespace wp
+{
+
+Descriptor<NeighborList>* neighbor_list_get_descriptor(uint64_t id)
+{
+    return g_neighbor_list_descriptors.find(id);
+}
+
+Descriptor<NeighborList>* neighbor_list_add_descriptor(uint64_t id, const NeighborList& list)
+{
+    return g_neighbor_list_descriptors.insert(id, list);
+}
+
+void neighbor_list_rem_descriptor(uint64_t id)
+{
+    g_neighbor_list_descriptors.erase(id);
+}
+
+// implemented in neighborlist.cu
+void neighbor_list_count_device(const NeighborList& list, uint64_t grid, const wp::vec3* points, int num_points);
+void neighbor_list_fill_device(const NeighborList& list, uint64_t grid, const wp::vec3* points, int num_points);
+void neighbor_list_displacement_device(const NeighborList& list, const wp::vec3* points, int num_points);
+
+} // namespace wp
+
+
+// host methods
+uint64_t neighbor_list_create_host(int max_neighbors)
+{
+    NeighborList* list = new NeighborList();
+    memset(list, 0, sizeof(NeighborList));
+
+    list->max_neighbors = max_neighbors;
+    list->displacement = (int*)alloc_host(sizeof(int));
+
+    return (uint64_t)(list);
+}
+
+void neighbor_list_destroy_host(uint64_t id)
+{
+    NeighborList* list = (NeighborList*)(id);
+
+    free_host(list->offsets);
+    free_host(list->counts);
+    free_host(list->indices);
+    free_host(list->points);
+    free_host(list->displacement);
+
+    delete list;
+}
+
+void neighbor_list_build_host(uint64_t id, uint64_t grid, const wp::vec3* points, int num_points, float radius, float skin)
+{
+    NeighborList* list = (NeighborList*)(id);
+
+    if (num_points > list->max_points || !list->offsets)
+    {
+        free_host(list->offsets);
+        free_host(list->counts);
+        free_host(list->points);
+
+        const int num_to_alloc = num_points*3/2;
+        list->offsets = (int*)alloc_host((num_to_alloc+1)*sizeof(int));
+        list->counts = (int*)alloc_host(num_to_alloc*sizeof(int));
+        list->points = (vec3*)alloc_host(num_to_alloc*sizeof(vec3));
+
+        list->max_points = num_to_alloc;
+    }
+
+    list->num_points = num_points;
+    list->radius = radius;
+    list->skin = skin;
+
+    cpu_launch(num_points, [&](int i)
+    {
+        list->counts[i] = neighbor_list_count_point(*list, grid, points, i);
+    });
+
+    list->offsets[0] = 0;
+    array_scan_host((uint64_t)list->counts, (uint64_t)(list->offsets+1), num_points, REDUCE_INT32, true);
+
+    const int num_neighbors = list->offsets[num_points];
+
+    if (num_neighbors > list->capacity)
+    {
+        free_host(list->indices);
+
+        list->capacity = neighbor_list_capacity(num_neighbors);
+        list->indices = (int*)alloc_host(size_t(list->capacity)*sizeof(int));
+    }
+
+    cpu_launch(num_points, [&](int i)
+    {
+        neighbor_list_fill_point(*list, grid, points, i);
+    });
+
+    memcpy(list->points, points, num_points*sizeof(vec3));
+}
+
+float neighbor_list_max_displacement_host(uint64_t id, const wp::vec3* points, int num_points)
+{
+    const NeighborList* list = (const NeighborList*)(id);
+
+    float d = 0.0f;
+
+    for (int i=0; i < min(num_points, list->num_points); ++i)
+        d = max(d, length_sq(points[i] - list->points[i]));
+
+    return sqrtf(d);
+}
+
+void neighbor_list_get_info_host(uint64_t id, int** offsets, int** counts, int** indices, int* num_points, int* num_neighbors)
+{
+    const NeighborList* list = (const NeighborList*)(id);
+
+    *offsets = list->offsets;
+    *counts = list->counts;
+    *indices = list->indices;
+    *num_points = list->num_points;
+    *num_neighbors = list->num_points ? list->offsets[list->num_points] : 0;
+}
+
+// device methods
+uint64_t neighbor_list_create_device(int max_neighbors)
+{
+    NeighborList list;
+    memset(&list, 0, sizeof(NeighborList));
+
+    list.max_neighbors = max_neighbors;
+    list.displacement = (int*)alloc_device(sizeof(int));
+
+    // upload to device
+    NeighborList* list_device = (NeighborList*)(alloc_device(sizeof(NeighborList)));
+
+    uint64_t list_id = (uint64_t)(list_device);
+    descriptor_upload(list_id, *neighbor_list_add_descriptor(list_id, list));
+
+    return list_id;
+}
+
+void neighbor_list_destroy_device(uint64_t id)
+{
+    Descriptor<NeighborList>* d = neighbor_list_get_descriptor(id);
+    if (d)
+    {
+        const NeighborList& list = d->host;
+
+        free_device(list.offsets);
+        free_device(list.counts);
+        free_device(list.indices);
+        free_device(list.points);
+        free_device(list.displacement);
+
+        free_device((NeighborList*)id);
+
+        neighbor_list_rem_descriptor(id);
+    }
+}
+
+void neighbor_list_build_device(uint64_t id, uint64_t grid, const wp::vec3* points, int num_points, float radius, float skin)
+{
+    Descriptor<NeighborList>* d = neighbor_list_get_descriptor(id);
+
+    if (!d)
+        return;
+
+    NeighborList& list = d->host;
+
+    if (num_points > list.max_points || !list.offsets)
+    {
+        free_device(list.offsets);
+        free_device(list.counts);
+        free_device(list.points);
+
+        const int num_to_alloc = num_points*3/2;
+        list.offsets = (int*)alloc_device((num_to_alloc+1)*sizeof(int));
+        list.counts = (int*)alloc_device(num_to_alloc*sizeof(int));
+        list.points = (vec3*)alloc_device(num_to_alloc*sizeof(vec3));
+
+        list.max_points = num_to_alloc;
+    }
+
+    list.num_points = num_points;
+    list.radius = radius;
+    list.skin = skin;
+
+    wp::neighbor_list_count_device(list, grid, points, num_points);
+
+    memset_device(list.offsets, 0, sizeof(int));
+    array_scan_device((uint64_t)list.counts, (uint64_t)(list.offsets+1), num_points, REDUCE_INT32, true);
+
+    // a limited list never holds more than max_neighbors per point, so it is sized up front and the
+    // build can be captured in a graph, otherwise the total is read back to size the indices, products
+    // are 64-bit since NeighborList.build() only validates that the total fits the int offsets
+    int64_t num_neighbors;
+
+    if (list.max_neighbors > 0)
+    {
+        num_neighbors = int64_t(num_points)*list.max_neighbors;
+    }
+    else
+    {
+        int total = 0;
+        memcpy_d2h(&total, list.offsets+num_points, sizeof(int));
+        cuda_stream_synchronize(cuda_get_stream());
+
+        num_neighbors = total;
+    }
+
+    if (num_neighbors > list.capacity)
+    {
+        free_device(list.indices);
+
+        // limited lists are sized for all points that fit the other arrays so that they are allocated once
+        if (list.max_neighbors > 0)
+            list.capacity = int(std::min(int64_t(list.max_points)*list.max_neighbors, int64_t(INT_MAX)));
+        else
+            list.capacity = neighbor_list_capacity(num_neighbors);
+
+        list.indices = (int*)alloc_device(size_t(list.capacity)*sizeof(int));
+    }
+
+    wp::neighbor_list_fill_device(list, grid, points, num_points);
+
+    memcpy_d2d(list.points, (void*)points, num_points*sizeof(vec3));
+
+    // the upload reads the list's pinned staging copy, which
+    // stays valid for replays of captured graphs
+    descriptor_upload(id, *d);
+}
+
+float neighbor_list_max_displacement_device(uint64_t id, const wp::vec3* points, int num_points)
+{
+    Descriptor<NeighborList>* d = neighbor_list_get_descriptor(id);
+
+    if (!d)
+        return 0.0f;
+
+    const NeighborList& list = d->host;
+
+    memset_device(list.displacement, 0, sizeof(int));
+
+    wp::neighbor_list_displacement_device(list, points, min(num_points, list.num_points));
+
+    float displacement = 0.0f;
+    memcpy_d2h(&displacement, list.displacement, sizeof(float));
+    cuda_stream_synchronize(cuda_get_stream());
+
+    return sqrtf(displacement);
+}
+
+void neighbor_list_get_info_device(uint64_t id, int** offsets, int** counts, int** indices, int* num_points, int* num_neighbors)
+{
+    Descriptor<NeighborList>* d = neighbor_list_get_descriptor(id);
+
+    if (d)
+    {
+        const NeighborList& list = d->host;
+
+        *offsets = list.offsets;
+        *counts = list.counts;
+        *indices = list.indices;
+        *num_points = list.num_points;
+        *num_neighbors = 0;
+
+        if (list.num_points)
+        {
+            memcpy_d2h(num_neighbors, list.offsets+list.num_points, sizeof(int));
+            cuda_stream_synchronize(cuda_get_stream());
+        }
+    }
+}
+
+#if __APPLE__
+
+namespace wp
+{
+
+void neighbor_list_count_device(const NeighborList& list, uint64_t grid, const wp::vec3* points, int num_points)
+{
+
+}
+
+void neighbor_list_fill_device(const NeighborList& list, uint64_t grid, const wp::vec3* points, int num_points)
+{
+
+}
+
+void neighbor_list_displacement_device(const NeighborList& list, const wp::vec3* points, int num_points)
+{
+
+}
+
+} // namespace wp
+
+#endif // __APPLE__
@@ -0,0 +1,59 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include "warp.h"
+#include "neighborlist.h"
+
+namespace wp
+{
+
+__global__ void count_neighbors(NeighborList list, uint64_t grid, const wp::vec3* points, int num_points)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < num_points)
+        list.counts[tid] = neighbor_list_count_point(list, grid, points, tid);
+}
+
+__global__ void fill_neighbors(NeighborList list, uint64_t grid, const wp::vec3* points, int num_points)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < num_points)
+        neighbor_list_fill_point(list, grid, points, tid);
+}
+
+// squared displacements are non-negative so their bits order the same way as the values
+__global__ void compute_max_displacement(NeighborList list, const wp::vec3* points, int num_points)
+{
+    const int tid = blockIdx.x*blockDim.x + threadIdx.x;
+
+    if (tid < num_points)
+    {
+        const float d = length_sq(points[tid] - list.points[tid]);
+
+        atomicMax(list.displacement, __float_as_int(d));
+    }
+}
+
+void neighbor_list_count_device(const NeighborList& list, uint64_t grid, const wp::vec3* points, int num_points)
+{
+    wp_launch_device(wp::count_neighbors, num_points, (list, grid, points, num_points));
+}
+
+void neighbor_list_fill_device(const NeighborList& list, uint64_t grid, const wp::vec3* points, int num_points)
+{
+    wp_launch_device(wp::fill_neighbors, num_points, (list, grid, points, num_points));
+}
+
+void neighbor_list_displacement_device(const NeighborList& list, const wp::vec3* points, int num_points)
+{
+    wp_launch_device(wp::compute_max_displacement, num_points, (list, points, num_points));
+}
+
+} // namespace wp
@@ -0,0 +1,159 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#pragma once
+
+namespace wp
+{
+
+// fixed radius neighbors of a set of points in compressed sparse row format, built from a hash grid
+// so that kernels iterating over the same neighborhood several times pay for the grid traversal once
+struct NeighborList
+{
+    int* offsets;       // start of each point's neighbors in indices, num_points+1 in length
+    int* counts;        // number of neighbors of each point, num_points in length
+    int* indices;       // neighbor indices, capacity in length
+
+    vec3* points;       // positions at the last build, the displacement since then is tested against the skin
+    int* displacement;  // bits of the largest squared displacement found by the last check, a single element
+
+    int num_points;
+    int max_points;
+
+    int capacity;
+    int max_neighbors;  // 0 for unlimited, otherwise only the closest max_neighbors points are kept
+
+    float radius;       // neighbors are all points within radius + skin at the last build
+    float skin;
+};
+
+// squared distance of a neighbor candidate, or a negative value if it is outside of the cutoff
+CUDA_CALLABLE inline float neighbor_list_dist_sq(const vec3* points, int i, int j, float cutoff)
+{
+    if (i == j)
+        return -1.0f;
+
+    const float d = length_sq(points[i] - points[j]);
+
+    return d <= cutoff*cutoff ? d : -1.0f;
+}
+
+// counts the neighbors of point i
+CUDA_CALLABLE inline int neighbor_list_count_point(const NeighborList& list, uint64_t grid, const vec3* points, int i)
+{
+    const float cutoff = list.radius + list.skin;
+
+    hash_grid_query_t query = hash_grid_query(grid, points[i], cutoff);
+    int j = 0;
+    int count = 0;
+
+    while (hash_grid_query_next(query, j))
+    {
+        if (neighbor_list_dist_sq(points, i, j, cutoff) >= 0.0f)
+            count++;
+    }
+
+    if (list.max_neighbors > 0)
+        count = min(count, list.max_neighbors);
+
+    return count;
+}
+
+// writes the neighbors of point i to its range of indices, once a limited range is full
+// a candidate replaces the farthest neighbor found so far if it is closer
+CUDA_CALLABLE inline void neighbor_list_fill_point(const NeighborList& list, uint64_t grid, const vec3* points, int i)
+{
+    const float cutoff = list.radius + list.skin;
+
+    int* neighbors = list.indices + list.offsets[i];
+    const int size = list.counts[i];
+
+    hash_grid_query_t query = hash_grid_query(grid, points[i], cutoff);
+    int j = 0;
+    int count = 0;
+
+    while (hash_grid_query_next(query, j))
+    {
+        const float d = neighbor_list_dist_sq(points, i, j, cutoff);
+
+        if (d < 0.0f)
+            continue;
+
+        if (count < size)
+        {
+            neighbors[count++] = j;
+        }
+        else
+        {
+            int farthest = 0;
+            float farthest_d = -1.0f;
+
+            for (int k=0; k < size; ++k)
+            {
+                const float dk = length_sq(points[i] - points[neighbors[k]]);
+                if (dk > farthest_d)
+                {
+                    farthest = k;
+                    farthest_d = dk;
+                }
+            }
+
+            if (d < farthest_d)
+                neighbors[farthest] = j;
+        }
+    }
+}
+
+// stores state required to iterate over the neighbors of a point
+struct neighbor_list_query_t
+{
+    CUDA_CALLABLE neighbor_list_query_t() {}
+    CUDA_CALLABLE neighbor_list_query_t(int) {} // for backward pass
+
+    const int* indices;
+
+    int index;      // position of the next neighbor in indices
+    int end;        // index following the last neighbor of the point
+};
+
+CUDA_CALLABLE inline neighbor_list_query_t neighbor_list_query(uint64_t id, int point)
+{
+    const NeighborList& list = *(const NeighborList*)(id);
+
+    neighbor_list_query_t query;
+
+    query.indices = list.indices;
+    query.index = list.offsets[point];
+    query.end = query.index + list.counts[point];
+
+    return query;
+}
+
+CUDA_CALLABLE inline bool neighbor_list_query_next(neighbor_list_query_t& query, int& index)
+{
+    if (query.index < query.end)
+    {
+        index = query.indices[query.index];
+        query.index++;
+        return true;
+    }
+
+    return false;
+}
+
+CUDA_CALLABLE inline int neighbor_list_count(uint64_t id, int point)
+{
+    const NeighborList& list = *(const NeighborList*)(id);
+    return list.counts[point];
+}
+
+CUDA_CALLABLE inline void adj_neighbor_list_query(uint64_t id, int point, uint64_t& adj_id, int& adj_point, neighbor_list_query_t& adj_res) {}
+CUDA_CALLABLE inline void adj_neighbor_list_query_next(neighbor_list_query_t& query, int& index, neighbor_list_query_t& adj_query, int& adj_index, bool& adj_res) {}
+CUDA_CALLABLE inline void adj_neighbor_list_count(uint64_t id, int point, uint64_t& adj_id, int& adj_point, int& adj_res) {}
+
+} // namespace wp
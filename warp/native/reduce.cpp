@@ -0,0 +1,314 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include "warp.h"
+#include "reduce.h"
+
+#include <vector>
+
+using namespace wp;
+
+namespace
+{
+
+// arrays are split into chunks of at least this many elements which are processed
+// in parallel by the CPU thread pool, partial results are then combined serially
+const int kMinReduceChunk = 4096;
+
+int reduce_num_chunks(int n)
+{
+    const int max_chunks = cpu_get_num_threads()*4;
+    const int num_chunks = (n + kMinReduceChunk - 1)/kMinReduceChunk;
+
+    return num_chunks < max_chunks ? num_chunks : max_chunks;
+}
+
+inline void chunk_range(int chunk, int num_chunks, int n, int& begin, int& end)
+{
+    begin = int((int64_t(n)*chunk)/num_chunks);
+    end = int((int64_t(n)*(chunk+1))/num_chunks);
+}
+
+// reduces load(i) for i in [begin, end), four independent accumulators
+// break the loop carried dependency so the compiler can vectorize
+template <typename T, typename Op, typename Load>
+T reduce_range(int begin, int end, T init, Op op, Load load)
+{
+    T acc[4] = { init, init, init, init };
+
+    int i = begin;
+    for (; i + 4 <= end; i += 4)
+    {
+        acc[0] = op(acc[0], load(i+0));
+        acc[1] = op(acc[1], load(i+1));
+        acc[2] = op(acc[2], load(i+2));
+        acc[3] = op(acc[3], load(i+3));
+    }
+
+    for (; i < end; ++i)
+        acc[0] = op(acc[0], load(i));
+
+    return op(op(acc[0], acc[1]), op(acc[2], acc[3]));
+}
+
+template <typename T, typename Op, typename Load>
+T reduce_host(int n, T init, Op op, Load load)
+{
+    const int num_chunks = reduce_num_chunks(n);
+
+    std::vector<T> partials(num_chunks, init);
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        chunk_range(chunk, num_chunks, n, begin, end);
+
+        partials[chunk] = reduce_range(begin, end, init, op, load);
+    });
+
+    T result = init;
+    for (int i=0; i < num_chunks; ++i)
+        result = op(result, partials[i]);
+
+    return result;
+}
+
+template <typename T>
+struct LoadValue
+{
+    const T* a;
+    inline T operator()(int i) const { return a[i]; }
+};
+
+template <typename T>
+struct LoadDot
+{
+    const T* a;
+    const T* b;
+    inline typename reduce_traits<T>::scalar operator()(int i) const { return reduce_traits<T>::dot(a[i], b[i]); }
+};
+
+template <typename T>
+void array_sum_host_impl(const T* a, T* out, int n)
+{
+    LoadValue<T> load = { a };
+    *out = reduce_host(n, reduce_traits<T>::zero(), ReduceAdd(), load);
+}
+
+template <typename T>
+void array_inner_host_impl(const T* a, const T* b, typename reduce_traits<T>::scalar* out, int n)
+{
+    typedef typename reduce_traits<T>::scalar S;
+
+    LoadDot<T> load = { a, b };
+    *out = reduce_host(n, reduce_traits<S>::zero(), ReduceAdd(), load);
+}
+
+template <typename T>
+void array_min_host_impl(const T* a, T* out, int n)
+{
+    LoadValue<T> load = { a };
+    *out = reduce_host(n, reduce_traits<T>::highest(), ReduceMin(), load);
+}
+
+template <typename T>
+void array_max_host_impl(const T* a, T* out, int n)
+{
+    LoadValue<T> load = { a };
+    *out = reduce_host(n, reduce_traits<T>::lowest(), ReduceMax(), load);
+}
+
+// returns the index of the first element that compares best
+template <typename T, typename Less>
+void array_arg_host_impl(const T* a, int* out, int n, Less less)
+{
+    const int num_chunks = reduce_num_chunks(n);
+
+    std::vector<int> partials(num_chunks, -1);
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        chunk_range(chunk, num_chunks, n, begin, end);
+
+        int best = begin;
+        for (int i=begin+1; i < end; ++i)
+        {
+            if (less(a[i], a[best]))
+                best = i;
+        }
+
+        partials[chunk] = best;
+    });
+
+    // chunks are in order so ties resolve to the lowest index
+    int best = partials[0];
+    for (int i=1; i < num_chunks; ++i)
+    {
+        if (less(a[partials[i]], a[best]))
+            best = partials[i];
+    }
+
+    *out = best;
+}
+
+struct ArgLess
+{
+    template <typename T> inline bool operator()(const T& a, const T& b) const { return a < b; }
+};
+
+struct ArgGreater
+{
+    template <typename T> inline bool operator()(const T& a, const T& b) const { return a > b; }
+};
+
+// two pass scan, chunk totals are scanned serially and used to offset each chunk, in-place is supported
+template <typename T>
+void array_scan_host_impl(const T* in, T* out, int n, bool inclusive)
+{
+    const int num_chunks = reduce_num_chunks(n);
+
+    std::vector<T> offsets(num_chunks, reduce_traits<T>::zero());
+
+    LoadValue<T> load = { in };
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        chunk_range(chunk, num_chunks, n, begin, end);
+
+        offsets[chunk] = reduce_range(begin, end, reduce_traits<T>::zero(), ReduceAdd(), load);
+    });
+
+    T total = reduce_traits<T>::zero();
+    for (int i=0; i < num_chunks; ++i)
+    {
+        T chunk_sum = offsets[i];
+        offsets[i] = total;
+        total = total + chunk_sum;
+    }
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        chunk_range(chunk, num_chunks, n, begin, end);
+
+        T acc = offsets[chunk];
+
+        if (inclusive)
+        {
+            for (int i=begin; i < end; ++i)
+            {
+                acc = acc + in[i];
+                out[i] = acc;
+            }
+        }
+        else
+        {
+            for (int i=begin; i < end; ++i)
+            {
+                const T x = in[i];
+                out[i] = acc;
+                acc = acc + x;
+            }
+        }
+    });
+}
+
+} // anonymous namespace
+
+
+void array_sum_host(uint64_t a, uint64_t out, int len, int type)
+{
+    switch (type)
+    {
+        case REDUCE_INT32: array_sum_host_impl((const int*)a, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_sum_host_impl((const float*)a, (float*)out, len); break;
+        case REDUCE_VEC3: array_sum_host_impl((const vec3*)a, (vec3*)out, len); break;
+        default: printf("Warp: array_sum() unsupported type %d\n", type);
+    }
+}
+
+void array_inner_host(uint64_t a, uint64_t b, uint64_t out, int len, int type)
+{
+    switch (type)
+    {
+        case REDUCE_INT32: array_inner_host_impl((const int*)a, (const int*)b, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_inner_host_impl((const float*)a, (const float*)b, (float*)out, len); break;
+        case REDUCE_VEC3: array_inner_host_impl((const vec3*)a, (const vec3*)b, (float*)out, len); break;
+        default: printf("Warp: array_inner() unsupported type %d\n", type);
+    }
+}
+
+void array_min_host(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_min_host_impl((const int*)a, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_min_host_impl((const float*)a, (float*)out, len); break;
+        case REDUCE_VEC3: array_min_host_impl((const vec3*)a, (vec3*)out, len); break;
+        default: printf("Warp: array_min() unsupported type %d\n", type);
+    }
+}
+
+void array_max_host(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_max_host_impl((const int*)a, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_max_host_impl((const float*)a, (float*)out, len); break;
+        case REDUCE_VEC3: array_max_host_impl((const vec3*)a, (vec3*)out, len); break;
+        default: printf("Warp: array_max() unsupported type %d\n", type);
+    }
+}
+
+void array_argmin_host(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_arg_host_impl((const int*)a, (int*)out, len, ArgLess()); break;
+        case REDUCE_FLOAT32: array_arg_host_impl((const float*)a, (int*)out, len, ArgLess()); break;
+        default: printf("Warp: array_argmin() unsupported type %d\n", type);
+    }
+}
+
+void array_argmax_host(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_arg_host_impl((const int*)a, (int*)out, len, ArgGreater()); break;
+        case REDUCE_FLOAT32: array_arg_host_impl((const float*)a, (int*)out, len, ArgGreater()); break;
+        default: printf("Warp: array_argmax() unsupported type %d\n", type);
+    }
+}
+
+void array_scan_host(uint64_t in, uint64_t out, int len, int type, bool inclusive)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_scan_host_impl((const int*)in, (int*)out, len, inclusive); break;
+        case REDUCE_FLOAT32: array_scan_host_impl((const float*)in, (float*)out, len, inclusive); break;
+        case REDUCE_VEC3: array_scan_host_impl((const vec3*)in, (vec3*)out, len, inclusive); break;
+        default: printf("Warp: array_scan() unsupported type %d\n", type);
+    }
+}
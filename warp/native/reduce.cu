@@ -0,0 +1,235 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#include "warp.h"
+#include "reduce.h"
+
+#define THRUST_IGNORE_CUB_VERSION_CHECK
+
+#include <cub/cub.cuh>
+
+using namespace wp;
+
+namespace
+{
+
+template <typename T>
+struct DotOp
+{
+    const T* a;
+    const T* b;
+
+    __device__ inline typename reduce_traits<T>::scalar operator()(int i) const { return reduce_traits<T>::dot(a[i], b[i]); }
+};
+
+template <typename T>
+__global__ void write_arg_index(const cub::KeyValuePair<int, T>* pair, int* out)
+{
+    *out = pair->key;
+}
+
+// all temporary storage is allocated stream-ordered on the runtime stream
+template <typename T, typename InputIt, typename Op>
+void reduce_device(InputIt in, T* out, int n, Op op, T init)
+{
+    cudaStream_t stream = (cudaStream_t)cuda_get_stream();
+
+    size_t temp_size = 0;
+    check_cuda(cub::DeviceReduce::Reduce(NULL, temp_size, in, out, n, op, init, stream));
+
+    void* temp = alloc_device(temp_size);
+    check_cuda(cub::DeviceReduce::Reduce(temp, temp_size, in, out, n, op, init, stream));
+    free_device(temp);
+}
+
+template <typename T>
+void array_sum_device_impl(const T* a, T* out, int n)
+{
+    reduce_device(a, out, n, ReduceAdd(), reduce_traits<T>::zero());
+}
+
+template <typename T>
+void array_inner_device_impl(const T* a, const T* b, typename reduce_traits<T>::scalar* out, int n)
+{
+    typedef typename reduce_traits<T>::scalar S;
+
+    DotOp<T> op = { a, b };
+    cub::TransformInputIterator<S, DotOp<T>, cub::CountingInputIterator<int> > iter(cub::CountingInputIterator<int>(0), op);
+
+    reduce_device(iter, out, n, ReduceAdd(), reduce_traits<S>::zero());
+}
+
+template <typename T>
+void array_min_device_impl(const T* a, T* out, int n)
+{
+    reduce_device(a, out, n, ReduceMin(), reduce_traits<T>::highest());
+}
+
+template <typename T>
+void array_max_device_impl(const T* a, T* out, int n)
+{
+    reduce_device(a, out, n, ReduceMax(), reduce_traits<T>::lowest());
+}
+
+template <typename T>
+void array_arg_device_impl(const T* a, int* out, int n, bool find_max)
+{
+    cudaStream_t stream = (cudaStream_t)cuda_get_stream();
+
+    typedef cub::KeyValuePair<int, T> Pair;
+    Pair* pair = (Pair*)alloc_device(sizeof(Pair));
+
+    size_t temp_size = 0;
+    if (find_max)
+    {
+        check_cuda(cub::DeviceReduce::ArgMax(NULL, temp_size, a, pair, n, stream));
+    }
+    else
+    {
+        check_cuda(cub::DeviceReduce::ArgMin(NULL, temp_size, a, pair, n, stream));
+    }
+
+    void* temp = alloc_device(temp_size);
+
+    if (find_max)
+    {
+        check_cuda(cub::DeviceReduce::ArgMax(temp, temp_size, a, pair, n, stream));
+    }
+    else
+    {
+        check_cuda(cub::DeviceReduce::ArgMin(temp, temp_size, a, pair, n, stream));
+    }
+
+    // keep only the index
+    write_arg_index<<<1, 1, 0, stream>>>(pair, out);
+
+    free_device(temp);
+    free_device(pair);
+}
+
+template <typename T>
+void array_scan_device_impl(const T* in, T* out, int n, bool inclusive)
+{
+    cudaStream_t stream = (cudaStream_t)cuda_get_stream();
+
+    size_t temp_size = 0;
+    if (inclusive)
+    {
+        check_cuda(cub::DeviceScan::InclusiveScan(NULL, temp_size, in, out, ReduceAdd(), n, stream));
+    }
+    else
+    {
+        check_cuda(cub::DeviceScan::ExclusiveScan(NULL, temp_size, in, out, ReduceAdd(), reduce_traits<T>::zero(), n, stream));
+    }
+
+    void* temp = alloc_device(temp_size);
+
+    if (inclusive)
+    {
+        check_cuda(cub::DeviceScan::InclusiveScan(temp, temp_size, in, out, ReduceAdd(), n, stream));
+    }
+    else
+    {
+        check_cuda(cub::DeviceScan::ExclusiveScan(temp, temp_size, in, out, ReduceAdd(), reduce_traits<T>::zero(), n, stream));
+    }
+
+    free_device(temp);
+}
+
+} // anonymous namespace
+
+
+void array_sum_device(uint64_t a, uint64_t out, int len, int type)
+{
+    switch (type)
+    {
+        case REDUCE_INT32: array_sum_device_impl((const int*)a, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_sum_device_impl((const float*)a, (float*)out, len); break;
+        case REDUCE_VEC3: array_sum_device_impl((const vec3*)a, (vec3*)out, len); break;
+        default: printf("Warp: array_sum() unsupported type %d\n", type);
+    }
+}
+
+void array_inner_device(uint64_t a, uint64_t b, uint64_t out, int len, int type)
+{
+    switch (type)
+    {
+        case REDUCE_INT32: array_inner_device_impl((const int*)a, (const int*)b, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_inner_device_impl((const float*)a, (const float*)b, (float*)out, len); break;
+        case REDUCE_VEC3: array_inner_device_impl((const vec3*)a, (const vec3*)b, (float*)out, len); break;
+        default: printf("Warp: array_inner() unsupported type %d\n", type);
+    }
+}
+
+void array_min_device(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_min_device_impl((const int*)a, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_min_device_impl((const float*)a, (float*)out, len); break;
+        case REDUCE_VEC3: array_min_device_impl((const vec3*)a, (vec3*)out, len); break;
+        default: printf("Warp: array_min() unsupported type %d\n", type);
+    }
+}
+
+void array_max_device(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_max_device_impl((const int*)a, (int*)out, len); break;
+        case REDUCE_FLOAT32: array_max_device_impl((const float*)a, (float*)out, len); break;
+        case REDUCE_VEC3: array_max_device_impl((const vec3*)a, (vec3*)out, len); break;
+        default: printf("Warp: array_max() unsupported type %d\n", type);
+    }
+}
+
+void array_argmin_device(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_arg_device_impl((const int*)a, (int*)out, len, false); break;
+        case REDUCE_FLOAT32: array_arg_device_impl((const float*)a, (int*)out, len, false); break;
+        default: printf("Warp: array_argmin() unsupported type %d\n", type);
+    }
+}
+
+void array_argmax_device(uint64_t a, uint64_t out, int len, int type)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_arg_device_impl((const int*)a, (int*)out, len, true); break;
+        case REDUCE_FLOAT32: array_arg_device_impl((const float*)a, (int*)out, len, true); break;
+        default: printf("Warp: array_argmax() unsupported type %d\n", type);
+    }
+}
+
+void array_scan_device(uint64_t in, uint64_t out, int len, int type, bool inclusive)
+{
+    if (len == 0)
+        return;
+
+    switch (type)
+    {
+        case REDUCE_INT32: array_scan_device_impl((const int*)in, (int*)out, len, inclusive); break;
+        case REDUCE_FLOAT32: array_scan_device_impl((const float*)in, (float*)out, len, inclusive); break;
+        case REDUCE_VEC3: array_scan_device_impl((const vec3*)in, (vec3*)out, len, inclusive); break;
+        default: printf("Warp: array_scan() unsupported type %d\n", type);
+    }
+}
@@ -0,0 +1,75 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#pragma once
+
+#include "builtin.h"
+
+namespace wp
+{
+
+// element types supported by the array reductions, must match warp/context.py
+enum ReduceType
+{
+    REDUCE_INT32 = 0,
+    REDUCE_FLOAT32 = 1,
+    REDUCE_VEC3 = 2
+};
+
+template <typename T> struct reduce_traits;
+
+template <> struct reduce_traits<int>
+{
+    typedef int scalar;
+
+    static CUDA_CALLABLE inline int zero() { return 0; }
+    static CUDA_CALLABLE inline int highest() { return INT32_MAX; }
+    static CUDA_CALLABLE inline int lowest() { return INT32_MIN; }
+    static CUDA_CALLABLE inline int dot(int a, int b) { return a*b; }
+};
+
+template <> struct reduce_traits<float>
+{
+    typedef float scalar;
+
+    static CUDA_CALLABLE inline float zero() { return 0.0f; }
+    static CUDA_CALLABLE inline float highest() { return FLT_MAX; }
+    static CUDA_CALLABLE inline float lowest() { return -FLT_MAX; }
+    static CUDA_CALLABLE inline float dot(float a, float b) { return a*b; }
+};
+
+template <> struct reduce_traits<vec3>
+{
+    typedef float scalar;
+
+    static CUDA_CALLABLE inline vec3 zero() { return vec3(0.0f); }
+    static CUDA_CALLABLE inline vec3 highest() { return vec3(FLT_MAX); }
+    static CUDA_CALLABLE inline vec3 lowest() { return vec3(-FLT_MAX); }
+    static CUDA_CALLABLE inline float dot(vec3 a, vec3 b) { return wp::dot(a, b); }
+};
+
+// binary operators shared by the host and device implementations, min/max are component-wise for vectors
+struct ReduceAdd
+{
+    template <typename T>
+    CUDA_CALLABLE inline T operator()(const T& a, const T& b) const { return a + b; }
+};
+
+struct ReduceMin
+{
+    template <typename T>
+    CUDA_CALLABLE inline T operator()(const T& a, const T& b) const { return min(a, b); }
+};
+
+struct ReduceMax
+{
+    template <typename T>
+    CUDA_CALLABLE inline T operator()(const T& a, const T& b) const { return max(a, b); }
+};
+
+} // namespace wp
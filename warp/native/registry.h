@@ -0,0 +1,269 @@
+/** Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+ * NVIDIA CORPORATION and its licensors retain all intellectual property
+ * and proprietary rights in and to this software, related documentation
+ * and any modifications thereto.  Any use, reproduction, disclosure or
+ * distribution of this software and related documentation without an express
+ * license agreement from NVIDIA CORPORATION is strictly prohibited.
+ */
+
+#pragma once
+
+#include "warp.h"
+
+#include <string.h>
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+namespace wp
+{
+
+// host-side state of a device object, the device copy of the descriptor lives at the object's id
+template <typename T>
+struct Descriptor
+{
+    // only modified by calls on the object itself
+    T host;
+
+    // pinned source of descriptor uploads, captured graphs read it when they are replayed
+    T* staging;
+
+    // recorded after the last upload from staging
+    void* event;
+};
+
+// Maps the ids of device objects to their host-side descriptors
+//
+// Ids are the device addresses kernels read the descriptors from, they are kept in an open addressing
+// table so that lookups take constant time and never lock. Readers probe the current table while
+// create and destroy, which are rare, serialize on a mutex. Tables replaced by a resize are retired
+// rather than freed since readers may still be probing them. Calls on different objects may be
+// issued from different threads, calls on the same object must not overlap its destruction.
+template <typename T>
+class DescriptorRegistry
+{
+public:
+
+    DescriptorRegistry() : m_table(NULL), m_used(0), m_live(0) {}
+
+    ~DescriptorRegistry()
+    {
+        for (size_t i=0; i < m_tables.size(); ++i)
+            delete m_tables[i];
+    }
+
+    // returns the descriptor of id, or NULL if id was not created by this registry
+    Descriptor<T>* find(uint64_t id) const
+    {
+        const Table* table = m_table.load(std::memory_order_acquire);
+        if (!table || !id)
+            return NULL;
+
+        for (size_t i=hash(id)&table->mask; ; i=(i+1)&table->mask)
+        {
+            const uint64_t key = table->slots[i].key.load(std::memory_order_acquire);
+
+            if (key == id)
+                return table->slots[i].value.load(std::memory_order_relaxed);
+
+            if (key == kEmpty)
+                return NULL;
+        }
+    }
+
+    Descriptor<T>* insert(uint64_t id, const T& desc)
+    {
+        Descriptor<T>* d = new Descriptor<T>();
+        d->host = desc;
+        d->staging = NULL;
+        d->event = NULL;
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // keep the table at most half full, tombstones count since they lengthen probes
+        if (!m_table.load(std::memory_order_relaxed) || (m_used+1)*2 > m_table.load(std::memory_order_relaxed)->slots.size())
+            resize();
+
+        Table* table = m_table.load(std::memory_order_relaxed);
+
+        for (size_t i=hash(id)&table->mask; ; i=(i+1)&table->mask)
+        {
+            Slot& slot = table->slots[i];
+            const uint64_t key = slot.key.load(std::memory_order_relaxed);
+
+            if (key == kEmpty || key == kTombstone)
+            {
+                // the value is published before the key so readers that match the key see it
+                slot.value.store(d, std::memory_order_relaxed);
+                slot.key.store(id, std::memory_order_release);
+
+                if (key == kEmpty)
+                    m_used++;
+
+                m_live++;
+                break;
+            }
+        }
+
+        return d;
+    }
+
+    // removes id and frees its descriptor, waits for pending uploads from its staging copy
+    void erase(uint64_t id)
+    {
+        Descriptor<T>* d = NULL;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            Table* table = m_table.load(std::memory_order_relaxed);
+            if (!table)
+                return;
+
+            for (size_t i=hash(id)&table->mask; ; i=(i+1)&table->mask)
+            {
+                Slot& slot = table->slots[i];
+                const uint64_t key = slot.key.load(std::memory_order_relaxed);
+
+                if (key == id)
+                {
+                    d = slot.value.load(std::memory_order_relaxed);
+                    slot.key.store(kTombstone, std::memory_order_release);
+
+                    m_live--;
+                    break;
+                }
+
+                if (key == kEmpty)
+                    return;
+            }
+        }
+
+        if (d->event)
+        {
+            cuda_event_synchronize(d->event);
+            cuda_event_destroy(d->event);
+        }
+
+        if (d->staging)
+            free_pinned(d->staging);
+
+        delete d;
+    }
+
+private:
+
+    // device addresses are never 0 or ~0
+    static const uint64_t kEmpty = 0;
+    static const uint64_t kTombstone = ~uint64_t(0);
+
+    static const size_t kMinSlots = 64;
+
+    struct Slot
+    {
+        std::atomic<uint64_t> key;
+        std::atomic<Descriptor<T>*> value;
+    };
+
+    struct Table
+    {
+        Table(size_t n) : slots(n), mask(n-1)
+        {
+            for (size_t i=0; i < n; ++i)
+            {
+                slots[i].key.store(kEmpty, std::memory_order_relaxed);
+                slots[i].value.store(NULL, std::memory_order_relaxed);
+            }
+        }
+
+        std::vector<Slot> slots;
+        size_t mask;
+    };
+
+    // ids are aligned allocations, the low bits carry no information so all bits are mixed
+    static size_t hash(uint64_t id)
+    {
+        id ^= id >> 33;
+        id *= 0xff51afd7ed558ccdull;
+        id ^= id >> 33;
+        id *= 0xc4ceb9fe1a85ec53ull;
+        id ^= id >> 33;
+
+        return size_t(id);
+    }
+
+    // rehashes the live entries into a table with room for as many again, called with the mutex held
+    void resize()
+    {
+        size_t n = kMinSlots;
+        while (n < (m_live+1)*4)
+            n *= 2;
+
+        Table* table = new Table(n);
+        Table* old = m_table.load(std::memory_order_relaxed);
+
+        if (old)
+        {
+            for (size_t i=0; i < old->slots.size(); ++i)
+            {
+                const uint64_t key = old->slots[i].key.load(std::memory_order_relaxed);
+
+                if (key == kEmpty || key == kTombstone)
+                    continue;
+
+                size_t j = hash(key)&table->mask;
+                while (table->slots[j].key.load(std::memory_order_relaxed) != kEmpty)
+                    j = (j+1)&table->mask;
+
+                table->slots[j].value.store(old->slots[i].value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+                table->slots[j].key.store(key, std::memory_order_relaxed);
+            }
+        }
+
+        m_tables.push_back(table);
+        m_table.store(table, std::memory_order_release);
+
+        m_used = m_live;
+    }
+
+    std::atomic<Table*> m_table;
+    std::vector<Table*> m_tables;
+    std::mutex m_mutex;
+
+    size_t m_used;
+    size_t m_live;
+};
+
+
+// copies the host descriptor to the device copy at id on the current stream
+//
+// Uploads go through a pinned copy owned by the descriptor, so they are asynchronous
+// and remain valid inside captured graphs. The previous upload must have read the
+// staging copy before it is overwritten, which by the time the next update is issued
+// it almost always has. Events are only recorded outside of capture, so the event
+// waited on here never belongs to a graph.
+template <typename T>
+void descriptor_upload(uint64_t id, Descriptor<T>& d)
+{
+    const bool capturing = cuda_is_capturing();
+
+    if (!d.staging)
+        d.staging = (T*)alloc_pinned(sizeof(T));
+
+    if (d.event)
+        cuda_event_synchronize(d.event);
+
+    ::memcpy(d.staging, &d.host, sizeof(T));
+    memcpy_h2d((T*)id, d.staging, sizeof(T));
+
+    if (!capturing)
+    {
+        if (!d.event)
+            d.event = cuda_event_create(false);
+
+        cuda_event_record(d.event, cuda_get_stream());
+    }
+}
+
+} // namespace wp
@@ -6,76 +6,192 @@
  * license agreement from NVIDIA CORPORATION is strictly prohibited.
  */
 
+#include "warp.h"
 #include "sort.h"
 #include "string.h"
 
+#include <vector>
+
+namespace
+{
+
+// 8-bit digits keep each thread's histogram and scatter targets (256 write streams) resident in L1
+const int kRadixBits = 8;
+const int kRadixSize = 1 << kRadixBits;
+const int kRadixMask = kRadixSize - 1;
+
+// smallest number of elements assigned to a thread
+const int kMinSortChunk = 16*1024;
+
+// maps keys to unsigned integers with the same ordering
+inline uint32_t radix_key(int k) { return uint32_t(k) ^ 0x80000000u; }
+inline uint64_t radix_key(int64_t k) { return uint64_t(k) ^ 0x8000000000000000ull; }
+
+inline uint32_t radix_key(float k)
+{
+    uint32_t u;
+    memcpy(&u, &k, sizeof(u));
+
+    // negative floats order in reverse, so flip all bits, otherwise just the sign
+    return (u & 0x80000000u) ? ~u : (u | 0x80000000u);
+}
+
+inline int sort_num_chunks(int n)
+{
+    const int max_chunks = cpu_get_num_threads();
+    const int num_chunks = (n + kMinSortChunk - 1)/kMinSortChunk;
+
+    return num_chunks < max_chunks ? (num_chunks > 0 ? num_chunks : 1) : max_chunks;
+}
+
+inline void sort_chunk_range(int chunk, int num_chunks, int n, int& begin, int& end)
+{
+    begin = int((int64_t(n)*chunk)/num_chunks);
+    end = int((int64_t(n)*(chunk+1))/num_chunks);
+}
+
+// stable LSD radix sort, each pass builds per-chunk histograms in parallel
+// and then scatters each chunk to its own offsets within every bucket
+template <typename K>
+void radix_sort_pairs_host_impl(K* keys, int* values, int n)
+{
+    const int num_passes = int(sizeof(K)*8)/kRadixBits;
+    const int num_chunks = sort_num_chunks(n);
+
+    // total digit counts for every pass, used to skip passes where all keys share a digit
+    std::vector<int> totals(num_passes*kRadixSize, 0);
+    std::vector<int> counts(num_chunks*num_passes*kRadixSize, 0);
+
+    cpu_launch(num_chunks, [&](int chunk)
+    {
+        int begin, end;
+        sort_chunk_range(chunk, num_chunks, n, begin, end);
+
+        int* c = &counts[chunk*num_passes*kRadixSize];
+
+        for (int i=begin; i < end; ++i)
+        {
+            const auto k = radix_key(keys[i]);
+
+            for (int p=0; p < num_passes; ++p)
+                ++c[p*kRadixSize + ((k >> (p*kRadixBits)) & kRadixMask)];
+        }
+    });
+
+    for (int chunk=0; chunk < num_chunks; ++chunk)
+        for (int i=0; i < num_passes*kRadixSize; ++i)
+            totals[i] += counts[chunk*num_passes*kRadixSize + i];
+
+    // second half of the key and value buffers is used as auxiliary storage
+    K* src_keys = keys;
+    K* dst_keys = keys + n;
+    int* src_values = values;
+    int* dst_values = values + n;
+
+    std::vector<int> offsets(num_chunks*kRadixSize);
+
+    for (int p=0; p < num_passes; ++p)
+    {
+        const int* total = &totals[p*kRadixSize];
+
+        bool constant = false;
+        for (int b=0; b < kRadixSize; ++b)
+            constant |= (total[b] == n);
+
+        if (constant)
+            continue;
+
+        const int shift = p*kRadixBits;
+
+        // chunk contents change after each executed pass so their histograms are rebuilt
+        cpu_launch(num_chunks, [&](int chunk)
+        {
+            int begin, end;
+            sort_chunk_range(chunk, num_chunks, n, begin, end);
+
+            int* c = &offsets[chunk*kRadixSize];
+            memset(c, 0, sizeof(int)*kRadixSize);
+
+            for (int i=begin; i < end; ++i)
+                ++c[(radix_key(src_keys[i]) >> shift) & kRadixMask];
+        });
+
+        // exclusive scan in bucket-major, chunk-minor order keeps the sort stable
+        int sum = 0;
+        for (int b=0; b < kRadixSize; ++b)
+        {
+            for (int chunk=0; chunk < num_chunks; ++chunk)
+            {
+                const int c = offsets[chunk*kRadixSize + b];
+                offsets[chunk*kRadixSize + b] = sum;
+                sum += c;
+            }
+        }
+
+        cpu_launch(num_chunks, [&](int chunk)
+        {
+            int begin, end;
+            sort_chunk_range(chunk, num_chunks, n, begin, end);
+
+            int* o = &offsets[chunk*kRadixSize];
+
+            for (int i=begin; i < end; ++i)
+            {
+                const K k = src_keys[i];
+                const int offset = o[(radix_key(k) >> shift) & kRadixMask]++;
+
+                dst_keys[offset] = k;
+                dst_values[offset] = src_values[i];
+            }
+        });
+
+        std::swap(src_keys, dst_keys);
+        std::swap(src_values, dst_values);
+    }
+
+    // odd number of executed passes leaves the result in the auxiliary buffers
+    if (src_keys != keys)
+    {
+        memcpy(keys, src_keys, sizeof(K)*n);
+        memcpy(values, src_values, sizeof(int)*n);
+    }
+}
+
+} // anonymous namespace
+
+
 void radix_sort_pairs_host(int* keys, int* values, int n)
 {
-	static int tables[2][1 << 16];
-	memset(tables, 0, sizeof(tables));
-		
-	int* auxKeys = keys + n;
-	int* auxValues = values + n;
-
-	// build histograms
-	for (int i=0; i < n; ++i)
-	{
-		const unsigned short low = keys[i] & 0xffff;
-		const unsigned short high = keys[i] >> 16;
-		
-		++tables[0][low];
-		++tables[1][high];
-	}
-	
-	// convert histograms to offset tables in-place
-	int offlow = 0;
-	int offhigh = 0;
-	
-	for (int i=0; i < 65536; ++i)
-	{
-		const int newofflow = offlow + tables[0][i];
-		const int newoffhigh = offhigh + tables[1][i];
-		
-		tables[0][i] = offlow;
-		tables[1][i] = offhigh;
-		
-		offlow = newofflow;
-		offhigh = newoffhigh;
-	}
-		
-	// pass 1 - sort by low 16 bits
-	for (int i=0; i < n; ++i)
-	{
-		// lookup offset of input
-		const int k = keys[i];
-		const int v = values[i];
-		const int b = k & 0xffff;
-		
-		// find offset and increment
-		const int offset = tables[0][b]++;
-		
-		auxKeys[offset] = k;
-		auxValues[offset] = v;
-	}	
-		
-	// pass 2 - sort by high 16 bits
-	for (int i=0; i < n; ++i)
-	{
-		// lookup offset of input
-		const int k = auxKeys[i];
-		const int v = auxValues[i];
-
-		const int b = k >> 16;
-		
-		const int offset = tables[1][b]++;
-		
-		keys[offset] = k;
-		values[offset] = v;
-	}	
+    radix_sort_pairs_host_impl(keys, values, n);
+}
+
+void radix_sort_pairs_host(int64_t* keys, int* values, int n)
+{
+    radix_sort_pairs_host_impl(keys, values, n);
+}
+
+void radix_sort_pairs_host(float* keys, int* values, int n)
+{
+    radix_sort_pairs_host_impl(keys, values, n);
+}
+
+void sort_pairs_host(uint64_t keys, uint64_t values, int n, int key_type)
+{
+    if (n <= 1)
+        return;
+
+    switch (key_type)
+    {
+        case SORT_INT32: radix_sort_pairs_host((int*)keys, (int*)values, n); break;
+        case SORT_FLOAT32: radix_sort_pairs_host((float*)keys, (int*)values, n); break;
+        case SORT_INT64: radix_sort_pairs_host((int64_t*)keys, (int*)values, n); break;
+        default: printf("Warp: sort_pairs() unsupported key type %d\n", key_type);
+    }
 }
 
 #if __APPLE__
 
 void radix_sort_reserve(int n) {}
+void radix_sort_release(void* stream) {}
 
-#endif // __APPLE_
+#endif // __APPLE__
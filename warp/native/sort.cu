@@ -13,45 +13,115 @@
 
 #include <cub/cub.cuh>
 
-static void* radix_sort_temp_memory = NULL;
-static size_t radix_sort_temp_max_size = 0;
+#include <map>
 
-void radix_sort_reserve(int n)
+struct RadixSortTemp
 {
-    cub::DoubleBuffer<int> d_keys((int*)0, (int*)n);
-	cub::DoubleBuffer<int> d_values((int*)0, (int*)n);
+    void* mem = NULL;
+    size_t size = 0;
+};
+
+// temporary memory is kept per stream so that sorts issued
+// on different streams can run concurrently
+static std::map<void*, RadixSortTemp> g_radix_sort_temp;
+
+// grows the current stream's temporary memory to fit a sort of n keys of type K
+template <typename K>
+const RadixSortTemp& radix_sort_reserve_impl(int n)
+{
+    cub::DoubleBuffer<K> d_keys((K*)0, (K*)0);
+	cub::DoubleBuffer<int> d_values((int*)0, (int*)0);
 
     // compute temporary memory required
 	size_t sort_temp_size;
-	cub::DeviceRadixSort::SortPairs(NULL, sort_temp_size, d_keys, d_values, int(n), 0, 32, (cudaStream_t)cuda_get_stream());
+	cub::DeviceRadixSort::SortPairs(NULL, sort_temp_size, d_keys, d_values, int(n), 0, int(sizeof(K)*8), (cudaStream_t)cuda_get_stream());
+
+    RadixSortTemp& temp = g_radix_sort_temp[cuda_get_stream()];
 
-    if (sort_temp_size > radix_sort_temp_max_size)
+    // the memory is only used by work on its own stream, which is current here,
+    // so the stream-ordered free cannot overlap a sort still in flight
+    if (sort_temp_size > temp.size)
     {
-	    free_device(radix_sort_temp_memory);
-        radix_sort_temp_memory = alloc_device(sort_temp_size);
-        radix_sort_temp_max_size = sort_temp_size;
+	    free_device(temp.mem);
+        temp.mem = alloc_device(sort_temp_size);
+        temp.size = sort_temp_size;
     }
+
+    return temp;
 }
 
-void radix_sort_pairs_device(int* keys, int* values, int n)
+void radix_sort_reserve(int n)
 {
-    cub::DoubleBuffer<int> d_keys(keys, keys + n);
+    radix_sort_reserve_impl<int>(n);
+}
+
+void radix_sort_release(void* stream)
+{
+    std::map<void*, RadixSortTemp>::iterator iter = g_radix_sort_temp.find(stream);
+
+    if (iter != g_radix_sort_temp.end())
+    {
+        // free in order with the stream's work rather than on the current stream
+        void* current = cuda_get_stream();
+        cuda_set_stream(stream);
+
+        free_device(iter->second.mem);
+
+        cuda_set_stream(current == stream ? NULL : current);
+
+        g_radix_sort_temp.erase(iter);
+    }
+}
+
+template <typename K>
+void radix_sort_pairs_device_impl(K* keys, int* values, int n)
+{
+    cub::DoubleBuffer<K> d_keys(keys, keys + n);
 	cub::DoubleBuffer<int> d_values(values, values + n);
 
-    radix_sort_reserve(n);
+    const RadixSortTemp& temp = radix_sort_reserve_impl<K>(n);
 
-    // sort
+    // sort, cub handles the ordering of signed and floating point keys
     cub::DeviceRadixSort::SortPairs(
-        radix_sort_temp_memory, 
-        radix_sort_temp_max_size, 
+        temp.mem, 
+        temp.size, 
         d_keys, 
         d_values, 
-        n, 0, 32, 
+        n, 0, int(sizeof(K)*8), 
         (cudaStream_t)cuda_get_stream());
 
 	if (d_keys.Current() != keys)
-		memcpy_d2d(keys, d_keys.Current(), sizeof(int)*n);
+		memcpy_d2d(keys, d_keys.Current(), sizeof(K)*n);
 
 	if (d_values.Current() != values)
 		memcpy_d2d(values, d_values.Current(), sizeof(int)*n);
-}
\ No newline at end of file
+}
+
+void radix_sort_pairs_device(int* keys, int* values, int n)
+{
+    radix_sort_pairs_device_impl(keys, values, n);
+}
+
+void radix_sort_pairs_device(int64_t* keys, int* values, int n)
+{
+    radix_sort_pairs_device_impl(keys, values, n);
+}
+
+void radix_sort_pairs_device(float* keys, int* values, int n)
+{
+    radix_sort_pairs_device_impl(keys, values, n);
+}
+
+void sort_pairs_device(uint64_t keys, uint64_t values, int n, int key_type)
+{
+    if (n <= 1)
+        return;
+
+    switch (key_type)
+    {
+        case SORT_INT32: radix_sort_pairs_device((int*)keys, (int*)values, n); break;
+        case SORT_FLOAT32: radix_sort_pairs_device((float*)keys, (int*)values, n); break;
+        case SORT_INT64: radix_sort_pairs_device((int64_t*)keys, (int*)values, n); break;
+        default: printf("Warp: sort_pairs() unsupported key type %d\n", key_type);
+    }
+}
@@ -8,6 +8,25 @@
 
 #pragma once
 
+#include <stdint.h>
+
+// key types supported by sort_pairs_host() / sort_pairs_device(), must match warp/context.py
+enum SortKeyType
+{
+    SORT_INT32 = 0,
+    SORT_FLOAT32 = 1,
+    SORT_INT64 = 2
+};
+
+// keys and values must have space for 2*n elements, the second half is used as temporary storage
 void radix_sort_reserve(int n);
+// frees the temporary memory of a stream, called by cuda_stream_destroy() once the stream is idle
+void radix_sort_release(void* stream);
+
 void radix_sort_pairs_host(int* keys, int* values, int n);
-void radix_sort_pairs_device(int* keys, int* values, int n);
\ No newline at end of file
+void radix_sort_pairs_host(int64_t* keys, int* values, int n);
+void radix_sort_pairs_host(float* keys, int* values, int n);
+
+void radix_sort_pairs_device(int* keys, int* values, int n);
+void radix_sort_pairs_device(int64_t* keys, int* values, int n);
+void radix_sort_pairs_device(float* keys, int* values, int n);
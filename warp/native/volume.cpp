@@ -9,52 +9,735 @@
 #include "volume.h"
 
 #include "warp.h"
+#include "registry.h"
 
 #ifndef WP_CUDA
 
+#include <stdio.h>
+
+#include <algorithm>
+#include <vector>
+
+#if _WIN32
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    ifndef WIN32_LEAN_AND_MEAN
+#        define WIN32_LEAN_AND_MEAN
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
 using namespace wp;
 
+namespace
+{
+
+// size of the pinned staging buffers used when streaming files to the device
+const uint64_t kDefaultLoadChunk = 64*1024*1024;
+
+// host-side copy of device volume descriptors, so destroy and get_buffer_info() don't read them back
+DescriptorRegistry<Volume> g_volume_descriptors;
+
+// checks the NanoVDB signature of a grid header held in host memory and returns its grid type
+bool volume_check_header(const void* header, uint64_t size, pnanovdb_uint32_t* grid_type)
+{
+    if (size < PNANOVDB_GRID_SIZE)
+        return false;
+
+    uint64_t nanovdb_magic;
+    memcpy(&nanovdb_magic, header, sizeof(uint64_t));
+    if (nanovdb_magic != PNANOVDB_MAGIC_NUMBER)
+        return false; // NanoVDB signature missing!
+
+    memcpy(grid_type, (const char*)header + PNANOVDB_GRID_OFF_GRID_TYPE, sizeof(pnanovdb_uint32_t));
+    return true;
+}
+
+// wraps a grid buffer that already lives on the target device
+template<Device device>
+uint64_t volume_create_from_buffer(void* target_buf, uint64_t size, pnanovdb_uint32_t grid_type, int ownership)
+{
+    Volume *volume = new Volume;
+    volume->buf = pnanovdb_make_buf((pnanovdb_uint32_t*)target_buf, size / sizeof(uint32_t));
+    volume->grid = { 0u };
+    volume->tree = pnanovdb_grid_get_tree(volume->buf, volume->grid);
+    volume->grid_type = grid_type;
+    volume->buf_ownership = ownership;
+    volume->size_in_bytes = size;
+
+    Volume *volume_result = volume;
+
+    if (device == Device::CUDA) {
+        volume_result = (Volume*)alloc<device>(sizeof(Volume));
+        descriptor_upload((uint64_t)volume_result, *g_volume_descriptors.insert((uint64_t)volume_result, *volume));
+        delete volume;
+    }
+
+    return (uint64_t)volume_result;
+}
+
+FILE* volume_open_file(const char* path, uint64_t* size)
+{
+    FILE* f = fopen(path, "rb");
+    if (!f)
+        return NULL;
+
+#if _WIN32
+    _fseeki64(f, 0, SEEK_END);
+    *size = uint64_t(_ftelli64(f));
+#else
+    fseeko(f, 0, SEEK_END);
+    *size = uint64_t(ftello(f));
+#endif
+    rewind(f);
+
+    return f;
+}
+
+// maps the whole file read-only, pages are only read from disk when first touched
+void* volume_map_file(const char* path, uint64_t* size)
+{
+#if _WIN32
+    HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return NULL;
+
+    LARGE_INTEGER file_size;
+    void* ptr = NULL;
+
+    if (GetFileSizeEx(file, &file_size) && file_size.QuadPart > 0)
+    {
+        // the view keeps the mapping alive after its handles are closed
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (mapping)
+        {
+            ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+        *size = uint64_t(file_size.QuadPart);
+    }
+    CloseHandle(file);
+
+    return ptr;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+
+    struct stat st;
+    void* ptr = NULL;
+
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        ptr = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (ptr == MAP_FAILED)
+            ptr = NULL;
+
+        *size = uint64_t(st.st_size);
+    }
+    close(fd);
+
+    return ptr;
+#endif
+}
+
+void volume_unmap_file(void* ptr, uint64_t size)
+{
+#if _WIN32
+    UnmapViewOfFile(ptr);
+#else
+    munmap(ptr, size_t(size));
+#endif
+}
+
+// node of a level set under construction, children are a range of the next finer level
+struct LevelSetNode
+{
+    pnanovdb_coord_t origin;
+
+    // for leaves begin is the index of the leaf's values
+    int begin;
+    int end;
+
+    // byte offset of the node in the grid buffer
+    uint64_t offset;
+
+    // bounds and range of the active voxels
+    pnanovdb_coord_t bbox_min;
+    pnanovdb_coord_t bbox_max;
+    float min;
+    float max;
+    bool active;
+
+    // values of the first and last voxel once the tiles are filled
+    float first;
+    float last;
+};
+
+template <typename T>
+void grid_write(uint8_t* buf, uint64_t offset, T value)
+{
+    memcpy(buf + offset, &value, sizeof(T));
+}
+
+void grid_write_coord(uint8_t* buf, uint64_t offset, pnanovdb_coord_t c)
+{
+    grid_write(buf, offset + 0, c.x);
+    grid_write(buf, offset + 4, c.y);
+    grid_write(buf, offset + 8, c.z);
+}
+
+void level_set_node_merge(LevelSetNode& node, const LevelSetNode& child)
+{
+    if (!child.active)
+        return;
+
+    if (!node.active)
+    {
+        node.bbox_min = child.bbox_min;
+        node.bbox_max = child.bbox_max;
+        node.min = child.min;
+        node.max = child.max;
+        node.active = true;
+        return;
+    }
+
+    node.bbox_min.x = std::min(node.bbox_min.x, child.bbox_min.x);
+    node.bbox_min.y = std::min(node.bbox_min.y, child.bbox_min.y);
+    node.bbox_min.z = std::min(node.bbox_min.z, child.bbox_min.z);
+    node.bbox_max.x = std::max(node.bbox_max.x, child.bbox_max.x);
+    node.bbox_max.y = std::max(node.bbox_max.y, child.bbox_max.y);
+    node.bbox_max.z = std::max(node.bbox_max.z, child.bbox_max.z);
+    node.min = std::min(node.min, child.min);
+    node.max = std::max(node.max, child.max);
+}
+
+// Signed flood fill of the tiles of an internal node with 2^(3*log2dim) slots, as in OpenVDB:
+// scanning the slots in memory order each tile takes the sign of the nearest preceding child
+// along z, then y, then x. children[n] is the index of the child in slot n or -1 for tiles.
+void level_set_flood_fill(int log2dim, const int* children, const std::vector<LevelSetNode>& nodes, float background, float* tiles)
+{
+    const int dim = 1 << log2dim;
+    const int size = 1 << (3*log2dim);
+
+    int first = 0;
+    while (first < size && children[first] < 0)
+        ++first;
+
+    if (first == size)
+    {
+        for (int n=0; n < size; ++n)
+            tiles[n] = background;
+
+        return;
+    }
+
+    bool x_inside = nodes[children[first]].first < 0.0f;
+
+    for (int x=0; x < dim; ++x)
+    {
+        const int x00 = x << (2*log2dim);
+        if (children[x00] >= 0)
+            x_inside = nodes[children[x00]].last < 0.0f;
+
+        bool y_inside = x_inside;
+
+        for (int y=0; y < dim; ++y)
+        {
+            const int xy0 = x00 + (y << log2dim);
+            if (children[xy0] >= 0)
+                y_inside = nodes[children[xy0]].last < 0.0f;
+
+            bool z_inside = y_inside;
+
+            for (int z=0; z < dim; ++z)
+            {
+                const int xyz = xy0 + z;
+
+                if (children[xyz] >= 0)
+                    z_inside = nodes[children[xyz]].last < 0.0f;
+                else
+                    tiles[xyz] = z_inside ? -background : background;
+            }
+        }
+    }
+}
+
+// writes the header, child mask, and table of an internal node, tiles hold the filled tile values, tiles are never active
+void level_set_write_internal(uint8_t* buf, const LevelSetNode& node, int log2dim, const int* children, const std::vector<LevelSetNode>& child_nodes, const float* tiles,
+                              uint32_t off_child_mask, uint32_t off_min, uint32_t off_max, uint32_t off_table, uint32_t table_stride)
+{
+    const int size = 1 << (3*log2dim);
+
+    grid_write_coord(buf, node.offset + 0, node.bbox_min);
+    grid_write_coord(buf, node.offset + 12, node.bbox_max);
+    grid_write(buf, node.offset + off_min, node.min);
+    grid_write(buf, node.offset + off_max, node.max);
+
+    for (int n=0; n < size; ++n)
+    {
+        const uint64_t entry = node.offset + off_table + uint64_t(table_stride)*n;
+
+        if (children[n] >= 0)
+        {
+            const uint64_t word = node.offset + off_child_mask + 4*(n >> 5);
+
+            uint32_t mask;
+            memcpy(&mask, buf + word, sizeof(uint32_t));
+            grid_write(buf, word, mask | (1u << (n & 31)));
+
+            grid_write(buf, entry, int64_t(child_nodes[children[n]].offset - node.offset));
+        }
+        else
+        {
+            grid_write(buf, entry, tiles[n]);
+        }
+    }
+}
+
+// Builds a NanoVDB float level set from leaf nodes, leaves holds the index space origin of each
+// leaf (multiples of 8) and values its 512 voxel values in NanoVDB order, i.e.: (x*8 + y)*8 + z.
+// Voxels closer to the surface than background are active, the tiles of internal nodes are signed
+// by a flood fill from the leaves, and the space outside of all upper nodes is background.
+std::vector<uint8_t> volume_build_level_set(const int* leaf_origins, const float* values, int num_leaves, float voxel_size, const vec3& translation, float background)
+{
+    const pnanovdb_grid_type_constants_t& c = pnanovdb_grid_type_constants[PNANOVDB_GRID_TYPE_FLOAT];
+
+    // order leaves by upper node, then by their slot in the upper and lower node so that every node's children are consecutive
+    struct LeafKey
+    {
+        int upper[3];
+        uint32_t upper_slot;
+        uint32_t lower_slot;
+        int index;
+
+        bool operator<(const LeafKey& k) const
+        {
+            if (upper[0] != k.upper[0]) return upper[0] < k.upper[0];
+            if (upper[1] != k.upper[1]) return upper[1] < k.upper[1];
+            if (upper[2] != k.upper[2]) return upper[2] < k.upper[2];
+            if (upper_slot != k.upper_slot) return upper_slot < k.upper_slot;
+            return lower_slot < k.lower_slot;
+        }
+    };
+
+    std::vector<LeafKey> keys(num_leaves);
+    for (int i=0; i < num_leaves; ++i)
+    {
+        pnanovdb_coord_t ijk = { leaf_origins[i*3+0], leaf_origins[i*3+1], leaf_origins[i*3+2] };
+
+        keys[i].upper[0] = ijk.x & ~4095;
+        keys[i].upper[1] = ijk.y & ~4095;
+        keys[i].upper[2] = ijk.z & ~4095;
+        keys[i].upper_slot = pnanovdb_upper_coord_to_offset(&ijk);
+        keys[i].lower_slot = pnanovdb_lower_coord_to_offset(&ijk);
+        keys[i].index = i;
+    }
+
+    std::sort(keys.begin(), keys.end());
+
+    std::vector<LevelSetNode> leaves;
+    std::vector<LevelSetNode> lowers;
+    std::vector<LevelSetNode> uppers;
+
+    uint64_t voxel_count = 0;
+
+    for (int i=0; i < num_leaves; ++i)
+    {
+        const LeafKey& k = keys[i];
+        const pnanovdb_coord_t origin = { leaf_origins[k.index*3+0], leaf_origins[k.index*3+1], leaf_origins[k.index*3+2] };
+
+        const bool new_upper = uppers.empty() || uppers.back().origin.x != k.upper[0] || uppers.back().origin.y != k.upper[1] || uppers.back().origin.z != k.upper[2];
+        const bool new_lower = new_upper || i == 0 || keys[i-1].upper_slot != k.upper_slot;
+
+        // skip duplicate leaves
+        if (!new_lower && keys[i-1].lower_slot == k.lower_slot)
+            continue;
+
+        if (new_upper)
+        {
+            LevelSetNode upper = {};
+            upper.origin.x = k.upper[0];
+            upper.origin.y = k.upper[1];
+            upper.origin.z = k.upper[2];
+            upper.begin = upper.end = int(lowers.size());
+            uppers.push_back(upper);
+        }
+
+        if (new_lower)
+        {
+            LevelSetNode lower = {};
+            lower.origin.x = origin.x & ~127;
+            lower.origin.y = origin.y & ~127;
+            lower.origin.z = origin.z & ~127;
+            lower.begin = lower.end = int(leaves.size());
+            lowers.push_back(lower);
+            uppers.back().end++;
+        }
+
+        LevelSetNode leaf = {};
+        leaf.origin = origin;
+        leaf.begin = k.index;
+
+        const float* v = values + size_t(k.index)*512;
+
+        for (int n=0; n < 512; ++n)
+        {
+            if (fabsf(v[n]) >= background)
+                continue;
+
+            const pnanovdb_coord_t ijk = { origin.x + (n >> 6), origin.y + ((n >> 3) & 7), origin.z + (n & 7) };
+
+            LevelSetNode voxel = {};
+            voxel.bbox_min = voxel.bbox_max = ijk;
+            voxel.min = voxel.max = v[n];
+            voxel.active = true;
+
+            level_set_node_merge(leaf, voxel);
+            voxel_count++;
+        }
+
+        leaf.first = v[0];
+        leaf.last = v[511];
+
+        leaves.push_back(leaf);
+        lowers.back().end++;
+    }
+
+    // node layout, levels are stored breadth first with 32 byte aligned nodes
+    const uint64_t tree_offset = PNANOVDB_GRID_SIZE;
+    const uint64_t root_offset = tree_offset + PNANOVDB_TREE_SIZE;
+    const uint64_t upper_offset = root_offset + c.root_size + uint64_t(c.root_tile_size)*uppers.size();
+    const uint64_t lower_offset = upper_offset + uint64_t(c.upper_size)*uppers.size();
+    const uint64_t leaf_offset = lower_offset + uint64_t(c.lower_size)*lowers.size();
+    const uint64_t grid_size = leaf_offset + uint64_t(c.leaf_size)*leaves.size();
+
+    for (size_t i=0; i < uppers.size(); ++i) uppers[i].offset = upper_offset + c.upper_size*i;
+    for (size_t i=0; i < lowers.size(); ++i) lowers[i].offset = lower_offset + c.lower_size*i;
+    for (size_t i=0; i < leaves.size(); ++i) leaves[i].offset = leaf_offset + c.leaf_size*i;
+
+    std::vector<uint8_t> grid(grid_size, 0);
+    uint8_t* buf = grid.data();
+
+    // leaves
+    for (size_t i=0; i < leaves.size(); ++i)
+    {
+        const LevelSetNode& leaf = leaves[i];
+        const float* v = values + size_t(leaf.begin)*512;
+
+        grid_write_coord(buf, leaf.offset + PNANOVDB_LEAF_OFF_BBOX_MIN, leaf.active ? leaf.bbox_min : leaf.origin);
+
+        // extent of the active voxels in the low bytes, the has bbox flag in the high byte
+        uint32_t dif_and_flags = 0;
+        if (leaf.active)
+            dif_and_flags = uint32_t(leaf.bbox_max.x - leaf.bbox_min.x) | (uint32_t(leaf.bbox_max.y - leaf.bbox_min.y) << 8) | (uint32_t(leaf.bbox_max.z - leaf.bbox_min.z) << 16) | (2u << 24);
+
+        grid_write(buf, leaf.offset + PNANOVDB_LEAF_OFF_BBOX_DIF_AND_FLAGS, dif_and_flags);
+
+        for (int w=0; w < 16; ++w)
+        {
+            uint32_t mask = 0;
+            for (int b=0; b < 32; ++b)
+                if (fabsf(v[w*32 + b]) < background)
+                    mask |= 1u << b;
+
+            grid_write(buf, leaf.offset + PNANOVDB_LEAF_OFF_VALUE_MASK + 4*w, mask);
+        }
+
+        grid_write(buf, leaf.offset + c.leaf_off_min, leaf.min);
+        grid_write(buf, leaf.offset + c.leaf_off_max, leaf.max);
+
+        memcpy(buf + leaf.offset + c.leaf_off_table, v, 512*sizeof(float));
+    }
+
+    // lower then upper nodes, the flood fill of each level reads the filled values of the level below
+    std::vector<int> children(PNANOVDB_UPPER_TABLE_COUNT);
+    std::vector<float> tiles(PNANOVDB_UPPER_TABLE_COUNT);
+
+    for (size_t i=0; i < lowers.size(); ++i)
+    {
+        LevelSetNode& lower = lowers[i];
+
+        std::fill(children.begin(), children.begin() + PNANOVDB_LOWER_TABLE_COUNT, -1);
+        for (int l=lower.begin; l < lower.end; ++l)
+        {
+            children[pnanovdb_lower_coord_to_offset(&leaves[l].origin)] = l;
+            level_set_node_merge(lower, leaves[l]);
+        }
+
+        level_set_flood_fill(4, children.data(), leaves, background, tiles.data());
+        level_set_write_internal(buf, lower, 4, children.data(), leaves, tiles.data(),
+                                 PNANOVDB_LOWER_OFF_CHILD_MASK, c.lower_off_min, c.lower_off_max, c.lower_off_table, c.table_stride);
+
+        lower.first = children[0] >= 0 ? leaves[children[0]].first : tiles[0];
+        lower.last = children[PNANOVDB_LOWER_TABLE_COUNT-1] >= 0 ? leaves[children[PNANOVDB_LOWER_TABLE_COUNT-1]].last : tiles[PNANOVDB_LOWER_TABLE_COUNT-1];
+    }
+
+    LevelSetNode root = {};
+
+    for (size_t i=0; i < uppers.size(); ++i)
+    {
+        LevelSetNode& upper = uppers[i];
+
+        std::fill(children.begin(), children.end(), -1);
+        for (int l=upper.begin; l < upper.end; ++l)
+        {
+            children[pnanovdb_upper_coord_to_offset(&lowers[l].origin)] = l;
+            level_set_node_merge(upper, lowers[l]);
+        }
+
+        level_set_flood_fill(5, children.data(), lowers, background, tiles.data());
+        level_set_write_internal(buf, upper, 5, children.data(), lowers, tiles.data(),
+                                 PNANOVDB_UPPER_OFF_CHILD_MASK, c.upper_off_min, c.upper_off_max, c.upper_off_table, c.table_stride);
+
+        level_set_node_merge(root, upper);
+
+        // root tile pointing at the upper node
+        const uint64_t tile = root_offset + c.root_size + uint64_t(c.root_tile_size)*i;
+
+        grid_write(buf, tile + PNANOVDB_ROOT_TILE_OFF_KEY, pnanovdb_coord_to_key(&upper.origin));
+        grid_write(buf, tile + PNANOVDB_ROOT_TILE_OFF_CHILD, int64_t(upper.offset - root_offset));
+        grid_write(buf, tile + PNANOVDB_ROOT_TILE_OFF_STATE, uint32_t(0));
+        grid_write(buf, tile + c.root_tile_off_value, background);
+    }
+
+    // root
+    grid_write_coord(buf, root_offset + PNANOVDB_ROOT_OFF_BBOX_MIN, root.bbox_min);
+    grid_write_coord(buf, root_offset + PNANOVDB_ROOT_OFF_BBOX_MAX, root.bbox_max);
+    grid_write(buf, root_offset + PNANOVDB_ROOT_OFF_TABLE_SIZE, uint32_t(uppers.size()));
+    grid_write(buf, root_offset + c.root_off_background, background);
+    grid_write(buf, root_offset + c.root_off_min, root.min);
+    grid_write(buf, root_offset + c.root_off_max, root.max);
+
+    // tree, offsets are relative to the tree
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_OFFSET_LEAF, uint64_t(leaves.empty() ? 0 : leaf_offset - tree_offset));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_OFFSET_LOWER, uint64_t(lowers.empty() ? 0 : lower_offset - tree_offset));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_OFFSET_UPPER, uint64_t(uppers.empty() ? 0 : upper_offset - tree_offset));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_OFFSET_ROOT, uint64_t(root_offset - tree_offset));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_COUNT_LEAF, uint32_t(leaves.size()));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_COUNT_LOWER, uint32_t(lowers.size()));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_NODE_COUNT_UPPER, uint32_t(uppers.size()));
+    grid_write(buf, tree_offset + PNANOVDB_TREE_OFF_VOXEL_COUNT, voxel_count);
+
+    // grid
+    grid_write(buf, PNANOVDB_GRID_OFF_MAGIC, uint64_t(PNANOVDB_MAGIC_NUMBER));
+    grid_write(buf, PNANOVDB_GRID_OFF_CHECKSUM, ~uint64_t(0));
+    grid_write(buf, PNANOVDB_GRID_OFF_VERSION, uint32_t((PNANOVDB_MAJOR_VERSION_NUMBER << 21) | (PNANOVDB_MINOR_VERSION_NUMBER << 10) | PNANOVDB_PATCH_VERSION_NUMBER));
+    grid_write(buf, PNANOVDB_GRID_OFF_FLAGS, uint32_t(PNANOVDB_GRID_FLAGS_HAS_BBOX | PNANOVDB_GRID_FLAGS_HAS_MIN_MAX | PNANOVDB_GRID_FLAGS_IS_BREADTH_FIRST));
+    grid_write(buf, PNANOVDB_GRID_OFF_GRID_INDEX, uint32_t(0));
+    grid_write(buf, PNANOVDB_GRID_OFF_GRID_COUNT, uint32_t(1));
+    grid_write(buf, PNANOVDB_GRID_OFF_GRID_SIZE, grid_size);
+    memcpy(buf + PNANOVDB_GRID_OFF_GRID_NAME, "level_set", 10);
+
+    const uint64_t map = PNANOVDB_GRID_OFF_MAP;
+    const float t[3] = { translation.x, translation.y, translation.z };
+
+    for (int i=0; i < 3; ++i)
+    {
+        grid_write(buf, map + PNANOVDB_MAP_OFF_MATF + 4*(i*4), voxel_size);
+        grid_write(buf, map + PNANOVDB_MAP_OFF_INVMATF + 4*(i*4), 1.0f/voxel_size);
+        grid_write(buf, map + PNANOVDB_MAP_OFF_VECF + 4*i, t[i]);
+        grid_write(buf, map + PNANOVDB_MAP_OFF_MATD + 8*(i*4), double(voxel_size));
+        grid_write(buf, map + PNANOVDB_MAP_OFF_INVMATD + 8*(i*4), 1.0/double(voxel_size));
+        grid_write(buf, map + PNANOVDB_MAP_OFF_VECD + 8*i, double(t[i]));
+
+        const int lo[3] = { root.bbox_min.x, root.bbox_min.y, root.bbox_min.z };
+        const int hi[3] = { root.bbox_max.x, root.bbox_max.y, root.bbox_max.z };
+
+        grid_write(buf, PNANOVDB_GRID_OFF_WORLD_BBOX + 8*i, double(lo[i])*voxel_size + t[i]);
+        grid_write(buf, PNANOVDB_GRID_OFF_WORLD_BBOX + 8*(i+3), double(hi[i] + 1)*voxel_size + t[i]);
+        grid_write(buf, PNANOVDB_GRID_OFF_VOXEL_SIZE + 8*i, double(voxel_size));
+    }
+
+    grid_write(buf, map + PNANOVDB_MAP_OFF_TAPERF, 1.0f);
+    grid_write(buf, map + PNANOVDB_MAP_OFF_TAPERD, 1.0);
+
+    grid_write(buf, PNANOVDB_GRID_OFF_GRID_CLASS, uint32_t(PNANOVDB_GRID_CLASS_LEVEL_SET));
+    grid_write(buf, PNANOVDB_GRID_OFF_GRID_TYPE, uint32_t(PNANOVDB_GRID_TYPE_FLOAT));
+
+    return grid;
+}
+
+} // anonymous namespace
+
 // Creates a Volume on the specified device
-// NB: buf must be a pointer on the same device
+// NB: buf must be a pointer on the same device, if copy is false the volume
+// references buf directly and the caller must keep it alive
 template<Device device>
-uint64_t volume_create(void* buf, uint64_t size)
+uint64_t volume_create(void* buf, uint64_t size, bool copy)
 {
     { // Checking for a valid NanoVDB buffer
+        if (size < PNANOVDB_GRID_SIZE)
+            return 0;
+
         uint64_t nanovdb_magic;
         memcpy<device, Device::CPU>(&nanovdb_magic, buf, sizeof(uint64_t));
+        if (device == Device::CUDA)
+            cuda_stream_synchronize(cuda_get_stream());
+
         if (nanovdb_magic != PNANOVDB_MAGIC_NUMBER) {
             return 0; // NanoVDB signature missing!
         }
     }
-    
+
+    // grid type is read from the source header here so that samplers don't have to
+    pnanovdb_uint32_t grid_type;
+    memcpy<device, Device::CPU>(&grid_type, (char*)buf + PNANOVDB_GRID_OFF_GRID_TYPE, sizeof(pnanovdb_uint32_t));
+    if (device == Device::CUDA)
+        cuda_stream_synchronize(cuda_get_stream());
+
+    if (!copy)
+        return volume_create_from_buffer<device>(buf, size, grid_type, Volume::BUF_EXTERNAL);
+
     void* target_buf = alloc<device>(size);
     memcpy<device, device>(target_buf, buf, size);
 
-    Volume *volume = new Volume;
-    volume->buf = pnanovdb_make_buf((pnanovdb_uint32_t*)target_buf, size / sizeof(uint32_t));
-    volume->grid = { 0u };
-    volume->tree = pnanovdb_grid_get_tree(volume->buf, volume->grid);
-    volume->size_in_bytes = size;
+    return volume_create_from_buffer<device>(target_buf, size, grid_type, Volume::BUF_OWNED);
+}
 
-    Volume *volume_result = volume;
+uint64_t volume_create_host(void* buf, uint64_t size, bool copy)
+{
+    return volume_create<Device::CPU>(buf, size, copy);
+}
 
-    if (device == Device::CUDA) {
-        volume_result = (Volume*)alloc<device>(sizeof(Volume));
-        memcpy<Device::CPU, device>(volume_result, volume, sizeof(Volume));
-        delete volume;
+uint64_t volume_create_device(void* buf, uint64_t size, bool copy)
+{
+    return volume_create<Device::CUDA>(buf, size, copy);
+}
+
+// Host volumes are memory-mapped from the file, so no copy of the grid is made
+// and only the pages that are actually sampled are read from disk
+uint64_t volume_load_host(const char* path)
+{
+    uint64_t size = 0;
+    void* ptr = volume_map_file(path, &size);
+    if (!ptr)
+        return 0;
+
+    pnanovdb_uint32_t grid_type;
+    if (!volume_check_header(ptr, size, &grid_type))
+    {
+        volume_unmap_file(ptr, size);
+        return 0;
     }
 
-    return (uint64_t)volume_result;
+    return volume_create_from_buffer<Device::CPU>(ptr, size, grid_type, Volume::BUF_MAPPED);
 }
 
-uint64_t volume_create_host(void* buf, uint64_t size)
+// Device volumes are streamed through two pinned staging buffers, reading the
+// next chunk from disk overlaps with the asynchronous upload of the previous one
+uint64_t volume_load_device(const char* path, uint64_t chunk_size)
 {
-    return volume_create<Device::CPU>(buf, size);
+    uint64_t size = 0;
+    FILE* f = volume_open_file(path, &size);
+    if (!f)
+        return 0;
+
+    if (chunk_size == 0)
+        chunk_size = kDefaultLoadChunk;
+
+    chunk_size = std::max(std::min(chunk_size, size), uint64_t(PNANOVDB_GRID_SIZE));
+
+    void* staging[2] = { alloc_pinned(chunk_size), alloc_pinned(chunk_size) };
+    void* events[2] = { cuda_event_create(false), cuda_event_create(false) };
+
+    void* stream = cuda_get_stream();
+    void* target_buf = NULL;
+
+    pnanovdb_uint32_t grid_type = PNANOVDB_GRID_TYPE_UNKNOWN;
+    bool success = true;
+
+    for (uint64_t offset = 0, chunk = 0; offset < size; offset += chunk_size, ++chunk)
+    {
+        const uint64_t n = std::min(chunk_size, size - offset);
+        const int b = int(chunk & 1);
+
+        // wait for the upload that last used this staging buffer
+        if (chunk >= 2)
+            cuda_event_synchronize(events[b]);
+
+        if (fread(staging[b], 1, size_t(n), f) != size_t(n))
+        {
+            success = false;
+            break;
+        }
+
+        if (chunk == 0)
+        {
+            if (!volume_check_header(staging[b], n, &grid_type))
+            {
+                success = false;
+                break;
+            }
+
+            target_buf = alloc_device(size);
+        }
+
+        memcpy_h2d((char*)target_buf + offset, staging[b], size_t(n));
+        cuda_event_record(events[b], stream);
+    }
+
+    fclose(f);
+
+    cuda_stream_synchronize(stream);
+
+    for (int b = 0; b < 2; ++b)
+    {
+        cuda_event_destroy(events[b]);
+        free_pinned(staging[b]);
+    }
+
+    if (!success || !target_buf)
+    {
+        if (target_buf)
+            free_device(target_buf);
+
+        return 0;
+    }
+
+    return volume_create_from_buffer<Device::CUDA>(target_buf, size, grid_type, Volume::BUF_OWNED);
 }
 
-uint64_t volume_create_device(void* buf, uint64_t size)
+// Level sets are assembled on the host, distance evaluation is left to the caller so
+// that only the leaves near the surface are ever computed
+uint64_t volume_create_level_set_host(const int* leaves, const float* values, int num_leaves, float voxel_size, float tx, float ty, float tz, float background)
 {
-    return volume_create<Device::CUDA>(buf, size);
+    std::vector<uint8_t> grid = volume_build_level_set(leaves, values, num_leaves, voxel_size, vec3(tx, ty, tz), background);
+
+    void* target_buf = alloc_host(grid.size());
+    memcpy(target_buf, grid.data(), grid.size());
+
+    return volume_create_from_buffer<Device::CPU>(target_buf, grid.size(), PNANOVDB_GRID_TYPE_FLOAT, Volume::BUF_OWNED);
+}
+
+// leaves and values are device pointers
+uint64_t volume_create_level_set_device(const int* leaves, const float* values, int num_leaves, float voxel_size, float tx, float ty, float tz, float background)
+{
+    std::vector<int> host_leaves(size_t(num_leaves)*3);
+    std::vector<float> host_values(size_t(num_leaves)*512);
+
+    if (num_leaves)
+    {
+        memcpy_d2h(host_leaves.data(), (void*)leaves, host_leaves.size()*sizeof(int));
+        memcpy_d2h(host_values.data(), (void*)values, host_values.size()*sizeof(float));
+        cuda_stream_synchronize(cuda_get_stream());
+    }
+
+    std::vector<uint8_t> grid = volume_build_level_set(host_leaves.data(), host_values.data(), num_leaves, voxel_size, vec3(tx, ty, tz), background);
+
+    void* target_buf = alloc_device(grid.size());
+    memcpy_h2d(target_buf, grid.data(), grid.size());
+
+    // the upload reads from pageable memory that is released on return
+    cuda_stream_synchronize(cuda_get_stream());
+
+    return volume_create_from_buffer<Device::CUDA>(target_buf, grid.size(), PNANOVDB_GRID_TYPE_FLOAT, Volume::BUF_OWNED);
 }
 
 
@@ -69,10 +752,9 @@ void volume_get_buffer_info(uint64_t id, void** buf, uint64_t* size)
 
     Volume* volume_src = (Volume*)(id);
     if (device == Device::CUDA) {
-        Volume volume;
-        memcpy_d2h(&volume, volume_src, sizeof(Volume));
-        *buf = volume.buf.data;
-        *size = volume.size_in_bytes;
+        const Descriptor<Volume>* d = g_volume_descriptors.find(id);
+        *buf = d ? d->host.buf.data : 0;
+        *size = d ? d->host.size_in_bytes : 0;
     } else {
         *buf = volume_src->buf.data;
         *size = volume_src->size_in_bytes;
@@ -96,13 +778,25 @@ void volume_destroy(uint64_t id)
 
     Volume* volume_src = (Volume*)(id);
     if (device == Device::CUDA) {
-        Volume volume;
-        memcpy_d2h(&volume, volume_src, sizeof(Volume));
-        free_device(volume.buf.data);
+        const Descriptor<Volume>* d = g_volume_descriptors.find(id);
+        if (!d)
+            return;
+
+        if (d->host.buf_ownership == Volume::BUF_OWNED)
+            free_device(d->host.buf.data);
+
+        g_volume_descriptors.erase(id);
     } else {
-        free_host(volume_src->buf.data);
+        if (volume_src->buf_ownership == Volume::BUF_OWNED)
+            free_host(volume_src->buf.data);
+        else if (volume_src->buf_ownership == Volume::BUF_MAPPED)
+            volume_unmap_file(volume_src->buf.data, volume_src->size_in_bytes);
     }
-    free<device>(volume_src);
+
+    if (device == Device::CUDA)
+        free<device>(volume_src);
+    else
+        delete volume_src;
 }
 
 void volume_destroy_host(uint64_t id)
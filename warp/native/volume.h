@@ -24,55 +24,221 @@ struct Volume
     static constexpr int CLOSEST = 0;
     static constexpr int LINEAR = 1;
 
+    // how the grid buffer is released when the volume is destroyed
+    static constexpr int BUF_OWNED = 0;     // allocated by the volume
+    static constexpr int BUF_EXTERNAL = 1;  // owned by the caller, must outlive the volume
+    static constexpr int BUF_MAPPED = 2;    // read-only mapping of a file (host only)
+
     pnanovdb_buf_t buf;
     pnanovdb_grid_handle_t grid;
     pnanovdb_tree_handle_t tree;
 
+    // PNANOVDB_GRID_TYPE_* of the grid, read once at creation so samplers can dispatch without touching the header
+    pnanovdb_uint32_t grid_type;
+    int buf_ownership;
+
     uint64_t size_in_bytes;
 };
 
-// Sampling the volume at the given index-space coordinates, uvw can be fractional
-CUDA_CALLABLE inline float volume_sample_local(uint64_t id, vec3 uvw, int sampling_mode)
+// Voxel readers for the supported grid types, values of scalar grids are converted to float
+// and vector grids to vec3. The grid type is a template argument so that PNanoVDB's per-type
+// strides and offsets fold to constants instead of being looked up from its constant table
+template <int GridType> struct volume_grid;
+
+template <> struct volume_grid<PNANOVDB_GRID_TYPE_FLOAT>
 {
-    const Volume volume = *(const Volume*)(id);
-    const pnanovdb_root_handle_t root = pnanovdb_tree_get_root(volume.buf, volume.tree);
-    const pnanovdb_vec3_t uvw_pnano{ uvw.x, uvw.y, uvw.z };
+    typedef float value_type;
+    static CUDA_CALLABLE inline float read(pnanovdb_buf_t buf, pnanovdb_address_t address) { return pnanovdb_read_float(buf, address); }
+};
+
+template <> struct volume_grid<PNANOVDB_GRID_TYPE_DOUBLE>
+{
+    typedef float value_type;
+    static CUDA_CALLABLE inline float read(pnanovdb_buf_t buf, pnanovdb_address_t address) { return float(pnanovdb_read_double(buf, address)); }
+};
+
+template <> struct volume_grid<PNANOVDB_GRID_TYPE_INT32>
+{
+    typedef float value_type;
+    static CUDA_CALLABLE inline float read(pnanovdb_buf_t buf, pnanovdb_address_t address) { return float(pnanovdb_read_int32(buf, address)); }
+};
+
+template <> struct volume_grid<PNANOVDB_GRID_TYPE_VEC3F>
+{
+    typedef vec3 value_type;
+    static CUDA_CALLABLE inline vec3 read(pnanovdb_buf_t buf, pnanovdb_address_t address)
+    {
+        return vec3(pnanovdb_read_float(buf, pnanovdb_address_offset(address, 0u)),
+                    pnanovdb_read_float(buf, pnanovdb_address_offset(address, 4u)),
+                    pnanovdb_read_float(buf, pnanovdb_address_offset(address, 8u)));
+    }
+};
+
+template <> struct volume_grid<PNANOVDB_GRID_TYPE_VEC3D>
+{
+    typedef vec3 value_type;
+    static CUDA_CALLABLE inline vec3 read(pnanovdb_buf_t buf, pnanovdb_address_t address)
+    {
+        return vec3(float(pnanovdb_read_double(buf, pnanovdb_address_offset(address, 0u))),
+                    float(pnanovdb_read_double(buf, pnanovdb_address_offset(address, 8u))),
+                    float(pnanovdb_read_double(buf, pnanovdb_address_offset(address, 16u))));
+    }
+};
+
+template <int GridType>
+CUDA_CALLABLE inline typename volume_grid<GridType>::value_type volume_read(const Volume& volume, pnanovdb_readaccessor_t& accessor, const pnanovdb_coord_t& ijk)
+{
+    const pnanovdb_address_t address =
+        pnanovdb_readaccessor_get_value_address(GridType, volume.buf, PNANOVDB_REF(accessor), PNANOVDB_REF(ijk));
+    return volume_grid<GridType>::read(volume.buf, address);
+}
+
+// splits index-space coordinates into the base voxel and trilinear weights
+CUDA_CALLABLE inline pnanovdb_coord_t volume_linear_weights(const vec3& uvw, float wx[2], float wy[2], float wz[2])
+{
+    const float base_x = floorf(uvw.x);
+    const float base_y = floorf(uvw.y);
+    const float base_z = floorf(uvw.z);
+
+    wx[1] = uvw.x - base_x; wx[0] = 1.0f - wx[1];
+    wy[1] = uvw.y - base_y; wy[0] = 1.0f - wy[1];
+    wz[1] = uvw.z - base_z; wz[0] = 1.0f - wz[1];
+
+    return pnanovdb_coord_t{ (pnanovdb_int32_t)base_x, (pnanovdb_int32_t)base_y, (pnanovdb_int32_t)base_z };
+}
+
+template <int GridType>
+CUDA_CALLABLE inline typename volume_grid<GridType>::value_type volume_sample(const Volume& volume, pnanovdb_readaccessor_t& accessor, const vec3& uvw, int sampling_mode)
+{
+    typedef typename volume_grid<GridType>::value_type T;
 
     if (sampling_mode == Volume::CLOSEST)
     {
+        const pnanovdb_vec3_t uvw_pnano{ uvw.x, uvw.y, uvw.z };
         const pnanovdb_coord_t ijk = pnanovdb_vec3_round_to_coord(uvw_pnano);
-        const pnanovdb_address_t address =
-            pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_FLOAT, volume.buf, root, PNANOVDB_REF(ijk));
-        return pnanovdb_read_float(volume.buf, address);
+        return volume_read<GridType>(volume, accessor, ijk);
     }
     else if (sampling_mode == Volume::LINEAR)
     {
-        constexpr pnanovdb_coord_t OFFSETS[] = {
-            { 0, 0, 0 }, { 0, 0, 1 }, { 0, 1, 0 }, { 0, 1, 1 }, { 1, 0, 0 }, { 1, 0, 1 }, { 1, 1, 0 }, { 1, 1, 1 },
-        };
-
-        const pnanovdb_vec3_t ijk_base{ floorf(uvw_pnano.x), floorf(uvw_pnano.y), floorf(uvw_pnano.z) };
-        const pnanovdb_vec3_t ijk_frac{ uvw_pnano.x - ijk_base.x, uvw_pnano.y - ijk_base.y, uvw_pnano.z - ijk_base.z };
-        const pnanovdb_coord_t ijk{ (pnanovdb_int32_t)ijk_base.x, (pnanovdb_int32_t)ijk_base.y, (pnanovdb_int32_t)ijk_base.z };
-
-        pnanovdb_readaccessor_t accessor;
-        pnanovdb_readaccessor_init(PNANOVDB_REF(accessor), root);
-        float val = 0.0f;
-        const float wx[2]{ 1 - ijk_frac.x, ijk_frac.x };
-        const float wy[2]{ 1 - ijk_frac.y, ijk_frac.y };
-        const float wz[2]{ 1 - ijk_frac.z, ijk_frac.z };
+        float wx[2], wy[2], wz[2];
+        const pnanovdb_coord_t ijk = volume_linear_weights(uvw, wx, wy, wz);
+
+        T val = T(0.0f);
+#if defined(__CUDA_ARCH__)
 #pragma unroll
+#endif
         for (int idx = 0; idx < 8; ++idx)
         {
-            const pnanovdb_coord_t& offs = OFFSETS[idx];
-            const pnanovdb_coord_t ijkShifted = pnanovdb_coord_add(ijk, offs);
-            pnanovdb_address_t address = pnanovdb_readaccessor_get_value_address(
-                PNANOVDB_GRID_TYPE_FLOAT, volume.buf, PNANOVDB_REF(accessor), PNANOVDB_REF(ijkShifted));
-            val += wx[offs.x] * wy[offs.y] * wz[offs.z] * pnanovdb_read_float(volume.buf, address);
+            const int di = (idx >> 2) & 1;
+            const int dj = (idx >> 1) & 1;
+            const int dk = idx & 1;
+
+            const pnanovdb_coord_t ijk_shifted{ ijk.x + di, ijk.y + dj, ijk.z + dk };
+            val += (wx[di] * wy[dj] * wz[dk]) * volume_read<GridType>(volume, accessor, ijk_shifted);
         }
         return val;
     }
-    return 0;
+    return T(0.0f);
+}
+
+// trilinear value and index-space gradient of a scalar grid from a single set of 8 voxel fetches
+template <int GridType>
+CUDA_CALLABLE inline float volume_sample_grad(const Volume& volume, pnanovdb_readaccessor_t& accessor, const vec3& uvw, vec3& grad)
+{
+    float wx[2], wy[2], wz[2];
+    const pnanovdb_coord_t ijk = volume_linear_weights(uvw, wx, wy, wz);
+
+    const float dw[2] = { -1.0f, 1.0f };
+
+    float val = 0.0f;
+    grad = vec3(0.0f);
+#if defined(__CUDA_ARCH__)
+#pragma unroll
+#endif
+    for (int idx = 0; idx < 8; ++idx)
+    {
+        const int di = (idx >> 2) & 1;
+        const int dj = (idx >> 1) & 1;
+        const int dk = idx & 1;
+
+        const pnanovdb_coord_t ijk_shifted{ ijk.x + di, ijk.y + dj, ijk.z + dk };
+        const float v = volume_read<GridType>(volume, accessor, ijk_shifted);
+
+        val += wx[di] * wy[dj] * wz[dk] * v;
+        grad += vec3(dw[di] * wy[dj] * wz[dk], wx[di] * dw[dj] * wz[dk], wx[di] * wy[dj] * dw[dk]) * v;
+    }
+    return val;
+}
+
+// runtime dispatch on the grid type, sampling a grid of a different kind returns zero
+CUDA_CALLABLE inline float volume_sample_f(const Volume& volume, pnanovdb_readaccessor_t& accessor, const vec3& uvw, int sampling_mode)
+{
+    switch (volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_FLOAT: return volume_sample<PNANOVDB_GRID_TYPE_FLOAT>(volume, accessor, uvw, sampling_mode);
+        case PNANOVDB_GRID_TYPE_DOUBLE: return volume_sample<PNANOVDB_GRID_TYPE_DOUBLE>(volume, accessor, uvw, sampling_mode);
+        case PNANOVDB_GRID_TYPE_INT32: return volume_sample<PNANOVDB_GRID_TYPE_INT32>(volume, accessor, uvw, sampling_mode);
+        default: return 0.0f;
+    }
+}
+
+CUDA_CALLABLE inline vec3 volume_sample_v(const Volume& volume, pnanovdb_readaccessor_t& accessor, const vec3& uvw, int sampling_mode)
+{
+    switch (volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_VEC3F: return volume_sample<PNANOVDB_GRID_TYPE_VEC3F>(volume, accessor, uvw, sampling_mode);
+        case PNANOVDB_GRID_TYPE_VEC3D: return volume_sample<PNANOVDB_GRID_TYPE_VEC3D>(volume, accessor, uvw, sampling_mode);
+        default: return vec3(0.0f);
+    }
+}
+
+CUDA_CALLABLE inline float volume_sample_grad_f(const Volume& volume, pnanovdb_readaccessor_t& accessor, const vec3& uvw, vec3& grad)
+{
+    switch (volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_FLOAT: return volume_sample_grad<PNANOVDB_GRID_TYPE_FLOAT>(volume, accessor, uvw, grad);
+        case PNANOVDB_GRID_TYPE_DOUBLE: return volume_sample_grad<PNANOVDB_GRID_TYPE_DOUBLE>(volume, accessor, uvw, grad);
+        case PNANOVDB_GRID_TYPE_INT32: return volume_sample_grad<PNANOVDB_GRID_TYPE_INT32>(volume, accessor, uvw, grad);
+        default: grad = vec3(0.0f); return 0.0f;
+    }
+}
+
+CUDA_CALLABLE inline pnanovdb_readaccessor_t volume_accessor_init(const Volume& volume)
+{
+    pnanovdb_readaccessor_t accessor;
+    pnanovdb_readaccessor_init(PNANOVDB_REF(accessor), pnanovdb_tree_get_root(volume.buf, volume.tree));
+    return accessor;
+}
+
+CUDA_CALLABLE inline vec3 volume_world_to_index(const Volume& volume, const vec3& xyz)
+{
+    const pnanovdb_vec3_t pos{ xyz.x, xyz.y, xyz.z };
+    const pnanovdb_vec3_t uvw = pnanovdb_grid_world_to_indexf(volume.buf, volume.grid, PNANOVDB_REF(pos));
+    return vec3(uvw.x, uvw.y, uvw.z);
+}
+
+// transforms an index-space gradient to world space, i.e.: multiplies by the transpose of the inverse map
+CUDA_CALLABLE inline vec3 volume_grad_to_world(const Volume& volume, const vec3& grad)
+{
+    const pnanovdb_map_handle_t map = pnanovdb_grid_get_map(volume.buf, volume.grid);
+
+    vec3 result;
+    for (int j = 0; j < 3; ++j)
+    {
+        result[j] = grad.x * pnanovdb_map_get_invmatf(volume.buf, map, 0 + j) +
+                    grad.y * pnanovdb_map_get_invmatf(volume.buf, map, 3 + j) +
+                    grad.z * pnanovdb_map_get_invmatf(volume.buf, map, 6 + j);
+    }
+    return result;
+}
+
+// Sampling the volume at the given index-space coordinates, uvw can be fractional
+CUDA_CALLABLE inline float volume_sample_local(uint64_t id, vec3 uvw, int sampling_mode)
+{
+    const Volume& volume = *(const Volume*)(id);
+    pnanovdb_readaccessor_t accessor = volume_accessor_init(volume);
+
+    return volume_sample_f(volume, accessor, uvw, sampling_mode);
 }
 
 CUDA_CALLABLE inline void adj_volume_sample_local(
@@ -83,14 +249,10 @@ CUDA_CALLABLE inline void adj_volume_sample_local(
 // Sampling the volume at the given world-space coordinates
 CUDA_CALLABLE inline float volume_sample_world(uint64_t id, vec3 xyz, int sampling_mode)
 {
-    const Volume volume = *(const Volume*)(id);
-    const pnanovdb_root_handle_t root = pnanovdb_tree_get_root(volume.buf, volume.tree);
+    const Volume& volume = *(const Volume*)(id);
+    pnanovdb_readaccessor_t accessor = volume_accessor_init(volume);
 
-    const pnanovdb_vec3_t xyz_pnano{ xyz.x, xyz.y, xyz.z };
-    const pnanovdb_vec3_t uvw_pnano = pnanovdb_grid_world_to_indexf(volume.buf, volume.grid, PNANOVDB_REF(xyz_pnano));
-    const vec3 uvw{ uvw_pnano.x, uvw_pnano.y, uvw_pnano.z };
-
-    return volume_sample_local(id, uvw, sampling_mode);
+    return volume_sample_f(volume, accessor, volume_world_to_index(volume, xyz), sampling_mode);
 }
 
 CUDA_CALLABLE inline void adj_volume_sample_world(
@@ -98,15 +260,83 @@ CUDA_CALLABLE inline void adj_volume_sample_world(
 {
 }
 
+// Sampling a vec3 volume at the given index-space coordinates
+CUDA_CALLABLE inline vec3 volume_sample_local_v(uint64_t id, vec3 uvw, int sampling_mode)
+{
+    const Volume& volume = *(const Volume*)(id);
+    pnanovdb_readaccessor_t accessor = volume_accessor_init(volume);
+
+    return volume_sample_v(volume, accessor, uvw, sampling_mode);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_local_v(
+    uint64_t id, vec3 uvw, int sampling_mode, uint64_t& adj_id, vec3& adj_uvw, int& adj_sampling_mode, vec3& adj_result)
+{
+}
+
+// Sampling a vec3 volume at the given world-space coordinates
+CUDA_CALLABLE inline vec3 volume_sample_world_v(uint64_t id, vec3 xyz, int sampling_mode)
+{
+    const Volume& volume = *(const Volume*)(id);
+    pnanovdb_readaccessor_t accessor = volume_accessor_init(volume);
+
+    return volume_sample_v(volume, accessor, volume_world_to_index(volume, xyz), sampling_mode);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_world_v(
+    uint64_t id, vec3 xyz, int sampling_mode, uint64_t& adj_id, vec3& adj_xyz, int& adj_sampling_mode, vec3& adj_result)
+{
+}
+
+// Trilinear sample of a scalar volume at the given index-space coordinates, also returns the index-space gradient
+CUDA_CALLABLE inline float volume_sample_grad_local(uint64_t id, vec3 uvw, vec3& grad)
+{
+    const Volume& volume = *(const Volume*)(id);
+    pnanovdb_readaccessor_t accessor = volume_accessor_init(volume);
+
+    return volume_sample_grad_f(volume, accessor, uvw, grad);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_grad_local(
+    uint64_t id, vec3 uvw, vec3& grad, uint64_t& adj_id, vec3& adj_uvw, vec3& adj_grad, float& adj_result)
+{
+}
+
+// Trilinear sample of a scalar volume at the given world-space coordinates, also returns the world-space gradient
+CUDA_CALLABLE inline float volume_sample_grad_world(uint64_t id, vec3 xyz, vec3& grad)
+{
+    const Volume& volume = *(const Volume*)(id);
+    pnanovdb_readaccessor_t accessor = volume_accessor_init(volume);
+
+    vec3 grad_index;
+    const float val = volume_sample_grad_f(volume, accessor, volume_world_to_index(volume, xyz), grad_index);
+
+    grad = volume_grad_to_world(volume, grad_index);
+    return val;
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_grad_world(
+    uint64_t id, vec3 xyz, vec3& grad, uint64_t& adj_id, vec3& adj_xyz, vec3& adj_grad, float& adj_result)
+{
+}
+
 CUDA_CALLABLE inline float volume_lookup(uint64_t id, int32_t i, int32_t j, int32_t k)
 {
-    const Volume volume = *(const Volume*)(id);
+    const Volume& volume = *(const Volume*)(id);
     const pnanovdb_root_handle_t root = pnanovdb_tree_get_root(volume.buf, volume.tree);
-
     const pnanovdb_coord_t ijk{ i, j, k };
-    const pnanovdb_address_t address =
-        pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_FLOAT, volume.buf, root, PNANOVDB_REF(ijk));
-    return pnanovdb_read_float(volume.buf, address);
+
+    switch (volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_FLOAT:
+            return volume_grid<PNANOVDB_GRID_TYPE_FLOAT>::read(volume.buf, pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_FLOAT, volume.buf, root, PNANOVDB_REF(ijk)));
+        case PNANOVDB_GRID_TYPE_DOUBLE:
+            return volume_grid<PNANOVDB_GRID_TYPE_DOUBLE>::read(volume.buf, pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_DOUBLE, volume.buf, root, PNANOVDB_REF(ijk)));
+        case PNANOVDB_GRID_TYPE_INT32:
+            return volume_grid<PNANOVDB_GRID_TYPE_INT32>::read(volume.buf, pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_INT32, volume.buf, root, PNANOVDB_REF(ijk)));
+        default:
+            return 0.0f;
+    }
 }
 
 CUDA_CALLABLE inline void adj_volume_lookup(
@@ -114,10 +344,194 @@ CUDA_CALLABLE inline void adj_volume_lookup(
 {
 }
 
+CUDA_CALLABLE inline vec3 volume_lookup_v(uint64_t id, int32_t i, int32_t j, int32_t k)
+{
+    const Volume& volume = *(const Volume*)(id);
+    const pnanovdb_root_handle_t root = pnanovdb_tree_get_root(volume.buf, volume.tree);
+    const pnanovdb_coord_t ijk{ i, j, k };
+
+    switch (volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_VEC3F:
+            return volume_grid<PNANOVDB_GRID_TYPE_VEC3F>::read(volume.buf, pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_VEC3F, volume.buf, root, PNANOVDB_REF(ijk)));
+        case PNANOVDB_GRID_TYPE_VEC3D:
+            return volume_grid<PNANOVDB_GRID_TYPE_VEC3D>::read(volume.buf, pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_VEC3D, volume.buf, root, PNANOVDB_REF(ijk)));
+        default:
+            return vec3(0.0f);
+    }
+}
+
+CUDA_CALLABLE inline void adj_volume_lookup_v(
+    uint64_t id, int32_t i, int32_t j, int32_t k, uint64_t& adj_id, int32_t& adj_i, int32_t& adj_j, int32_t& adj_k, vec3& adj_result)
+{
+}
+
+CUDA_CALLABLE inline int32_t volume_lookup_i(uint64_t id, int32_t i, int32_t j, int32_t k)
+{
+    const Volume& volume = *(const Volume*)(id);
+    if (volume.grid_type != PNANOVDB_GRID_TYPE_INT32)
+        return 0;
+
+    const pnanovdb_root_handle_t root = pnanovdb_tree_get_root(volume.buf, volume.tree);
+    const pnanovdb_coord_t ijk{ i, j, k };
+
+    return pnanovdb_read_int32(volume.buf, pnanovdb_root_get_value_address(PNANOVDB_GRID_TYPE_INT32, volume.buf, root, PNANOVDB_REF(ijk)));
+}
+
+CUDA_CALLABLE inline void adj_volume_lookup_i(
+    uint64_t id, int32_t i, int32_t j, int32_t k, uint64_t& adj_id, int32_t& adj_i, int32_t& adj_j, int32_t& adj_k, int32_t& adj_result)
+{
+}
+
+// Volume handle with a persistent read accessor, created once per thread and reused across samples
+// so that spatially coherent queries (e.g.: ray marching) hit the cached leaf and internal nodes
+// instead of traversing the tree from the root for every sample
+struct volume_accessor_t
+{
+    CUDA_CALLABLE volume_accessor_t()
+    {
+    }
+    CUDA_CALLABLE volume_accessor_t(int)
+    {
+    } // for backward pass
+
+    Volume volume;
+    pnanovdb_readaccessor_t accessor;
+};
+
+CUDA_CALLABLE inline volume_accessor_t volume_accessor(uint64_t id)
+{
+    volume_accessor_t result;
+    result.volume = *(const Volume*)(id);
+    result.accessor = volume_accessor_init(result.volume);
+
+    return result;
+}
+
+CUDA_CALLABLE inline void adj_volume_accessor(uint64_t id, uint64_t& adj_id, volume_accessor_t& adj_result)
+{
+}
+
+CUDA_CALLABLE inline float volume_sample_local(volume_accessor_t& acc, vec3 uvw, int sampling_mode)
+{
+    return volume_sample_f(acc.volume, acc.accessor, uvw, sampling_mode);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_local(
+    volume_accessor_t& acc, vec3 uvw, int sampling_mode, volume_accessor_t& adj_acc, vec3& adj_uvw, int& adj_sampling_mode, float& adj_result)
+{
+}
+
+CUDA_CALLABLE inline float volume_sample_world(volume_accessor_t& acc, vec3 xyz, int sampling_mode)
+{
+    return volume_sample_f(acc.volume, acc.accessor, volume_world_to_index(acc.volume, xyz), sampling_mode);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_world(
+    volume_accessor_t& acc, vec3 xyz, int sampling_mode, volume_accessor_t& adj_acc, vec3& adj_xyz, int& adj_sampling_mode, float& adj_result)
+{
+}
+
+CUDA_CALLABLE inline vec3 volume_sample_local_v(volume_accessor_t& acc, vec3 uvw, int sampling_mode)
+{
+    return volume_sample_v(acc.volume, acc.accessor, uvw, sampling_mode);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_local_v(
+    volume_accessor_t& acc, vec3 uvw, int sampling_mode, volume_accessor_t& adj_acc, vec3& adj_uvw, int& adj_sampling_mode, vec3& adj_result)
+{
+}
+
+CUDA_CALLABLE inline vec3 volume_sample_world_v(volume_accessor_t& acc, vec3 xyz, int sampling_mode)
+{
+    return volume_sample_v(acc.volume, acc.accessor, volume_world_to_index(acc.volume, xyz), sampling_mode);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_world_v(
+    volume_accessor_t& acc, vec3 xyz, int sampling_mode, volume_accessor_t& adj_acc, vec3& adj_xyz, int& adj_sampling_mode, vec3& adj_result)
+{
+}
+
+CUDA_CALLABLE inline float volume_sample_grad_local(volume_accessor_t& acc, vec3 uvw, vec3& grad)
+{
+    return volume_sample_grad_f(acc.volume, acc.accessor, uvw, grad);
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_grad_local(
+    volume_accessor_t& acc, vec3 uvw, vec3& grad, volume_accessor_t& adj_acc, vec3& adj_uvw, vec3& adj_grad, float& adj_result)
+{
+}
+
+CUDA_CALLABLE inline float volume_sample_grad_world(volume_accessor_t& acc, vec3 xyz, vec3& grad)
+{
+    vec3 grad_index;
+    const float val = volume_sample_grad_f(acc.volume, acc.accessor, volume_world_to_index(acc.volume, xyz), grad_index);
+
+    grad = volume_grad_to_world(acc.volume, grad_index);
+    return val;
+}
+
+CUDA_CALLABLE inline void adj_volume_sample_grad_world(
+    volume_accessor_t& acc, vec3 xyz, vec3& grad, volume_accessor_t& adj_acc, vec3& adj_xyz, vec3& adj_grad, float& adj_result)
+{
+}
+
+CUDA_CALLABLE inline float volume_lookup(volume_accessor_t& acc, int32_t i, int32_t j, int32_t k)
+{
+    const pnanovdb_coord_t ijk{ i, j, k };
+
+    switch (acc.volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_FLOAT: return volume_read<PNANOVDB_GRID_TYPE_FLOAT>(acc.volume, acc.accessor, ijk);
+        case PNANOVDB_GRID_TYPE_DOUBLE: return volume_read<PNANOVDB_GRID_TYPE_DOUBLE>(acc.volume, acc.accessor, ijk);
+        case PNANOVDB_GRID_TYPE_INT32: return volume_read<PNANOVDB_GRID_TYPE_INT32>(acc.volume, acc.accessor, ijk);
+        default: return 0.0f;
+    }
+}
+
+CUDA_CALLABLE inline void adj_volume_lookup(
+    volume_accessor_t& acc, int32_t i, int32_t j, int32_t k, volume_accessor_t& adj_acc, int32_t& adj_i, int32_t& adj_j, int32_t& adj_k, float& adj_result)
+{
+}
+
+CUDA_CALLABLE inline vec3 volume_lookup_v(volume_accessor_t& acc, int32_t i, int32_t j, int32_t k)
+{
+    const pnanovdb_coord_t ijk{ i, j, k };
+
+    switch (acc.volume.grid_type)
+    {
+        case PNANOVDB_GRID_TYPE_VEC3F: return volume_read<PNANOVDB_GRID_TYPE_VEC3F>(acc.volume, acc.accessor, ijk);
+        case PNANOVDB_GRID_TYPE_VEC3D: return volume_read<PNANOVDB_GRID_TYPE_VEC3D>(acc.volume, acc.accessor, ijk);
+        default: return vec3(0.0f);
+    }
+}
+
+CUDA_CALLABLE inline void adj_volume_lookup_v(
+    volume_accessor_t& acc, int32_t i, int32_t j, int32_t k, volume_accessor_t& adj_acc, int32_t& adj_i, int32_t& adj_j, int32_t& adj_k, vec3& adj_result)
+{
+}
+
+CUDA_CALLABLE inline int32_t volume_lookup_i(volume_accessor_t& acc, int32_t i, int32_t j, int32_t k)
+{
+    if (acc.volume.grid_type != PNANOVDB_GRID_TYPE_INT32)
+        return 0;
+
+    const pnanovdb_coord_t ijk{ i, j, k };
+    const pnanovdb_address_t address =
+        pnanovdb_readaccessor_get_value_address(PNANOVDB_GRID_TYPE_INT32, acc.volume.buf, PNANOVDB_REF(acc.accessor), PNANOVDB_REF(ijk));
+
+    return pnanovdb_read_int32(acc.volume.buf, address);
+}
+
+CUDA_CALLABLE inline void adj_volume_lookup_i(
+    volume_accessor_t& acc, int32_t i, int32_t j, int32_t k, volume_accessor_t& adj_acc, int32_t& adj_i, int32_t& adj_j, int32_t& adj_k, int32_t& adj_result)
+{
+}
+
 // Index- to world-space space transformation
 CUDA_CALLABLE inline vec3 volume_transform(uint64_t id, vec3 uvw)
 {
-    const Volume volume = *(const Volume*)(id);
+    const Volume& volume = *(const Volume*)(id);
     const pnanovdb_vec3_t pos{ uvw.x, uvw.y, uvw.z };
     const pnanovdb_vec3_t xyz = pnanovdb_grid_index_to_worldf(volume.buf, volume.grid, PNANOVDB_REF(pos));
     return { xyz.x, xyz.y, xyz.z };
@@ -130,7 +544,7 @@ CUDA_CALLABLE inline void adj_volume_transform(uint64_t id, vec3 uvw, uint64_t&
 // World- to index-space transformation
 CUDA_CALLABLE inline vec3 volume_transform_inv(uint64_t id, vec3 xyz)
 {
-    const Volume volume = *(const Volume*)(id);
+    const Volume& volume = *(const Volume*)(id);
     const pnanovdb_vec3_t pos{ xyz.x, xyz.y, xyz.z };
     const pnanovdb_vec3_t uvw = pnanovdb_grid_world_to_indexf(volume.buf, volume.grid, PNANOVDB_REF(pos));
     return { uvw.x, uvw.y, uvw.z };
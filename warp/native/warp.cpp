@@ -11,15 +11,234 @@
 #include "stdlib.h"
 #include "string.h"
 
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// set while a thread executes tasks of a launch, launches issued from inside a task run inline
+static thread_local bool t_in_parallel_for = false;
+
+// simple pool of persistent worker threads used to execute CPU kernel launches,
+// each launch is split into chunks that are claimed by workers through an atomic counter
+struct CPUThreadPool
+{
+    typedef void (*Task)(void* ctx, int begin, int end);
+
+    std::vector<std::thread> workers;
+
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable done;
+
+    // held for the duration of a launch, serializes launches issued from different threads
+    std::mutex launch_mutex;
+
+    // current job
+    Task task = NULL;
+    void* ctx = NULL;
+    int dim = 0;
+    int grain = 1;
+    std::atomic<int> next;
+
+    int pending = 0;
+    uint64_t generation = 0;
+    bool quit = false;
+
+    // total threads including the caller, 0 means use hardware concurrency
+    int num_threads = 0;
+
+    CPUThreadPool() : next(0) {}
+
+    int get_num_threads()
+    {
+        if (num_threads <= 0)
+            return std::max(1, int(std::thread::hardware_concurrency()));
+        else
+            return num_threads;
+    }
+
+    void set_num_threads(int n)
+    {
+        std::lock_guard<std::mutex> launch_lock(launch_mutex);
+
+        stop();
+        num_threads = n;
+    }
+
+    // lazily spawn workers on first launch
+    void start()
+    {
+        const int num_workers = get_num_threads()-1;
+
+        if (int(workers.size()) == num_workers)
+            return;
+
+        stop();
+
+        // workers of a resized pool must not run the job of the last launch again
+        uint64_t current;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            current = generation;
+        }
+
+        for (int i=0; i < num_workers; ++i)
+            workers.push_back(std::thread(&CPUThreadPool::worker_main, this, current));
+    }
+
+    void stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            quit = true;
+        }
+        wake.notify_all();
+
+        for (size_t i=0; i < workers.size(); ++i)
+            workers[i].join();
+
+        workers.clear();
+        quit = false;
+    }
+
+    void run_chunks()
+    {
+        t_in_parallel_for = true;
+
+        for (;;)
+        {
+            const int begin = next.fetch_add(grain);
+            if (begin >= dim)
+                break;
+
+            task(ctx, begin, std::min(begin+grain, dim));
+        }
+
+        t_in_parallel_for = false;
+    }
+
+    // last is the generation current when the worker was spawned, it only wakes for later launches
+    void worker_main(uint64_t last)
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                wake.wait(lock, [&]{ return quit || generation != last; });
+
+                if (quit)
+                    return;
+
+                last = generation;
+            }
+
+            run_chunks();
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (--pending == 0)
+                    done.notify_one();
+            }
+        }
+    }
+
+    void parallel_for(Task t, void* c, int n, int g)
+    {
+        if (n <= 0)
+            return;
+
+        // launched from inside a task of another launch, this or another thread
+        // of the outer launch holds launch_mutex so the nested launch runs inline
+        if (t_in_parallel_for)
+        {
+            t(c, 0, n);
+            return;
+        }
+
+        std::unique_lock<std::mutex> launch_lock(launch_mutex);
+
+        const int threads = get_num_threads();
+
+        if (g <= 0)
+            g = std::max(1, n/(threads*4));
+
+        // single chunk or single thread
+        if (threads == 1 || n <= g)
+        {
+            t_in_parallel_for = true;
+            t(c, 0, n);
+            t_in_parallel_for = false;
+            return;
+        }
+
+        start();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+
+            task = t;
+            ctx = c;
+            dim = n;
+            grain = g;
+            next = 0;
+
+            pending = int(workers.size());
+            generation++;
+        }
+        wake.notify_all();
+
+        // calling thread participates
+        run_chunks();
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [&]{ return pending == 0; });
+    }
+};
+
+// allocated on first use and intentionally never deleted, joining threads
+// from a static destructor during library unload is not safe on all platforms
+static CPUThreadPool* g_cpu_pool;
+
+static CPUThreadPool& cpu_pool()
+{
+    static std::once_flag flag;
+    std::call_once(flag, []{ g_cpu_pool = new CPUThreadPool(); });
+
+    return *g_cpu_pool;
+}
+
+void cpu_parallel_for(void (*task)(void* ctx, int begin, int end), void* ctx, int dim, int grain)
+{
+    cpu_pool().parallel_for(task, ctx, dim, grain);
+}
+
+void cpu_set_num_threads(int num_threads)
+{
+    cpu_pool().set_num_threads(num_threads);
+}
+
+int cpu_get_num_threads()
+{
+    return cpu_pool().get_num_threads();
+}
+
 int cuda_init();
 
 int init()
 {
+    // allows runtime functions such as the array reductions to use cpu_launch()
+    wp::s_cpu_scheduler = &cpu_parallel_for;
+
     return cuda_init();
 }
 
 void shutdown()
 {
+    if (g_cpu_pool)
+        g_cpu_pool->set_num_threads(g_cpu_pool->num_threads);
 }
 
 void* alloc_host(size_t s)
@@ -42,34 +261,13 @@ void memset_host(void* dest, int value, size_t n)
     memset(dest, value, n);
 }
 
-void array_inner_host(uint64_t a, uint64_t b, uint64_t out, int len)
-{
-    const float* ptr_a = (const float*)(a);
-    const float* ptr_b = (const float*)(b);
-    float* ptr_out = (float*)(out);
-
-    *ptr_out = 0.0f;
-    for (int i=0; i < len; ++i)
-        *ptr_out += ptr_a[i]*ptr_b[i];
-}
-
-void array_sum_host(uint64_t a, uint64_t out, int len)
-{
-    const float* ptr_a = (const float*)(a);
-    float* ptr_out = (float*)(out);
-
-    *ptr_out = 0.0f;
-    for (int i=0; i < len; ++i)
-        *ptr_out += ptr_a[i];
-}
-
-
-
 // impl. files
 #include "bvh.cpp"
 #include "mesh.cpp"
 #include "hashgrid.cpp"
 #include "sort.cpp"
+#include "reduce.cpp"
+#include "neighborlist.cpp"
 #include "volume.cpp"
 //#include "spline.inl"
 
@@ -88,6 +286,19 @@ void free_device(void* ptr)
 {
 }
 
+void array_sum_device(uint64_t a, uint64_t out, int len, int type) {}
+void array_inner_device(uint64_t a, uint64_t b, uint64_t out, int len, int type) {}
+void array_min_device(uint64_t a, uint64_t out, int len, int type) {}
+void array_max_device(uint64_t a, uint64_t out, int len, int type) {}
+void array_argmin_device(uint64_t a, uint64_t out, int len, int type) {}
+void array_argmax_device(uint64_t a, uint64_t out, int len, int type) {}
+void array_scan_device(uint64_t in, uint64_t out, int len, int type, bool inclusive) {}
+void sort_pairs_device(uint64_t keys, uint64_t values, int n, int key_type) {}
+
+bool cuda_mempool_enabled() { return false; }
+void cuda_mempool_trim(size_t min_bytes_to_keep) {}
+void cuda_mempool_get_stats(uint64_t* used, uint64_t* used_high, uint64_t* reserved, uint64_t* reserved_high) { *used = 0; *used_high = 0; *reserved = 0; *reserved_high = 0; }
+
 
 void memcpy_h2d(void* dest, void* src, size_t n)
 {
@@ -101,6 +312,10 @@ void memcpy_d2d(void* dest, void* src, size_t n)
 {
 }
 
+void memcpy_peer(int dest_device, void* dest, int src_device, void* src, size_t n)
+{
+}
+
 void memset_device(void* dest, int value, size_t n)
 {
 }
@@ -116,15 +331,41 @@ WP_API void cuda_restore_context() {}
 WP_API void* cuda_get_context() { return NULL;}
 WP_API void cuda_set_context(void* ctx) {}
 WP_API void* cuda_get_stream() { return NULL; }
-WP_API const char* cuda_get_device_name() { return "Not supported"; }
+WP_API void* alloc_pinned(size_t s) { return alloc_host(s); }
+WP_API void free_pinned(void* ptr) { free_host(ptr); }
+WP_API int cuda_device_get_count() { return 0; }
+WP_API int cuda_get_device() { return -1; }
+WP_API void cuda_set_device(int ordinal) {}
+WP_API const char* cuda_get_device_name(int ordinal) { return "Not supported"; }
+WP_API void cuda_set_stream(void* stream) {}
+WP_API void* cuda_stream_create() { return NULL; }
+WP_API void cuda_stream_destroy(void* stream) {}
+WP_API void cuda_stream_synchronize(void* stream) {}
+WP_API void cuda_stream_wait_event(void* stream, void* event) {}
+WP_API void* cuda_event_create(bool enable_timing) { return NULL; }
+WP_API void cuda_event_destroy(void* event) {}
+WP_API void cuda_event_record(void* event, void* stream) {}
+WP_API void cuda_event_synchronize(void* event) {}
+WP_API float cuda_event_elapsed_time(void* start, void* end) { return 0.0f; }
+WP_API bool nvtx_init() { return false; }
+WP_API void nvtx_range_push(const char* name) {}
+WP_API void nvtx_range_pop() {}
+WP_API bool cuda_is_capturing() { return false; }
 WP_API void cuda_graph_begin_capture() {}
 WP_API void* cuda_graph_end_capture() { return NULL; }
 WP_API void cuda_graph_launch(void* graph) {}
 WP_API void cuda_graph_destroy(void* graph) {}
-WP_API size_t cuda_compile_program(const char* cuda_src, const char* include_dir, bool debug, bool verbose, const char* output_file) { return 0; }
+WP_API int cuda_graph_get_kernel_count(void* graph) { return 0; }
+WP_API void* cuda_graph_get_kernel(void* graph, int index) { return NULL; }
+WP_API bool cuda_graph_set_kernel_params(void* graph, int index, void** args) { return false; }
+WP_API int cuda_get_device_arch(int ordinal) { return 0; }
+WP_API int nvrtc_get_version() { return 0; }
+WP_API size_t cuda_compile_program(const char* cuda_src, const char* include_dir, int arch, bool debug, bool verbose, bool ptx, const char* output_file) { return 0; }
 WP_API void* cuda_load_module(const char* ptx) { return NULL; }
 WP_API void cuda_unload_module(void* module) {}
 WP_API void* cuda_get_kernel(void* module, const char* name) { return NULL; }
-WP_API size_t cuda_launch_kernel(void* kernel, size_t dim, void** args) { return 0;}
+WP_API int cuda_get_kernel_block_dim(void* kernel) { return 0; }
+WP_API size_t cuda_launch_kernel(void* kernel, const int* shape, int ndim, int block_dim, void** args) { return 0;}
+WP_API size_t cuda_launch_kernels(void** kernels, const int* block_dims, void*** args, int count) { return 0;}
 
 #endif // __APPLE__
\ No newline at end of file
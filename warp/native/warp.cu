@@ -7,10 +7,15 @@
  */
 
 #include "warp.h"
+#include "sort.h"
 
 #include <cuda.h>
 #include <cuda_runtime_api.h>
 
+#include <vector>
+#include <cstring>
+#include <unordered_map>
+
 #if defined(__linux__)
 #include <dlfcn.h>
 static void* GetProcAddress(void* handle, const char* name) { return dlsym(handle, name); }
@@ -34,6 +39,21 @@ typedef CUresult CUDAAPI cuModuleLoadDataEx_t(CUmodule *module, const void *imag
 typedef CUresult CUDAAPI cuModuleGetFunction_t(CUfunction *hfunc, CUmodule hmod, const char *name);
 
 typedef CUresult CUDAAPI cuLaunchKernel_t(CUfunction f, unsigned int gridDimX, unsigned int gridDimY, unsigned int gridDimZ, unsigned int blockDimX, unsigned int blockDimY, unsigned int blockDimZ, unsigned int sharedMemBytes, CUstream hStream, void **kernelParams, void **extra);
+typedef CUresult CUDAAPI cuOccupancyMaxPotentialBlockSize_t(int* minGridSize, int* blockSize, CUfunction func, CUoccupancyB2DSize blockSizeToDynamicSMemSize, size_t dynamicSMemSize, int blockSizeLimit);
+
+// layout of the original (v1) CUDA_KERNEL_NODE_PARAMS, newer headers redefine the name to a larger struct
+struct kernel_node_params_t
+{
+    CUfunction func;
+    unsigned int gridDimX, gridDimY, gridDimZ;
+    unsigned int blockDimX, blockDimY, blockDimZ;
+    unsigned int sharedMemBytes;
+    void** kernelParams;
+    void** extra;
+};
+
+typedef CUresult CUDAAPI cuGraphKernelNodeGetParams_t(CUgraphNode hNode, kernel_node_params_t* nodeParams);
+typedef CUresult CUDAAPI cuGraphExecKernelNodeSetParams_t(CUgraphExec hGraphExec, CUgraphNode hNode, const kernel_node_params_t* nodeParams);
 
 static cuInit_t* cuInit_f;
 static cuCtxGetCurrent_t* cuCtxGetCurrent_f;
@@ -43,16 +63,79 @@ static cuModuleUnload_t* cuModuleUnload_f;
 static cuModuleLoadDataEx_t* cuModuleLoadDataEx_f;
 static cuModuleGetFunction_t* cuModuleGetFunction_f;
 static cuLaunchKernel_t* cuLaunchKernel_f;
+static cuOccupancyMaxPotentialBlockSize_t* cuOccupancyMaxPotentialBlockSize_f;
+static cuGraphKernelNodeGetParams_t* cuGraphKernelNodeGetParams_f;
+static cuGraphExecKernelNodeSetParams_t* cuGraphExecKernelNodeSetParams_f;
 
 //static cuCtxCreate_t* cuCtxCreate_f;
 //static cuCtxDestroy_t* cuCtxDestroy_f;
 //static cuDeviceGet_t* cuDeviceGet_f;
 
+// per-device state created at init, the globals below cache the entry of the current device
+struct DeviceInfo
+{
+    CUcontext context;
+    cudaStream_t default_stream;
+    cudaStream_t stream;
+    bool mempool_enabled;
+    int arch;
+    char name[256];
+
+    // used to order the streams of two devices around peer copies
+    cudaEvent_t peer_event;
+};
+
+static std::vector<DeviceInfo> g_devices;
+
+// peer access is enabled on the first copy between a pair of devices, indexed by device*count + peer
+static std::vector<bool> g_peer_access;
+
+// ordinal of the current device, selected with cuda_set_device(), -1 if no device is available
+static int g_cuda_device = -1;
+
 static CUcontext g_cuda_context;
 static CUcontext g_save_context;
 
+// stream created at init, used whenever no other stream has been made current
+static cudaStream_t g_cuda_default_stream;
+
+// current stream, all runtime copies, memsets, sorts, and kernel launches are issued on it
 static cudaStream_t g_cuda_stream;
 
+// stream-ordered allocations through the device's default memory pool (CUDA 11.2+)
+static bool g_cuda_mempool_enabled;
+
+static void device_init(DeviceInfo& info, int ordinal)
+{
+    check_cuda(cudaStreamCreate(&info.default_stream));
+    info.stream = info.default_stream;
+
+    check_cuda(cudaEventCreateWithFlags(&info.peer_event, cudaEventDisableTiming));
+
+    cudaDeviceProp prop;
+    if (cudaGetDeviceProperties(&prop, ordinal) == cudaSuccess)
+    {
+        info.arch = prop.major*10 + prop.minor;
+        strncpy(info.name, prop.name, sizeof(info.name)-1);
+    }
+
+    int mempool_supported = 0;
+    cudaDeviceGetAttribute(&mempool_supported, cudaDevAttrMemoryPoolsSupported, ordinal);
+
+    if (mempool_supported)
+    {
+        cudaMemPool_t pool;
+        check_cuda(cudaDeviceGetDefaultMemPool(&pool, ordinal));
+
+        // keep freed memory in the pool instead of releasing it
+        // back to the OS at each stream synchronization point
+        uint64_t threshold = UINT64_MAX;
+        check_cuda(cudaMemPoolSetAttribute(pool, cudaMemPoolAttrReleaseThreshold, &threshold));
+
+        info.mempool_enabled = true;
+    }
+}
+
 int cuda_init()
 {
     #if defined(_WIN32)
@@ -71,6 +154,9 @@ int cuda_init()
     cuModuleLoadDataEx_f = (cuModuleLoadDataEx_t*)GetProcAddress(hCudaDriver, "cuModuleLoadDataEx");
     cuModuleGetFunction_f = (cuModuleGetFunction_t*)GetProcAddress(hCudaDriver, "cuModuleGetFunction");
     cuLaunchKernel_f = (cuLaunchKernel_t*)GetProcAddress(hCudaDriver, "cuLaunchKernel");
+    cuOccupancyMaxPotentialBlockSize_f = (cuOccupancyMaxPotentialBlockSize_t*)GetProcAddress(hCudaDriver, "cuOccupancyMaxPotentialBlockSize");
+    cuGraphKernelNodeGetParams_f = (cuGraphKernelNodeGetParams_t*)GetProcAddress(hCudaDriver, "cuGraphKernelNodeGetParams");
+    cuGraphExecKernelNodeSetParams_f = (cuGraphExecKernelNodeSetParams_t*)GetProcAddress(hCudaDriver, "cuGraphExecKernelNodeSetParams");
 
     if (cuInit_f == NULL)
         return -1;
@@ -79,50 +165,250 @@ int cuda_init()
     if (err != CUDA_SUCCESS)
 		return err;
 
+    int count = 0;
+    if (cudaGetDeviceCount(&count) != cudaSuccess || count == 0)
+        return -1;
+
     CUcontext ctx;
     cuCtxGetCurrent_f(&ctx);
 
-    if (ctx == NULL)
+    // a context made current by the application is used for its device,
+    // all other devices use their primary context
+    int current = 0;
+    if (ctx != NULL)
+        cudaGetDevice(&current);
+
+    g_devices.resize(count);
+    g_peer_access.resize(count*count, false);
+
+    for (int i=0; i < count; ++i)
     {
-        // create a new default runtime context
-        cudaSetDevice(0);
-        cuCtxGetCurrent_f(&ctx);
+        DeviceInfo& info = g_devices[i];
+        memset(&info, 0, sizeof(DeviceInfo));
+
+        if (ctx != NULL && i == current)
+        {
+            info.context = ctx;
+            cuCtxSetCurrent_f(ctx);
+        }
+        else
+        {
+            // create the primary context of the device
+            cudaSetDevice(i);
+            cudaFree(0);
+            cuCtxGetCurrent_f(&info.context);
+        }
+
+        device_init(info, i);
     }
-    
-    // save the context, all API calls must have this context set on the calling thread
-    g_cuda_context = ctx;
-    
-    check_cuda(cudaStreamCreate(&g_cuda_stream));
-    
+
+    // all API calls must have the current device's context set on the calling thread
+    cuda_set_device(current);
+
     return 0;
 }
 
-// void* alloc_host(size_t s)
-// {
-//     void* ptr;
-//     check_cuda(cudaMallocHost(&ptr, s));
-//     return ptr;
-// }
+int cuda_device_get_count()
+{
+    return int(g_devices.size());
+}
+
+int cuda_get_device()
+{
+    return g_cuda_device;
+}
+
+void cuda_set_device(int ordinal)
+{
+    if (ordinal < 0 || ordinal >= int(g_devices.size()) || ordinal == g_cuda_device)
+        return;
+
+    // the current stream is remembered per device
+    if (g_cuda_device >= 0)
+        g_devices[g_cuda_device].stream = g_cuda_stream;
 
-// void free_host(void* ptr)
-// {
-//     cudaFreeHost(ptr);
-// }
+    const DeviceInfo& info = g_devices[ordinal];
+
+    g_cuda_device = ordinal;
+    g_cuda_context = info.context;
+    g_cuda_default_stream = info.default_stream;
+    g_cuda_stream = info.stream;
+    g_cuda_mempool_enabled = info.mempool_enabled;
+
+    cuCtxSetCurrent_f(g_cuda_context);
+}
+
+void* alloc_pinned(size_t s)
+{
+    void* ptr = NULL;
+    check_cuda(cudaMallocHost(&ptr, s));
+    return ptr;
+}
+
+void free_pinned(void* ptr)
+{
+    check_cuda(cudaFreeHost(ptr));
+}
 
 void* alloc_device(size_t s)
 {
-    void* ptr;
-    check_cuda(cudaMalloc(&ptr, s));
+    void* ptr = NULL;
+
+    if (g_cuda_mempool_enabled)
+    {
+        check_cuda(cudaMallocAsync(&ptr, s, g_cuda_stream));
+    }
+    else
+    {
+        check_cuda(cudaMalloc(&ptr, s));
+    }
+
     return ptr;
 }
 
 void free_device(void* ptr)
 {
-    check_cuda(cudaFree(ptr));
+    if (g_cuda_mempool_enabled)
+    {
+        check_cuda(cudaFreeAsync(ptr, g_cuda_stream));
+    }
+    else
+    {
+        check_cuda(cudaFree(ptr));
+    }
+}
+
+bool cuda_mempool_enabled()
+{
+    return g_cuda_mempool_enabled;
+}
+
+void cuda_mempool_trim(size_t min_bytes_to_keep)
+{
+    if (!g_cuda_mempool_enabled)
+        return;
+
+    int device = 0;
+    cudaGetDevice(&device);
+
+    cudaMemPool_t pool;
+    check_cuda(cudaDeviceGetDefaultMemPool(&pool, device));
+
+    // pending stream-ordered frees must complete before memory can be released
+    check_cuda(cudaDeviceSynchronize());
+    check_cuda(cudaMemPoolTrimTo(pool, min_bytes_to_keep));
+}
+
+void cuda_mempool_get_stats(uint64_t* used, uint64_t* used_high, uint64_t* reserved, uint64_t* reserved_high)
+{
+    *used = 0;
+    *used_high = 0;
+    *reserved = 0;
+    *reserved_high = 0;
+
+    if (!g_cuda_mempool_enabled)
+        return;
+
+    int device = 0;
+    cudaGetDevice(&device);
+
+    cudaMemPool_t pool;
+    check_cuda(cudaDeviceGetDefaultMemPool(&pool, device));
+
+    cudaMemPoolGetAttribute(pool, cudaMemPoolAttrUsedMemCurrent, used);
+    cudaMemPoolGetAttribute(pool, cudaMemPoolAttrUsedMemHigh, used_high);
+    cudaMemPoolGetAttribute(pool, cudaMemPoolAttrReservedMemCurrent, reserved);
+    cudaMemPoolGetAttribute(pool, cudaMemPoolAttrReservedMemHigh, reserved_high);
+}
+
+bool cuda_is_capturing()
+{
+    cudaStreamCaptureStatus status = cudaStreamCaptureStatusNone;
+    cudaStreamIsCapturing(g_cuda_stream, &status);
+
+    return status != cudaStreamCaptureStatusNone;
+}
+
+static bool is_pinned(const void* ptr)
+{
+    cudaPointerAttributes attr;
+    if (cudaPointerGetAttributes(&attr, ptr) != cudaSuccess)
+    {
+        // older runtimes report unregistered host memory as an error
+        cudaGetLastError();
+        return false;
+    }
+
+    return attr.type == cudaMemoryTypeHost;
+}
+
+// pinned staging buffers for uploads from pageable memory, the source is copied
+// into a staging buffer so the upload no longer blocks the host, each buffer is
+// reused once the event recorded after its last upload has completed
+struct StagingBuffer
+{
+    void* ptr;
+    size_t size;
+    cudaEvent_t event;
+    int device;
+};
+
+static std::vector<StagingBuffer> g_staging_buffers;
+
+// larger uploads go directly through the driver
+static const size_t kMaxStagingSize = 16*1024*1024;
+static const size_t kMinStagingSize = 64*1024;
+static const int kMaxStagingBuffers = 8;
+
+static StagingBuffer* staging_acquire(size_t n)
+{
+    for (size_t i=0; i < g_staging_buffers.size(); ++i)
+    {
+        StagingBuffer& buf = g_staging_buffers[i];
+
+        // events can only be recorded on streams of the device they were created on
+        if (buf.device == g_cuda_device && buf.size >= n && cudaEventQuery(buf.event) == cudaSuccess)
+            return &buf;
+    }
+
+    if (int(g_staging_buffers.size()) >= kMaxStagingBuffers)
+        return NULL;
+
+    size_t size = kMinStagingSize;
+    while (size < n)
+        size *= 2;
+
+    StagingBuffer buf;
+    buf.size = size;
+    buf.device = g_cuda_device;
+    buf.ptr = alloc_pinned(size);
+    
+    if (!buf.ptr)
+        return NULL;
+
+    check_cuda(cudaEventCreateWithFlags(&buf.event, cudaEventDisableTiming));
+
+    g_staging_buffers.push_back(buf);
+    return &g_staging_buffers.back();
 }
 
 void memcpy_h2d(void* dest, void* src, size_t n)
 {
+    // graph capture records the host pointer, so staging cannot be used
+    if (n <= kMaxStagingSize && !cuda_is_capturing() && !is_pinned(src))
+    {
+        StagingBuffer* buf = staging_acquire(n);
+
+        if (buf)
+        {
+            memcpy(buf->ptr, src, n);
+
+            check_cuda(cudaMemcpyAsync(dest, buf->ptr, n, cudaMemcpyHostToDevice, g_cuda_stream));
+            check_cuda(cudaEventRecord(buf->event, g_cuda_stream));
+            return;
+        }
+    }
+
     check_cuda(cudaMemcpyAsync(dest, src, n, cudaMemcpyHostToDevice, g_cuda_stream));
 }
 
@@ -161,30 +447,104 @@ void memset_device(void* dest, int value, size_t n)
     }
 }
 
-void synchronize()
+static void peer_access_enable(int peer)
 {
-    check_cuda(cudaStreamSynchronize(g_cuda_stream));
+    bool& enabled = g_peer_access[g_cuda_device*g_devices.size() + peer];
+
+    if (!enabled)
+    {
+        int can_access = 0;
+        cudaDeviceCanAccessPeer(&can_access, g_cuda_device, peer);
+
+        if (can_access)
+        {
+            // without peer access the driver stages copies through host memory
+            if (cudaDeviceEnablePeerAccess(peer, 0) == cudaErrorPeerAccessAlreadyEnabled)
+                cudaGetLastError();
+
+            // allocations from the peer's memory pool are mapped separately
+            if (g_devices[peer].mempool_enabled)
+            {
+                cudaMemPool_t pool;
+                check_cuda(cudaDeviceGetDefaultMemPool(&pool, peer));
+
+                cudaMemAccessDesc desc;
+                desc.location.type = cudaMemLocationTypeDevice;
+                desc.location.id = g_cuda_device;
+                desc.flags = cudaMemAccessFlagsProtReadWrite;
+
+                check_cuda(cudaMemPoolSetAccess(pool, &desc, 1));
+            }
+        }
+
+        enabled = true;
+    }
 }
 
-void array_inner_device(uint64_t a, uint64_t b, uint64_t out, int len)
+void memcpy_peer(int dest_device, void* dest, int src_device, void* src, size_t n)
 {
+    if (src_device == dest_device)
+    {
+        memcpy_d2d(dest, src, n);
+        return;
+    }
+
+    if (src_device < 0 || src_device >= int(g_devices.size()) || dest_device != g_cuda_device)
+    {
+        printf("Warp: Invalid devices for peer copy, dest: %d src: %d current: %d\n", dest_device, src_device, g_cuda_device);
+        return;
+    }
+
+    peer_access_enable(src_device);
+
+    const DeviceInfo& src_info = g_devices[src_device];
+    DeviceInfo& dest_info = g_devices[dest_device];
+
+    // the copy is issued on the current stream of the destination device, it waits for
+    // prior work on the source device's stream, which in turn waits for the copy to
+    // complete before later work on it can overwrite the source, captured copies are
+    // ordered by the application
+    const bool capturing = cuda_is_capturing();
 
+    if (!capturing)
+    {
+        cuCtxSetCurrent_f(src_info.context);
+        check_cuda(cudaEventRecord(src_info.peer_event, src_info.stream));
+        cuCtxSetCurrent_f(dest_info.context);
+
+        check_cuda(cudaStreamWaitEvent(g_cuda_stream, src_info.peer_event, 0));
+    }
+
+    check_cuda(cudaMemcpyPeerAsync(dest, dest_device, src, src_device, n, g_cuda_stream));
+
+    if (!capturing)
+    {
+        check_cuda(cudaEventRecord(dest_info.peer_event, g_cuda_stream));
+
+        cuCtxSetCurrent_f(src_info.context);
+        check_cuda(cudaStreamWaitEvent(src_info.stream, dest_info.peer_event, 0));
+        cuCtxSetCurrent_f(dest_info.context);
+    }
 }
 
-void array_sum_device(uint64_t a, uint64_t out, int len)
+// waits for work on all streams of all devices
+void synchronize()
 {
-    
+    for (size_t i=0; i < g_devices.size(); ++i)
+    {
+        cuCtxSetCurrent_f(g_devices[i].context);
+        check_cuda(cudaDeviceSynchronize());
+    }
+
+    cuCtxSetCurrent_f(g_cuda_context);
 }
 
 
 uint64_t cuda_check_device()
 {
-    cudaStreamCaptureStatus status;
-    cudaStreamIsCapturing(g_cuda_stream, &status);
-    
     // do not check during cuda stream capture
     // since we cannot synchronize the device
-    if (status == cudaStreamCaptureStatusNone)
+    if (!cuda_is_capturing())
     {
         cudaDeviceSynchronize();
         return cudaPeekAtLastError(); 
@@ -208,11 +568,139 @@ void* cuda_get_stream()
     return g_cuda_stream;
 }
 
+void cuda_set_stream(void* stream)
+{
+    g_cuda_stream = stream ? (cudaStream_t)stream : g_cuda_default_stream;
+}
+
+void* cuda_stream_create()
+{
+    cudaStream_t stream = NULL;
+    check_cuda(cudaStreamCreate(&stream));
+
+    return stream;
+}
+
+void cuda_stream_destroy(void* stream)
+{
+    if (!stream || stream == g_cuda_default_stream)
+        return;
+
+    // scratch memory may still be in use by work on the stream
+    check_cuda(cudaStreamSynchronize((cudaStream_t)stream));
+
+    radix_sort_release(stream);
+
+    if (g_cuda_stream == stream)
+        g_cuda_stream = g_cuda_default_stream;
+
+    check_cuda(cudaStreamDestroy((cudaStream_t)stream));
+}
+
+void cuda_stream_synchronize(void* stream)
+{
+    check_cuda(cudaStreamSynchronize((cudaStream_t)stream));
+}
+
+void cuda_stream_wait_event(void* stream, void* event)
+{
+    check_cuda(cudaStreamWaitEvent((cudaStream_t)stream, (cudaEvent_t)event, 0));
+}
+
+void* cuda_event_create(bool enable_timing)
+{
+    cudaEvent_t event = NULL;
+    check_cuda(cudaEventCreateWithFlags(&event, enable_timing ? cudaEventDefault : cudaEventDisableTiming));
+
+    return event;
+}
+
+void cuda_event_destroy(void* event)
+{
+    check_cuda(cudaEventDestroy((cudaEvent_t)event));
+}
+
+void cuda_event_record(void* event, void* stream)
+{
+    check_cuda(cudaEventRecord((cudaEvent_t)event, (cudaStream_t)stream));
+}
+
+void cuda_event_synchronize(void* event)
+{
+    check_cuda(cudaEventSynchronize((cudaEvent_t)event));
+}
+
+float cuda_event_elapsed_time(void* start, void* end)
+{
+    float ms = 0.0f;
+    check_cuda(cudaEventElapsedTime(&ms, (cudaEvent_t)start, (cudaEvent_t)end));
+
+    return ms;
+}
+
+// NVTX is loaded on first use so that the library is only required while profiling
+typedef int nvtxRangePushA_t(const char* message);
+typedef int nvtxRangePop_t();
+
+static nvtxRangePushA_t* nvtxRangePushA_f;
+static nvtxRangePop_t* nvtxRangePop_f;
+
+bool nvtx_init()
+{
+    static bool initialized = false;
+
+    if (!initialized)
+    {
+    #if defined(_WIN32)
+        HMODULE hNvtx = LoadLibrary("nvToolsExt64_1.dll");
+    #elif defined(__linux__)
+        void* hNvtx = dlopen("libnvToolsExt.so.1", RTLD_NOW);
+        if (hNvtx == NULL)
+            hNvtx = dlopen("libnvToolsExt.so", RTLD_NOW);
+    #endif
+
+        if (hNvtx)
+        {
+            nvtxRangePushA_f = (nvtxRangePushA_t*)GetProcAddress(hNvtx, "nvtxRangePushA");
+            nvtxRangePop_f = (nvtxRangePop_t*)GetProcAddress(hNvtx, "nvtxRangePop");
+        }
+
+        initialized = true;
+    }
+
+    return nvtxRangePushA_f != NULL && nvtxRangePop_f != NULL;
+}
+
+void nvtx_range_push(const char* name)
+{
+    if (nvtxRangePushA_f)
+        nvtxRangePushA_f(name);
+}
+
+void nvtx_range_pop()
+{
+    if (nvtxRangePop_f)
+        nvtxRangePop_f();
+}
+
 void cuda_graph_begin_capture()
 {
     check_cuda(cudaStreamBeginCapture(g_cuda_stream, cudaStreamCaptureModeGlobal));
 }
 
+// captured graphs keep their source graph since kernel nodes can only be updated through its node handles
+struct CaptureGraph
+{
+    cudaGraph_t graph;
+    cudaGraphExec_t graph_exec;
+
+    // graphs are launched on the current stream of the device they were captured on
+    int device;
+
+    // kernel nodes in a topological order, for a single stream this is the order they were launched in
+    std::vector<cudaGraphNode_t> kernel_nodes;
+};
+
 void* cuda_graph_end_capture()
 {
     cudaGraph_t graph = NULL;
@@ -223,10 +711,64 @@ void* cuda_graph_end_capture()
         cudaGraphExec_t graph_exec = NULL;
         check_cuda(cudaGraphInstantiate(&graph_exec, graph, NULL, NULL, 0))
 
-        // free source graph
-        check_cuda(cudaGraphDestroy(graph));
+        if (graph_exec == NULL)
+        {
+            check_cuda(cudaGraphDestroy(graph));
+            return NULL;
+        }
+
+        CaptureGraph* capture = new CaptureGraph();
+        capture->graph = graph;
+        capture->graph_exec = graph_exec;
+        capture->device = g_cuda_device;
+
+        size_t num_nodes = 0;
+        check_cuda(cudaGraphGetNodes(graph, NULL, &num_nodes));
+
+        std::vector<cudaGraphNode_t> nodes(num_nodes);
+        check_cuda(cudaGraphGetNodes(graph, nodes.data(), &num_nodes));
+
+        // Kahn's algorithm, nodes become ready once all of their dependencies have been visited
+        std::vector<size_t> pending(num_nodes);
+        std::vector<cudaGraphNode_t> ready;
+        std::unordered_map<cudaGraphNode_t, size_t> node_index;
+
+        for (size_t i=0; i < num_nodes; ++i)
+        {
+            node_index[nodes[i]] = i;
+
+            check_cuda(cudaGraphNodeGetDependencies(nodes[i], NULL, &pending[i]));
 
-        return graph_exec;
+            if (pending[i] == 0)
+                ready.push_back(nodes[i]);
+        }
+
+        for (size_t r=0; r < ready.size(); ++r)
+        {
+            cudaGraphNode_t node = ready[r];
+
+            cudaGraphNodeType type;
+            check_cuda(cudaGraphNodeGetType(node, &type));
+
+            if (type == cudaGraphNodeTypeKernel)
+                capture->kernel_nodes.push_back(node);
+
+            size_t num_dependents = 0;
+            check_cuda(cudaGraphNodeGetDependentNodes(node, NULL, &num_dependents));
+
+            std::vector<cudaGraphNode_t> dependents(num_dependents);
+            check_cuda(cudaGraphNodeGetDependentNodes(node, dependents.data(), &num_dependents));
+
+            for (size_t d=0; d < num_dependents; ++d)
+            {
+                const size_t index = node_index[dependents[d]];
+
+                if (--pending[index] == 0)
+                    ready.push_back(dependents[d]);
+            }
+        }
+
+        return capture;
     }
     else
     {
@@ -234,14 +776,77 @@ void* cuda_graph_end_capture()
     }
 }
 
-void cuda_graph_launch(void* graph_exec)
+void cuda_graph_launch(void* graph)
+{
+    CaptureGraph* capture = (CaptureGraph*)graph;
+
+    const int current = g_cuda_device;
+    cuda_set_device(capture->device);
+
+    check_cuda(cudaGraphLaunch(capture->graph_exec, g_cuda_stream));
+
+    cuda_set_device(current);
+}
+
+void cuda_graph_destroy(void* graph)
 {
-    check_cuda(cudaGraphLaunch((cudaGraphExec_t)graph_exec, g_cuda_stream));
+    CaptureGraph* capture = (CaptureGraph*)graph;
+
+    const int current = g_cuda_device;
+    cuda_set_device(capture->device);
+
+    check_cuda(cudaGraphExecDestroy(capture->graph_exec));
+    check_cuda(cudaGraphDestroy(capture->graph));
+
+    cuda_set_device(current);
+
+    delete capture;
 }
 
-void cuda_graph_destroy(void* graph_exec)
+int cuda_graph_get_kernel_count(void* graph)
 {
-    check_cuda(cudaGraphExecDestroy((cudaGraphExec_t)graph_exec));
+    return int(((CaptureGraph*)graph)->kernel_nodes.size());
+}
+
+void* cuda_graph_get_kernel(void* graph, int index)
+{
+    CaptureGraph* capture = (CaptureGraph*)graph;
+
+    if (!cuGraphKernelNodeGetParams_f || index < 0 || index >= int(capture->kernel_nodes.size()))
+        return NULL;
+
+    kernel_node_params_t params;
+    if (cuGraphKernelNodeGetParams_f((CUgraphNode)capture->kernel_nodes[index], &params) != CUDA_SUCCESS)
+        return NULL;
+
+    return params.func;
+}
+
+bool cuda_graph_set_kernel_params(void* graph, int index, void** args)
+{
+    CaptureGraph* capture = (CaptureGraph*)graph;
+
+    if (!cuGraphKernelNodeGetParams_f || !cuGraphExecKernelNodeSetParams_f || index < 0 || index >= int(capture->kernel_nodes.size()))
+        return false;
+
+    CUgraphNode node = (CUgraphNode)capture->kernel_nodes[index];
+
+    // launch configuration comes from the captured node, parameter values are copied from args
+    kernel_node_params_t params;
+    if (cuGraphKernelNodeGetParams_f(node, &params) != CUDA_SUCCESS)
+        return false;
+
+    params.kernelParams = args;
+    params.extra = NULL;
+
+    CUresult res = cuGraphExecKernelNodeSetParams_f((CUgraphExec)capture->graph_exec, node, &params);
+    if (res != CUDA_SUCCESS)
+    {
+        printf("Warp: Failed to update graph kernel node parameters with error: %d\n", res);
+        return false;
+    }
+
+    return true;
 }
 
 void cuda_acquire_context()
@@ -264,20 +869,45 @@ void* cuda_get_context()
 void cuda_set_context(void* ctx)
 {
     g_cuda_context = (CUcontext)ctx;
+
+    if (g_cuda_device >= 0)
+        g_devices[g_cuda_device].context = g_cuda_context;
+}
+
+const char* cuda_get_device_name(int ordinal)
+{
+    if (ordinal < 0 || ordinal >= int(g_devices.size()))
+        return "Not supported";
+
+    return g_devices[ordinal].name;
 }
 
-const char* cuda_get_device_name()
+int cuda_get_device_arch(int ordinal)
 {
-    static cudaDeviceProp prop;
-    cudaGetDeviceProperties(&prop, 0);
+    if (ordinal < 0 || ordinal >= int(g_devices.size()))
+        return 0;
+
+    return g_devices[ordinal].arch;
+}
+
+int nvrtc_get_version()
+{
+    int major = 0;
+    int minor = 0;
+    nvrtcVersion(&major, &minor);
 
-    return prop.name;
+    return major*1000 + minor*10;
 }
 
-size_t cuda_compile_program(const char* cuda_src, const char* include_dir, bool debug, bool verbose, const char* output_file)
+size_t cuda_compile_program(const char* cuda_src, const char* include_dir, int arch, bool debug, bool verbose, bool ptx, const char* output_file)
 {
     nvrtcResult res;
 
+#if CUDA_VERSION < 11010
+    // nvrtc can only emit CUBIN from CUDA 11.1 onwards
+    ptx = true;
+#endif
+
     nvrtcProgram prog;
     res = nvrtcCreateProgram(
         &prog,          // prog
@@ -302,10 +932,15 @@ size_t cuda_compile_program(const char* cuda_src, const char* include_dir, bool
     strcpy(include_opt, "--include-path=");
     strcat(include_opt, include_dir);
 
+    // PTX targets a virtual architecture and is JIT compiled by the driver at load time,
+    // CUBIN contains SASS for the given real architecture and loads without a JIT step
+    char arch_opt[64];
+    sprintf(arch_opt, "--gpu-architecture=%s_%d", ptx ? "compute" : "sm", arch);
+
     const char *opts[] = 
     {   
         "--device-as-default-execution-space",
-        "--gpu-architecture=compute_52",
+        arch_opt,
 //        "--use_fast_math",
         "--std=c++11",
         "--define-macro=WP_CUDA",
@@ -318,19 +953,39 @@ size_t cuda_compile_program(const char* cuda_src, const char* include_dir, bool
 
     if (res == NVRTC_SUCCESS)
     {
-        // save ptx
-        size_t ptx_size;
-        nvrtcGetPTXSize(prog, &ptx_size);
-
-        char* ptx = (char*)malloc(ptx_size);
-        nvrtcGetPTX(prog, ptx);
+        // save ptx or cubin
+        size_t output_size = 0;
+        char* output = NULL;
+
+        if (ptx)
+        {
+            nvrtcGetPTXSize(prog, &output_size);
+            output = (char*)malloc(output_size);
+            nvrtcGetPTX(prog, output);
+        }
+#if CUDA_VERSION >= 11010
+        else
+        {
+            nvrtcGetCUBINSize(prog, &output_size);
+            output = (char*)malloc(output_size);
+            nvrtcGetCUBIN(prog, output);
+        }
+#endif
 
         // write to file
-        FILE* file = fopen(output_file, "w");
-        fwrite(ptx, 1, ptx_size, file);
-        fclose(file);
-
-        free(ptx);
+        FILE* file = fopen(output_file, "wb");
+        if (file)
+        {
+            fwrite(output, 1, output_size, file);
+            fclose(file);
+        }
+        else
+        {
+            printf("Warp: Failed to open %s for writing\n", output_file);
+            res = NVRTC_ERROR_INTERNAL_ERROR;
+        }
+
+        free(output);
     }
 
     if (res != NVRTC_SUCCESS || verbose)
@@ -351,9 +1006,16 @@ size_t cuda_compile_program(const char* cuda_src, const char* include_dir, bool
     return res;
 }
 
+// loads a PTX or CUBIN image, the driver detects the format
 void* cuda_load_module(const char* path)
 {
     FILE* file = fopen(path, "rb");
+    if (!file)
+    {
+        printf("Warp: Failed to open CUDA module %s\n", path);
+        return NULL;
+    }
+
     fseek(file, 0, SEEK_END);
     size_t length = ftell(file);
     fseek(file, 0, SEEK_SET);
@@ -364,14 +1026,14 @@ void* cuda_load_module(const char* path)
 
     if (result != length)
     {
-        printf("Warp: Failed to load PTX from disk, unexpected number of bytes\n");
+        printf("Warp: Failed to load CUDA module from disk, unexpected number of bytes\n");
         return NULL;
     }
 
     CUmodule module = NULL;
     CUresult res = cuModuleLoadDataEx_f(&module, buf, 0, 0, 0);
     if (res != CUDA_SUCCESS)
-        printf("Warp: Loading PTX module failed with error: %d\n", res);
+        printf("Warp: Loading CUDA module failed with error: %d\n", res);
 
     free(buf);
 
@@ -393,28 +1055,82 @@ void* cuda_get_kernel(void* module, const char* name)
     return kernel;
 }
 
-size_t cuda_launch_kernel(void* kernel, size_t dim, void** args)
+// default block size if the occupancy calculator is unavailable
+static const int kDefaultBlockDim = wp::LAUNCH_DEFAULT_BLOCK_DIM;
+
+// larger blocks rarely help Warp kernels and reduce the number of resident blocks for small launches
+static const int kMaxBlockDim = 256;
+
+int cuda_get_kernel_block_dim(void* kernel)
 {
-    const int block_dim = 256;
-    const int grid_dim = (dim + block_dim - 1)/block_dim;
+    if (!kernel || !cuOccupancyMaxPotentialBlockSize_f)
+        return kDefaultBlockDim;
+
+    int min_grid_size = 0;
+    int block_size = 0;
+
+    CUresult res = cuOccupancyMaxPotentialBlockSize_f(&min_grid_size, &block_size, (CUfunction)kernel, NULL, 0, kMaxBlockDim);
+    if (res != CUDA_SUCCESS || block_size <= 0)
+        return kDefaultBlockDim;
+
+    return block_size;
+}
+
+static CUresult launch_kernel(void* kernel, const int* shape, int ndim, int block_dim, void** args)
+{
+    // the last (fastest varying) launch dimension maps to x so that
+    // neighbouring threads access neighbouring elements in row-major arrays
+    unsigned int block[3];
+    unsigned int grid[3];
+
+    wp::launch_geometry(shape, ndim, block_dim, block, grid);
 
     CUresult res = cuLaunchKernel_f(
         (CUfunction)kernel,
-        grid_dim, 1, 1,
-        block_dim, 1, 1,
+        grid[0], grid[1], grid[2],
+        block[0], block[1], block[2],
         0, g_cuda_stream,
         args,
         0);
 
+    if (res != CUDA_SUCCESS)
+        printf("Warp: Kernel launch failed with error: %d, grid: (%u, %u, %u), block: (%u, %u, %u)\n", res, grid[0], grid[1], grid[2], block[0], block[1], block[2]);
+
     return res;
+}
+
+size_t cuda_launch_kernel(void* kernel, const int* shape, int ndim, int block_dim, void** args)
+{
+    return launch_kernel(kernel, shape, ndim, block_dim, args);
+}
+
+size_t cuda_launch_kernels(void** kernels, const int* block_dims, void*** args, int count)
+{
+    size_t result = CUDA_SUCCESS;
+
+    for (int i=0; i < count; ++i)
+    {
+        // the first parameter of every kernel is its launch bounds
+        const wp::launch_bounds_t* bounds = (const wp::launch_bounds_t*)args[i][0];
+
+        if (bounds->size == 0)
+            continue;
+
+        CUresult res = launch_kernel(kernels[i], bounds->shape, bounds->ndim, block_dims[i], args[i]);
+        if (res != CUDA_SUCCESS && result == CUDA_SUCCESS)
+            result = res;
+    }
 
+    return result;
 }
 
 // impl. files
 #include "bvh.cu"
 #include "mesh.cu"
 #include "sort.cu"
+#include "reduce.cu"
 #include "hashgrid.cu"
+#include "neighborlist.cu"
 
 //#include "spline.inl"
 //#include "volume.inl"
@@ -51,11 +51,23 @@ extern "C"
     WP_API void free_host(void* ptr);
     WP_API void free_device(void* ptr);
 
+    // page-locked host memory, copies to and from it run asynchronously with the host
+    WP_API void* alloc_pinned(size_t s);
+    WP_API void free_pinned(void* ptr);
+
+    // device allocations are stream-ordered and served from the
+    // driver's memory pool when supported by the device
+    WP_API bool cuda_mempool_enabled();
+    WP_API void cuda_mempool_trim(size_t min_bytes_to_keep);
+    WP_API void cuda_mempool_get_stats(uint64_t* used, uint64_t* used_high, uint64_t* reserved, uint64_t* reserved_high);
+
     // all memcpys are performed asynchronously
     WP_API void memcpy_h2h(void* dest, void* src, size_t n);
     WP_API void memcpy_h2d(void* dest, void* src, size_t n);
     WP_API void memcpy_d2h(void* dest, void* src, size_t n);
     WP_API void memcpy_d2d(void* dest, void* src, size_t n);
+    // copies between allocations on two devices, must be called with the destination device current
+    WP_API void memcpy_peer(int dest_device, void* dest, int src_device, void* src, size_t n);
 
     // all memsets are performed asynchronously
     WP_API void memset_host(void* dest, int value, size_t n);
@@ -63,37 +75,89 @@ extern "C"
 
     // create a user-accesible copy of the mesh, it is the 
     // users reponsibility to keep-alive the points/tris data for the duration of the mesh lifetime
-	WP_API uint64_t mesh_create_host(wp::vec3* points, wp::vec3* velocities, int* tris, int num_points, int num_tris);
+	WP_API uint64_t mesh_create_host(wp::vec3* points, wp::vec3* velocities, int* tris, int num_points, int num_tris, int bvh_builder, int bvh_width);
 	WP_API void mesh_destroy_host(uint64_t id);
     WP_API void mesh_refit_host(uint64_t id);
+    WP_API void mesh_refit_partial_host(uint64_t id, int* faces, int num_faces);
+    WP_API bool mesh_update_host(uint64_t id, wp::vec3* points, wp::vec3* velocities, int* tris, int num_points, int num_tris, bool topology_changed, int bvh_builder, int bvh_width, float rebuild_ratio);
 
-	WP_API uint64_t mesh_create_device(wp::vec3* points, wp::vec3* velocities, int* tris, int num_points, int num_tris);
+	WP_API uint64_t mesh_create_device(wp::vec3* points, wp::vec3* velocities, int* tris, int num_points, int num_tris, int bvh_builder, int bvh_width);
 	WP_API void mesh_destroy_device(uint64_t id);
     WP_API void mesh_refit_device(uint64_t id);
+    WP_API void mesh_refit_partial_device(uint64_t id, int* faces, int num_faces);
+    WP_API bool mesh_update_device(uint64_t id, wp::vec3* points, wp::vec3* velocities, int* tris, int num_points, int num_tris, bool topology_changed, int bvh_builder, int bvh_width, float rebuild_ratio);
+
+    WP_API void mesh_query_rays_host(uint64_t id, wp::vec3* starts, wp::vec3* dirs, int num_rays, float max_t, bool any_hit, bool sort_rays, float* t, int* faces, float* u, float* v, wp::vec3* normals);
+    WP_API void mesh_query_rays_device(uint64_t id, wp::vec3* starts, wp::vec3* dirs, int num_rays, float max_t, bool any_hit, bool sort_rays, float* t, int* faces, float* u, float* v, wp::vec3* normals);
 
-    WP_API uint64_t hash_grid_create_host(int dim_x, int dim_y, int dim_z);
+    WP_API uint64_t hash_grid_create_host(int dim_x, int dim_y, int dim_z, bool sparse);
     WP_API void hash_grid_reserve_host(uint64_t id, int num_points);
     WP_API void hash_grid_destroy_host(uint64_t id);
     WP_API void hash_grid_update_host(uint64_t id, float cell_width, const wp::vec3* positions, int num_points);
+    WP_API void hash_grid_permute_host(uint64_t id, void* dest, const void* src, int element_size, bool inverse);
+    WP_API void hash_grid_set_ordered_host(uint64_t id, bool ordered);
 
-    WP_API uint64_t hash_grid_create_device(int dim_x, int dim_y, int dim_z);
+    WP_API uint64_t hash_grid_create_device(int dim_x, int dim_y, int dim_z, bool sparse);
     WP_API void hash_grid_reserve_device(uint64_t id, int num_points);
     WP_API void hash_grid_destroy_device(uint64_t id);
     WP_API void hash_grid_update_device(uint64_t id, float cell_width, const wp::vec3* positions, int num_points);
-
-    WP_API uint64_t volume_create_host(void* buf, uint64_t size);
+    WP_API void hash_grid_permute_device(uint64_t id, void* dest, const void* src, int element_size, bool inverse);
+    WP_API void hash_grid_set_ordered_device(uint64_t id, bool ordered);
+
+    // neighbor lists are built from a hash grid over the same points, max_neighbors of 0 keeps all neighbors
+    WP_API uint64_t neighbor_list_create_host(int max_neighbors);
+    WP_API void neighbor_list_destroy_host(uint64_t id);
+    WP_API void neighbor_list_build_host(uint64_t id, uint64_t grid, const wp::vec3* points, int num_points, float radius, float skin);
+    WP_API float neighbor_list_max_displacement_host(uint64_t id, const wp::vec3* points, int num_points);
+    WP_API void neighbor_list_get_info_host(uint64_t id, int** offsets, int** counts, int** indices, int* num_points, int* num_neighbors);
+
+    WP_API uint64_t neighbor_list_create_device(int max_neighbors);
+    WP_API void neighbor_list_destroy_device(uint64_t id);
+    WP_API void neighbor_list_build_device(uint64_t id, uint64_t grid, const wp::vec3* points, int num_points, float radius, float skin);
+    WP_API float neighbor_list_max_displacement_device(uint64_t id, const wp::vec3* points, int num_points);
+    WP_API void neighbor_list_get_info_device(uint64_t id, int** offsets, int** counts, int** indices, int* num_points, int* num_neighbors);
+
+    // if copy is false the volume references buf directly, it is the users responsibility to keep it alive
+    WP_API uint64_t volume_create_host(void* buf, uint64_t size, bool copy);
+    WP_API uint64_t volume_load_host(const char* path);
     WP_API void volume_get_buffer_info_host(uint64_t id, void** buf, uint64_t* size);
     WP_API void volume_destroy_host(uint64_t id);
+    WP_API uint64_t volume_create_level_set_host(const int* leaves, const float* values, int num_leaves, float voxel_size, float tx, float ty, float tz, float background);
 
-    WP_API uint64_t volume_create_device(void* buf, uint64_t size);
+    WP_API uint64_t volume_create_device(void* buf, uint64_t size, bool copy);
+    WP_API uint64_t volume_load_device(const char* path, uint64_t chunk_size);
     WP_API void volume_get_buffer_info_device(uint64_t id, void** buf, uint64_t* size);
     WP_API void volume_destroy_device(uint64_t id);
-
-    WP_API void array_inner_host(uint64_t a, uint64_t b, uint64_t out, int len);
-    WP_API void array_sum_host(uint64_t a, uint64_t out, int len);
-
-    WP_API void array_inner_device(uint64_t a, uint64_t b, uint64_t out, int len);
-    WP_API void array_sum_device(uint64_t a, uint64_t out, int len);
+    WP_API uint64_t volume_create_level_set_device(const int* leaves, const float* values, int num_leaves, float voxel_size, float tx, float ty, float tz, float background);
+
+    // array reductions and scans, type is one of wp::ReduceType (int32, float32, vec3), results are
+    // written to out which must be in the same memory space as the inputs, device versions do not synchronize
+    WP_API void array_sum_host(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_inner_host(uint64_t a, uint64_t b, uint64_t out, int len, int type);
+    WP_API void array_min_host(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_max_host(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_argmin_host(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_argmax_host(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_scan_host(uint64_t in, uint64_t out, int len, int type, bool inclusive);
+
+    WP_API void array_sum_device(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_inner_device(uint64_t a, uint64_t b, uint64_t out, int len, int type);
+    WP_API void array_min_device(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_max_device(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_argmin_device(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_argmax_device(uint64_t a, uint64_t out, int len, int type);
+    WP_API void array_scan_device(uint64_t in, uint64_t out, int len, int type, bool inclusive);
+
+    // sorts (key, int value) pairs by key, key_type is one of SortKeyType (int32, float32, int64), keys
+    // and values must have storage for 2*n elements, the second half is overwritten with temporary data
+    WP_API void sort_pairs_host(uint64_t keys, uint64_t values, int n, int key_type);
+    WP_API void sort_pairs_device(uint64_t keys, uint64_t values, int n, int key_type);
+
+    // executes task over the range [0, dim) using the CPU thread pool, the calling
+    // thread participates in the work, grain of 0 selects a chunk size automatically
+    WP_API void cpu_parallel_for(void (*task)(void* ctx, int begin, int end), void* ctx, int dim, int grain);
+    WP_API void cpu_set_num_threads(int num_threads);
+    WP_API int cpu_get_num_threads();
 
     // ensures all device side operations have completed
     WP_API void synchronize();
@@ -107,18 +171,59 @@ extern "C"
     WP_API void* cuda_get_context();
     WP_API void cuda_set_context(void* ctx);
     WP_API void* cuda_get_stream();
-    WP_API const char* cuda_get_device_name();
+
+    // devices are selected by ordinal, each has its own context, streams, and memory pool, and
+    // all CUDA entry points operate on the current device
+    WP_API int cuda_device_get_count();
+    WP_API int cuda_get_device();
+    WP_API void cuda_set_device(int ordinal);
+    WP_API const char* cuda_get_device_name(int ordinal);
+
+    // streams and events, passing NULL to cuda_set_stream() restores the default stream
+    WP_API void cuda_set_stream(void* stream);
+    WP_API void* cuda_stream_create();
+    WP_API void cuda_stream_destroy(void* stream);
+    WP_API void cuda_stream_synchronize(void* stream);
+    WP_API void cuda_stream_wait_event(void* stream, void* event);
+
+    WP_API void* cuda_event_create(bool enable_timing);
+    WP_API void cuda_event_destroy(void* event);
+    WP_API void cuda_event_record(void* event, void* stream);
+    WP_API void cuda_event_synchronize(void* event);
+    WP_API float cuda_event_elapsed_time(void* start, void* end);
+
+    // NVTX ranges for profiling tools, nvtx_init() returns false if the NVTX library could not be loaded
+    WP_API bool nvtx_init();
+    WP_API void nvtx_range_push(const char* name);
+    WP_API void nvtx_range_pop();
+
+    // true while the current stream is being captured into a graph
+    WP_API bool cuda_is_capturing();
 
     WP_API void cuda_graph_begin_capture();
     WP_API void* cuda_graph_end_capture();
     WP_API void cuda_graph_launch(void* graph);
     WP_API void cuda_graph_destroy(void* graph);
 
-    WP_API size_t cuda_compile_program(const char* cuda_src, const char* include_dir, bool debug, bool verbose, const char* output_file);
-    WP_API void* cuda_load_module(const char* ptx);
+    // kernel nodes of a captured graph in launch order, their parameters can be updated without recapturing
+    WP_API int cuda_graph_get_kernel_count(void* graph);
+    WP_API void* cuda_graph_get_kernel(void* graph, int index);
+    WP_API bool cuda_graph_set_kernel_params(void* graph, int index, void** args);
+
+    // compute capability of the device as major*10 + minor, e.g.: 80 for sm_80
+    WP_API int cuda_get_device_arch(int ordinal);
+    WP_API int nvrtc_get_version();
+
+    // compiles to PTX for the virtual architecture compute_<arch>, or to CUBIN for sm_<arch> if ptx is false
+    WP_API size_t cuda_compile_program(const char* cuda_src, const char* include_dir, int arch, bool debug, bool verbose, bool ptx, const char* output_file);
+    WP_API void* cuda_load_module(const char* path);
     WP_API void cuda_unload_module(void* module);
     WP_API void* cuda_get_kernel(void* module, const char* name);
-    WP_API size_t cuda_launch_kernel(void* kernel, size_t dim, void** args);
+    WP_API int cuda_get_kernel_block_dim(void* kernel);
+    WP_API size_t cuda_launch_kernel(void* kernel, const int* shape, int ndim, int block_dim, void** args);
+    // launches count kernels in order on the current stream, args[i] are the packed parameters of kernels[i]
+    // starting with its launch bounds, returns the first launch error
+    WP_API size_t cuda_launch_kernels(void** kernels, const int* block_dims, void*** args, int count);
 
 } // extern "C"
 
@@ -0,0 +1,312 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import json
+import timeit
+
+import warp
+
+
+class ProfileRecord:
+
+    def __init__(self, name, category, device, dim, bytes):
+
+        self.name = name
+        self.category = category
+        self.device = device
+        self.dim = dim
+        self.bytes = bytes
+
+        # CUDA work is timed with events, CPU work is synchronous and uses host timestamps
+        self.start_event = None
+        self.end_event = None
+        self.start_time = 0.0
+        self.end_time = 0.0
+
+        # offset from the start of the profile and duration in milliseconds, valid once resolved
+        self.offset = 0.0
+        self.elapsed = 0.0
+
+
+class Profiler:
+    """Records the device time of every kernel launch and runtime operation issued inside a ``with`` block
+
+    CUDA work is timed by recording events on the current stream of the operation's device around each operation,
+    so the measured times are device times and do not depend on when the host synchronizes. Timings are resolved lazily,
+    the first call to :meth:`summary` or :meth:`save_chrome_trace` after new work was recorded synchronizes the device.
+    At most ``max_pending`` unresolved CUDA operations are kept, beyond that the profiler synchronizes to recycle its events.
+    Work issued during CUDA graph capture is not recorded. Entering the profiler waits for the work already queued on each
+    CUDA device, the trace timelines of the host and of all devices are then aligned to within the synchronization latency.
+
+    Example::
+
+        with wp.Profiler() as profiler:
+            for i in range(100):
+                model.step()
+
+        profiler.print_summary()
+        profiler.save_chrome_trace("step.json")
+
+    Args:
+        nvtx: Whether to also emit NVTX ranges for each operation so they are visible in Nsight Systems,
+              ignored if the NVTX library cannot be loaded
+        max_pending: Number of CUDA operations after which pending timings are resolved
+    """
+
+    def __init__(self, nvtx: bool=True, max_pending: int=4096):
+
+        self.nvtx = nvtx
+        self.max_pending = max_pending
+        self.records = []
+
+        # records whose events have not been queried yet
+        self.pending = []
+
+        # events can only be compared with events of the same device, so the pools and origins are kept per device,
+        # along with the host time in milliseconds since origin_time at which each device reached its origin
+        self.event_pool = {}
+        self.origin_events = {}
+        self.origin_offsets = {}
+        self.origin_time = 0.0
+
+    def __enter__(self):
+
+        runtime = warp.context.runtime
+
+        if (runtime.profiler != None):
+            raise RuntimeError("Warp: Error, entering a profiler while one is already active")
+
+        if (self.nvtx):
+            self.nvtx = runtime.core.nvtx_init()
+
+        self.origin_time = timeit.default_timer()
+
+        # an origin event completes once its stream has finished earlier work, waiting for it on the host
+        # gives the host time it was reached, which aligns the device timelines with the host and each other
+        # to within the synchronization latency
+        for device in runtime.cuda_devices:
+            event = self.record_event(self.acquire_event(device), device)
+            event.synchronize()
+
+            self.origin_events[device] = event
+            self.origin_offsets[device] = (timeit.default_timer() - self.origin_time)*1000.0
+
+        runtime.profiler = self
+
+        return self
+
+    def __exit__(self, exc_type, exc_value, traceback):
+
+        warp.context.runtime.profiler = None
+
+    def acquire_event(self, device):
+
+        pool = self.event_pool.get(device)
+
+        if (pool):
+            return pool.pop()
+        else:
+            return warp.Event(enable_timing=True, device=device)
+
+    def record_event(self, event, device):
+
+        runtime = warp.context.runtime
+
+        with warp.ScopedDevice(device):
+            runtime.core.cuda_event_record(event.handle, warp.get_stream(device).handle)
+
+        return event
+
+    def begin(self, name: str, device: str, dim=None, bytes: int=0, category: str="kernel"):
+        """Starts timing an operation, returns a record that must be passed to :meth:`end`, or None if the operation is not recorded"""
+
+        runtime = warp.context.runtime
+
+        if (runtime.capturing):
+            return None
+
+        record = ProfileRecord(name, category, device, dim, bytes)
+
+        if (self.nvtx):
+            runtime.core.nvtx_range_push(name.encode('utf-8'))
+
+        if (device != "cpu"):
+            record.start_event = self.record_event(self.acquire_event(device), device)
+        else:
+            record.start_time = timeit.default_timer()
+
+        return record
+
+    def end(self, record: ProfileRecord):
+        """Stops timing an operation started with :meth:`begin`"""
+
+        if (record == None):
+            return
+
+        runtime = warp.context.runtime
+
+        if (record.device != "cpu"):
+            record.end_event = self.record_event(self.acquire_event(record.device), record.device)
+            self.pending.append(record)
+
+            if (len(self.pending) >= self.max_pending):
+                self.resolve()
+        else:
+            record.end_time = timeit.default_timer()
+            record.offset = (record.start_time - self.origin_time)*1000.0
+            record.elapsed = (record.end_time - record.start_time)*1000.0
+
+        if (self.nvtx):
+            runtime.core.nvtx_range_pop()
+
+        self.records.append(record)
+
+    def resolve(self):
+        """Waits for outstanding CUDA work and computes the device times of all pending records"""
+
+        if (not self.pending):
+            return
+
+        warp.synchronize()
+
+        for r in self.pending:
+            r.offset = self.origin_offsets[r.device] + self.origin_events[r.device].elapsed_time(r.start_event)
+            r.elapsed = r.start_event.elapsed_time(r.end_event)
+
+            pool = self.event_pool.setdefault(r.device, [])
+            pool.append(r.start_event)
+            pool.append(r.end_event)
+
+            r.start_event = None
+            r.end_event = None
+
+        self.pending = []
+
+    def clear(self):
+        """Discards all recorded operations"""
+
+        self.resolve()
+        self.records = []
+
+    def summary(self) -> dict:
+        """Aggregates the recorded operations by name
+
+        Returns:
+            A dictionary mapping each operation name to a dictionary with the keys ``device``, ``category``,
+            ``count``, ``total_ms``, ``mean_ms``, ``min_ms``, ``max_ms``, ``bytes``, and ``dims``,
+            where ``dims`` lists the distinct launch dimensions in the order they were first seen
+        """
+
+        self.resolve()
+
+        stats = {}
+
+        for r in self.records:
+
+            s = stats.get(r.name)
+            if (s == None):
+                s = { "device": r.device, "category": r.category, "count": 0, "total_ms": 0.0, "mean_ms": 0.0, "min_ms": r.elapsed, "max_ms": 0.0, "bytes": 0, "dims": [] }
+                stats[r.name] = s
+
+            s["count"] += 1
+            s["total_ms"] += r.elapsed
+            s["min_ms"] = min(s["min_ms"], r.elapsed)
+            s["max_ms"] = max(s["max_ms"], r.elapsed)
+            s["bytes"] += r.bytes
+
+            if (r.dim != None and r.dim not in s["dims"]):
+                s["dims"].append(r.dim)
+
+        for s in stats.values():
+            s["mean_ms"] = s["total_ms"]/s["count"]
+
+        return stats
+
+    def print_summary(self):
+        """Prints the aggregated statistics, sorted by total time"""
+
+        stats = self.summary()
+
+        print(f"{'name':40} {'device':6} {'count':>8} {'total (ms)':>12} {'mean (ms)':>12} {'max (ms)':>12}  dims")
+
+        for name, s in sorted(stats.items(), key=lambda x: x[1]["total_ms"], reverse=True):
+            dims = ", ".join(str(d) for d in s["dims"][:4]) + (", ..." if len(s["dims"]) > 4 else "")
+            print(f"{name[:40]:40} {s['device']:6} {s['count']:8} {s['total_ms']:12.3f} {s['mean_ms']:12.3f} {s['max_ms']:12.3f}  {dims}")
+
+    def save_chrome_trace(self, path: str):
+        """Writes the recorded operations in the Chrome trace event format, which can be opened with chrome://tracing or Perfetto
+
+        CPU operations and the operations of each CUDA device are written to separate tracks, all are measured relative
+        to the start of the profile.
+        """
+
+        self.resolve()
+
+        tracks = { "cpu": 0 }
+        for i, device in enumerate(warp.context.runtime.cuda_devices):
+            tracks[device] = i + 1
+
+        events = []
+
+        for device, tid in tracks.items():
+            events.append({ "name": "thread_name", "ph": "M", "pid": 0, "tid": tid, "args": { "name": device } })
+
+        for r in self.records:
+
+            args = {}
+            if (r.dim != None):
+                args["dim"] = r.dim
+            if (r.bytes):
+                args["bytes"] = r.bytes
+
+            events.append({
+                "name": r.name,
+                "cat": r.category,
+                "ph": "X",
+                "pid": 0,
+                "tid": tracks.get(r.device, 0),
+                "ts": r.offset*1000.0,
+                "dur": r.elapsed*1000.0,
+                "args": args })
+
+        with open(path, "w") as f:
+            json.dump({ "traceEvents": events, "displayTimeUnit": "ms" }, f)
+
+
+class ScopedProfile:
+    """Times the enclosed operation if a :class:`Profiler` is active, otherwise does nothing
+
+    Args:
+        name: Name the operation is aggregated under
+        device: Device the operation runs on
+        dim: Optional launch dimensions or element count
+        bytes: Optional number of bytes moved by the operation
+        category: Category of the operation in the Chrome trace
+    """
+
+    def __init__(self, name: str, device: str, dim=None, bytes: int=0, category: str="runtime"):
+
+        self.name = name
+        self.device = device
+        self.dim = dim
+        self.bytes = bytes
+        self.category = category
+        self.record = None
+
+    def __enter__(self):
+
+        profiler = warp.context.runtime.profiler
+
+        if (profiler):
+            self.record = profiler.begin(self.name, self.device, self.dim, self.bytes, self.category)
+
+    def __exit__(self, exc_type, exc_value, traceback):
+
+        profiler = warp.context.runtime.profiler
+
+        if (profiler and self.record):
+            profiler.end(self.record)
@@ -0,0 +1,150 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+# Evaluation of narrow band signed distance fields of triangle meshes, the leaves
+# are assembled into a NanoVDB level set by Volume.bake_mesh()
+
+import numpy as np
+
+import warp as wp
+
+
+@wp.kernel
+def mark_leaves(mesh: wp.uint64,
+                lower_x: int,
+                lower_y: int,
+                lower_z: int,
+                dim_y: int,
+                dim_z: int,
+                voxel_size: float,
+                max_dist: float,
+                flags: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    i = (tid//(dim_y*dim_z) + lower_x)*8
+    j = ((tid//dim_z)%dim_y + lower_y)*8
+    k = (tid%dim_z + lower_z)*8
+
+    # center of the 8^3 voxels of the leaf
+    center = (wp.vec3(float(i), float(j), float(k)) + wp.vec3(3.5, 3.5, 3.5))*voxel_size
+
+    face_index = int(0)
+    face_u = float(0.0)
+    face_v = float(0.0)
+    sign = float(0.0)
+
+    flags[tid] = 0
+
+    if (wp.mesh_query_point(mesh, center, max_dist, sign, face_index, face_u, face_v)):
+        flags[tid] = 1
+
+
+@wp.kernel
+def compact_leaves(lower_x: int,
+                   lower_y: int,
+                   lower_z: int,
+                   dim_y: int,
+                   dim_z: int,
+                   flags: wp.array(dtype=int),
+                   offsets: wp.array(dtype=int),
+                   leaves: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    if (flags[tid] == 0):
+        return
+
+    # inclusive scan of the flags gives each leaf its slot
+    index = offsets[tid] - 1
+
+    leaves[index*3 + 0] = (tid//(dim_y*dim_z) + lower_x)*8
+    leaves[index*3 + 1] = ((tid//dim_z)%dim_y + lower_y)*8
+    leaves[index*3 + 2] = (tid%dim_z + lower_z)*8
+
+
+@wp.kernel
+def eval_leaves(mesh: wp.uint64,
+                leaves: wp.array(dtype=int),
+                voxel_size: float,
+                background: float,
+                max_dist: float,
+                values: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    leaf = tid//512
+    n = tid%512
+
+    # voxels are stored x major within a leaf
+    i = leaves[leaf*3 + 0] + n//64
+    j = leaves[leaf*3 + 1] + (n//8)%8
+    k = leaves[leaf*3 + 2] + n%8
+
+    p = wp.vec3(float(i), float(j), float(k))*voxel_size
+
+    face_index = int(0)
+    face_u = float(0.0)
+    face_v = float(0.0)
+    sign = float(0.0)
+
+    # voxels outside the band still need the sign of the closest face, which lies within max_dist
+    d = background
+
+    if (wp.mesh_query_point(mesh, p, max_dist, sign, face_index, face_u, face_v)):
+        closest = wp.mesh_eval_position(mesh, face_index, face_u, face_v)
+        d = wp.clamp(wp.length(p - closest)*sign, -background, background)
+
+    values[tid] = d
+
+
+def mesh_level_set_leaves(mesh: wp.Mesh, voxel_size: float, background: float):
+    """Computes the leaves of a narrow band level set of a closed mesh
+
+    Leaves are the 8^3 voxel blocks of a NanoVDB grid whose index space is the world scaled by ``1/voxel_size``,
+    a leaf is kept if any of its voxels may lie closer to the surface than ``background``.
+
+    Returns:
+        A tuple ``(leaves, values, num_leaves)`` of the integer leaf origins, 3 per leaf, and the 512 clamped
+        signed distances of each leaf
+    """
+
+    device = mesh.device
+
+    points = mesh.points.numpy()
+
+    # candidate leaves cover the bounds of the mesh grown by the band
+    lower = np.floor((np.min(points, axis=0) - background)/voxel_size).astype(np.int64)//8
+    upper = np.floor((np.max(points, axis=0) + background)/voxel_size).astype(np.int64)//8
+
+    dim = upper - lower + 1
+    num_candidates = int(np.prod(dim))
+
+    (lower_x, lower_y, lower_z) = (int(lower[0]), int(lower[1]), int(lower[2]))
+
+    # a voxel center of the leaf may be up to half the diagonal between its corner voxels away from the leaf center
+    max_dist = background + 0.5*np.sqrt(3.0)*7.0*voxel_size
+
+    flags = wp.zeros(num_candidates, dtype=int, device=device)
+    offsets = wp.zeros(num_candidates, dtype=int, device=device)
+
+    wp.launch(mark_leaves, dim=num_candidates, inputs=[mesh.id, lower_x, lower_y, lower_z, int(dim[1]), int(dim[2]), voxel_size, max_dist, flags], device=device)
+
+    # the surface is then within the band plus the leaf diagonal of every voxel of a kept leaf, which bounds their queries
+    voxel_dist = background + np.sqrt(3.0)*7.0*voxel_size
+    wp.array_scan(flags, offsets, inclusive=True)
+
+    num_leaves = int(offsets.numpy()[-1])
+
+    leaves = wp.zeros(num_leaves*3, dtype=int, device=device)
+    values = wp.zeros(num_leaves*512, dtype=float, device=device)
+
+    if (num_leaves):
+        wp.launch(compact_leaves, dim=num_candidates, inputs=[lower_x, lower_y, lower_z, int(dim[1]), int(dim[2]), flags, offsets, leaves], device=device)
+        wp.launch(eval_leaves, dim=num_leaves*512, inputs=[mesh.id, leaves, voxel_size, background, voxel_dist, values], device=device)
+
+    return (leaves, values, num_leaves)
@@ -101,6 +101,105 @@ def capsule_sdf_grad(radius: float, half_width: float, p: wp.vec3):
 
 
 
+@wp.kernel
+def compute_shape_bounds(
+    body_X_sc: wp.array(dtype=wp.transform),
+    shape_X_co: wp.array(dtype=wp.transform),
+    shape_body: wp.array(dtype=int),
+    shape_geo_type: wp.array(dtype=int),
+    shape_geo_id: wp.array(dtype=wp.uint64),
+    shape_geo_scale: wp.array(dtype=wp.vec3),
+    contact_shapes: wp.array(dtype=int),
+    shape_lower: wp.array(dtype=wp.vec3),
+    shape_upper: wp.array(dtype=wp.vec3),
+    soft_contact_margin: float,
+    # outputs
+    bounds_points: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+
+    shape_index = contact_shapes[tid]
+    rigid_index = shape_body[shape_index]
+
+    X_sc = wp.transform_identity()
+    if (rigid_index >= 0):
+        X_sc = body_X_sc[rigid_index]
+
+    X_so = wp.transform_multiply(X_sc, shape_X_co[shape_index])
+
+    lower = shape_lower[tid]
+    upper = shape_upper[tid]
+
+    # GEO_MESH (3), meshes may be deformed by updates so their bounds are read from the BVH root
+    if (shape_geo_type[shape_index] == 3):
+        mesh = shape_geo_id[shape_index]
+        scale = shape_geo_scale[shape_index][0]
+
+        lower = wp.mesh_bounds_lower(mesh)*scale
+        upper = wp.mesh_bounds_upper(mesh)*scale
+
+    center = (lower + upper)*0.5
+    extent = (upper - lower)*0.5
+
+    # world space extents of the rotated local box
+    q = wp.transform_get_rotation(X_so)
+
+    ax = wp.quat_rotate(q, wp.vec3(extent[0], 0.0, 0.0))
+    ay = wp.quat_rotate(q, wp.vec3(0.0, extent[1], 0.0))
+    az = wp.quat_rotate(q, wp.vec3(0.0, 0.0, extent[2]))
+
+    e = wp.vec3(abs(ax[0]) + abs(ay[0]) + abs(az[0]) + soft_contact_margin,
+                abs(ax[1]) + abs(ay[1]) + abs(az[1]) + soft_contact_margin,
+                abs(ax[2]) + abs(ay[2]) + abs(az[2]) + soft_contact_margin)
+
+    c = wp.transform_point(X_so, center)
+
+    # each shape is a degenerate triangle (lower, upper, upper) whose bounds are the shape's world bounds
+    bounds_points[tid*2 + 0] = c - e
+    bounds_points[tid*2 + 1] = c + e
+
+
+@wp.kernel
+def find_soft_contact_candidates(
+    bvh: wp.uint64,
+    particle_x: wp.array(dtype=wp.vec3),
+    contact_shapes: wp.array(dtype=int),
+    candidate_max: int,
+    write: int,
+    # outputs
+    particle_count: wp.array(dtype=int),
+    particle_offset: wp.array(dtype=int),
+    candidate_particle: wp.array(dtype=int),
+    candidate_shape: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    px = particle_x[tid]
+
+    # candidates of this particle start after those of all previous particles (inclusive scan of the counts)
+    start = int(0)
+    if (write == 1):
+        start = particle_offset[tid] - particle_count[tid]
+
+    query = wp.mesh_query_aabb(bvh, px, px)
+
+    index = int(-1)
+    count = int(0)
+
+    while wp.mesh_query_aabb_next(query, index):
+
+        if (write == 1):
+            slot = start + count
+            if (slot < candidate_max):
+                candidate_particle[slot] = tid
+                candidate_shape[slot] = contact_shapes[index]
+
+        count = count + 1
+
+    if (write == 0):
+        particle_count[tid] = count
+
+
 @wp.kernel
 def create_soft_contacts(
     num_particles: int,
@@ -111,20 +210,36 @@ def create_soft_contacts(
     shape_geo_type: wp.array(dtype=int), 
     shape_geo_id: wp.array(dtype=wp.uint64),
     shape_geo_scale: wp.array(dtype=wp.vec3),
+    shape_sdf_band: wp.array(dtype=float),
     soft_contact_margin: float,
+    particle_offset: wp.array(dtype=int),
+    candidate_particle: wp.array(dtype=int),
+    candidate_shape: wp.array(dtype=int),
+    candidate_max: int,
     #outputs,
-    soft_contact_count: wp.array(dtype=int),
-    soft_contact_particle: wp.array(dtype=int),
-    soft_contact_body: wp.array(dtype=int),
-    soft_contact_body_pos: wp.array(dtype=wp.vec3),
-    soft_contact_body_vel: wp.array(dtype=wp.vec3),
-    soft_contact_normal: wp.array(dtype=wp.vec3),
-    soft_contact_max: int):
+    candidate_count: wp.array(dtype=int),
+    candidate_overflow: wp.array(dtype=int),
+    candidate_flag: wp.array(dtype=int),
+    candidate_body_pos: wp.array(dtype=wp.vec3),
+    candidate_body_vel: wp.array(dtype=wp.vec3),
+    candidate_normal: wp.array(dtype=wp.vec3)):
     
     tid = wp.tid()           
 
-    shape_index = tid // num_particles     # which shape
-    particle_index = tid % num_particles   # which particle
+    total = particle_offset[num_particles-1]
+
+    # candidates beyond candidate_max were not written by the broad phase and are dropped
+    if (tid == 0):
+        candidate_count[0] = total
+        candidate_overflow[0] = wp.max(total - candidate_max, 0)
+
+    candidate_flag[tid] = 0
+
+    if (tid >= total):
+        return
+
+    shape_index = candidate_shape[tid]
+    particle_index = candidate_particle[tid]
     rigid_index = shape_body[shape_index]
 
     px = particle_x[particle_index]
@@ -186,34 +301,147 @@ def create_soft_contacts(
             n = wp.normalize(delta)*sign
             v = shape_v
 
+    # GEO_SDF (4)
+    if (geo_type == 4):
+        volume = shape_geo_id[shape_index]
+
+        grad = wp.vec3()
+        sample = wp.volume_sample_grad_world(volume, x_local/geo_scale[0], grad)*geo_scale[0]
+
+        # samples outside the band are saturated and have no gradient
+        if (abs(sample) < shape_sdf_band[shape_index]):
+            d = sample
+            n = wp.normalize(grad)
+
 
     if (d < soft_contact_margin):
 
-        index = wp.atomic_add(soft_contact_count, 0, 1) 
+        # compute contact point in body local space
+        candidate_body_pos[tid] = wp.transform_point(X_co, x_local - n*d)
+        candidate_body_vel[tid] = wp.transform_vector(X_co, v)
+        candidate_normal[tid] = wp.transform_vector(X_so, n)
+        candidate_flag[tid] = 1
+
+
+@wp.kernel
+def compact_soft_contacts(
+    shape_body: wp.array(dtype=int),
+    candidate_particle: wp.array(dtype=int),
+    candidate_shape: wp.array(dtype=int),
+    candidate_body_pos: wp.array(dtype=wp.vec3),
+    candidate_body_vel: wp.array(dtype=wp.vec3),
+    candidate_normal: wp.array(dtype=wp.vec3),
+    candidate_flag: wp.array(dtype=int),
+    candidate_offset: wp.array(dtype=int),
+    candidate_max: int,
+    soft_contact_max: int,
+    #outputs,
+    soft_contact_count: wp.array(dtype=int),
+    soft_contact_particle: wp.array(dtype=int),
+    soft_contact_body: wp.array(dtype=int),
+    soft_contact_body_pos: wp.array(dtype=wp.vec3),
+    soft_contact_body_vel: wp.array(dtype=wp.vec3),
+    soft_contact_normal: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+
+    # the total may exceed soft_contact_max, in which case the remaining contacts are dropped
+    if (tid == 0):
+        soft_contact_count[0] = candidate_offset[candidate_max-1]
 
-        if (index < soft_contact_max):
+    if (candidate_flag[tid] == 0):
+        return
 
-            # compute contact point in body local space
-            body_pos = wp.transform_point(X_co, x_local - n*d)
-            body_vel = wp.transform_vector(X_co, v)
+    # inclusive scan of the flags gives each contact its slot
+    index = candidate_offset[tid] - 1
 
-            world_normal = wp.transform_vector(X_so, n)
+    if (index < soft_contact_max):
 
-            soft_contact_body[index] = rigid_index
-            soft_contact_body_pos[index] = body_pos
-            soft_contact_body_vel[index] = body_vel
-            soft_contact_particle[index] = particle_index
-            soft_contact_normal[index] = world_normal
+        soft_contact_body[index] = shape_body[candidate_shape[tid]]
+        soft_contact_body_pos[index] = candidate_body_pos[tid]
+        soft_contact_body_vel[index] = candidate_body_vel[tid]
+        soft_contact_particle[index] = candidate_particle[tid]
+        soft_contact_normal[index] = candidate_normal[tid]
 
 
 def collide(model, state):
+    """Generates soft contacts between particles and shapes
+
+    A broad phase BVH over the world bounds of all shapes, enlarged by ``model.soft_contact_margin``, yields candidate
+    (particle, shape) pairs. Only candidates are tested against the shape SDFs, and the resulting contacts are written
+    to consecutive slots using prefix sums over the per-particle candidate counts and the per-candidate contact flags.
+    At most ``model.soft_contact_candidate_max`` candidates are tested per call, the number found is written to
+    ``model.soft_contact_candidate_count`` and the number dropped because they did not fit to ``model.soft_contact_candidate_overflow``.
+    Mesh shape bounds are read from the mesh BVH on every call, so meshes deformed with :meth:`warp.Mesh.update` stay covered.
+    """
 
     # clear old count
     model.soft_contact_count.zero_()
-    
+
+    num_shapes = len(model.soft_contact_shapes)
+
+    if (model.particle_count == 0 or num_shapes == 0):
+        return
+
+    # the margin may have been raised after finalize(), SDF distances saturate at the band
+    if (model.soft_contact_sdf_band != None and model.soft_contact_margin > model.soft_contact_sdf_band):
+        raise RuntimeError(f"Soft contact margin {model.soft_contact_margin} exceeds the narrowest SDF band {model.soft_contact_sdf_band}, increase the band_width of the SDF shapes")
+
+    # shape bounds are stored as two points per shape
+    if (model.soft_contact_bvh == None):
+        bounds_points = wp.zeros(2*num_shapes, dtype=wp.vec3, device=model.device)
+        bounds_indices = wp.array([[2*i, 2*i+1, 2*i+1] for i in range(num_shapes)], dtype=wp.int32, device=model.device)
+    else:
+        bounds_points = model.soft_contact_bvh.points
+
+    wp.launch(
+        kernel=compute_shape_bounds,
+        dim=num_shapes,
+        inputs=[
+            state.body_q,
+            model.shape_transform,
+            model.shape_body,
+            model.shape_geo_type,
+            model.shape_geo_id,
+            model.shape_geo_scale,
+            model.soft_contact_shapes,
+            model.soft_contact_shape_lower,
+            model.soft_contact_shape_upper,
+            model.soft_contact_margin],
+        outputs=[bounds_points],
+        device=model.device)
+
+    if (model.soft_contact_bvh == None):
+        model.soft_contact_bvh = wp.Mesh(bounds_points, bounds_indices)
+    else:
+        # refit, rebuilding once moving shapes degrade the tree
+        model.soft_contact_bvh.update()
+
+    # count candidates per particle, then write them to the ranges given by the scanned counts
+    for write in range(2):
+
+        wp.launch(
+            kernel=find_soft_contact_candidates,
+            dim=model.particle_count,
+            inputs=[
+                model.soft_contact_bvh.id,
+                state.particle_q,
+                model.soft_contact_shapes,
+                model.soft_contact_candidate_max,
+                write],
+            outputs=[
+                model.soft_contact_particle_count,
+                model.soft_contact_particle_offset,
+                model.soft_contact_candidate_particle,
+                model.soft_contact_candidate_shape],
+            device=model.device)
+
+        if (write == 0):
+            wp.array_scan(model.soft_contact_particle_count, model.soft_contact_particle_offset, inclusive=True)
+
     wp.launch(
         kernel=create_soft_contacts,
-        dim=model.particle_count*model.shape_count,
+        dim=model.soft_contact_candidate_max,
         inputs=[
             model.particle_count,
             state.particle_q, 
@@ -223,14 +451,42 @@ def collide(model, state):
             model.shape_geo_type, 
             model.shape_geo_id,
             model.shape_geo_scale,
+            model.shape_sdf_band,
             model.soft_contact_margin,
+            model.soft_contact_particle_offset,
+            model.soft_contact_candidate_particle,
+            model.soft_contact_candidate_shape,
+            model.soft_contact_candidate_max],
+        outputs=[
+            model.soft_contact_candidate_count,
+            model.soft_contact_candidate_overflow,
+            model.soft_contact_candidate_flag,
+            model.soft_contact_candidate_body_pos,
+            model.soft_contact_candidate_body_vel,
+            model.soft_contact_candidate_normal],
+        device=model.device)
+
+    wp.array_scan(model.soft_contact_candidate_flag, model.soft_contact_candidate_offset, inclusive=True)
+
+    wp.launch(
+        kernel=compact_soft_contacts,
+        dim=model.soft_contact_candidate_max,
+        inputs=[
+            model.shape_body,
+            model.soft_contact_candidate_particle,
+            model.soft_contact_candidate_shape,
+            model.soft_contact_candidate_body_pos,
+            model.soft_contact_candidate_body_vel,
+            model.soft_contact_candidate_normal,
+            model.soft_contact_candidate_flag,
+            model.soft_contact_candidate_offset,
+            model.soft_contact_candidate_max,
+            model.soft_contact_max],
+        outputs=[
             model.soft_contact_count,
             model.soft_contact_particle,
             model.soft_contact_body,
             model.soft_contact_body_pos,
             model.soft_contact_body_vel,
-            model.soft_contact_normal,
-            model.soft_contact_max],
-            # outputs
-        outputs=[],
-        device=model.device)
\ No newline at end of file
+            model.soft_contact_normal],
+        device=model.device)
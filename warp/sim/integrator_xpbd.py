@@ -5,6 +5,9 @@
 # distribution of this software and related documentation without an express
 # license agreement from NVIDIA CORPORATION is strictly prohibited.
 
+import ctypes
+import weakref
+
 import warp as wp
 
 
@@ -42,10 +45,17 @@ def solve_springs(x: wp.array(dtype=wp.vec3),
                  spring_stiffness: wp.array(dtype=float),
                  spring_damping: wp.array(dtype=float),
                  dt: float,
+                 color_indices: wp.array(dtype=int),
+                 color_offset: int,
+                 gauss_seidel: int,
                  delta: wp.array(dtype=wp.vec3)):
 
     tid = wp.tid()
 
+    # in Gauss-Seidel mode each launch solves the springs of one color, no two of which share a particle
+    if (gauss_seidel == 1):
+        tid = color_indices[color_offset + tid]
+
     i = spring_indices[tid * 2 + 0]
     j = spring_indices[tid * 2 + 1]
 
@@ -84,8 +94,12 @@ def solve_springs(x: wp.array(dtype=wp.vec3),
 
     xd = dir*multiplier
 
-    wp.atomic_sub(delta, i, xd*wi)
-    wp.atomic_add(delta, j, xd*wj)
+    if (gauss_seidel == 1):
+        x[i] = xi - xd*wi
+        x[j] = xj + xd*wj
+    else:
+        wp.atomic_sub(delta, i, xd*wi)
+        wp.atomic_add(delta, j, xd*wj)
 
 
 
@@ -99,10 +113,17 @@ def solve_tetrahedra(x: wp.array(dtype=wp.vec3),
                      materials: wp.array(dtype=float),
                      dt: float,
                      relaxation: float,
+                     color_indices: wp.array(dtype=int),
+                     color_offset: int,
+                     gauss_seidel: int,
                      delta: wp.array(dtype=wp.vec3)):
 
     tid = wp.tid()
 
+    # in Gauss-Seidel mode each launch solves the tetrahedra of one color, no two of which share a particle
+    if (gauss_seidel == 1):
+        tid = color_indices[color_offset + tid]
+
     i = indices[tid * 4 + 0]
     j = indices[tid * 4 + 1]
     k = indices[tid * 4 + 2]
@@ -226,10 +247,16 @@ def solve_tetrahedra(x: wp.array(dtype=wp.vec3),
     delta3 = delta3 + grad3 * multiplier
 
     # apply forces
-    wp.atomic_sub(delta, i, delta0*w0*relaxation)
-    wp.atomic_sub(delta, j, delta1*w1*relaxation)
-    wp.atomic_sub(delta, k, delta2*w2*relaxation)
-    wp.atomic_sub(delta, l, delta3*w3*relaxation)
+    if (gauss_seidel == 1):
+        x[i] = x0 - delta0*w0*relaxation
+        x[j] = x1 - delta1*w1*relaxation
+        x[k] = x2 - delta2*w2*relaxation
+        x[l] = x3 - delta3*w3*relaxation
+    else:
+        wp.atomic_sub(delta, i, delta0*w0*relaxation)
+        wp.atomic_sub(delta, j, delta1*w1*relaxation)
+        wp.atomic_sub(delta, k, delta2*w2*relaxation)
+        wp.atomic_sub(delta, l, delta3*w3*relaxation)
 
 
 @wp.kernel
@@ -259,6 +286,17 @@ def apply_deltas(x_orig: wp.array(dtype=wp.vec3),
     delta[tid] = wp.vec3()
 
 
+@wp.kernel
+def update_velocities(x_orig: wp.array(dtype=wp.vec3),
+                      x_new: wp.array(dtype=wp.vec3),
+                      dt: float,
+                      v_out: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+
+    v_out[tid] = (x_new[tid] - x_orig[tid])/dt
+
+
 class XPBDIntegrator:
     """A implicit integrator using XPBD
 
@@ -269,6 +307,15 @@ class XPBDIntegrator:
     preserves energy, however it not unconditionally stable, and requires a time-step
     small enough to support the required stiffness and damping forces.
 
+    By default constraints are solved in a Jacobi fashion, every constraint accumulates its correction
+    into a particle delta buffer with atomics and the deltas are applied once per iteration.
+    In Gauss-Seidel mode the constraint colors computed by :meth:`ModelBuilder.finalize` are solved
+    one per launch and write particle positions directly, which converges faster and needs no atomics.
+    On CUDA devices the Gauss-Seidel iterations are captured into a CUDA graph on the first step and
+    replayed on later steps with the same state buffers and time-step. At most ``max_graphs`` graphs
+    are kept, and they are released when the integrator is used with a different model. Gauss-Seidel
+    mode updates positions in-place and does not support differentiation.
+
     See: https://en.wikipedia.org/wiki/Semi-implicit_Euler_method
 
     Example:
@@ -279,18 +326,137 @@ class XPBDIntegrator:
         >>> for i in range(100):
         >>>     state = integrator.forward(model, state, dt)
 
+    Args:
+        iterations: Number of constraint iterations per step
+        relaxation: Relaxation factor applied to tetrahedral corrections
+        gauss_seidel: Whether to solve constraints color by color instead of with Jacobi averaging
+        use_graph: Whether to reuse a captured CUDA graph for the Gauss-Seidel iterations
+        max_graphs: Number of captured graphs kept before the least recently captured one is released
+
     """
 
-    def __init__(self, iterations, relaxation):
+    def __init__(self, iterations, relaxation, gauss_seidel=False, use_graph=True, max_graphs=4):
         
         self.iterations = iterations
         self.relaxation = relaxation
+        self.gauss_seidel = gauss_seidel
+        self.use_graph = use_graph
+        self.max_graphs = max_graphs
+
+        # captured iteration graphs of graph_model keyed by the buffers and parameters they were recorded with,
+        # the model is referenced weakly so that a new model allocated at the same address is never matched
+        self.graphs = {}
+        self.graph_model = None
+
+    def __del__(self):
+        try:
+            self.clear_graphs()
+        except:
+            pass
+
+    def clear_graphs(self):
+        """Releases all captured iteration graphs, this must be called if model constraint arrays are reallocated"""
+
+        for graph in self.graphs.values():
+            wp.context.runtime.core.cuda_graph_destroy(ctypes.c_void_p(graph))
+
+        self.graphs = {}
+        self.graph_model = None
+
+
+    def solve_colored(self, model, x, v, dt):
+
+        for i in range(self.iterations):
+
+            # damped springs
+            for c in range(len(model.spring_color_offsets)-1):
+
+                offset = model.spring_color_offsets[c]
+                count = model.spring_color_offsets[c+1] - offset
+
+                wp.launch(kernel=solve_springs,
+                            dim=count,
+                            inputs=[x, v, model.particle_inv_mass, model.spring_indices, model.spring_rest_length, model.spring_stiffness, model.spring_damping, dt, model.spring_color_indices, offset, 1],
+                            outputs=[x],
+                            device=model.device)
+
+            # tetrahedral FEM
+            for c in range(len(model.tet_color_offsets)-1):
+
+                offset = model.tet_color_offsets[c]
+                count = model.tet_color_offsets[c+1] - offset
+
+                wp.launch(kernel=solve_tetrahedra,
+                            dim=count,
+                            inputs=[x, v, model.particle_inv_mass, model.tet_indices, model.tet_poses, model.tet_activations, model.tet_materials, dt, self.relaxation, model.tet_color_indices, offset, 1],
+                            outputs=[x],
+                            device=model.device)
+
+
+    def simulate_colored(self, model, state_in, state_out, dt):
+
+        # predicted positions are written to the output state and projected in-place
+        if (model.particle_count):
+            state_out.particle_f.zero_()
+
+            wp.launch(kernel=integrate_particles,
+                        dim=model.particle_count,
+                        inputs=[state_in.particle_q, state_in.particle_qd, state_out.particle_f, model.particle_inv_mass, model.gravity, dt],
+                        outputs=[state_out.particle_q, state_out.particle_qd],
+                        device=model.device)
+
+        x = state_out.particle_q
+        v = state_out.particle_qd
+
+        runtime = wp.context.runtime
+
+        # graphs are only replayed outside of tapes and enclosing captures, where every launch must be issued
+        if (self.use_graph and model.device != "cpu" and runtime.tape == None and not runtime.capturing):
+
+            if (self.graph_model == None or self.graph_model() is not model):
+                self.clear_graphs()
+                self.graph_model = weakref.ref(model)
+
+            key = (x.ptr, v.ptr, dt, self.iterations, self.relaxation)
+            
+            graph = self.graphs.get(key)
+            if (graph == None):
+
+                # dicts keep insertion order, so the first graph is the oldest
+                if (len(self.graphs) >= self.max_graphs):
+                    oldest = next(iter(self.graphs))
+                    wp.context.runtime.core.cuda_graph_destroy(ctypes.c_void_p(self.graphs.pop(oldest)))
+
+                # graphs are captured on, and always launched on, the model's device
+                with wp.ScopedDevice(model.device):
+                    wp.capture_begin()
+                    self.solve_colored(model, x, v, dt)
+                    graph = wp.capture_end()
+
+                self.graphs[key] = graph
+
+            wp.capture_launch(graph)
+
+        else:
+            self.solve_colored(model, x, v, dt)
+
+        if (model.particle_count):
+            wp.launch(kernel=update_velocities,
+                        dim=model.particle_count,
+                        inputs=[state_in.particle_q, x, dt],
+                        outputs=[v],
+                        device=model.device)
+
+        return state_out
 
 
     def simulate(self, model, state_in, state_out, dt):
 
         with wp.ScopedTimer("simulate", False):
 
+            if (self.gauss_seidel):
+                return self.simulate_colored(model, state_in, state_out, dt)
+
             q_pred = wp.zeros_like(state_in.particle_q)
             qd_pred = wp.zeros_like(state_in.particle_qd)
 
@@ -317,7 +483,7 @@ class XPBDIntegrator:
 
                     wp.launch(kernel=solve_springs,
                                 dim=model.spring_count,
-                                inputs=[state_in.particle_q, state_in.particle_qd, model.particle_inv_mass, model.spring_indices, model.spring_rest_length, model.spring_stiffness, model.spring_damping, dt],
+                                inputs=[state_in.particle_q, state_in.particle_qd, model.particle_inv_mass, model.spring_indices, model.spring_rest_length, model.spring_stiffness, model.spring_damping, dt, model.spring_color_indices, 0, 0],
                                 outputs=[state_out.particle_f],
                                 device=model.device)
                
@@ -326,7 +492,7 @@ class XPBDIntegrator:
 
                     wp.launch(kernel=solve_tetrahedra,
                                 dim=model.tet_count,
-                                inputs=[q_pred, qd_pred, model.particle_inv_mass, model.tet_indices, model.tet_poses, model.tet_activations, model.tet_materials, dt, self.relaxation],
+                                inputs=[q_pred, qd_pred, model.particle_inv_mass, model.tet_indices, model.tet_poses, model.tet_activations, model.tet_materials, dt, self.relaxation, model.tet_color_indices, 0, 0],
                                 outputs=[state_out.particle_f],
                                 device=model.device)
 
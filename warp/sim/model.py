@@ -42,6 +42,59 @@ JOINT_FREE = wp.constant(4)
 JOINT_COMPOUND = wp.constant(5)
 JOINT_UNIVERSAL = wp.constant(6)
 
+
+def color_constraints(constraints, particle_inv_mass) -> Tuple[List[int], List[int]]:
+    """Greedily colors constraints so that no two constraints of the same color share a dynamic particle
+
+    Particles with zero inverse mass are never moved by a constraint and do not cause conflicts.
+
+    Args:
+        constraints: A list of particle index tuples, one per constraint
+        particle_inv_mass: The inverse mass of each particle
+
+    Returns:
+        A tuple ``(order, offsets)`` where ``order`` lists the constraint indices grouped by color
+        and the constraints of color ``c`` are ``order[offsets[c]:offsets[c+1]]``
+    """
+
+    # bit c of a particle's mask is set if a constraint of color c already acts on it
+    masks = [0]*len(particle_inv_mass)
+    colors = []
+
+    for c in constraints:
+
+        used = 0
+        for p in c:
+            used |= masks[p]
+
+        # lowest color not used by any of the constraint's particles
+        color = (~used & (used + 1)).bit_length() - 1
+
+        for p in c:
+            if (particle_inv_mass[p] > 0.0):
+                masks[p] |= 1 << color
+
+        colors.append(color)
+
+    num_colors = max(colors) + 1 if colors else 0
+
+    counts = [0]*num_colors
+    for color in colors:
+        counts[color] += 1
+
+    offsets = [0]
+    for count in counts:
+        offsets.append(offsets[-1] + count)
+
+    order = [0]*len(colors)
+    heads = offsets[:-1]
+
+    for i, color in enumerate(colors):
+        order[heads[color]] = i
+        heads[color] += 1
+
+    return order, offsets
+
 class Mesh:
     """Describes a triangle collision mesh for simulation
 
@@ -136,6 +189,73 @@ class Mesh:
         return self.mesh.id
 
 
+class SDF:
+    """Describes a static collision shape given by the signed distance field of a closed triangle mesh
+
+    The field is baked into a sparse level set with :meth:`warp.Volume.bake_mesh` when the model is finalized,
+    contacts are then found by sampling the volume instead of walking the mesh BVH. Distances saturate at
+    the half width of the band, which must be at least the soft contact margin of the model, this is
+    checked by :meth:`ModelBuilder.finalize` and :func:`warp.sim.collide`.
+
+    Attributes:
+
+        mesh (Mesh): The mesh the field is baked from, it provides the mass properties of the shape
+        voxel_size (float): Edge length of the voxels
+        band_width (float): Half width of the narrow band in voxels
+        path (str): Optional cache file, the volume is stored next to it with a hash of the mesh, voxel size and band width appended to the
+                    file name, if that file exists the volume is loaded from it instead of baked, otherwise the baked volume is written to it
+    """
+
+    def __init__(self, mesh: Mesh, voxel_size: float, band_width: float=3.0, path: str=None):
+
+        self.mesh = mesh
+        self.voxel_size = voxel_size
+        self.band_width = band_width
+        self.path = path
+
+        self.vertices = mesh.vertices
+        self.indices = mesh.indices
+        self.I = mesh.I
+        self.mass = mesh.mass
+        self.com = mesh.com
+
+    def cache_path(self):
+        """Returns the file the volume is cached in, or None if the field is not cached"""
+
+        import hashlib
+        import os
+
+        if (not self.path):
+            return None
+
+        # a file baked from different inputs has a different name and is never loaded in place of this one
+        h = hashlib.sha256()
+        h.update(np.ascontiguousarray(self.vertices, dtype=np.float32).tobytes())
+        h.update(np.ascontiguousarray(self.indices, dtype=np.int32).tobytes())
+        h.update(np.array([self.voxel_size, self.band_width], dtype=np.float64).tobytes())
+
+        (root, ext) = os.path.splitext(self.path)
+
+        return f"{root}_{h.hexdigest()[:16]}{ext}"
+
+    def finalize(self, device):
+
+        import os
+
+        path = self.cache_path()
+
+        if (path and os.path.exists(path)):
+            self.volume = wp.Volume.load(path, device=device)
+        else:
+            self.mesh.finalize(device)
+            self.volume = wp.Volume.bake_mesh(self.mesh.mesh, self.voxel_size, self.band_width)
+
+            if (path):
+                self.volume.save(path)
+
+        return self.volume.id
+
+
 class State:
     """The State object holds all *time-varying* data for a model.
     
@@ -202,6 +322,7 @@ class Model:
         shape_geo_type (wp.array): Rigid shape geometry type, [shape_count], int
         shape_geo_src (wp.array): Rigid shape geometry source, shape [shape_count], int
         shape_geo_scale (wp.array): Rigid shape geometry scale, shape [shape_count, 3], float
+        shape_sdf_band (wp.array): Scaled band half width of SDF shapes, 0 for other shapes, shape [shape_count], float
         shape_materials (wp.array): Rigid shape contact materials, shape [shape_count, 4], float
 
         spring_indices (wp.array): Particle spring indices, shape [spring_count*2], int
@@ -209,6 +330,8 @@ class Model:
         spring_stiffness (wp.array): Particle spring stiffness, shape [spring_count], float
         spring_damping (wp.array): Particle spring damping, shape [spring_count], float
         spring_control (wp.array): Particle spring activation, shape [spring_count], float
+        spring_color_indices (wp.array): Spring indices grouped by constraint color, shape [spring_count], int
+        spring_color_offsets (list): Start of each color in spring_color_indices, with a trailing sentinel, length [spring_color_count+1], int
 
         tri_indices (wp.array): Triangle element indices, shape [tri_count*3], int
         tri_poses (wp.array): Triangle element rest pose, shape [tri_count, 2, 2], float
@@ -221,6 +344,8 @@ class Model:
         tet_poses (wp.array): Tetrahedral rest poses, shape [tet_count, 3, 3], float
         tet_activations (wp.array): Tetrahedral volumetric activations, shape [tet_count], float
         tet_materials (wp.array): Tetrahedral elastic parameters in form :math:`k_{mu}, k_{lambda}, k_{damp}`, shape [tet_count, 3]
+        tet_color_indices (wp.array): Tetrahedron indices grouped by constraint color, shape [tet_count], int
+        tet_color_offsets (list): Start of each color in tet_color_indices, with a trailing sentinel, length [tet_color_count+1], int
         
         body_com (wp.array): Rigid body center of mass (in local frame), shape [body_count, 7], float
         body_inertia (wp.array): Rigid body inertia tensor (relative to COM), shape [body_count, 3, 3], float
@@ -262,6 +387,7 @@ class Model:
         self.shape_geo_type = None
         self.shape_geo_src = None
         self.shape_geo_scale = None
+        self.shape_sdf_band = None
         self.shape_materials = None
 
         self.spring_indices = None
@@ -269,6 +395,8 @@ class Model:
         self.spring_stiffness = None
         self.spring_damping = None
         self.spring_control = None
+        self.spring_color_indices = None
+        self.spring_color_offsets = [0]
 
         self.tri_indices = None
         self.tri_poses = None
@@ -281,6 +409,8 @@ class Model:
         self.tet_poses = None
         self.tet_activations = None
         self.tet_materials = None
+        self.tet_color_indices = None
+        self.tet_color_offsets = [0]
         
         self.body_com = None
         self.body_inertia = None
@@ -313,6 +443,10 @@ class Model:
 
         self.soft_contact_distance = 0.1
         self.soft_contact_margin = 0.2
+
+        # narrowest scaled band of the SDF shapes, the margin may not exceed it
+        self.soft_contact_sdf_band = None
+
         self.soft_contact_ke = 1.e+3
         self.soft_contact_kd = 10.0
         self.soft_contact_kf = 1.e+3
@@ -336,6 +470,7 @@ class Model:
         self.particle_cohesion = 0.0
         self.particle_adhesion = 0.0
         self.particle_grid = None
+        self.particle_neighbors = None
 
         self.device = device
 
@@ -400,6 +535,36 @@ class Model:
 
         return tensors
 
+    def update_particle_neighbors(self, particle_q, skin: float=0.0, margin: float=0.0):
+        """Rebuilds the particle hash grid and the cached particle neighbor list if needed
+
+        Once the neighbor list has been built particle-particle contact iterates over it instead of querying the hash grid.
+        Neighbors are all particles within ``2*particle_radius + particle_cohesion + skin``, the list is reused until some
+        particle has moved further than ``skin/2`` since the last rebuild. Calls that do not rebuild only check the displacement
+        of the particles, which synchronizes with the device, so instead of calling it before every step it can be called
+        every few steps with a ``margin`` that bounds the distance particles move in between, otherwise contacts may be missed.
+
+        Args:
+            particle_q: The current particle positions
+            skin: Extra distance that neighbors are found within
+            margin: Distance particles may move before the next call
+
+        Returns:
+            True if the neighbors were rebuilt
+        """
+
+        cutoff = self.particle_radius*2.0 + self.particle_cohesion
+
+        neighbors = self.particle_neighbors
+
+        if (neighbors.radius == cutoff and neighbors.skin == skin and not neighbors.needs_rebuild(particle_q, margin)):
+            return False
+
+        self.particle_grid.build(particle_q, cutoff + skin)
+        neighbors.build(self.particle_grid, particle_q, cutoff, skin)
+
+        return True
+
     # builds contacts
     def collide(self, state: State):
         """Constructs a set of contacts between rigid bodies and ground
@@ -481,7 +646,7 @@ class Model:
                 add_contact(shape_body[i], -1, X_bs, (-edges[0], edges[1], edges[2]), 0.0, i)
                 add_contact(shape_body[i], -1, X_bs, (edges[0], edges[1], edges[2]), 0.0, i)
 
-            elif (geo_type == GEO_MESH):
+            elif (geo_type == GEO_MESH or geo_type == GEO_SDF):
 
                 mesh = shape_geo_src[i]
                 scale = shape_geo_scale[i]
@@ -902,6 +1067,35 @@ class ModelBuilder:
 
         self._add_shape(body, pos, rot, GEO_MESH, (scale[0], scale[1], scale[2], 0.0), mesh, density, ke, kd, kf, mu)
 
+    def add_shape_sdf(self,
+                      body: int,
+                      pos: Vec3=(0.0, 0.0, 0.0),
+                      rot: Quat=(0.0, 0.0, 0.0, 1.0),
+                      sdf: SDF=None,
+                      scale: Vec3=(1.0, 1.0, 1.0),
+                      density: float=1000.0,
+                      ke: float=1.e+5,
+                      kd: float=1000.0,
+                      kf: float=1000.0,
+                      mu: float=0.5):
+        """Adds a signed distance field collision shape to a body, particles collide with it by sampling the baked volume.
+
+        Args:
+            body: The index of the parent body this shape belongs to
+            pos: The location of the shape with respect to the parent frame
+            rot: The rotation of the shape with respect to the parent frame
+            sdf: The sdf object
+            scale: Scale to use for the collider, only uniform scale is supported
+            density: The density of the shape
+            ke: The contact elastic stiffness
+            kd: The contact damping stiffness
+            kf: The contact friction stiffness
+            mu: The coefficient of friction
+
+        """
+
+        self._add_shape(body, pos, rot, GEO_SDF, (scale[0], scale[1], scale[2], 0.0), sdf, density, ke, kd, kf, mu)
+
     def _add_shape(self, body , pos, rot, type, scale, src, density, ke, kd, kf, mu):
         self.shape_body.append(body)
         self.shape_transform.append(wp.transform(pos, rot))
@@ -1585,7 +1779,7 @@ class ModelBuilder:
             return self.compute_box_inertia(density, scale[0] * 2.0, scale[1] * 2.0, scale[2] * 2.0)
         elif (type == GEO_CAPSULE):
             return self.compute_capsule_inertia(density, scale[0], scale[1] * 2.0)
-        elif (type == GEO_MESH):
+        elif (type == GEO_MESH or type == GEO_SDF):
             #todo: non-uniform scale of inertia tensor
             s = scale[0]
             return (density * src.mass * s * s * s, density * src.I * s * s * s * s * s)
@@ -1655,6 +1849,9 @@ class ModelBuilder:
         #-------------------------------------
         # construct Model (non-time varying) data
 
+        # resolve the cuda alias so that all model buffers stay on one device
+        device = wp.get_device(device)
+
         m = Model(device)
 
         #---------------------        
@@ -1674,6 +1871,18 @@ class ModelBuilder:
         m.shape_geo_type = wp.array(self.shape_geo_type, dtype=wp.int32, device=device)
         m.shape_geo_src = self.shape_geo_src
 
+        # distances of SDF shapes saturate at the band half width, particles further from the
+        # surface than the band are not contacts, checked before anything is baked
+        shape_sdf_band = []
+        for geo_type, scale, geo in zip(self.shape_geo_type, self.shape_geo_scale, self.shape_geo_src):
+            if (geo_type == GEO_SDF):
+                band = geo.band_width*geo.voxel_size*scale[0]
+                if (band < m.soft_contact_margin):
+                    raise RuntimeError(f"SDF band of {band} (band_width*voxel_size*scale) is narrower than the soft contact margin {m.soft_contact_margin}, increase band_width")
+                shape_sdf_band.append(band)
+            else:
+                shape_sdf_band.append(0.0)
+
         # build list of ids for geometry sources (meshes, sdfs)
         shape_geo_id = []
         for geo in self.shape_geo_src:
@@ -1683,6 +1892,8 @@ class ModelBuilder:
                 shape_geo_id.append(-1)
 
         m.shape_geo_id = wp.array(shape_geo_id, dtype=wp.uint64, device=device)
+        m.shape_sdf_band = wp.array(shape_sdf_band, dtype=wp.float32, device=device)
+        m.soft_contact_sdf_band = min([b for b in shape_sdf_band if b > 0.0], default=None)
         m.shape_geo_scale = wp.array(self.shape_geo_scale, dtype=wp.vec3, device=device)
         m.shape_materials = wp.array(self.shape_materials, dtype=wp.vec4, device=device)
 
@@ -1695,6 +1906,10 @@ class ModelBuilder:
         m.spring_damping = wp.array(self.spring_damping, dtype=wp.float32, device=device)
         m.spring_control = wp.array(self.spring_control, dtype=wp.float32, device=device)
 
+        # springs of one color share no dynamic particle and can be solved in parallel
+        spring_order, m.spring_color_offsets = color_constraints(list(zip(self.spring_indices[0::2], self.spring_indices[1::2])), particle_inv_mass)
+        m.spring_color_indices = wp.array(spring_order, dtype=wp.int32, device=device)
+
         #---------------------
         # triangles
 
@@ -1716,6 +1931,9 @@ class ModelBuilder:
         m.tet_activations = wp.array(self.tet_activations, dtype=wp.float32, device=device)
         m.tet_materials = wp.array(self.tet_materials, dtype=wp.float32, device=device)
 
+        tet_order, m.tet_color_offsets = color_constraints(self.tet_indices, particle_inv_mass)
+        m.tet_color_indices = wp.array(tet_order, dtype=wp.int32, device=device)
+
         #-----------------------
         # muscles
 
@@ -1780,6 +1998,55 @@ class ModelBuilder:
         m.soft_contact_body_vel = wp.zeros(m.soft_contact_max, dtype=wp.vec3, device=device)
         m.soft_contact_normal = wp.zeros(m.soft_contact_max, dtype=wp.vec3, device=device)
 
+        # broad phase, every shape that generates soft contacts contributes its local bounds,
+        # these are transformed to world space and inserted into a BVH by collide()
+        soft_contact_shapes = []
+        soft_contact_shape_lower = []
+        soft_contact_shape_upper = []
+
+        for i, (geo_type, scale, src) in enumerate(zip(self.shape_geo_type, self.shape_geo_scale, self.shape_geo_src)):
+
+            if (geo_type == GEO_SPHERE):
+                extent = (scale[0], scale[0], scale[0])
+            elif (geo_type == GEO_BOX):
+                extent = scale
+            elif (geo_type == GEO_CAPSULE):
+                extent = (scale[0] + scale[1], scale[0], scale[0])
+            elif (geo_type == GEO_MESH or geo_type == GEO_SDF):
+                # SDF volumes are static, collide() reads mesh bounds from the mesh BVH instead
+                vertices = np.array(src.vertices)*scale[0]
+                soft_contact_shapes.append(i)
+                soft_contact_shape_lower.append(np.min(vertices, axis=0))
+                soft_contact_shape_upper.append(np.max(vertices, axis=0))
+                continue
+            else:
+                continue
+
+            soft_contact_shapes.append(i)
+            soft_contact_shape_lower.append((-extent[0], -extent[1], -extent[2]))
+            soft_contact_shape_upper.append(extent)
+
+        m.soft_contact_shapes = wp.array(soft_contact_shapes, dtype=wp.int32, device=device)
+        m.soft_contact_shape_lower = wp.array(soft_contact_shape_lower, dtype=wp.vec3, device=device)
+        m.soft_contact_shape_upper = wp.array(soft_contact_shape_upper, dtype=wp.vec3, device=device)
+        m.soft_contact_bvh = None
+
+        # candidate (particle, shape) pairs that passed the broad phase, contacts are compacted from these
+        m.soft_contact_candidate_max = 4*m.soft_contact_max
+
+        m.soft_contact_candidate_count = wp.zeros(1, dtype=wp.int32, device=device)
+        m.soft_contact_candidate_overflow = wp.zeros(1, dtype=wp.int32, device=device)
+        m.soft_contact_candidate_particle = wp.zeros(m.soft_contact_candidate_max, dtype=int, device=device)
+        m.soft_contact_candidate_shape = wp.zeros(m.soft_contact_candidate_max, dtype=int, device=device)
+        m.soft_contact_candidate_body_pos = wp.zeros(m.soft_contact_candidate_max, dtype=wp.vec3, device=device)
+        m.soft_contact_candidate_body_vel = wp.zeros(m.soft_contact_candidate_max, dtype=wp.vec3, device=device)
+        m.soft_contact_candidate_normal = wp.zeros(m.soft_contact_candidate_max, dtype=wp.vec3, device=device)
+        m.soft_contact_candidate_flag = wp.zeros(m.soft_contact_candidate_max, dtype=int, device=device)
+        m.soft_contact_candidate_offset = wp.zeros(m.soft_contact_candidate_max, dtype=int, device=device)
+
+        m.soft_contact_particle_count = wp.zeros(len(self.particle_q), dtype=int, device=device)
+        m.soft_contact_particle_offset = wp.zeros(len(self.particle_q), dtype=int, device=device)
+
         # counts
         m.particle_count = len(self.particle_q)
         m.body_count = len(self.body_q)
@@ -1798,6 +2065,7 @@ class ModelBuilder:
         
         # hash-grid for particle interactions
         m.particle_grid = wp.HashGrid(128, 128, 128, device)
+        m.particle_neighbors = wp.NeighborList(device)
 
         # store refs to geometry
         m.geo_meshes = self.geo_meshes
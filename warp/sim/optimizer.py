@@ -63,10 +63,7 @@ def inner(a, b, out):
     if (a.device != b.device):
         raise RuntimeError("Inner product devices do not match")
 
-    if a.device == "cpu":
-        wp.runtime.array_inner_host(a, b, out, a.length)
-    elif a.device == "cuda":
-        wp.runtime.array_inner_device(a, b, out, a.length)
+    wp.array_inner(a, b, out)
 
 class Optimizer:
 
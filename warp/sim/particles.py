@@ -36,6 +36,35 @@ def particle_force(n: wp.vec3,
     return  -n*fn - vt*ft
 
 
+@wp.func
+def particle_contact_force(x: wp.vec3,
+                           v: wp.vec3,
+                           x_j: wp.vec3,
+                           v_j: wp.vec3,
+                           radius: float,
+                           k_contact: float,
+                           k_damp: float,
+                           k_friction: float,
+                           k_mu: float,
+                           k_cohesion: float):
+
+    # compute distance to point
+    n = x - x_j
+    d = wp.length(n)
+    err = d - radius*2.0
+
+    f = wp.vec3()
+
+    if (err <= k_cohesion):
+
+        n = n/d
+        vrel = v - v_j
+
+        f = particle_force(n, vrel, err, k_contact, k_damp, k_friction, k_mu)
+
+    return f
+
+
 @wp.kernel
 def eval_particle_forces_kernel(grid : wp.uint64,
                  particle_x: wp.array(dtype=wp.vec3),
@@ -62,25 +91,43 @@ def eval_particle_forces_kernel(grid : wp.uint64,
     query = wp.hash_grid_query(grid, x, radius*2.0+k_cohesion)
     index = int(0)
 
-    count = int(0)
-
     while(wp.hash_grid_query_next(query, index)):
 
         if index != i:
-            
-            # compute distance to point
-            n = x - particle_x[index]
-            d = wp.length(n)
-            err = d - radius*2.0
+            f = f + particle_contact_force(x, v, particle_x[index], particle_v[index], radius, k_contact, k_damp, k_friction, k_mu, k_cohesion)
+
+    particle_f[i] = f
+
+
+@wp.kernel
+def eval_particle_forces_neighbors_kernel(grid : wp.uint64,
+                 neighbors : wp.uint64,
+                 particle_x: wp.array(dtype=wp.vec3),
+                 particle_v: wp.array(dtype=wp.vec3),
+                 particle_f: wp.array(dtype=wp.vec3),
+                 radius: float,
+                 k_contact: float,
+                 k_damp: float,
+                 k_friction: float,
+                 k_mu: float,
+                 k_cohesion: float):
+
+    tid = wp.tid()
+
+    # order threads by the cells of the last rebuild
+    i = wp.hash_grid_point_id(grid, tid)
 
-            count += 1
+    x = particle_x[i]
+    v = particle_v[i]
 
-            if (err <= k_cohesion):
+    f = wp.vec3()
 
-                n = n/d
-                vrel = v - particle_v[index]
+    # particle contact, the list excludes the particle itself
+    query = wp.neighbor_list_query(neighbors, i)
+    index = int(0)
 
-                f = f + particle_force(n, vrel, err, k_contact, k_damp, k_friction, k_mu)
+    while(wp.neighbor_list_query_next(query, index)):
+        f = f + particle_contact_force(x, v, particle_x[index], particle_v[index], radius, k_contact, k_damp, k_friction, k_mu, k_cohesion)
 
     particle_f[i] = f
 
@@ -88,20 +135,46 @@ def eval_particle_forces_kernel(grid : wp.uint64,
 def eval_particle_forces(model, state, forces):
 
     if (model.particle_radius > 0.0):
-                        
-        wp.launch(
-            kernel=eval_particle_forces_kernel,
-            dim=model.particle_count,
-            inputs=[
-                model.particle_grid.id,
-                state.particle_q,
-                state.particle_qd,
-                forces,
-                model.particle_radius,
-                model.particle_ke,
-                model.particle_kd,
-                model.particle_kf,
-                model.particle_mu,
-                model.particle_cohesion
-            ],
-            device=model.device)
+
+        # use the cached neighbors once Model.update_particle_neighbors() has built them, the grid is
+        # queried instead if it has been rebuilt directly since (e.g.: particle_grid.build())
+        neighbors = model.particle_neighbors
+
+        if (neighbors is not None and neighbors.num_points == model.particle_count and neighbors.is_current(model.particle_grid)):
+
+            wp.launch(
+                kernel=eval_particle_forces_neighbors_kernel,
+                dim=model.particle_count,
+                inputs=[
+                    model.particle_grid.id,
+                    model.particle_neighbors.id,
+                    state.particle_q,
+                    state.particle_qd,
+                    forces,
+                    model.particle_radius,
+                    model.particle_ke,
+                    model.particle_kd,
+                    model.particle_kf,
+                    model.particle_mu,
+                    model.particle_cohesion
+                ],
+                device=model.device)
+
+        else:
+
+            wp.launch(
+                kernel=eval_particle_forces_kernel,
+                dim=model.particle_count,
+                inputs=[
+                    model.particle_grid.id,
+                    state.particle_q,
+                    state.particle_qd,
+                    forces,
+                    model.particle_radius,
+                    model.particle_ke,
+                    model.particle_kd,
+                    model.particle_kf,
+                    model.particle_mu,
+                    model.particle_cohesion
+                ],
+                device=model.device)
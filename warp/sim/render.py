@@ -97,7 +97,7 @@ class SimRenderer(warp.render.UsdRenderer):
                     wp.render._usd_add_xform(mesh)
                     wp.render._usd_set_xform(mesh, X_bs.p, X_bs.q, (geo_scale[0], geo_scale[1], geo_scale[2]), 0.0)
 
-                elif (geo_type == warp.sim.GEO_MESH):
+                elif (geo_type == warp.sim.GEO_MESH or geo_type == warp.sim.GEO_SDF):
 
                     mesh = UsdGeom.Mesh.Define(self.stage, parent_path.AppendChild("mesh_" + str(s)))
                     mesh.GetPointsAttr().Set(geo_src.vertices)
@@ -107,8 +107,6 @@ class SimRenderer(warp.render.UsdRenderer):
                     wp.render._usd_add_xform(mesh)
                     wp.render._usd_set_xform(mesh, X_bs.p, X_bs.q, (geo_scale[0], geo_scale[1], geo_scale[2]), 0.0)
 
-                elif (geo_type == warp.sim.GEO_SDF):
-                    pass
         
 
 
@@ -5,6 +5,8 @@
 # distribution of this software and related documentation without an express
 # license agreement from NVIDIA CORPORATION is strictly prohibited.
 
+import ctypes
+
 import numpy as np
 import warp as wp
 
@@ -19,6 +21,16 @@ class Tape:
         self.capture_graph_forward = None
         self.capture_graph_backward = None
 
+        # graph of the forward and backward pass built by capture_graph(), with the graph kernel node of each launch
+        self.graph = None
+        self.graph_launches = []
+
+    def __del__(self):
+        try:
+            self.destroy_graph()
+        except:
+            pass
+
     def __enter__(self):      
         if (wp.context.runtime.tape != None):
             raise RuntimeError("Warp: Error, entering a tape while one is already active")
@@ -134,8 +146,164 @@ class Tape:
             self.gradients[a] = adj
             return adj
 
+    def capture_graph(self, loss: wp.array=None, grads: dict=None, zero: list=[]):
+        """Captures the recorded forward launches followed by the backward pass into a single CUDA graph
+
+        Once captured :meth:`replay` re-evaluates the forward pass and accumulates fresh gradients with one graph launch,
+        without walking the recorded launches in Python. Gradients are zeroed at the start of every replay, except for
+        the loss and user specified gradients. Only the kernel launches recorded on the tape are part of the graph,
+        all of them must be on the same CUDA device.
+
+        Args:
+            loss: Optional scalar loss, its gradient is seeded with one
+            grads: Optional mapping from output arrays to their incoming gradients
+            zero: Arrays zeroed at the start of every replay, e.g.: outputs that kernels accumulate into with atomics
+        """
+
+        device = self.launches[0][4] if self.launches else "cuda"
+
+        for launch in self.launches:
+            if (launch[4] == "cpu" or launch[4] != device):
+                raise RuntimeError(f"Tape.capture_graph() requires all launches to be on the same cuda device, kernel '{launch[0].key}' was launched on '{launch[4]}'")
+
+        self.destroy_graph()
+
+        seeded = []
+
+        if (loss):
+            self.gradients[loss] = wp.array(np.ones(1), dtype=wp.float32, device=loss.device)
+            seeded.append(self.gradients[loss])
+
+        if (grads):
+            self.gradients.update(grads)
+            seeded.extend(grads.values())
+
+        forward = []
+        backward = []
+
+        for kernel, dim, inputs, outputs, device in self.launches:
+            forward.append(wp.Launch(kernel, dim, inputs, outputs, device=device))
+
+        # allocates all adjoints before the capture begins
+        for kernel, dim, inputs, outputs, device in reversed(self.launches):
+
+            adj_inputs = [self.get_adjoint(a) for a in inputs]
+            adj_outputs = [self.get_adjoint(a) for a in outputs]
+
+            backward.append(wp.Launch(kernel, dim, inputs, outputs, adj_inputs, adj_outputs, device=device, adjoint=True))
+
+        with wp.ScopedDevice(device):
+
+            wp.capture_begin()
+
+            try:
+                for a in zero:
+                    a.zero_()
+
+                for v in self.gradients.values():
+                    if not any(v is s for s in seeded):
+                        v.zero_()
+
+                for l in forward + backward:
+                    l.launch()
+
+            except:
+                # end the invalidated capture and discard its graph, the original error is the one reported
+                try:
+                    graph = wp.capture_end()
+                    wp.context.runtime.core.cuda_graph_destroy(ctypes.c_void_p(graph))
+                except Exception:
+                    pass
+
+                raise
+
+            graph = wp.capture_end()
+
+        self.graph = graph
+
+        # match each launch to its kernel node, other runtime work (e.g.: memsets) also creates kernel nodes
+        core = wp.context.runtime.core
+        graph = ctypes.c_void_p(self.graph)
+
+        nodes = [core.cuda_graph_get_kernel(graph, i) for i in range(core.cuda_graph_get_kernel_count(graph))]
+        node = 0
+
+        for l in forward + backward:
+
+            index = -1
+
+            if (l.bounds.size > 0):
+
+                func = l.func
+
+                while node < len(nodes) and nodes[node] != func:
+                    node += 1
+
+                if (node < len(nodes)):
+                    index = node
+                    node += 1
+
+            self.graph_launches.append((l, index))
+
+    def set_param(self, name: str, value, kernel=None) -> int:
+        """Changes an argument of the launches in the graph built by :meth:`capture_graph`, without recapturing it
+
+        The forward and backward launch of every recorded kernel with a parameter called ``name`` are updated, which is
+        intended for scalars such as time steps or loss weights. Arrays may also be replaced by arrays of the same type,
+        their gradients are still written to the adjoints allocated at capture time.
+
+        Args:
+            name: Name of the kernel parameter
+            value: The new value
+            kernel: Optional kernel, if given only its launches are updated
+
+        Returns:
+            The number of graph launches that were updated
+        """
+
+        if (self.graph == None):
+            raise RuntimeError("Tape.set_param() requires a graph built with Tape.capture_graph()")
+
+        core = wp.context.runtime.core
+        graph = ctypes.c_void_p(self.graph)
+
+        count = 0
+
+        for l, index in self.graph_launches:
+
+            if (kernel != None and l.kernel != kernel):
+                continue
+
+            if (name not in l.arg_index):
+                continue
+
+            if (index < 0):
+                raise RuntimeError(f"Unable to find the graph node of kernel '{l.kernel.key}'")
+
+            l.set_param(name, value)
+
+            if (not core.cuda_graph_set_kernel_params(graph, index, l.kernel_params)):
+                raise RuntimeError(f"Unable to update parameter '{name}' of kernel '{l.kernel.key}' in the graph")
+
+            count += 1
+
+        return count
+
+    def destroy_graph(self):
+
+        if (self.graph):
+            wp.context.runtime.core.cuda_graph_destroy(ctypes.c_void_p(self.graph))
+
+        self.graph = None
+        self.graph_launches = []
+
     def replay(self):
         
+        # single graph of the forward and backward pass
+        if (self.graph):
+            wp.capture_launch(self.graph)
+            return
+
         if self.capture == False:
             raise RuntimeError("Cannot replay from a non-captured Tape")
 
@@ -146,6 +314,166 @@ class Tape:
     def reset(self):
         
         self.launches = []
+        self.destroy_graph()
 
         for a in self.gradients.values():
             a.zero_()
+
+
+def state_arrays(state):
+    """Returns the arrays of a state object in a consistent order, e.g.: the attributes of a :class:`warp.sim.State`"""
+
+    return [v for v in vars(state).values() if isinstance(v, wp.array)]
+
+
+class CheckpointTape:
+    """Differentiates a rollout of many steps while only storing the state at the start of each segment of steps
+
+    Recording a long rollout on a :class:`Tape` keeps the arrays of every step alive along with their adjoints. A
+    ``CheckpointTape`` instead runs :meth:`forward` without recording and copies the state at the start of every
+    segment of ``segment_length`` steps. :meth:`backward` then processes the segments last to first, each is
+    recomputed from its checkpoint on a temporary tape and differentiated, after which its states and adjoints are
+    released. Memory is proportional to ``num_steps/segment_length + segment_length`` states, which is smallest for
+    segments of ``sqrt(num_steps)`` steps, at the cost of running the forward pass twice.
+
+    The rollout must be deterministic, and ``step`` must only write to ``state_out``. Gradients of arrays that are
+    not part of the states, e.g.: model parameters with ``requires_grad=True``, are accumulated over all segments. ::
+
+        def step(state_in, state_out, i):
+            state_in.clear_forces()
+            integrator.simulate(model, state_in, state_out, dt)
+
+        rollout = wp.CheckpointTape(step, num_steps=4096, make_state=lambda: model.state(requires_grad=True))
+        final = rollout.forward(state_0)
+
+        tape = wp.Tape()
+        with tape:
+            wp.launch(loss_kernel, dim=n, inputs=[final.particle_q, loss], device="cuda")
+
+        tape.backward(loss)
+        rollout.backward(tape.gradients)
+
+        grad = rollout.gradients[state_0.particle_qd]
+
+    Args:
+        step: Function called as ``step(state_in, state_out, i)`` that issues the launches of step ``i``
+        num_steps: Number of steps in the rollout
+        make_state: Function returning a new state, the arrays of all states must be in the same order, see :func:`state_arrays`
+        segment_length: Number of steps between checkpoints, 0 uses ``ceil(sqrt(num_steps))``
+    """
+
+    def __init__(self, step, num_steps: int, make_state, segment_length: int=0):
+
+        if (segment_length <= 0):
+            segment_length = int(np.ceil(np.sqrt(num_steps)))
+
+        self.step = step
+        self.num_steps = num_steps
+        self.make_state = make_state
+        self.segment_length = max(1, segment_length)
+
+        self.checkpoints = []
+        self.final = None
+
+        self.gradients = {}
+
+    def copy_state(self, dest, src):
+
+        for d, s in zip(state_arrays(dest), state_arrays(src)):
+            wp.copy(d, s)
+
+    def forward(self, state):
+        """Runs the rollout from ``state`` and returns the final state, the states at the start of each segment are stored"""
+
+        self.checkpoints = []
+        self.gradients = {}
+
+        # steps alternate between two working states
+        work = [self.make_state(), self.make_state()]
+        current = state
+
+        for start in range(0, self.num_steps, self.segment_length):
+
+            if (start == 0):
+                # the initial state belongs to the caller and is not copied
+                self.checkpoints.append(state)
+            else:
+                checkpoint = self.make_state()
+                self.copy_state(checkpoint, current)
+                self.checkpoints.append(checkpoint)
+
+            for i in range(start, min(start + self.segment_length, self.num_steps)):
+
+                out = work[i%2]
+                self.step(current, out, i)
+                current = out
+
+        self.final = self.make_state()
+        self.copy_state(self.final, current)
+
+        return self.final
+
+    def backward(self, grads: dict):
+        """Computes the gradients with respect to the initial state and other inputs of the rollout
+
+        Args:
+            grads: Mapping from the arrays of the final state returned by :meth:`forward` to their gradients,
+                   e.g.: :attr:`Tape.gradients` of a tape that computed a loss from the final state
+
+        Returns:
+            The :attr:`gradients` mapping, which holds the gradients of the arrays of the initial state and of
+            any other arrays the steps read from
+        """
+
+        if (self.final == None):
+            raise RuntimeError("CheckpointTape.backward() must be called after CheckpointTape.forward()")
+
+        # incoming adjoints of the state at the end of the current segment, by position
+        adj = [grads.get(a) for a in state_arrays(self.final)]
+
+        for s in reversed(range(len(self.checkpoints))):
+
+            start = s*self.segment_length
+            end = min(start + self.segment_length, self.num_steps)
+
+            states = [self.checkpoints[s]] + [self.make_state() for i in range(start, end)]
+
+            # arrays outside of the states accumulate into the gradients of previous segments
+            tape = Tape()
+            tape.gradients.update(self.gradients)
+
+            with tape:
+                for i in range(start, end):
+                    self.step(states[i - start], states[i - start + 1], i)
+
+            seeds = {}
+            for a, g in zip(state_arrays(states[-1]), adj):
+                if (g is not None):
+                    seeds[a] = g
+
+            tape.backward(grads=seeds)
+
+            adj = [tape.gradients.get(a) for a in state_arrays(states[0])]
+
+            segment_arrays = set(id(a) for state in states for a in state_arrays(state))
+
+            for a, g in tape.gradients.items():
+                if (id(a) not in segment_arrays):
+                    self.gradients[a] = g
+
+            # releases the recomputed states and their adjoints before the previous segment is processed
+            del tape
+            del states
+
+            # checkpoints are only needed once
+            if (s > 0):
+                self.checkpoints[s] = None
+
+        for a, g in zip(state_arrays(self.checkpoints[0]), adj):
+            if (g is not None):
+                self.gradients[a] = g
+
+        self.checkpoints = []
+        self.final = None
+
+        return self.gradients
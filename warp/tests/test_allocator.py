@@ -0,0 +1,132 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+@wp.kernel
+def inc_kernel(a: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    a[tid] = a[tid] + 1.0
+
+
+def test_allocator_reuse(test, device):
+
+    wp.synchronize()
+    wp.trim_memory(device)
+
+    a = wp.zeros(1000, dtype=float, device=device)
+    ptr = a.ptr
+    del a
+
+    # allocation of a similarly sized array should be served from the cache
+    stats = wp.get_memory_stats(device)
+    hits = stats["num_hits"]
+
+    b = wp.zeros(1010, dtype=float, device=device)
+
+    test.assertEqual(b.ptr, ptr)
+    test.assertEqual(wp.get_memory_stats(device)["num_hits"], hits + 1)
+
+    # reused memory must still be zero initialized
+    assert_np_equal(b.numpy(), np.zeros(1010))
+
+
+def test_allocator_stats(test, device):
+
+    wp.synchronize()
+    wp.trim_memory(device)
+
+    base = wp.get_memory_stats(device)
+
+    arrays = [wp.zeros(n, dtype=wp.vec3, device=device) for n in [1, 100, 10000]]
+
+    stats = wp.get_memory_stats(device)
+    test.assertEqual(stats["bytes_requested"] - base["bytes_requested"], 12*(1 + 100 + 10000))
+    test.assertGreaterEqual(stats["bytes_in_use"] - base["bytes_in_use"], 12*(1 + 100 + 10000))
+    test.assertGreaterEqual(stats["high_water_mark"], stats["bytes_in_use"])
+    test.assertTrue(stats["fragmentation"] >= 0.0 and stats["fragmentation"] < 1.0)
+
+    arrays = None
+
+    stats = wp.get_memory_stats(device)
+    test.assertEqual(stats["bytes_in_use"], base["bytes_in_use"])
+    test.assertGreater(stats["bytes_cached"], 0)
+
+    wp.synchronize()
+    wp.trim_memory(device)
+
+    test.assertEqual(wp.get_memory_stats(device)["bytes_cached"], 0)
+
+
+def test_allocator_side_stream(test, device):
+
+    n = 1024*64
+
+    wp.synchronize()
+    wp.trim_memory(device)
+
+    s = wp.Stream(device=device)
+
+    a = wp.zeros(n, dtype=float, device=device)
+    s.wait_stream(wp.get_stream(device))
+
+    for i in range(10):
+        wp.launch(inc_kernel, dim=n, inputs=[a], device=device, stream=s)
+
+    # the array remembers the side stream, its block is fenced on it when freed
+    test.assertTrue(s in a.streams)
+
+    # the array keeps the stream alive after the last user reference to it is dropped
+    del s
+
+    ptr = a.ptr
+    del a
+
+    # the reused block must not be cleared before the side stream is done with it
+    b = wp.zeros(n, dtype=float, device=device)
+    test.assertEqual(b.ptr, ptr)
+
+    wp.launch(inc_kernel, dim=n, inputs=[b], device=device)
+
+    assert_np_equal(b.numpy(), np.full(n, 1.0))
+
+
+def test_allocator_block_size(test, device):
+
+    for size in [1, 255, 256, 257, 1000, 4096, 4097, 1000000, 123456789]:
+
+        block = wp.context.Allocator.block_size(size)
+
+        # blocks cover the request and waste at most a quarter of an octave
+        test.assertGreaterEqual(block, size)
+        test.assertTrue(block <= max(256, size*1.25 + 256))
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestAllocator(parent):
+        pass
+
+    add_function_test(TestAllocator, "test_allocator_reuse", test_allocator_reuse, devices=devices)
+    add_function_test(TestAllocator, "test_allocator_stats", test_allocator_stats, devices=devices)
+    add_function_test(TestAllocator, "test_allocator_side_stream", test_allocator_side_stream, devices=[d for d in devices if d != "cpu"])
+    add_function_test(TestAllocator, "test_allocator_block_size", test_allocator_block_size, devices=["cpu"])
+
+    return TestAllocator
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
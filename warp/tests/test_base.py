@@ -79,18 +79,18 @@ def add_function_test(cls, name, func, devices=["cpu"], **kwargs):
     
     for device in devices:
 
-        # pass args to func
-        def test_func(self):
+        # pass args to func, the device is bound per iteration
+        def test_func(self, device=device):
             func(self, device, **kwargs)
         
-        setattr(cls, name + "_" + device, test_func)
+        setattr(cls, name + "_" + device.replace(":", "_"), test_func)
 
 
 def add_kernel_test(cls, kernel, dim, name=None, expect=None, inputs=None, devices=["cpu"]):
     
     for device in devices:
 
-        def test_func(self):
+        def test_func(self, device=device):
 
             args = []
             if (inputs):
@@ -126,4 +126,4 @@ def add_kernel_test(cls, kernel, dim, name=None, expect=None, inputs=None, devic
         if (name == None):
             name = kernel.key
 
-        setattr(cls, name + "_" + device, test_func)
+        setattr(cls, name + "_" + device.replace(":", "_"), test_func)
@@ -0,0 +1,170 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import os
+import sys
+import uuid
+import tempfile
+import importlib
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+# generated modules are written here, each test creates modules with unique names and sources
+# so that they are built rather than served from the kernel cache
+module_dir = tempfile.mkdtemp()
+sys.path.insert(0, module_dir)
+
+def create_module(body, options=None):
+
+    name = "test_build_" + uuid.uuid4().hex
+
+    source = "import warp as wp\n\n"
+
+    if (options):
+        source += f"wp.set_module_options({repr(options)})\n\n"
+
+    source += "@wp.kernel\n"
+    source += "def build_kernel(a: wp.array(dtype=float)):\n"
+    source += "    tid = wp.tid()\n"
+    source += f"    {body}\n"
+
+    with open(os.path.join(module_dir, name + ".py"), "w") as f:
+        f.write(source)
+
+    importlib.invalidate_caches()
+
+    return importlib.import_module(name)
+
+def create_valid_module(value):
+    return create_module(f"a[tid] = {value}")
+
+def create_invalid_module():
+    return create_module("a[tid] = undefined_function(1.0)")
+
+def build_modules(modules, errors=None):
+
+    tasks = []
+    for m in modules:
+        tasks.extend([(m, t) for t in m.prepare_build()])
+
+    wp.context.run_build_tasks(tasks, errors)
+
+    for m in modules:
+        if (not m.build_failed):
+            m.finish_load([t for module, t in tasks if module is m])
+
+def check_module(test, module, device, value):
+
+    a = wp.zeros(16, dtype=float, device=device)
+    wp.launch(module.build_kernel, dim=16, inputs=[a], device=device)
+
+    assert_np_equal(a.numpy(), np.full(16, value))
+
+
+def test_build_parallel(test, device):
+
+    values = [1.0, 2.0, 3.0, 4.0]
+    py_modules = [create_valid_module(v) for v in values]
+
+    modules = [m.build_kernel.module for m in py_modules]
+    build_modules(modules)
+
+    for m, v in zip(py_modules, values):
+        test.assertTrue(m.build_kernel.module.loaded)
+        check_module(test, m, device, v)
+
+
+def test_build_errors(test, device):
+
+    valid = create_valid_module(5.0)
+    invalid = create_invalid_module()
+
+    modules = [valid.build_kernel.module, invalid.build_kernel.module]
+
+    # failures are collected rather than raised, the other modules still build
+    errors = []
+    build_modules(modules, errors)
+
+    test.assertEqual(len(errors), 1)
+    test.assertTrue(errors[0][0] is invalid.build_kernel.module)
+    test.assertTrue(invalid.build_kernel.module.build_failed)
+    test.assertFalse(valid.build_kernel.module.build_failed)
+
+    check_module(test, valid, device, 5.0)
+
+    # without an errors list the first failure is raised once every task has run
+    valid = create_valid_module(6.0)
+    invalid = create_invalid_module()
+
+    modules = [valid.build_kernel.module, invalid.build_kernel.module]
+
+    with test.assertRaises(KeyError):
+        build_modules(modules)
+
+    test.assertTrue(invalid.build_kernel.module.build_failed)
+    test.assertFalse(valid.build_kernel.module.build_failed)
+
+
+def test_build_force_load(test, device):
+
+    valid = [create_valid_module(7.0), create_valid_module(8.0)]
+    invalid = [create_invalid_module(), create_invalid_module()]
+
+    # one error is raised naming every failed module, after the others have loaded
+    with test.assertRaises(RuntimeError) as context:
+        wp.force_load()
+
+    for m in invalid:
+        test.assertTrue(m.build_kernel.module.build_failed)
+        test.assertTrue(m.build_kernel.module.name in str(context.exception))
+
+    for m in valid:
+        test.assertTrue(m.build_kernel.module.loaded)
+
+    check_module(test, valid[0], device, 7.0)
+    check_module(test, valid[1], device, 8.0)
+
+    # failed modules are not attempted again
+    wp.force_load()
+
+
+def test_build_targets(test, device):
+
+    # a module built for every target but the launch device
+    other = "cuda" if device == "cpu" else "cpu"
+    module = create_module("a[tid] = 9.0", options={"targets": [other]})
+
+    a = wp.zeros(16, dtype=float, device=device)
+
+    with test.assertRaises(RuntimeError) as context:
+        wp.launch(module.build_kernel, dim=16, inputs=[a], device=device)
+
+    test.assertTrue("was not compiled for device" in str(context.exception))
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestBuild(parent):
+        pass
+
+    add_function_test(TestBuild, "test_build_parallel", test_build_parallel, devices=devices)
+    add_function_test(TestBuild, "test_build_errors", test_build_errors, devices=devices)
+    add_function_test(TestBuild, "test_build_force_load", test_build_force_load, devices=devices)
+    add_function_test(TestBuild, "test_build_targets", test_build_targets, devices=devices)
+
+    return TestBuild
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
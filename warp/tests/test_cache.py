@@ -0,0 +1,154 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import os
+import sys
+import time
+import tempfile
+import threading
+import subprocess
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+@wp.kernel
+def cache_kernel(a: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    a[tid] = 1.0
+
+
+def test_cache_lock_threads(test, device):
+
+    with tempfile.TemporaryDirectory() as d:
+
+        path = os.path.join(d, "entry.lock")
+
+        inside = [0]
+        overlap = [False]
+        count = [0]
+
+        def worker():
+            for i in range(20):
+                with wp.build.CacheLock(path):
+
+                    inside[0] += 1
+                    if (inside[0] > 1):
+                        overlap[0] = True
+
+                    # non-atomic update, lost increments would show up in the count
+                    c = count[0]
+                    time.sleep(0.0005)
+                    count[0] = c + 1
+
+                    inside[0] -= 1
+
+        threads = [threading.Thread(target=worker) for i in range(4)]
+
+        for t in threads:
+            t.start()
+        for t in threads:
+            t.join()
+
+        test.assertFalse(overlap[0])
+        test.assertEqual(count[0], 4*20)
+
+
+def test_cache_lock_process(test, device):
+
+    with tempfile.TemporaryDirectory() as d:
+
+        path = os.path.join(d, "entry.lock")
+        marker = os.path.join(d, "marker")
+
+        # the child takes the lock, signals that it holds it, and records its release before unlocking
+        script = (
+            "import sys, time\n"
+            f"sys.path.insert(0, {repr(os.path.dirname(os.path.dirname(os.path.dirname(os.path.abspath(__file__)))))})\n"
+            "import warp.build\n"
+            f"with warp.build.CacheLock({repr(path)}):\n"
+            f"    open({repr(marker)}, 'w').write('locked')\n"
+            "    time.sleep(0.5)\n"
+            f"    open({repr(marker)}, 'w').write('released')\n")
+
+        child = subprocess.Popen([sys.executable, "-c", script])
+
+        try:
+            start = time.time()
+            while not os.path.exists(marker):
+                test.assertIsNone(child.poll())
+                test.assertLess(time.time() - start, 60.0)
+                time.sleep(0.01)
+
+            # blocks until the child has released the lock
+            with wp.build.CacheLock(path):
+                with open(marker) as f:
+                    test.assertEqual(f.read(), "released")
+
+        finally:
+            child.wait()
+
+        test.assertEqual(child.returncode, 0)
+
+
+def test_cache_write_atomic(test, device):
+
+    with tempfile.TemporaryDirectory() as d:
+
+        path = os.path.join(d, "module.cpp")
+
+        wp.build.write_file_atomic(path, "first")
+        wp.build.write_file_atomic(path, "second")
+
+        with open(path) as f:
+            test.assertEqual(f.read(), "second")
+
+        # a write that fails part way through keeps the previous contents and leaves no temporary behind
+        class Unwritable:
+            pass
+
+        with test.assertRaises(TypeError):
+            wp.build.write_file_atomic(path, Unwritable())
+
+        with open(path) as f:
+            test.assertEqual(f.read(), "second")
+
+        test.assertEqual(os.listdir(d), ["module.cpp"])
+
+
+def test_cache_key(test, device):
+
+    module = cache_kernel.module
+    module_hash = module.hash_module()
+
+    # keys are stable for the same inputs
+    test.assertEqual(module.cache_key(module_hash, "cuda", "sm_80"), module.cache_key(module_hash, "cuda", "sm_80"))
+
+    # argument lists with the same concatenation give different keys
+    test.assertNotEqual(module.cache_key(module_hash, "ab", "c"), module.cache_key(module_hash, "a", "bc"))
+    test.assertNotEqual(module.cache_key(module_hash, "abc"), module.cache_key(module_hash, "abc", ""))
+    test.assertNotEqual(module.cache_key(module_hash, "1", "23"), module.cache_key(module_hash, 12, 3))
+
+
+def register(parent):
+
+    class TestCache(parent):
+        pass
+
+    add_function_test(TestCache, "test_cache_lock_threads", test_cache_lock_threads)
+    add_function_test(TestCache, "test_cache_lock_process", test_cache_lock_process)
+    add_function_test(TestCache, "test_cache_write_atomic", test_cache_write_atomic)
+    add_function_test(TestCache, "test_cache_key", test_cache_key)
+
+    return TestCache
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
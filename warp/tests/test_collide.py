@@ -0,0 +1,164 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+import warp.sim
+from warp.tests.test_base import *
+
+wp.init()
+
+np.random.seed(42)
+
+
+def box_sdf(p, h):
+    q = np.abs(p) - h
+    return np.linalg.norm(np.maximum(q, 0.0), axis=1) + np.minimum(np.max(q, axis=1), 0.0)
+
+
+def test_soft_contacts(test, device):
+
+    builder = wp.sim.ModelBuilder()
+
+    points = np.random.rand(4096, 3)*np.array((6.0, 2.0, 2.0)) - np.array((1.0, 1.0, 1.0))
+
+    for p in points:
+        builder.add_particle(p.tolist(), (0.0, 0.0, 0.0), 1.0)
+
+    builder.add_shape_sphere(body=-1, pos=(0.0, 0.0, 0.0), radius=0.5)
+    builder.add_shape_box(body=-1, pos=(2.0, 0.0, 0.0), hx=0.3, hy=0.4, hz=0.2)
+
+    # the tilted box is only found if its world bounds account for the rotation
+    builder.add_shape_box(body=-1, pos=(4.0, 0.0, 0.0), rot=wp.quat_from_axis_angle((0.0, 0.0, 1.0), 0.25*np.pi), hx=0.6, hy=0.1, hz=0.3)
+
+    model = builder.finalize(device=device)
+    model.soft_contact_margin = 0.1
+
+    state = model.state()
+
+    wp.sim.collide(model, state)
+
+    def to_box(p, center, angle):
+        c, s = np.cos(-angle), np.sin(-angle)
+        d = p - center
+        return np.stack([c*d[:,0] - s*d[:,1], s*d[:,0] + c*d[:,1], d[:,2]], axis=1)
+
+    # brute force over all particle shape pairs
+    distances = [np.linalg.norm(points, axis=1) - 0.5,
+                 box_sdf(points - np.array((2.0, 0.0, 0.0)), np.array((0.3, 0.4, 0.2))),
+                 box_sdf(to_box(points, np.array((4.0, 0.0, 0.0)), 0.25*np.pi), np.array((0.6, 0.1, 0.3)))]
+
+    expected = np.sort(np.concatenate([np.nonzero(d < model.soft_contact_margin)[0] for d in distances]))
+
+    count = model.soft_contact_count.numpy()[0]
+    test.assertEqual(count, len(expected))
+
+    # contacts are written to the first count slots
+    particles = np.sort(model.soft_contact_particle.numpy()[0:count])
+    assert_np_equal(particles, expected.astype(np.int32))
+
+    # far fewer candidates than particle shape pairs reach the narrow phase
+    test.assertTrue(model.soft_contact_candidate_count.numpy()[0] < len(points))
+
+    # repeated calls refit the broad phase and produce the same contacts
+    wp.sim.collide(model, state)
+    test.assertEqual(model.soft_contact_count.numpy()[0], count)
+    test.assertEqual(model.soft_contact_candidate_overflow.numpy()[0], 0)
+
+    # candidates that do not fit are dropped and counted
+    total = model.soft_contact_candidate_count.numpy()[0]
+    model.soft_contact_candidate_max = total//2
+
+    wp.sim.collide(model, state)
+    test.assertEqual(model.soft_contact_candidate_overflow.numpy()[0], total - total//2)
+    test.assertTrue(model.soft_contact_count.numpy()[0] < count)
+
+
+def test_soft_contacts_mesh(test, device):
+
+    builder = wp.sim.ModelBuilder()
+
+    points = np.random.rand(4096, 3)*np.array((4.0, 2.0, 2.0)) - np.array((1.0, 1.0, 1.0))
+
+    for p in points:
+        builder.add_particle(p.tolist(), (0.0, 0.0, 0.0), 1.0)
+
+    # unit cube, vertex x*4 + y*2 + z is at the corner (x, y, z) - 0.5
+    vertices = np.array([(x - 0.5, y - 0.5, z - 0.5) for x in (0, 1) for y in (0, 1) for z in (0, 1)])
+    indices = [0, 1, 3, 0, 3, 2,
+               4, 6, 7, 4, 7, 5,
+               0, 4, 5, 0, 5, 1,
+               2, 3, 7, 2, 7, 6,
+               0, 2, 6, 0, 6, 4,
+               1, 5, 7, 1, 7, 3]
+
+    mesh = wp.sim.Mesh(vertices, indices)
+    builder.add_shape_mesh(body=-1, mesh=mesh)
+
+    model = builder.finalize(device=device)
+    model.soft_contact_margin = 0.1
+
+    state = model.state()
+
+    wp.sim.collide(model, state)
+
+    # deform the mesh away from the vertices it was finalized with, the broad phase follows its BVH
+    offset = np.array((2.0, 0.0, 0.0))
+
+    wp.copy(mesh.mesh.points, wp.array((vertices + offset).astype(np.float32), dtype=wp.vec3, device=device))
+    mesh.mesh.update()
+
+    wp.sim.collide(model, state)
+
+    # the narrow phase only finds faces within the margin, so contacts are the particles close to the surface
+    expected = np.nonzero(np.abs(box_sdf(points - offset, np.array((0.5, 0.5, 0.5)))) < model.soft_contact_margin)[0]
+
+    count = model.soft_contact_count.numpy()[0]
+    test.assertEqual(count, len(expected))
+
+    particles = np.sort(model.soft_contact_particle.numpy()[0:count])
+    assert_np_equal(particles, expected.astype(np.int32))
+
+
+def test_soft_contacts_sdf_band(test, device):
+
+    builder = wp.sim.ModelBuilder()
+    builder.add_particle((0.0, 2.0, 0.0), (0.0, 0.0, 0.0), 1.0)
+
+    vertices = np.array([(x, y, z) for x in (-0.5, 0.5) for y in (-0.5, 0.5) for z in (-0.5, 0.5)])
+    indices = [0, 1, 3, 0, 3, 2,
+               4, 6, 7, 4, 7, 5,
+               0, 4, 5, 0, 5, 1,
+               2, 3, 7, 2, 7, 6,
+               0, 2, 6, 0, 6, 4,
+               1, 5, 7, 1, 7, 3]
+
+    # a band of 3*0.05 = 0.15 does not cover the default margin of 0.2
+    sdf = wp.sim.SDF(wp.sim.Mesh(vertices, indices), voxel_size=0.05, band_width=3.0)
+    builder.add_shape_sdf(body=-1, sdf=sdf)
+
+    with test.assertRaises(RuntimeError):
+        builder.finalize(device=device)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestCollide(parent):
+        pass
+
+    add_function_test(TestCollide, "test_soft_contacts", test_soft_contacts, devices=devices)
+    add_function_test(TestCollide, "test_soft_contacts_mesh", test_soft_contacts_mesh, devices=devices)
+    add_function_test(TestCollide, "test_soft_contacts_sdf_band", test_soft_contacts_sdf_band, devices=devices)
+
+    return TestCollide
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
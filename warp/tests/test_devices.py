@@ -0,0 +1,144 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+@wp.kernel
+def scale_kernel(a: wp.array(dtype=float), s: float):
+
+    tid = wp.tid()
+
+    a[tid] = a[tid]*s
+
+
+@wp.kernel
+def closest_face_kernel(mesh: wp.uint64, points: wp.array(dtype=wp.vec3), faces: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    face_index = int(0)
+    face_u = float(0.0)
+    face_v = float(0.0)
+    sign = float(0.0)
+
+    if (wp.mesh_query_point(mesh, points[tid], 1.e+6, sign, face_index, face_u, face_v)):
+        faces[tid] = face_index
+
+
+def test_device_names(test, device):
+
+    test.assertEqual(wp.get_device("cpu"), "cpu")
+    test.assertEqual(wp.get_device_ordinal("cpu"), -1)
+
+    with test.assertRaises(RuntimeError):
+        wp.get_device("gpu")
+
+    if (device == "cpu"):
+        return
+
+    # resources store the canonical name of the device they were created on
+    a = wp.zeros(16, dtype=float, device=device)
+    test.assertEqual(a.device, device)
+    test.assertEqual(wp.get_device(device), device)
+    test.assertTrue(device in wp.get_devices())
+
+    # the alias resolves to the current device
+    with wp.ScopedDevice(device):
+        test.assertEqual(wp.get_device("cuda"), device)
+
+        b = wp.zeros(16, dtype=float, device="cuda")
+        test.assertEqual(b.device, device)
+
+
+def test_device_launch(test, device):
+
+    n = 1024
+
+    with wp.ScopedDevice(device):
+
+        a = wp.array(np.arange(n, dtype=np.float32), dtype=float, device=device)
+
+        wp.launch(scale_kernel, dim=n, inputs=[a, 2.0], device=device)
+
+        assert_np_equal(a.numpy(), 2.0*np.arange(n, dtype=np.float32))
+
+    # kernels run on the device they are launched on regardless of the current device
+    wp.launch(scale_kernel, dim=n, inputs=[a, 0.5], device=device)
+
+    assert_np_equal(a.numpy(), np.arange(n, dtype=np.float32))
+
+
+def test_device_mesh(test, device):
+
+    points = np.array([[0.0, 0.0, 0.0], [1.0, 0.0, 0.0], [0.0, 1.0, 0.0], [1.0, 1.0, 0.0]])
+    indices = np.array([0, 1, 2, 1, 3, 2])
+
+    mesh = wp.Mesh(points=wp.array(points, dtype=wp.vec3, device=device),
+                   indices=wp.array(indices, dtype=int, device=device))
+
+    test.assertEqual(mesh.device, device)
+
+    queries = wp.array(np.array([[0.2, 0.2, 1.0], [0.8, 0.8, -1.0]]), dtype=wp.vec3, device=device)
+    faces = wp.zeros(2, dtype=int, device=device)
+
+    wp.launch(closest_face_kernel, dim=2, inputs=[mesh.id, queries, faces], device=device)
+
+    assert_np_equal(faces.numpy(), np.array([0, 1]))
+
+    mesh.refit()
+
+
+def test_device_peer_copy(test, device):
+
+    devices = [d for d in wp.get_devices() if d != "cpu"]
+
+    n = 1024*64
+
+    src = wp.array(np.arange(n, dtype=np.float32), dtype=float, device=devices[0])
+    dst = wp.zeros(n, dtype=float, device=devices[1])
+
+    # the copy is ordered after the pending launch on the source device
+    wp.launch(scale_kernel, dim=n, inputs=[src, 2.0], device=devices[0])
+    wp.copy(dst, src)
+
+    # and before later launches on the source device
+    wp.launch(scale_kernel, dim=n, inputs=[src, 0.0], device=devices[0])
+
+    assert_np_equal(dst.numpy(), 2.0*np.arange(n, dtype=np.float32))
+
+    # and back again
+    wp.copy(src, dst)
+
+    assert_np_equal(src.numpy(), 2.0*np.arange(n, dtype=np.float32))
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestDevices(parent):
+        pass
+
+    cuda_devices = [d for d in devices if d != "cpu"]
+
+    add_function_test(TestDevices, "test_device_names", test_device_names, devices=devices)
+    add_function_test(TestDevices, "test_device_launch", test_device_launch, devices=cuda_devices)
+    add_function_test(TestDevices, "test_device_mesh", test_device_mesh, devices=devices)
+
+    if (len(cuda_devices) > 1):
+        add_function_test(TestDevices, "test_device_peer_copy", test_device_peer_copy, devices=[cuda_devices[1]])
+
+    return TestDevices
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -80,9 +80,9 @@ def count_neighbors_reference(
         wp.atomic_add(counts, i, 1)
 
 
-def test_hashgrid_query(test, device):
+def test_hashgrid_query(test, device, sparse=False):
         
-    grid = wp.HashGrid(dim_x, dim_y, dim_z, device)
+    grid = wp.HashGrid(dim_x, dim_y, dim_z, device, sparse=sparse)
 
     for i in range(num_runs):
 
@@ -132,6 +132,152 @@ def test_hashgrid_query(test, device):
 
             print(f"Passed: {np.array_equal(counts, counts_ref)}")
 
+def test_hashgrid_sparse_far(test, device):
+
+    grid = wp.HashGrid(dim_x, dim_y, dim_z, device, sparse=True)
+
+    # clusters at cell coordinates beyond the range of the sparse keys are clamped to the boundary cells
+    np.random.seed(532)
+    points = np.random.rand(num_points, 3)*scale
+
+    points[num_points//4:num_points//2,0] += 1.e7
+    points[num_points//2:,1] -= 1.e7
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    counts_arr = wp.zeros(num_points, dtype=int, device=device)
+    counts_arr_ref = wp.zeros(num_points, dtype=int, device=device)
+
+    wp.launch(kernel=count_neighbors_reference, dim=num_points*num_points, inputs=[query_radius, points_arr, counts_arr_ref, num_points], device=device)
+
+    grid.build(points_arr, cell_radius)
+
+    wp.launch(kernel=count_neighbors, dim=num_points, inputs=[grid.id, query_radius, points_arr, counts_arr], device=device)
+
+    test.assertTrue(np.array_equal(counts_arr.numpy(), counts_arr_ref.numpy()))
+
+
+def test_hashgrid_reorder(test, device):
+
+    grid = wp.HashGrid(dim_x, dim_y, dim_z, device)
+
+    # shuffled so that the original order has no spatial coherence
+    np.random.seed(532)
+    points = np.random.rand(num_points, 3)*scale - np.array((scale, scale, scale))*0.5
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    ids_arr = wp.array(np.arange(num_points, dtype=np.int32), dtype=int, device=device)
+    counts_arr = wp.zeros(num_points, dtype=int, device=device)
+    counts_arr_ref = wp.zeros(num_points, dtype=int, device=device)
+
+    wp.launch(kernel=count_neighbors_reference, dim=num_points*num_points, inputs=[query_radius, points_arr, counts_arr_ref, num_points], device=device)
+
+    grid.build(points_arr, cell_radius)
+    grid.reorder([points_arr, ids_arr])
+
+    # a second forward permutation would scramble the arrays
+    with test.assertRaises(RuntimeError):
+        grid.reorder([points_arr])
+
+    # ids track where each reordered point came from
+    ids = ids_arr.numpy()
+    test.assertTrue(np.array_equal(np.sort(ids), np.arange(num_points)))
+    test.assertTrue(np.allclose(points_arr.numpy(), points[ids]))
+
+    # queries now index the reordered arrays directly
+    wp.launch(kernel=count_neighbors, dim=num_points, inputs=[grid.id, query_radius, points_arr, counts_arr], device=device)
+
+    test.assertTrue(np.array_equal(counts_arr.numpy(), counts_arr_ref.numpy()[ids]))
+
+    # scatter back to the original order
+    grid.reorder([points_arr, counts_arr], inverse=True)
+
+    test.assertTrue(np.allclose(points_arr.numpy(), points))
+    test.assertTrue(np.array_equal(counts_arr.numpy(), counts_arr_ref.numpy()))
+
+    with test.assertRaises(RuntimeError):
+        grid.reorder([points_arr], inverse=True)
+
+    # an empty grid has nothing to permute and stays unordered
+    empty_arr = wp.zeros(0, dtype=wp.vec3, device=device)
+    grid.build(empty_arr, cell_radius)
+    grid.reorder([empty_arr])
+    test.assertFalse(grid.ordered)
+
+
+def test_hashgrid_many(test, device):
+
+    np.random.seed(532)
+
+    # more grids than fit in the initial descriptor table, each with its own points
+    grids = []
+
+    for i in range(80):
+        points = np.random.rand(256, 3)*scale*0.25
+        grid = wp.HashGrid(dim_x, dim_y, dim_z, device)
+        grids.append((grid, wp.array(points, dtype=wp.vec3, device=device)))
+
+    def check(grids):
+
+        for grid, points_arr in grids:
+
+            n = len(points_arr)
+            counts_arr = wp.zeros(n, dtype=int, device=device)
+            counts_arr_ref = wp.zeros(n, dtype=int, device=device)
+
+            wp.launch(kernel=count_neighbors_reference, dim=n*n, inputs=[query_radius, points_arr, counts_arr_ref, n], device=device)
+            wp.launch(kernel=count_neighbors, dim=n, inputs=[grid.id, query_radius, points_arr, counts_arr], device=device)
+
+            test.assertTrue(np.array_equal(counts_arr.numpy(), counts_arr_ref.numpy()))
+
+    for grid, points_arr in grids:
+        grid.build(points_arr, cell_radius)
+
+    check(grids)
+
+    # destroying grids leaves the others intact
+    grids = grids[::2]
+
+    for grid, points_arr in grids:
+        grid.build(points_arr, cell_radius)
+
+    check(grids)
+
+
+def test_hashgrid_capture(test, device):
+
+    np.random.seed(532)
+
+    a = wp.HashGrid(dim_x, dim_y, dim_z, device)
+    b = wp.HashGrid(dim_x, dim_y, dim_z, device)
+
+    a_points = wp.array(np.random.rand(num_points, 3)*scale*0.5, dtype=wp.vec3, device=device)
+    b_points = wp.array(np.random.rand(num_points//2, 3)*scale*0.5 + scale, dtype=wp.vec3, device=device)
+
+    # reserve outside of capture
+    a.build(a_points, cell_radius)
+    b.build(b_points, cell_radius)
+
+    # each grid uploads its own descriptor when the graph is replayed
+    with wp.ScopedDevice(device):
+        wp.capture_begin()
+        a.build(a_points, cell_radius)
+        b.build(b_points, cell_radius)
+        graph = wp.capture_end()
+
+    wp.capture_launch(graph)
+
+    for grid, points_arr in ((a, a_points), (b, b_points)):
+
+        n = len(points_arr)
+        counts_arr = wp.zeros(n, dtype=int, device=device)
+        counts_arr_ref = wp.zeros(n, dtype=int, device=device)
+
+        wp.launch(kernel=count_neighbors_reference, dim=n*n, inputs=[query_radius, points_arr, counts_arr_ref, n], device=device)
+        wp.launch(kernel=count_neighbors, dim=n, inputs=[grid.id, query_radius, points_arr, counts_arr], device=device)
+
+        test.assertTrue(np.array_equal(counts_arr.numpy(), counts_arr_ref.numpy()))
+
+
 def register(parent):
 
     devices = wp.get_devices()
@@ -140,6 +286,11 @@ def register(parent):
         pass
 
     add_function_test(TestHashGrid, "test_hashgrid_query", test_hashgrid_query, devices=devices)
+    add_function_test(TestHashGrid, "test_hashgrid_query_sparse", test_hashgrid_query, devices=devices, sparse=True)
+    add_function_test(TestHashGrid, "test_hashgrid_sparse_far", test_hashgrid_sparse_far, devices=devices)
+    add_function_test(TestHashGrid, "test_hashgrid_reorder", test_hashgrid_reorder, devices=devices)
+    add_function_test(TestHashGrid, "test_hashgrid_many", test_hashgrid_many, devices=devices)
+    add_function_test(TestHashGrid, "test_hashgrid_capture", test_hashgrid_capture, devices=[d for d in devices if d != "cpu"])
 
     return TestHashGrid
 
@@ -0,0 +1,203 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+@wp.kernel
+def count_kernel(ids: wp.array(dtype=int),
+                 counter: wp.array(dtype=int),
+                 total: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    ids[tid] = tid
+
+    wp.atomic_add(counter, 0, 1)
+    wp.atomic_add(total, 0, 1.0)
+
+
+def test_launch_atomics(test, device):
+
+    n = 100000
+
+    ids = wp.zeros(n, dtype=int, device=device)
+    counter = wp.zeros(1, dtype=int, device=device)
+    total = wp.zeros(1, dtype=float, device=device)
+
+    wp.launch(count_kernel, dim=n, inputs=[ids, counter, total], device=device)
+
+    # every thread must see its own index and no atomic increments can be lost
+    assert_np_equal(ids.numpy(), np.arange(n))
+    assert_np_equal(counter.numpy(), np.array([n]))
+    assert_np_equal(total.numpy(), np.array([float(n)]))
+
+
+def test_launch_cpu_threads(test, device):
+
+    n = 4096
+
+    # resizing after a parallel launch must not replay that launch on the new workers
+    for num_threads in [1, 3, 2]:
+
+        wp.set_cpu_threads(num_threads)
+        test.assertEqual(wp.get_cpu_threads(), num_threads)
+
+        ids = wp.zeros(n, dtype=int, device=device)
+        counter = wp.zeros(1, dtype=int, device=device)
+        total = wp.zeros(1, dtype=float, device=device)
+
+        wp.launch(count_kernel, dim=n, inputs=[ids, counter, total], device=device)
+
+        assert_np_equal(ids.numpy(), np.arange(n))
+        assert_np_equal(counter.numpy(), np.array([n]))
+
+    # back to one thread per hardware thread
+    wp.set_cpu_threads(0)
+
+
+@wp.kernel
+def index_kernel(ids: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    ids[tid] = tid
+
+
+def test_launch_multidim(test, device):
+
+    # shapes chosen so the launch doesn't divide evenly into 2D and 3D blocks
+    for shape in [(37, 53), (5, 19, 23)]:
+
+        n = int(np.prod(shape))
+
+        for block_dim in [0, 64, 256]:
+
+            ids = wp.array(np.full(n, -1), dtype=int, device=device)
+
+            wp.launch(index_kernel, dim=shape, inputs=[ids], device=device, block_dim=block_dim)
+
+            # each element must be written exactly once with its own linear index
+            assert_np_equal(ids.numpy(), np.arange(n))
+
+    # thread counts that don't fit the 32-bit launch bounds are rejected rather than wrapped
+    with test.assertRaises(RuntimeError):
+        wp.context.launch_bounds_t((65536, 65536))
+
+    with test.assertRaises(RuntimeError):
+        wp.context.launch_bounds_t((2048, 2048, 1024))
+
+
+@wp.kernel
+def axpy_kernel(x: wp.array(dtype=float),
+                y: wp.array(dtype=float),
+                a: float,
+                offset: wp.vec3):
+
+    tid = wp.tid()
+
+    y[tid] = y[tid] + a*x[tid] + offset[1]
+
+
+def test_launch_prebound(test, device):
+
+    n = 1000
+
+    x = wp.array(np.arange(n, dtype=np.float32), dtype=float, device=device)
+    y = wp.zeros(n, dtype=float, device=device)
+
+    axpy = wp.Launch(axpy_kernel, dim=n, inputs=[x, y, 2.0, (0.0, 1.0, 0.0)], device=device)
+
+    axpy.launch()
+    axpy.launch()
+
+    expected = 2.0*(2.0*np.arange(n) + 1.0)
+    assert_np_equal(y.numpy(), expected)
+
+    # patched scalars, vectors and arrays are used by the next launch
+    z = wp.zeros(n, dtype=float, device=device)
+
+    axpy.set_param("a", -1.0)
+    axpy.set_param("offset", (0.0, 0.5, 0.0))
+    axpy.set_param(1, z)
+    axpy.launch()
+
+    assert_np_equal(y.numpy(), expected)
+    assert_np_equal(z.numpy(), -np.arange(n) + 0.5)
+
+    # a smaller launch only touches the first elements
+    axpy.set_dim(10)
+    axpy.launch()
+
+    assert_np_equal(z.numpy()[0:10], 2.0*(-np.arange(10) + 0.5))
+    assert_np_equal(z.numpy()[10:], -np.arange(10, n) + 0.5)
+
+    with test.assertRaises(RuntimeError):
+        axpy.set_param("y", wp.zeros(n, dtype=int, device=device))
+
+
+def test_launch_sequence(test, device):
+
+    n = 1000
+
+    x = wp.array(np.ones(n, dtype=np.float32), dtype=float, device=device)
+    y = wp.zeros(n, dtype=float, device=device)
+    z = wp.zeros(n, dtype=float, device=device)
+
+    # y += x, z += 2*y, launches must execute in order
+    seq = wp.LaunchSequence([
+        wp.Launch(axpy_kernel, dim=n, inputs=[x, y, 1.0, (0.0, 0.0, 0.0)], device=device),
+        wp.Launch(axpy_kernel, dim=n, inputs=[y, z, 2.0, (0.0, 0.0, 0.0)], device=device)])
+
+    for i in range(3):
+        seq.launch()
+
+    assert_np_equal(y.numpy(), np.full(n, 3.0))
+    assert_np_equal(z.numpy(), np.full(n, 2.0*(1.0 + 2.0 + 3.0)))
+
+    # patches made after the sequence was created are picked up
+    seq.launches[0].set_param("a", 0.0)
+    seq.launch()
+
+    assert_np_equal(y.numpy(), np.full(n, 3.0))
+    assert_np_equal(z.numpy(), np.full(n, 2.0*(1.0 + 2.0 + 3.0 + 3.0)))
+
+    if (device != "cpu"):
+
+        # arrays of a sequence replayed on a side stream are fenced on it by the caching allocator
+        s = wp.Stream(device=device)
+        s.wait_stream(wp.get_stream(device))
+
+        seq.launch(stream=s)
+        s.synchronize()
+
+        test.assertTrue(s in y.streams)
+        test.assertTrue(s in z.streams)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestLaunch(parent):
+        pass
+
+    add_function_test(TestLaunch, "test_launch_atomics", test_launch_atomics, devices=devices)
+    add_function_test(TestLaunch, "test_launch_cpu_threads", test_launch_cpu_threads, devices=["cpu"])
+    add_function_test(TestLaunch, "test_launch_multidim", test_launch_multidim, devices=devices)
+    add_function_test(TestLaunch, "test_launch_prebound", test_launch_prebound, devices=devices)
+    add_function_test(TestLaunch, "test_launch_sequence", test_launch_sequence, devices=devices)
+
+    return TestLaunch
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
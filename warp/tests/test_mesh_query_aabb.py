@@ -203,6 +203,40 @@ def test_mesh_query_aabb_count_nonoverlap(test, device):
         test.assertTrue(c == 1)
 
 
+def test_mesh_query_aabb_builders(test, device):
+
+    # random triangle soup, large enough that every builder produces a deep tree
+    np.random.seed(42)
+    num_tris = 2048
+
+    centers = np.random.rand(num_tris, 1, 3)*10.0
+    points = (centers + np.random.rand(num_tris, 3, 3)*0.5).reshape(-1, 3)
+    indices = np.arange(num_tris*3, dtype=np.int32)
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    indices_arr = wp.array(indices, dtype=int, device=device)
+
+    lowers = wp.empty(n=num_tris, dtype=wp.vec3, device=device)
+    uppers = wp.empty_like(lowers)
+    wp.launch(kernel=compute_bounds, dim=num_tris, inputs=[indices_arr, points_arr], outputs=[lowers, uppers], device=device)
+
+    # brute force overlap counts
+    l = lowers.numpy()
+    u = uppers.numpy()
+    overlap = np.all(l[:, None, :] <= u[None, :, :], axis=2) & np.all(u[:, None, :] >= l[None, :, :], axis=2)
+    counts_ref = np.sum(overlap, axis=1)
+
+    for builder in ["sah", "median", "linear"]:
+        for width in [2, 4]:
+
+            m = wp.Mesh(points=points_arr, indices=indices_arr, bvh_builder=builder, bvh_width=width)
+
+            counts = wp.zeros(n=num_tris, dtype=int, device=device)
+            wp.launch(kernel=compute_num_contacts, dim=num_tris, inputs=[lowers, uppers, m.id], outputs=[counts], device=device)
+
+            test.assertTrue(np.array_equal(counts.numpy(), counts_ref), f"bvh_builder={builder} bvh_width={width}")
+
+
 def register(parent):
         
     devices = wp.get_devices()
@@ -213,6 +247,7 @@ def register(parent):
     add_function_test(TestMeshQueryAABBMethods, "test_compute_bounds", test_compute_bounds, devices=devices)
     add_function_test(TestMeshQueryAABBMethods, "test_mesh_query_aabb_count_overlap", test_mesh_query_aabb_count_overlap, devices=devices)
     add_function_test(TestMeshQueryAABBMethods, "test_mesh_query_aabb_count_nonoverlap", test_mesh_query_aabb_count_nonoverlap, devices=devices)
+    add_function_test(TestMeshQueryAABBMethods, "test_mesh_query_aabb_builders", test_mesh_query_aabb_builders, devices=devices)
 
     return TestMeshQueryAABBMethods
 
@@ -0,0 +1,369 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+
+@wp.kernel
+def raycast(mesh: wp.uint64,
+            ray_origins: wp.array(dtype=wp.vec3),
+            ray_dirs: wp.array(dtype=wp.vec3),
+            hit_t: wp.array(dtype=float),
+            hit_faces: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    t = float(0.0)
+    u = float(0.0)
+    v = float(0.0)
+    sign = float(0.0)
+    n = wp.vec3()
+    f = int(0)
+
+    if wp.mesh_query_ray(mesh, ray_origins[tid], ray_dirs[tid], 1.e+6, t, u, v, sign, n, f):
+        hit_t[tid] = t
+        hit_faces[tid] = f
+    else:
+        hit_t[tid] = -1.0
+        hit_faces[tid] = -1
+
+
+@wp.kernel
+def raycast_brute(points: wp.array(dtype=wp.vec3),
+                  indices: wp.array(dtype=int),
+                  num_tris: int,
+                  ray_origins: wp.array(dtype=wp.vec3),
+                  ray_dirs: wp.array(dtype=wp.vec3),
+                  hit_t: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    o = ray_origins[tid]
+    d = ray_dirs[tid]
+
+    min_t = float(1.e+6)
+
+    for i in range(num_tris):
+
+        p = points[indices[i*3+0]]
+        q = points[indices[i*3+1]]
+        r = points[indices[i*3+2]]
+
+        # Moller-Trumbore
+        e1 = q - p
+        e2 = r - p
+        h = wp.cross(d, e2)
+        a = wp.dot(e1, h)
+
+        if (wp.abs(a) > 1.e-8):
+
+            s = o - p
+            u = wp.dot(s, h)/a
+            c = wp.cross(s, e1)
+            v = wp.dot(d, c)/a
+            t = wp.dot(e2, c)/a
+
+            if (u >= 0.0 and v >= 0.0 and u + v <= 1.0 and t >= 0.0 and t < min_t):
+                min_t = t
+
+    if (min_t < 1.e+6):
+        hit_t[tid] = min_t
+    else:
+        hit_t[tid] = -1.0
+
+
+@wp.kernel
+def raycast_any(mesh: wp.uint64,
+                ray_origins: wp.array(dtype=wp.vec3),
+                ray_dirs: wp.array(dtype=wp.vec3),
+                max_t: float,
+                hits: wp.array(dtype=int)):
+
+    tid = wp.tid()
+
+    if wp.mesh_query_ray_any(mesh, ray_origins[tid], ray_dirs[tid], max_t):
+        hits[tid] = 1
+    else:
+        hits[tid] = 0
+
+
+def make_triangle_soup():
+
+    np.random.seed(42)
+    num_tris = 1024
+
+    centers = np.random.rand(num_tris, 1, 3)*10.0
+    points = (centers + np.random.rand(num_tris, 3, 3)).reshape(-1, 3)
+    indices = np.arange(num_tris*3, dtype=np.int32)
+
+    num_rays = 1024
+    origins = np.random.rand(num_rays, 3)*14.0 - 2.0
+    dirs = np.random.rand(num_rays, 3) - 0.5
+    dirs /= np.linalg.norm(dirs, axis=1)[:, None]
+
+    return points, indices, num_tris, origins, dirs
+
+
+def test_mesh_query_ray_layouts(test, device):
+
+    points, indices, num_tris, origins, dirs = make_triangle_soup()
+    num_rays = len(origins)
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    indices_arr = wp.array(indices, dtype=int, device=device)
+
+    origins_arr = wp.array(origins, dtype=wp.vec3, device=device)
+    dirs_arr = wp.array(dirs, dtype=wp.vec3, device=device)
+
+    t_ref = wp.zeros(num_rays, dtype=float, device=device)
+    wp.launch(raycast_brute, dim=num_rays, inputs=[points_arr, indices_arr, num_tris, origins_arr, dirs_arr, t_ref], device=device)
+    t_ref = t_ref.numpy()
+
+    for width in [2, 4]:
+
+        mesh = wp.Mesh(points=points_arr, indices=indices_arr, bvh_width=width)
+
+        t = wp.zeros(num_rays, dtype=float, device=device)
+        faces = wp.zeros(num_rays, dtype=int, device=device)
+
+        wp.launch(raycast, dim=num_rays, inputs=[mesh.id, origins_arr, dirs_arr, t, faces], device=device)
+
+        test.assertTrue(np.allclose(t.numpy(), t_ref, atol=1.e-3), f"bvh_width={width}")
+
+        # wide nodes are requantized when the binary hierarchy is refit
+        points_arr.assign(points + 1.0)
+        mesh.refit()
+
+        t_moved = wp.zeros(num_rays, dtype=float, device=device)
+        t_moved_ref = wp.zeros(num_rays, dtype=float, device=device)
+
+        wp.launch(raycast, dim=num_rays, inputs=[mesh.id, origins_arr, dirs_arr, t_moved, faces], device=device)
+        wp.launch(raycast_brute, dim=num_rays, inputs=[points_arr, indices_arr, num_tris, origins_arr, dirs_arr, t_moved_ref], device=device)
+
+        test.assertTrue(np.allclose(t_moved.numpy(), t_moved_ref.numpy(), atol=1.e-3), f"bvh_width={width} after refit")
+
+        points_arr.assign(points)
+
+
+def test_mesh_query_rays_batched(test, device):
+
+    points, indices, num_tris, origins, dirs = make_triangle_soup()
+    num_rays = len(origins)
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    indices_arr = wp.array(indices, dtype=int, device=device)
+
+    origins_arr = wp.array(origins, dtype=wp.vec3, device=device)
+    dirs_arr = wp.array(dirs, dtype=wp.vec3, device=device)
+
+    for width in [2, 4]:
+
+        mesh = wp.Mesh(points=points_arr, indices=indices_arr, bvh_width=width)
+
+        t_ref = wp.zeros(num_rays, dtype=float, device=device)
+        faces_ref = wp.zeros(num_rays, dtype=int, device=device)
+        wp.launch(raycast, dim=num_rays, inputs=[mesh.id, origins_arr, dirs_arr, t_ref, faces_ref], device=device)
+
+        # misses are reported as -1 by the kernel and max_t by the batched query
+        max_t = 1.e+6
+        t_ref = t_ref.numpy()
+        t_ref[t_ref < 0.0] = max_t
+        faces_ref = faces_ref.numpy()
+
+        for sort_rays in [False, True]:
+
+            t, faces = mesh.query_rays(origins_arr, dirs_arr, max_t=max_t, sort_rays=sort_rays)
+
+            test.assertTrue(np.allclose(t.numpy(), t_ref, atol=1.e-3), f"bvh_width={width} sort_rays={sort_rays}")
+            test.assertTrue(np.array_equal(faces.numpy(), faces_ref), f"bvh_width={width} sort_rays={sort_rays}")
+
+
+def test_mesh_query_ray_any(test, device):
+
+    points, indices, num_tris, origins, dirs = make_triangle_soup()
+    num_rays = len(origins)
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    indices_arr = wp.array(indices, dtype=int, device=device)
+
+    origins_arr = wp.array(origins, dtype=wp.vec3, device=device)
+    dirs_arr = wp.array(dirs, dtype=wp.vec3, device=device)
+
+    # short rays so that both hits and misses occur
+    max_t = 2.0
+
+    t_ref = wp.zeros(num_rays, dtype=float, device=device)
+    wp.launch(raycast_brute, dim=num_rays, inputs=[points_arr, indices_arr, num_tris, origins_arr, dirs_arr, t_ref], device=device)
+    t_ref = t_ref.numpy()
+
+    # skip rays whose closest hit lies too close to max_t to classify robustly
+    hit_ref = (t_ref >= 0.0) & (t_ref < max_t)
+    valid = np.abs(t_ref - max_t) > 1.e-3
+
+    for width in [2, 4]:
+
+        mesh = wp.Mesh(points=points_arr, indices=indices_arr, bvh_width=width)
+
+        hits = wp.zeros(num_rays, dtype=int, device=device)
+        wp.launch(raycast_any, dim=num_rays, inputs=[mesh.id, origins_arr, dirs_arr, max_t, hits], device=device)
+
+        test.assertTrue(np.array_equal(hits.numpy()[valid] != 0, hit_ref[valid]), f"bvh_width={width}")
+
+        # any-hit faces need not be the closest, but must be a hit within range
+        t, faces = mesh.query_rays(origins_arr, dirs_arr, max_t=max_t, any_hit=True)
+        t = t.numpy()
+        faces = faces.numpy()
+
+        test.assertTrue(np.array_equal(faces[valid] >= 0, hit_ref[valid]), f"bvh_width={width}")
+        test.assertTrue(np.all(t[faces >= 0] < max_t))
+        test.assertTrue(np.all(t[faces >= 0] >= t_ref[faces >= 0] - 1.e-3))
+
+
+def test_mesh_refit_partial(test, device):
+
+    points, indices, num_tris, origins, dirs = make_triangle_soup()
+    num_rays = len(origins)
+
+    points_arr = wp.array(points, dtype=wp.vec3, device=device)
+    indices_arr = wp.array(indices, dtype=int, device=device)
+
+    origins_arr = wp.array(origins, dtype=wp.vec3, device=device)
+    dirs_arr = wp.array(dirs, dtype=wp.vec3, device=device)
+
+    for width in [2, 4]:
+
+        mesh = wp.Mesh(points=points_arr, indices=indices_arr, bvh_width=width)
+
+        # move a subset of the triangles, the soup shares no vertices between faces
+        moved = points.copy().reshape(num_tris, 3, 3)
+        faces = np.arange(0, num_tris, 7, dtype=np.int32)
+        moved[faces] += np.random.rand(len(faces), 1, 3)*2.0 - 1.0
+
+        points_arr.assign(moved.reshape(-1, 3))
+
+        # duplicates are allowed
+        mesh.refit(faces=wp.array(np.concatenate((faces, faces[::2])), dtype=int, device=device))
+
+        t = wp.zeros(num_rays, dtype=float, device=device)
+        faces_hit = wp.zeros(num_rays, dtype=int, device=device)
+        t_ref = wp.zeros(num_rays, dtype=float, device=device)
+
+        wp.launch(raycast, dim=num_rays, inputs=[mesh.id, origins_arr, dirs_arr, t, faces_hit], device=device)
+        wp.launch(raycast_brute, dim=num_rays, inputs=[points_arr, indices_arr, num_tris, origins_arr, dirs_arr, t_ref], device=device)
+
+        test.assertTrue(np.allclose(t.numpy(), t_ref.numpy(), atol=1.e-3), f"bvh_width={width}")
+
+        points_arr.assign(points)
+        mesh.refit()
+
+        # out of range faces are rejected on the host
+        if (device == "cpu"):
+            with test.assertRaises(RuntimeError):
+                mesh.refit(faces=wp.array([0, num_tris], dtype=int, device=device))
+
+            with test.assertRaises(RuntimeError):
+                mesh.refit(faces=wp.array([-1], dtype=int, device=device))
+
+
+def test_mesh_update(test, device):
+
+    points, indices, num_tris, origins, dirs = make_triangle_soup()
+    num_rays = len(origins)
+
+    origins_arr = wp.array(origins, dtype=wp.vec3, device=device)
+    dirs_arr = wp.array(dirs, dtype=wp.vec3, device=device)
+
+    def check(mesh, points_arr, indices_arr):
+
+        t = wp.zeros(num_rays, dtype=float, device=device)
+        faces = wp.zeros(num_rays, dtype=int, device=device)
+        t_ref = wp.zeros(num_rays, dtype=float, device=device)
+
+        wp.launch(raycast, dim=num_rays, inputs=[mesh.id, origins_arr, dirs_arr, t, faces], device=device)
+        wp.launch(raycast_brute, dim=num_rays, inputs=[points_arr, indices_arr, len(indices_arr)//3, origins_arr, dirs_arr, t_ref], device=device)
+
+        test.assertTrue(np.allclose(t.numpy(), t_ref.numpy(), atol=1.e-3))
+
+    for width in [2, 4]:
+
+        points_arr = wp.array(points, dtype=wp.vec3, device=device)
+        indices_arr = wp.array(indices, dtype=int, device=device)
+
+        mesh = wp.Mesh(points=points_arr, indices=indices_arr, bvh_width=width)
+        mesh_id = mesh.id
+
+        # small motion keeps the tree quality, refit only
+        points_arr = wp.array(points + 0.01, dtype=wp.vec3, device=device)
+        test.assertFalse(mesh.update(points=points_arr))
+        check(mesh, points_arr, indices_arr)
+
+        # scattering the triangles degrades the refit tree enough to rebuild
+        scattered = points.reshape(num_tris, 3, 3)[np.random.permutation(num_tris)]
+        scattered = scattered - scattered.mean(axis=1, keepdims=True) + np.random.rand(num_tris, 1, 3)*10.0
+        points_arr = wp.array(scattered.reshape(-1, 3), dtype=wp.vec3, device=device)
+        rebuilt = mesh.update(points=points_arr)
+
+        # device meshes decide from the cost of an earlier refit once it has been read back
+        if (device != "cpu"):
+            wp.synchronize()
+            rebuilt = mesh.update(points=points_arr) or rebuilt
+
+        test.assertTrue(rebuilt)
+        check(mesh, points_arr, indices_arr)
+
+        # switching the branching factor without rebuilding, then back again
+        other = 2 if width == 4 else 4
+        test.assertFalse(mesh.update(points=points_arr, rebuild_ratio=0.0, bvh_width=other))
+        check(mesh, points_arr, indices_arr)
+        test.assertFalse(mesh.update(points=points_arr, rebuild_ratio=0.0, bvh_width=width))
+        check(mesh, points_arr, indices_arr)
+
+        # a rejected update leaves the width unchanged
+        with test.assertRaises(RuntimeError):
+            mesh.update(points=wp.zeros(len(points), dtype=float, device=device), bvh_width=other)
+
+        test.assertEqual(mesh.bvh_width, width)
+
+        # new topology with more triangles than the original allocation
+        grown = np.concatenate((points, points + 5.0))
+        points_arr = wp.array(grown, dtype=wp.vec3, device=device)
+        indices_arr = wp.array(np.arange(len(grown), dtype=np.int32), dtype=int, device=device)
+        test.assertTrue(mesh.update(points=points_arr, indices=indices_arr))
+        check(mesh, points_arr, indices_arr)
+
+        # and fewer again
+        points_arr = wp.array(points[:900], dtype=wp.vec3, device=device)
+        indices_arr = wp.array(np.arange(900, dtype=np.int32), dtype=int, device=device)
+        test.assertTrue(mesh.update(points=points_arr, indices=indices_arr))
+        check(mesh, points_arr, indices_arr)
+
+        test.assertEqual(mesh.id, mesh_id)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestMeshQueryRay(parent):
+        pass
+
+    add_function_test(TestMeshQueryRay, "test_mesh_query_ray_layouts", test_mesh_query_ray_layouts, devices=devices)
+    add_function_test(TestMeshQueryRay, "test_mesh_query_rays_batched", test_mesh_query_rays_batched, devices=devices)
+    add_function_test(TestMeshQueryRay, "test_mesh_query_ray_any", test_mesh_query_ray_any, devices=devices)
+    add_function_test(TestMeshQueryRay, "test_mesh_refit_partial", test_mesh_refit_partial, devices=devices)
+    add_function_test(TestMeshQueryRay, "test_mesh_update", test_mesh_update, devices=devices)
+
+    return TestMeshQueryRay
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -0,0 +1,202 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+num_points = 2048
+extent = 4.0
+
+radius = 0.3
+skin = 0.1
+
+
+@wp.kernel
+def gather_neighbors(neighbors: wp.uint64,
+                     points: wp.array(dtype=wp.vec3),
+                     counts: wp.array(dtype=int),
+                     sums: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    query = wp.neighbor_list_query(neighbors, tid)
+    index = int(0)
+
+    count = int(0)
+    s = float(0.0)
+
+    while(wp.neighbor_list_query_next(query, index)):
+        count += 1
+        s += wp.length(points[tid] - points[index])
+
+    expect_eq(count, wp.neighbor_list_count(neighbors, tid))
+
+    counts[tid] = count
+    sums[tid] = s
+
+
+def brute_force(points_np, cutoff, max_neighbors=0):
+
+    neighbors = []
+
+    for i in range(len(points_np)):
+
+        d = np.linalg.norm(points_np - points_np[i], axis=1)
+        d[i] = np.inf
+
+        j = np.nonzero(d <= cutoff)[0]
+        j = j[np.argsort(d[j], kind="stable")]
+
+        if (max_neighbors > 0):
+            j = j[:max_neighbors]
+
+        neighbors.append(set(j.tolist()))
+
+    return neighbors
+
+
+def make_points(device):
+
+    rng = np.random.default_rng(123)
+    points_np = rng.uniform(0.0, extent, size=(num_points, 3)).astype(np.float32)
+
+    return points_np, wp.array(points_np, dtype=wp.vec3, device=device)
+
+
+def check_list(test, neighbors, expected):
+
+    (offsets, counts, indices) = neighbors.arrays()
+
+    offsets = offsets.numpy()
+    counts = counts.numpy()
+    indices = indices.numpy()
+
+    assert_np_equal(offsets[1:] - offsets[:-1], counts)
+
+    for i in range(len(expected)):
+        test.assertEqual(set(indices[offsets[i]:offsets[i]+counts[i]].tolist()), expected[i])
+
+
+def test_neighbor_list_build(test, device):
+
+    points_np, points = make_points(device)
+
+    for sparse in (False, True):
+
+        grid = wp.HashGrid(64, 64, 64, device, sparse=sparse)
+        grid.build(points, radius + skin)
+
+        neighbors = wp.NeighborList(device)
+        neighbors.build(grid, points, radius, skin)
+
+        check_list(test, neighbors, brute_force(points_np, radius + skin))
+
+
+def test_neighbor_list_max_neighbors(test, device):
+
+    max_neighbors = 8
+
+    points_np, points = make_points(device)
+
+    grid = wp.HashGrid(64, 64, 64, device)
+    grid.build(points, radius + skin)
+
+    neighbors = wp.NeighborList(device, max_neighbors=max_neighbors)
+    neighbors.build(grid, points, radius, skin)
+
+    # random points have no ties at the boundary, so the closest neighbors are unique
+    check_list(test, neighbors, brute_force(points_np, radius + skin, max_neighbors))
+
+
+def test_neighbor_list_query(test, device):
+
+    points_np, points = make_points(device)
+
+    grid = wp.HashGrid(64, 64, 64, device)
+    grid.build(points, radius)
+
+    neighbors = wp.NeighborList(device)
+    neighbors.build(grid, points, radius)
+
+    counts = wp.zeros(num_points, dtype=int, device=device)
+    sums = wp.zeros(num_points, dtype=float, device=device)
+
+    wp.launch(gather_neighbors, dim=num_points, inputs=[neighbors.id, points, counts, sums], device=device)
+
+    expected = brute_force(points_np, radius)
+
+    counts_expected = np.array([len(n) for n in expected])
+    sums_expected = np.array([np.sum(np.linalg.norm(points_np[list(n)] - points_np[i], axis=1)) for i, n in enumerate(expected)])
+
+    assert_np_equal(counts.numpy(), counts_expected)
+    assert_np_equal(sums.numpy(), sums_expected, tol=1.e-4)
+
+
+def test_neighbor_list_rebuild(test, device):
+
+    points_np, points = make_points(device)
+
+    grid = wp.HashGrid(64, 64, 64, device)
+    grid.build(points, radius + skin)
+
+    neighbors = wp.NeighborList(device)
+    neighbors.build(grid, points, radius, skin)
+
+    test.assertFalse(neighbors.needs_rebuild(points))
+    test.assertTrue(neighbors.is_current(grid))
+
+    # moving a point less than half the skin keeps the list valid
+    moved_np = points_np.copy()
+    moved_np[17,0] += 0.25*skin
+
+    moved = wp.array(moved_np, dtype=wp.vec3, device=device)
+
+    test.assertAlmostEqual(neighbors.max_displacement(moved), 0.25*skin, places=5)
+    test.assertFalse(neighbors.needs_rebuild(moved))
+
+    moved_np[42,1] -= 0.75*skin
+    moved = wp.array(moved_np, dtype=wp.vec3, device=device)
+
+    test.assertTrue(neighbors.needs_rebuild(moved))
+
+    # the list grows with the number of points
+    points_np = np.concatenate((points_np, points_np + extent))
+    points = wp.array(points_np, dtype=wp.vec3, device=device)
+
+    test.assertTrue(neighbors.needs_rebuild(points))
+
+    # rebuilding only the grid leaves the list describing the old points
+    grid.build(points, radius + skin)
+    test.assertFalse(neighbors.is_current(grid))
+
+    neighbors.build(grid, points, radius, skin)
+    test.assertTrue(neighbors.is_current(grid))
+
+    check_list(test, neighbors, brute_force(points_np, radius + skin))
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestNeighborList(parent):
+        pass
+
+    add_function_test(TestNeighborList, "test_neighbor_list_build", test_neighbor_list_build, devices=devices)
+    add_function_test(TestNeighborList, "test_neighbor_list_max_neighbors", test_neighbor_list_max_neighbors, devices=devices)
+    add_function_test(TestNeighborList, "test_neighbor_list_query", test_neighbor_list_query, devices=devices)
+    add_function_test(TestNeighborList, "test_neighbor_list_rebuild", test_neighbor_list_rebuild, devices=devices)
+
+    return TestNeighborList
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -0,0 +1,109 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import os
+import json
+import tempfile
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+
+@wp.kernel
+def scale(x: wp.array(dtype=float), s: float):
+
+    tid = wp.tid()
+    x[tid] = x[tid]*s
+
+
+def test_profiler_summary(test, device):
+
+    n = 1024
+
+    x = wp.array(np.ones(n, dtype=np.float32), dtype=float, device=device)
+    y = wp.zeros(n, dtype=float, device=device)
+
+    with wp.Profiler(nvtx=False) as profiler:
+
+        for i in range(4):
+            wp.launch(scale, dim=n, inputs=[x, 2.0], device=device)
+
+        wp.launch(scale, dim=n//2, inputs=[x, 0.5], device=device)
+
+        y.zero_()
+        wp.copy(y, x)
+
+    # launches after the profiler has exited are not recorded
+    wp.launch(scale, dim=n, inputs=[x, 1.0], device=device)
+
+    stats = profiler.summary()
+
+    s = stats["scale"]
+    test.assertEqual(s["count"], 5)
+    test.assertEqual(s["dims"], [n, n//2])
+    test.assertEqual(s["device"], device)
+    test.assertGreaterEqual(s["total_ms"], 0.0)
+    test.assertGreaterEqual(s["max_ms"], s["mean_ms"])
+    test.assertGreaterEqual(s["mean_ms"], s["min_ms"])
+
+    test.assertEqual(stats["memset"]["count"], 1)
+    test.assertEqual(stats["memset"]["bytes"], n*4)
+
+    memcpy = "memcpy_h2h" if device == "cpu" else "memcpy_d2d"
+    test.assertEqual(stats[memcpy]["bytes"], n*4)
+
+    assert_np_equal(y.numpy(), np.full(n, 8.0, dtype=np.float32))
+
+
+def test_profiler_chrome_trace(test, device):
+
+    n = 256
+
+    x = wp.zeros(n, dtype=float, device=device)
+
+    with wp.Profiler(nvtx=False) as profiler:
+        for i in range(3):
+            wp.launch(scale, dim=n, inputs=[x, 2.0], device=device)
+
+    path = os.path.join(tempfile.gettempdir(), f"warp_test_profiler_{device}.json")
+    profiler.save_chrome_trace(path)
+
+    with open(path, "r") as f:
+        trace = json.load(f)
+
+    os.remove(path)
+
+    events = [e for e in trace["traceEvents"] if e["ph"] == "X"]
+
+    test.assertEqual(len(events), 3)
+
+    # launches on a stream are ordered
+    for a, b in zip(events[:-1], events[1:]):
+        test.assertEqual(a["name"], "scale")
+        test.assertGreaterEqual(b["ts"], a["ts"])
+        test.assertGreaterEqual(a["dur"], 0.0)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestProfiler(parent):
+        pass
+
+    add_function_test(TestProfiler, "test_profiler_summary", test_profiler_summary, devices=devices)
+    add_function_test(TestProfiler, "test_profiler_chrome_trace", test_profiler_chrome_trace, devices=devices)
+
+    return TestProfiler
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
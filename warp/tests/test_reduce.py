@@ -0,0 +1,118 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+np.random.seed(42)
+
+def test_reduce_float(test, device):
+
+    n = 100003
+
+    a_np = np.random.rand(n).astype(np.float32)
+    b_np = np.random.rand(n).astype(np.float32)
+
+    a = wp.array(a_np, dtype=float, device=device)
+    b = wp.array(b_np, dtype=float, device=device)
+
+    assert_np_equal(wp.array_sum(a).numpy(), np.array([np.sum(a_np, dtype=np.float64)]), tol=0.5)
+    assert_np_equal(wp.array_inner(a, b).numpy(), np.array([np.dot(a_np.astype(np.float64), b_np)]), tol=0.5)
+    assert_np_equal(wp.array_min(a).numpy(), np.array([np.min(a_np)]))
+    assert_np_equal(wp.array_max(a).numpy(), np.array([np.max(a_np)]))
+    assert_np_equal(wp.array_argmin(a).numpy(), np.array([np.argmin(a_np)]))
+    assert_np_equal(wp.array_argmax(a).numpy(), np.array([np.argmax(a_np)]))
+
+
+def test_reduce_int(test, device):
+
+    n = 50000
+
+    a_np = np.random.randint(-100, 100, size=n, dtype=np.int32)
+    a = wp.array(a_np, dtype=int, device=device)
+
+    assert_np_equal(wp.array_sum(a).numpy(), np.array([np.sum(a_np)]))
+    assert_np_equal(wp.array_inner(a, a).numpy(), np.array([np.dot(a_np, a_np)]))
+    assert_np_equal(wp.array_min(a).numpy(), np.array([np.min(a_np)]))
+    assert_np_equal(wp.array_max(a).numpy(), np.array([np.max(a_np)]))
+
+    # ties resolve to the first occurrence
+    assert_np_equal(wp.array_argmin(a).numpy(), np.array([np.argmin(a_np)]))
+    assert_np_equal(wp.array_argmax(a).numpy(), np.array([np.argmax(a_np)]))
+
+
+def test_reduce_vec3(test, device):
+
+    n = 20000
+
+    a_np = np.random.rand(n, 3).astype(np.float32)
+    a = wp.array(a_np, dtype=wp.vec3, device=device)
+
+    assert_np_equal(wp.array_sum(a).numpy(), np.sum(a_np, axis=0, dtype=np.float64), tol=0.5)
+    assert_np_equal(wp.array_inner(a, a).numpy(), np.array([np.sum(a_np.astype(np.float64)*a_np)]), tol=0.5)
+    assert_np_equal(wp.array_min(a).numpy(), np.min(a_np, axis=0))
+    assert_np_equal(wp.array_max(a).numpy(), np.max(a_np, axis=0))
+
+    # outputs must hold the element type the reduction writes
+    with test.assertRaises(RuntimeError):
+        wp.array_sum(a, out=wp.zeros(1, dtype=float, device=device))
+
+    with test.assertRaises(RuntimeError):
+        wp.array_inner(a, a, out=wp.zeros(1, dtype=wp.vec3, device=device))
+
+    with test.assertRaises(RuntimeError):
+        wp.array_sum(a, out=wp.zeros(0, dtype=wp.vec3, device=device))
+
+    if (device != "cpu"):
+        with test.assertRaises(RuntimeError):
+            wp.array_sum(a, out=wp.zeros(1, dtype=wp.vec3, device="cpu"))
+
+
+def test_scan(test, device):
+
+    n = 70001
+
+    a_np = np.random.randint(0, 10, size=n, dtype=np.int32)
+    a = wp.array(a_np, dtype=int, device=device)
+
+    inclusive = np.cumsum(a_np)
+    exclusive = inclusive - a_np
+
+    assert_np_equal(wp.array_scan(a, inclusive=True).numpy(), inclusive)
+    assert_np_equal(wp.array_scan(a, inclusive=False).numpy(), exclusive)
+
+    # in-place
+    wp.array_scan(a, out=a)
+    assert_np_equal(a.numpy(), inclusive)
+
+    v_np = np.random.rand(n, 3).astype(np.float32)
+    v = wp.array(v_np, dtype=wp.vec3, device=device)
+
+    assert_np_equal(wp.array_scan(v).numpy(), np.cumsum(v_np, axis=0, dtype=np.float64), tol=1.0)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestReduce(parent):
+        pass
+
+    add_function_test(TestReduce, "test_reduce_float", test_reduce_float, devices=devices)
+    add_function_test(TestReduce, "test_reduce_int", test_reduce_int, devices=devices)
+    add_function_test(TestReduce, "test_reduce_vec3", test_reduce_vec3, devices=devices)
+    add_function_test(TestReduce, "test_scan", test_scan, devices=devices)
+
+    return TestReduce
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -0,0 +1,151 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+# the CPU kernels of this module are compiled in SIMD batches
+wp.set_module_options({"cpu_simd": "auto"})
+
+
+@wp.kernel
+def integrate_kernel(x: wp.array(dtype=wp.vec3),
+                     v: wp.array(dtype=wp.vec3),
+                     w: wp.array(dtype=float),
+                     g: wp.vec3,
+                     dt: float):
+
+    tid = wp.tid()
+
+    v1 = v[tid] + g*w[tid]*dt
+
+    # lanes of a batch take different sides of the branch
+    if (wp.length(v1) > 1.0):
+        v1 = wp.normalize(v1)
+
+    x[tid] = x[tid] + v1*dt
+    v[tid] = v1
+
+
+@wp.kernel
+def sum_kernel(a: wp.array(dtype=float), total: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    wp.atomic_add(total, 0, a[tid])
+
+
+@wp.kernel
+def square_kernel(a: wp.array(dtype=float), b: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    b[tid] = a[tid]*a[tid]
+
+
+def test_simd_integrate(test, device):
+
+    # not a multiple of any batch width so the remainder is covered
+    n = 1000
+
+    rng = np.random.default_rng(42)
+
+    x = rng.uniform(-1.0, 1.0, size=(n, 3)).astype(np.float32)
+    v = rng.uniform(-1.0, 1.0, size=(n, 3)).astype(np.float32)
+    w = rng.uniform(0.0, 2.0, size=n).astype(np.float32)
+
+    g = np.array((0.0, -9.8, 0.0), dtype=np.float32)
+    dt = 0.1
+
+    x_wp = wp.array(x, dtype=wp.vec3, device=device)
+    v_wp = wp.array(v, dtype=wp.vec3, device=device)
+    w_wp = wp.array(w, dtype=float, device=device)
+
+    wp.launch(integrate_kernel, dim=n, inputs=[x_wp, v_wp, w_wp, g, dt], device=device)
+
+    v1 = v + g[None,:]*w[:,None]*dt
+    l = np.linalg.norm(v1, axis=1)
+    v1 = np.where((l > 1.0)[:,None], v1/l[:,None], v1)
+
+    assert_np_equal(v_wp.numpy(), v1, tol=1.e-5)
+    assert_np_equal(x_wp.numpy(), x + v1*dt, tol=1.e-5)
+
+
+def test_simd_atomics(test, device):
+
+    # kernels with atomics are compiled one thread per call
+    n = 1001
+
+    a = wp.array(np.ones(n, dtype=np.float32), dtype=float, device=device)
+    total = wp.zeros(1, dtype=float, device=device)
+
+    wp.launch(sum_kernel, dim=n, inputs=[a, total], device=device)
+
+    assert_np_equal(total.numpy(), np.array([float(n)]))
+
+
+def test_simd_adjoint(test, device):
+
+    # backward passes accumulate with atomics and are never batched
+    n = 37
+
+    a = wp.array(np.arange(n, dtype=np.float32), dtype=float, device=device, requires_grad=True)
+    b = wp.zeros(n, dtype=float, device=device, requires_grad=True)
+
+    tape = wp.Tape()
+    with tape:
+        wp.launch(square_kernel, dim=n, inputs=[a, b], device=device)
+
+    assert_np_equal(b.numpy(), np.arange(n, dtype=np.float32)**2)
+
+    tape.backward(grads={b: wp.array(np.ones(n, dtype=np.float32), dtype=float, device=device)})
+
+    assert_np_equal(tape.gradients[a].numpy(), 2.0*np.arange(n, dtype=np.float32))
+
+
+def test_simd_codegen(test, device):
+
+    # kernels are analyzed when their module is built
+    test.assertTrue(integrate_kernel.module.load())
+
+    test.assertTrue(wp.codegen.simd_safe(integrate_kernel.adj))
+    test.assertFalse(wp.codegen.simd_safe(sum_kernel.adj))
+
+    # only the safe kernel's forward pass is issued in vectorized batches
+    width = 8
+
+    safe = wp.codegen.codegen_module(integrate_kernel, device="cpu", simd_width=width)
+    unsafe = wp.codegen.codegen_module(sum_kernel, device="cpu", simd_width=width)
+
+    test.assertEqual(safe.count("#pragma omp simd"), 1)
+    test.assertTrue(f"batch*{width}" in safe)
+
+    test.assertEqual(unsafe.count("#pragma omp simd"), 0)
+    test.assertTrue("s_threadIdx = i;" in unsafe)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestSIMD(parent):
+        pass
+
+    add_function_test(TestSIMD, "test_simd_integrate", test_simd_integrate, devices=devices)
+    add_function_test(TestSIMD, "test_simd_atomics", test_simd_atomics, devices=devices)
+    add_function_test(TestSIMD, "test_simd_adjoint", test_simd_adjoint, devices=devices)
+    add_function_test(TestSIMD, "test_simd_codegen", test_simd_codegen, devices=["cpu"])
+
+    return TestSIMD
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -0,0 +1,72 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+np.random.seed(42)
+
+def sort_and_check(test, device, keys_np, dtype):
+
+    n = len(keys_np)
+
+    # second half of each array is temporary storage
+    keys = wp.array(np.concatenate([keys_np, keys_np]), dtype=dtype, device=device)
+    values = wp.array(np.arange(2*n, dtype=np.int32), dtype=int, device=device)
+
+    wp.sort_pairs(keys, values, n)
+
+    # radix sort is stable, so must match a stable argsort exactly
+    order = np.argsort(keys_np, kind="stable")
+
+    assert_np_equal(keys.numpy()[0:n], keys_np[order])
+    assert_np_equal(values.numpy()[0:n], order.astype(np.int32))
+
+
+def test_sort_int(test, device):
+
+    for n in [1, 100, 100003]:
+        sort_and_check(test, device, np.random.randint(-2**31, 2**31-1, size=n, dtype=np.int32), int)
+
+    # few distinct values only use some of the digit passes
+    sort_and_check(test, device, np.random.randint(0, 100, size=50000, dtype=np.int32), int)
+
+
+def test_sort_float(test, device):
+
+    n = 100003
+
+    sort_and_check(test, device, (np.random.rand(n)*2000.0 - 1000.0).astype(np.float32), float)
+
+
+def test_sort_int64(test, device):
+
+    n = 100003
+
+    sort_and_check(test, device, np.random.randint(-2**62, 2**62, size=n, dtype=np.int64), wp.int64)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestSort(parent):
+        pass
+
+    add_function_test(TestSort, "test_sort_int", test_sort_int, devices=devices)
+    add_function_test(TestSort, "test_sort_float", test_sort_float, devices=devices)
+    add_function_test(TestSort, "test_sort_int64", test_sort_int64, devices=devices)
+
+    return TestSort
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -0,0 +1,163 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+from warp.tests.test_base import *
+
+wp.init()
+
+@wp.kernel
+def inc_kernel(a: wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    a[tid] = a[tid] + 1.0
+
+
+def test_stream_launch(test, device):
+
+    n = 1024*64
+
+    s1 = wp.Stream(device=device)
+    s2 = wp.Stream(device=device)
+
+    a = wp.zeros(n, dtype=float, device=device)
+    b = wp.zeros(n, dtype=float, device=device)
+
+    # arrays are initialized on the default stream
+    s1.wait_stream(wp.get_stream(device))
+    s2.wait_stream(wp.get_stream(device))
+
+    # independent work on two streams
+    for i in range(10):
+        wp.launch(inc_kernel, dim=n, inputs=[a], device=device, stream=s1)
+        wp.launch(inc_kernel, dim=n, inputs=[b], device=device, stream=s2)
+
+    # b is consumed on s1 once s2 has finished with it
+    s1.wait_stream(s2)
+
+    c = wp.zeros(n, dtype=float, device=device)
+    wp.copy(c, b, stream=s1)
+
+    wp.synchronize()
+
+    assert_np_equal(a.numpy(), np.full(n, 10.0))
+    assert_np_equal(c.numpy(), np.full(n, 10.0))
+
+    # per-launch streams must not change the current stream
+    test.assertTrue(wp.get_stream(device) is wp.context.runtime.default_streams[wp.get_device_ordinal(device)])
+
+
+def test_stream_scoped(test, device):
+
+    n = 1024
+
+    s = wp.Stream(device=device)
+    a = wp.zeros(n, dtype=float, device=device)
+
+    s.wait_stream(wp.get_stream(device))
+
+    with wp.ScopedStream(s):
+        test.assertTrue(wp.get_stream(device) is s)
+        wp.launch(inc_kernel, dim=n, inputs=[a], device=device)
+
+    test.assertTrue(wp.get_stream(device) is wp.context.runtime.default_streams[wp.get_device_ordinal(device)])
+
+    start = s.record_event(wp.Event(enable_timing=True, device=device))
+    wp.launch(inc_kernel, dim=n, inputs=[a], device=device, stream=s)
+    end = s.record_event(wp.Event(enable_timing=True, device=device))
+
+    end.synchronize()
+
+    test.assertGreaterEqual(start.elapsed_time(end), 0.0)
+    assert_np_equal(a.numpy(), np.full(n, 2.0))
+
+
+def test_pinned_copy(test, device):
+
+    n = 1024*16
+
+    src = wp.array(np.arange(n, dtype=np.float32), dtype=float, device="cpu", pinned=True)
+    test.assertTrue(src.pinned)
+
+    # round trip through the device using pinned memory on both ends
+    a = wp.empty(n, dtype=float, device=device)
+    wp.copy(a, src)
+
+    dest = wp.zeros_like(src)
+    test.assertTrue(dest.pinned)
+
+    wp.copy(dest, a)
+    wp.synchronize()
+
+    assert_np_equal(dest.numpy(), np.arange(n, dtype=np.float32))
+
+
+def test_readback(test, device):
+
+    n = 1024
+
+    a = wp.zeros(n, dtype=float, device=device)
+    readback = wp.ReadbackBuffer(n, dtype=float, num_buffers=2)
+
+    results = []
+
+    for i in range(5):
+
+        wp.launch(inc_kernel, dim=n, inputs=[a], device=device)
+        readback.push(a)
+
+        # results lag one step behind the launches
+        if i > 0:
+            results.append(readback.pop()[0])
+
+    results.append(readback.pop()[0])
+
+    test.assertEqual(len(readback), 0)
+    test.assertEqual(results, [1.0, 2.0, 3.0, 4.0, 5.0])
+
+    # pushing more copies than buffers keeps the oldest ones instead of dropping them
+    for i in range(5):
+        wp.launch(inc_kernel, dim=n, inputs=[a], device=device)
+        readback.push(a)
+
+    test.assertEqual(len(readback), 5)
+    test.assertEqual([readback.pop()[0] for i in range(5)], [6.0, 7.0, 8.0, 9.0, 10.0])
+
+    # copies held beyond the buffers are bounded, a push past the limit raises and loses nothing
+    readback = wp.ReadbackBuffer(n, dtype=float, num_buffers=2, max_ready=1)
+
+    for i in range(3):
+        wp.launch(inc_kernel, dim=n, inputs=[a], device=device)
+        readback.push(a)
+
+    with test.assertRaises(RuntimeError):
+        readback.push(a)
+
+    test.assertEqual(len(readback), 3)
+    test.assertEqual([readback.pop()[0] for i in range(3)], [11.0, 12.0, 13.0])
+
+
+def register(parent):
+
+    devices = [d for d in wp.get_devices() if d != "cpu"]
+
+    class TestStreams(parent):
+        pass
+
+    add_function_test(TestStreams, "test_stream_launch", test_stream_launch, devices=devices)
+    add_function_test(TestStreams, "test_stream_scoped", test_stream_scoped, devices=devices)
+    add_function_test(TestStreams, "test_pinned_copy", test_pinned_copy, devices=devices)
+    add_function_test(TestStreams, "test_readback", test_readback, devices=devices)
+
+    return TestStreams
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -129,6 +129,103 @@ def test_tape_dot_product(test, device):
     assert_np_equal(tape.gradients[y].numpy(), x.numpy())
 
 
+@wp.kernel
+def scale_sum(
+    x : wp.array(dtype=float),
+    s : float,
+    loss : wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    wp.atomic_add(loss, 0, x[tid]*s)
+
+
+def test_tape_capture_graph(test, device):
+
+    dim = 8
+    tape = wp.Tape()
+
+    x = wp.array(np.ones(dim)*3.0, dtype=wp.float32, device=device, requires_grad=True)
+    y = wp.zeros_like(x)
+    loss = wp.zeros(n=1, dtype=wp.float32, device=device, requires_grad=True)
+
+    with tape:
+        wp.launch(kernel=mul_constant, dim=dim, inputs=[x], outputs=[y], device=device)
+        wp.launch(kernel=scale_sum, dim=dim, inputs=[y, 0.5], outputs=[loss], device=device)
+
+    tape.capture_graph(loss=loss, zero=[loss])
+
+    # replays re-evaluate the loss and recompute, rather than accumulate, gradients
+    for i in range(3):
+        tape.replay()
+
+    assert_np_equal(loss.numpy(), np.array([dim*3.0]))
+    assert_np_equal(tape.gradients[x].numpy(), np.ones(dim))
+
+    # scalars are updated in the graph without recapturing it
+    test.assertEqual(tape.set_param("s", 2.0), 2)
+    tape.replay()
+
+    assert_np_equal(loss.numpy(), np.array([dim*12.0]))
+    assert_np_equal(tape.gradients[x].numpy(), np.ones(dim)*4.0)
+
+    # an error during capture is re-raised and leaves the tape without a graph
+    with test.assertRaises(AttributeError):
+        tape.capture_graph(loss=loss, zero=[None])
+
+    test.assertTrue(tape.graph is None)
+    test.assertFalse(wp.context.runtime.capturing)
+
+    tape.capture_graph(loss=loss, zero=[loss])
+    tape.replay()
+
+    assert_np_equal(loss.numpy(), np.array([dim*12.0]))
+
+
+@wp.kernel
+def affine_step(
+    x : wp.array(dtype=float),
+    c : wp.array(dtype=float),
+    y : wp.array(dtype=float)):
+
+    tid = wp.tid()
+
+    y[tid] = x[tid]*2.0 + c[tid]
+
+
+class AffineState:
+
+    def __init__(self, dim, device):
+        self.x = wp.zeros(dim, dtype=wp.float32, device=device, requires_grad=True)
+
+
+def test_tape_checkpoint(test, device):
+
+    dim = 8
+    steps = 10
+
+    c = wp.array(np.ones(dim), dtype=wp.float32, device=device, requires_grad=True)
+
+    def step(state_in, state_out, i):
+        wp.launch(kernel=affine_step, dim=dim, inputs=[state_in.x, c], outputs=[state_out.x], device=device)
+
+    for segment_length in [0, 3, steps]:
+
+        initial = AffineState(dim, device)
+        initial.x = wp.array(np.ones(dim), dtype=wp.float32, device=device, requires_grad=True)
+
+        rollout = wp.CheckpointTape(step, steps, make_state=lambda: AffineState(dim, device), segment_length=segment_length)
+        final = rollout.forward(initial)
+
+        # x_n = 2^n*x_0 + (2^n - 1)*c
+        assert_np_equal(final.x.numpy(), np.ones(dim)*(2**steps + 2**steps - 1))
+
+        rollout.backward({final.x: wp.array(np.ones(dim), dtype=wp.float32, device=device)})
+
+        assert_np_equal(rollout.gradients[initial.x].numpy(), np.ones(dim)*(2**steps))
+        assert_np_equal(rollout.gradients[c].numpy(), np.ones(dim)*(2**steps - 1))
+
+
 def register(parent):
 
     devices = wp.get_devices()
@@ -139,6 +236,8 @@ def register(parent):
     add_function_test(TestTape, "test_tape_mul_constant", test_tape_mul_constant, devices=devices)
     add_function_test(TestTape, "test_tape_mul_variable", test_tape_mul_variable, devices=devices)
     add_function_test(TestTape, "test_tape_dot_product", test_tape_dot_product, devices=devices)
+    add_function_test(TestTape, "test_tape_checkpoint", test_tape_checkpoint, devices=devices)
+    add_function_test(TestTape, "test_tape_capture_graph", test_tape_capture_graph, devices=[d for d in devices if d != "cpu"])
 
     return TestTape
 
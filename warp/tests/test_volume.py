@@ -9,6 +9,7 @@ import warp as wp
 from warp.tests.test_base import *
 
 import numpy as np
+import tempfile
 
 wp.init()
 
@@ -72,6 +73,154 @@ def test_volume_sample_linear(volume: wp.uint64,
     expect_near(wp.volume_sample_world(volume, q, wp.Volume.LINEAR), expected, 2.0e-4)
 
 
+@wp.kernel
+def test_volume_sample_grad(volume: wp.uint64,
+                            points: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+
+    p = points[tid]
+
+    if abs(p[0]) > 10.0 or abs(p[1]) > 10.0 or abs(p[2]) > 10.0:
+        return  # not testing against background values
+
+    # trilinear interpolation of x*y*z is exact, and so is its gradient
+    expected = p[0] * p[1] * p[2]
+    expected_grad = wp.vec3(p[1] * p[2], p[0] * p[2], p[0] * p[1])
+
+    grad = wp.vec3()
+    expect_near(wp.volume_sample_grad_local(volume, p, grad), expected, 2.0e-4)
+    expect_near(grad[0], expected_grad[0], 2.0e-3)
+    expect_near(grad[1], expected_grad[1], 2.0e-3)
+    expect_near(grad[2], expected_grad[2], 2.0e-3)
+
+    # the test grid has a uniform voxel size, so world-space derivatives scale by the inverse voxel size
+    q = wp.volume_transform(volume, p)
+    inv_voxel_size = wp.length(wp.volume_transform_inv(volume, q + wp.vec3(1.0, 0.0, 0.0)) - p)
+
+    grad_world = wp.vec3()
+    expect_near(wp.volume_sample_grad_world(volume, q, grad_world), expected, 2.0e-4)
+    expect_near(grad_world[0], expected_grad[0] * inv_voxel_size, 1.0e-2)
+    expect_near(grad_world[1], expected_grad[1] * inv_voxel_size, 1.0e-2)
+    expect_near(grad_world[2], expected_grad[2] * inv_voxel_size, 1.0e-2)
+
+    # vector and integer accessors return zero on a float grid
+    expect_eq(wp.volume_sample_local_v(volume, p, wp.Volume.LINEAR), wp.vec3(0.0, 0.0, 0.0))
+    expect_eq(wp.volume_lookup_i(volume, int(p[0]), int(p[1]), int(p[2])), 0)
+
+
+@wp.kernel
+def test_volume_accessor(volume: wp.uint64,
+                         points: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+
+    p = points[tid]
+
+    # march along a ray reusing one accessor, results must match the uncached queries
+    acc = wp.volume_accessor(volume)
+    step = wp.vec3(0.1, 0.05, -0.02)
+
+    for s in range(20):
+
+        q = p + step*float(s)
+
+        expect_eq(wp.volume_sample_local(acc, q, wp.Volume.LINEAR), wp.volume_sample_local(volume, q, wp.Volume.LINEAR))
+        expect_eq(wp.volume_sample_local(acc, q, wp.Volume.CLOSEST), wp.volume_sample_local(volume, q, wp.Volume.CLOSEST))
+
+        x = wp.volume_transform(volume, q)
+        expect_eq(wp.volume_sample_world(acc, x, wp.Volume.LINEAR), wp.volume_sample_world(volume, x, wp.Volume.LINEAR))
+
+        grad_acc = wp.vec3()
+        grad = wp.vec3()
+        expect_eq(wp.volume_sample_grad_world(acc, x, grad_acc), wp.volume_sample_grad_world(volume, x, grad))
+        expect_eq(grad_acc, grad)
+
+        i = int(q[0])
+        j = int(q[1])
+        k = int(q[2])
+        expect_eq(wp.volume_lookup(acc, i, j, k), wp.volume_lookup(volume, i, j, k))
+
+
+@wp.kernel
+def sample_sdf(volume: wp.uint64,
+               points: wp.array(dtype=wp.vec3),
+               values: wp.array(dtype=float),
+               grads: wp.array(dtype=wp.vec3)):
+
+    tid = wp.tid()
+
+    grad = wp.vec3()
+    values[tid] = wp.volume_sample_grad_world(volume, points[tid], grad)
+    grads[tid] = grad
+
+
+def test_volume_bake_mesh(test, device):
+
+    # unit cube with outward facing triangles
+    cube_points = np.array([[x, y, z] for x in (-0.5, 0.5) for y in (-0.5, 0.5) for z in (-0.5, 0.5)], dtype=np.float32)
+    cube_indices = np.array([0, 1, 3, 0, 3, 2,
+                             4, 6, 7, 4, 7, 5,
+                             0, 4, 5, 0, 5, 1,
+                             2, 3, 7, 2, 7, 6,
+                             0, 2, 6, 0, 6, 4,
+                             1, 5, 7, 1, 7, 3], dtype=np.int32)
+
+    mesh = wp.Mesh(points=wp.array(cube_points, dtype=wp.vec3, device=device),
+                   velocities=None,
+                   indices=wp.array(cube_indices, dtype=int, device=device))
+
+    voxel_size = 0.05
+    band_width = 3.0
+    background = band_width*voxel_size
+
+    volume = wp.Volume.bake_mesh(mesh, voxel_size, band_width)
+
+    rng = np.random.default_rng(123)
+    points_np = rng.uniform(-1.0, 1.0, size=(1000, 3)).astype(np.float32)
+
+    # analytic distance of the box, clamped like the baked band
+    q = np.abs(points_np) - 0.5
+    expected = np.linalg.norm(np.maximum(q, 0.0), axis=1) + np.minimum(np.max(q, axis=1), 0.0)
+    expected = np.clip(expected, -background, background)
+
+    points = wp.array(points_np, dtype=wp.vec3, device=device)
+    values = wp.zeros(len(points_np), dtype=float, device=device)
+    grads = wp.zeros(len(points_np), dtype=wp.vec3, device=device)
+
+    wp.launch(sample_sdf, dim=len(points_np), inputs=[volume.id, points, values, grads], device=device)
+
+    # trilinear interpolation is exact away from the edges and the saturated band
+    assert_np_equal(values.numpy(), expected, tol=0.5*voxel_size)
+
+    # outside of the cube and inside of the band the gradient points away from the closest point
+    outside = (np.max(q, axis=1) > voxel_size) & (expected < background - 2.0*voxel_size)
+    normals = np.maximum(q, 0.0)*np.sign(points_np)
+    normals /= np.linalg.norm(normals, axis=1)[:,None] + 1.e-12
+
+    grads_np = grads.numpy()
+    grads_np /= np.linalg.norm(grads_np, axis=1)[:,None] + 1.e-12
+
+    test.assertTrue(np.all(np.sum(grads_np[outside]*normals[outside], axis=1) > 0.9))
+
+    # a saved grid reads back with the same values
+    with tempfile.TemporaryDirectory() as tmp:
+
+        path = os.path.join(tmp, "cube.nvdbraw")
+
+        volume.save(path)
+        loaded = wp.Volume.load(path, device=device)
+
+        values_loaded = wp.zeros(len(points_np), dtype=float, device=device)
+        wp.launch(sample_sdf, dim=len(points_np), inputs=[loaded.id, points, values_loaded, grads], device=device)
+        wp.synchronize()
+
+        # release the mapping before the file is removed
+        del loaded
+
+    assert_np_equal(values_loaded.numpy(), values.numpy())
+
+
 devices = wp.get_devices()
 
 volume_path = os.path.abspath(os.path.join(os.path.dirname(__file__), "assets/test_grid.nvdbraw"))
@@ -79,6 +228,8 @@ volume_data = np.fromfile(volume_path, dtype=np.byte)
 volume_array = wp.array(volume_data, device="cpu")
 
 volumes = {}
+volumes_loaded = {}
+volumes_shared = {}
 points = {}
 points_jittered = {}
 
@@ -106,6 +257,17 @@ def register(parent):
         add_kernel_test(TestVolumes, test_volume_lookup, dim=len(points_np), inputs=[volumes[device].id, points[device]], devices=[device])
         add_kernel_test(TestVolumes, test_volume_sample_closest, dim=len(points), inputs=[volumes[device].id, points_jittered[device]], devices=[device])
         add_kernel_test(TestVolumes, test_volume_sample_linear, dim=len(points), inputs=[volumes[device].id, points_jittered[device]], devices=[device])
+        add_kernel_test(TestVolumes, test_volume_sample_grad, dim=len(points_np), inputs=[volumes[device].id, points_jittered[device]], devices=[device])
+        add_kernel_test(TestVolumes, test_volume_accessor, dim=len(points_np), inputs=[volumes[device].id, points_jittered[device]], devices=[device])
+
+        # volumes loaded from file (memory-mapped on the CPU, streamed to CUDA devices) and referencing a caller-owned buffer
+        volumes_loaded[device] = wp.Volume.load(volume_path, device=device, chunk_size=4096)
+        volumes_shared[device] = wp.Volume(volume_array.to(device), copy=False)
+
+        add_kernel_test(TestVolumes, test_volume_lookup, dim=len(points_np), inputs=[volumes_loaded[device].id, points[device]], devices=[device], name="test_volume_lookup_loaded")
+        add_kernel_test(TestVolumes, test_volume_lookup, dim=len(points_np), inputs=[volumes_shared[device].id, points[device]], devices=[device], name="test_volume_lookup_shared")
+
+    add_function_test(TestVolumes, "test_volume_bake_mesh", test_volume_bake_mesh, devices=devices)
 
     return TestVolumes
 
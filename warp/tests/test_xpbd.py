@@ -0,0 +1,158 @@
+# Copyright (c) 2022 NVIDIA CORPORATION.  All rights reserved.
+# NVIDIA CORPORATION and its licensors retain all intellectual property
+# and proprietary rights in and to this software, related documentation
+# and any modifications thereto.  Any use, reproduction, disclosure or
+# distribution of this software and related documentation without an express
+# license agreement from NVIDIA CORPORATION is strictly prohibited.
+
+import numpy as np
+
+import warp as wp
+import warp.sim
+from warp.tests.test_base import *
+
+wp.init()
+
+
+def build_chain(device, count=16):
+
+    builder = wp.sim.ModelBuilder()
+
+    # first particle is kinematic
+    builder.add_particle((0.0, 1.0, 0.0), (0.0, 0.0, 0.0), 0.0)
+
+    for i in range(1, count):
+        builder.add_particle((i*0.1, 1.0, 0.0), (0.0, 0.0, 0.0), 1.0)
+        builder.add_spring(i - 1, i, 1.e+6, 0.0, 0)
+
+    model = builder.finalize(device=device)
+    model.ground = False
+
+    return model
+
+
+def check_colors(test, order, offsets, constraints, inv_mass):
+
+    test.assertEqual(sorted(order), list(range(len(constraints))))
+    test.assertEqual(offsets[-1], len(constraints))
+
+    for c in range(len(offsets)-1):
+
+        particles = set()
+
+        for i in order[offsets[c]:offsets[c+1]]:
+            for p in constraints[i]:
+                if (inv_mass[p] > 0.0):
+                    test.assertFalse(p in particles)
+                    particles.add(p)
+
+
+def test_xpbd_coloring(test, device):
+
+    builder = wp.sim.ModelBuilder()
+    builder.add_soft_grid(pos=(0.0, 0.0, 0.0), rot=(0.0, 0.0, 0.0, 1.0), vel=(0.0, 0.0, 0.0), dim_x=6, dim_y=4, dim_z=4, cell_x=0.1, cell_y=0.1, cell_z=0.1,
+                          density=100.0, k_mu=1.e+3, k_lambda=1.e+3, k_damp=0.0, fix_left=True)
+
+    model = builder.finalize(device=device)
+
+    inv_mass = model.particle_inv_mass.numpy()
+    tets = model.tet_indices.numpy().reshape(-1, 4).tolist()
+
+    check_colors(test, model.tet_color_indices.numpy().tolist(), model.tet_color_offsets, tets, inv_mass)
+
+    # a tetrahedron can conflict with at most a bounded number of neighbors
+    test.assertTrue(len(model.tet_color_offsets)-1 < 32)
+
+    model = build_chain(device)
+
+    inv_mass = model.particle_inv_mass.numpy()
+    springs = model.spring_indices.numpy().reshape(-1, 2).tolist()
+
+    check_colors(test, model.spring_color_indices.numpy().tolist(), model.spring_color_offsets, springs, inv_mass)
+
+    # a chain alternates between two colors
+    test.assertEqual(len(model.spring_color_offsets)-1, 2)
+
+
+def test_xpbd_gauss_seidel(test, device):
+
+    model = build_chain(device)
+    rest = model.spring_rest_length.numpy()
+
+    def spring_error(state):
+        x = state.particle_q.numpy()
+        i = model.spring_indices.numpy().reshape(-1, 2)
+        return np.max(np.abs(np.linalg.norm(x[i[:,0]] - x[i[:,1]], axis=1) - rest))
+
+    def run(integrator):
+
+        state_0 = model.state()
+        state_1 = model.state()
+
+        for i in range(8):
+            integrator.simulate(model, state_0, state_1, 1.0/60.0)
+            (state_0, state_1) = (state_1, state_0)
+
+        return state_0
+
+    state = run(wp.sim.XPBDIntegrator(iterations=20, relaxation=1.0, gauss_seidel=True))
+
+    # the kinematic particle stays fixed and the chain keeps its length under gravity
+    assert_np_equal(state.particle_q.numpy()[0], np.array((0.0, 1.0, 0.0)), tol=1.e-6)
+    test.assertTrue(spring_error(state) < 1.e-3)
+
+    # solving without a graph produces the same result
+    state_direct = run(wp.sim.XPBDIntegrator(iterations=20, relaxation=1.0, gauss_seidel=True, use_graph=False))
+    assert_np_equal(state.particle_q.numpy(), state_direct.particle_q.numpy(), tol=1.e-5)
+
+    # the spring error of the unchanged Jacobi path is the baseline, Gauss-Seidel has to improve on it
+    state_jacobi = run(wp.sim.XPBDIntegrator(iterations=20, relaxation=1.0))
+    test.assertTrue(spring_error(state) < spring_error(state_jacobi))
+
+
+def test_xpbd_graph_reuse(test, device):
+
+    model = build_chain(device)
+    integrator = wp.sim.XPBDIntegrator(iterations=4, relaxation=1.0, gauss_seidel=True)
+
+    state_0 = model.state()
+    state_1 = model.state()
+
+    for i in range(6):
+        integrator.simulate(model, state_0, state_1, 1.0/60.0)
+        (state_0, state_1) = (state_1, state_0)
+
+    # one graph for each direction of the state ping-pong
+    test.assertEqual(len(integrator.graphs), 2)
+
+    # the cache is bounded, new time-steps release the oldest graphs
+    for i in range(8):
+        integrator.simulate(model, state_0, state_1, 1.0/(60.0 + i))
+
+    test.assertEqual(len(integrator.graphs), integrator.max_graphs)
+
+    # graphs of another model are never replayed
+    other = build_chain(device)
+    integrator.simulate(other, other.state(), other.state(), 1.0/60.0)
+    test.assertEqual(len(integrator.graphs), 1)
+
+    integrator.clear_graphs()
+    test.assertEqual(len(integrator.graphs), 0)
+
+
+def register(parent):
+
+    devices = wp.get_devices()
+
+    class TestXPBD(parent):
+        pass
+
+    add_function_test(TestXPBD, "test_xpbd_coloring", test_xpbd_coloring, devices=devices)
+    add_function_test(TestXPBD, "test_xpbd_gauss_seidel", test_xpbd_gauss_seidel, devices=devices)
+    add_function_test(TestXPBD, "test_xpbd_graph_reuse", test_xpbd_graph_reuse, devices=[d for d in devices if d != "cpu"])
+
+    return TestXPBD
+
+if __name__ == '__main__':
+    c = register(unittest.TestCase)
+    unittest.main(verbosity=2)
@@ -32,7 +32,7 @@ def from_torch(t, dtype=warp.types.float32):
         copy=False,
         owner=False,
         requires_grad=True,
-        device=t.device.type)
+        device=str(t.device))
 
     # save a reference to the source tensor, otherwise it will be deallocated
     a.tensor = t
@@ -48,11 +48,11 @@ def to_torch(a):
         # to an ndarray first, see https://pearu.github.io/array_interface_pytorch.html
         return torch.as_tensor(numpy.asarray(a))
 
-    elif a.device == "cuda":
+    elif a.device.startswith("cuda"):
         # Torch does support the __cuda_array_interface__
         # correctly, but we must be sure to maintain a reference
         # to the owning object to prevent memory allocs going out of schope
-        return torch.as_tensor(a, device="cuda")
+        return torch.as_tensor(a, device=a.device)
     
     else:
         raise RuntimeError("Unsupported device")
@@ -223,6 +223,18 @@ class hash_grid_query_t:
     def __init__(self):
         pass
 
+# definition just for kernel type (cannot be a parameter), see neighborlist.h
+class neighbor_list_query_t:
+
+    def __init__(self):
+        pass
+
+# definition just for kernel type (cannot be a parameter), see volume.h
+class volume_accessor_t:
+
+    def __init__(self):
+        pass
+
 
 def type_length(dtype):
     if (dtype == float or dtype == int):
@@ -309,7 +321,7 @@ def types_equal(a, b):
 
 class array:
 
-    def __init__(self, data=None, dtype=None, length=0, ptr=None, capacity=0, device=None, copy=True, owner=True, requires_grad=False):
+    def __init__(self, data=None, dtype=None, length=0, ptr=None, capacity=0, device=None, copy=True, owner=True, requires_grad=False, pinned=False):
         """ Constructs a new Warp array object from existing data.
 
         When the ``data`` argument is a valid list, tuple, or ndarray the array will be constructed from this object's data.
@@ -331,10 +343,17 @@ class array:
             copy (bool): Whether the incoming data will be copied or aliased, this is only possible when the incoming `data` already lives on the device specified and types match
             owner (bool): Should the array object try to deallocate memory when it is deleted
             requires_grad (bool): Whether or not gradients will be tracked for this array, see :class:`warp.Tape` for details
+            pinned (bool): Whether a ``cpu`` array is allocated in (or for ptr, aliases) page-locked memory, copies between pinned and ``cuda`` arrays are asynchronous
 
         """
 
         self.owner = False
+        self.pinned = False
+
+        # CUDA streams the array memory was used on, the allocator waits for the work issued to each
+        # of them before reusing the memory once it is freed, holding the Stream objects rather than
+        # their handles keeps a stream from being destroyed while the array may still be in use on it
+        self.streams = set()
 
         # canonicalize dtype
         if (dtype == int):
@@ -377,7 +396,7 @@ class array:
             shape = arr.__array_interface__["shape"]
             length = shape[0]
 
-            if (device == "cpu" and copy == False):
+            if (device == "cpu" and copy == False and pinned == False):
 
                 # ref numpy memory directly
                 self.ptr = ptr
@@ -398,7 +417,7 @@ class array:
                 # create a host wrapper around the numpy array
                 # and a new destination array to copy it to
                 src = array(dtype=dtype, length=length, capacity=length*type_size_in_bytes(dtype), ptr=ptr, device='cpu', copy=False, owner=False)
-                dest = empty(length, dtype=dtype, device=device, requires_grad=requires_grad)
+                dest = empty(length, dtype=dtype, device=device, requires_grad=requires_grad, pinned=pinned)
                 dest.owner = False
                 
                 # data copy
@@ -412,13 +431,16 @@ class array:
 
         else:
             
+            from warp.context import get_device
+
             # explicit construction from ptr to external memory
             self.length = length
             self.capacity = capacity
             self.dtype = dtype
             self.ptr = ptr
-            self.device = device
+            self.device = get_device(device) if device else device
             self.owner = owner
+            self.pinned = pinned
 
             self.__name__ = "array<" + type.__name__ + ">"
 
@@ -436,7 +458,7 @@ class array:
             self.shape = (self.length, dims)
         
         # set up array interface access so we can treat this object as a numpy array
-        if device == "cpu":
+        if self.device == "cpu":
 
             self.__array_interface__ = { 
                 "data": (self.ptr, False), 
@@ -446,7 +468,7 @@ class array:
             }
 
         # set up cuda array interface access so we can treat this object as a Torch tensor
-        if device == "cuda":
+        if self.device and self.device != "cpu":
 
             self.__cuda_array_interface__ = {
                 "data": (self.ptr, False),
@@ -464,10 +486,10 @@ class array:
                 # in this case we allow OS to clean up allocations
                 from warp.context import runtime
 
-                if (self.device == "cpu"):
-                    runtime.host_allocator.free(self.ptr, self.capacity)
+                if (self.pinned):
+                    runtime.pinned_allocator.free(self.ptr, self.capacity)
                 else:
-                    runtime.device_allocator.free(self.ptr, self.capacity)
+                    runtime.allocators[self.device].free(self.ptr, self.capacity, self.streams)
         
         except Exception as e:
             pass
@@ -488,13 +510,17 @@ class array:
 
     def zero_(self):
 
-        from warp.context import runtime
+        from warp.context import runtime, ScopedDevice
+        from warp.profiler import ScopedProfile
 
-        if (self.device == "cpu"):
-            runtime.core.memset_host(ctypes.cast(self.ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(self.length*type_size_in_bytes(self.dtype)))
+        num_bytes = self.length*type_size_in_bytes(self.dtype)
 
-        if(self.device == "cuda"):
-            runtime.core.memset_device(ctypes.cast(self.ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(self.length*type_size_in_bytes(self.dtype)))
+        with ScopedDevice(self.device), ScopedProfile("memset", self.device, bytes=num_bytes, category="memset"):
+
+            if (self.device == "cpu"):
+                runtime.core.memset_host(ctypes.cast(self.ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(num_bytes))
+            else:
+                runtime.core.memset_device(ctypes.cast(self.ptr,ctypes.POINTER(ctypes.c_int)), ctypes.c_int(0), ctypes.c_size_t(num_bytes))
 
 
     # equivalent to wrapping src data in an array and copying to self
@@ -511,11 +537,11 @@ class array:
     # convert data from one device to another, nop if already on device
     def to(self, device):
 
-        if (self.device == device):
+        from warp.context import empty, copy, synchronize, get_device
+
+        if (self.device == get_device(device)):
             return self
         else:
-            from warp.context import empty, copy, synchronize
-
             dest = empty(n=self.length, dtype=self.dtype, device=device)
             copy(dest, self)
             
@@ -544,12 +570,18 @@ class array:
             device=self.device,
             owner=False)
 
+        # uses of the alias are uses of this array's memory
+        arr.streams = self.streams
+
         return arr
 
 
 class Mesh:
 
-    def __init__(self, points, indices, velocities=None):
+    # BVH construction methods, must match BVHBuilder in native/bvh.h
+    bvh_builders = { "sah": 0, "median": 1, "linear": 2 }
+
+    def __init__(self, points, indices, velocities=None, bvh_builder=None, bvh_width=2):
         """ Class representing a triangle mesh.
 
         Attributes:
@@ -560,6 +592,12 @@ class Mesh:
             points (:class:`warp.array`): Array of vertex positions of type :class:`warp.vec3`
             indices (:class:`warp.array`): Array of triangle indices of type :class:`warp.int32`, should be length 3*number of triangles
             velocities (:class:`warp.array`): Array of vertex velocities of type :class:`warp.vec3` (optional)
+            bvh_builder (str): Method used to construct the BVH, trading build time against query performance:
+                               ``"sah"`` (binned surface area heuristic, best trees), ``"median"`` (object median split),
+                               or ``"linear"`` (Morton codes, fastest build). Defaults to ``"sah"`` for CPU meshes
+                               and ``"linear"`` for CUDA meshes, whose other builders run on the host.
+            bvh_width (int): Branching factor of the BVH used by queries, 2 or 4. Wide (4) BVHs store all children of a
+                             node in a single cache line with quantized bounds, which speeds up traversal especially on the GPU.
         """
 
         if (points.device != indices.device):
@@ -574,11 +612,22 @@ class Mesh:
         if (indices.dtype != int32):
             raise RuntimeError("Mesh indices should be an array of type wp.int32")
 
+        if (bvh_builder is None):
+            bvh_builder = "sah" if points.device == "cpu" else "linear"
+
+        if (bvh_builder not in Mesh.bvh_builders):
+            raise RuntimeError(f"Mesh bvh_builder should be one of {list(Mesh.bvh_builders.keys())}, got {bvh_builder}")
+
+        if (bvh_width not in (2, 4)):
+            raise RuntimeError(f"Mesh bvh_width should be 2 or 4, got {bvh_width}")
+
 
         self.device = points.device
         self.points = points
         self.velocities = velocities
         self.indices = indices
+        self.bvh_builder = bvh_builder
+        self.bvh_width = bvh_width
 
         def get_data(array):
             if (array):
@@ -586,48 +635,242 @@ class Mesh:
             else:
                 return ctypes.c_void_p(0)
 
-        from warp.context import runtime
+        from warp.context import runtime, ScopedDevice
+        from warp.profiler import ScopedProfile
 
-        if (self.device == "cpu"):
-            self.id = runtime.core.mesh_create_host(
-                get_data(points), 
-                get_data(velocities), 
-                get_data(indices), 
-                int(points.length), 
-                int(indices.length/3))
-        else:
-            self.id = runtime.core.mesh_create_device(
-                get_data(points), 
-                get_data(velocities), 
-                get_data(indices), 
-                int(points.length), 
-                int(indices.length/3))
+        # device meshes are built on, and must be used on, the device of their buffers
+        with ScopedDevice(self.device), ScopedProfile("mesh_build", self.device, dim=int(indices.length/3), category="mesh"):
+
+            if (self.device == "cpu"):
+                self.id = runtime.core.mesh_create_host(
+                    get_data(points), 
+                    get_data(velocities), 
+                    get_data(indices), 
+                    int(points.length), 
+                    int(indices.length/3),
+                    Mesh.bvh_builders[bvh_builder],
+                    bvh_width)
+            else:
+                self.id = runtime.core.mesh_create_device(
+                    get_data(points), 
+                    get_data(velocities), 
+                    get_data(indices), 
+                    int(points.length), 
+                    int(indices.length/3),
+                    Mesh.bvh_builders[bvh_builder],
+                    bvh_width)
 
 
     def __del__(self):
 
         try:
                 
-            from warp.context import runtime
+            from warp.context import runtime, ScopedDevice
 
             if (self.device == "cpu"):
                 runtime.core.mesh_destroy_host(self.id)
             else:
-                runtime.core.mesh_destroy_device(self.id)
+                with ScopedDevice(self.device):
+                    runtime.core.mesh_destroy_device(self.id)
         
         except:
             pass
 
-    def refit(self):
-        """ Refit the BVH to points. This should be called after users modify the `points` data."""
+    def refit(self, faces=None):
+        """ Refit the BVH to points. This should be called after users modify the `points` data.
+
+        Args:
+            faces (:class:`warp.array`): Optional array of type :class:`warp.int32` listing the only triangles whose vertices
+                                         moved since the last refit, only their bounds and the BVH nodes above them are
+                                         updated. Faces may be listed more than once. Every face must be in the range
+                                         ``[0, len(indices)//3)``, this is checked for ``cpu`` meshes, on CUDA devices
+                                         out of range faces are undefined behavior since checking would synchronize.
+        """
                 
-        from warp.context import runtime
+        from warp.context import runtime, ScopedDevice
+        from warp.profiler import ScopedProfile
+
+        if (faces is not None):
+
+            if (faces.dtype != int32):
+                raise RuntimeError("Mesh.refit() faces should be an array of type wp.int32")
+
+            if (faces.device != self.device):
+                raise RuntimeError(f"Mesh.refit() faces on device {faces.device} but mesh on device {self.device}")
+
+            # faces index the bounds and BVH leaves directly
+            if (self.device == "cpu" and len(faces) > 0):
+
+                num_tris = len(self.indices)//3
+                faces_np = faces.numpy()
+
+                if (faces_np.min() < 0 or faces_np.max() >= num_tris):
+                    raise RuntimeError(f"Mesh.refit() faces must be in the range [0, {num_tris}), got [{faces_np.min()}, {faces_np.max()}]")
+
+            with ScopedDevice(self.device), ScopedProfile("mesh_refit_partial", self.device, dim=len(faces), category="mesh"):
+
+                if (self.device == "cpu"):
+                    runtime.core.mesh_refit_partial_host(self.id, ctypes.c_void_p(faces.ptr), len(faces))
+                else:
+                    runtime.core.mesh_refit_partial_device(self.id, ctypes.c_void_p(faces.ptr), len(faces))
+                    runtime.verify_device()
+
+            return
+
+        with ScopedDevice(self.device), ScopedProfile("mesh_refit", self.device, category="mesh"):
+
+            if (self.device == "cpu"):
+                runtime.core.mesh_refit_host(self.id)
+            else:
+                runtime.core.mesh_refit_device(self.id)
+                runtime.verify_device()
+
+    def update(self, points=None, indices=None, velocities=None, rebuild_ratio=1.5, bvh_width=None):
+        """ Replace the mesh geometry in-place, the mesh ``id`` stays valid and existing allocations are reused when large enough.
+
+        If only ``points`` (or ``velocities``) change and the triangle count stays the same the BVH is refit, and rebuilt
+        with the mesh's ``bvh_builder`` only once the refit tree's surface area heuristic cost grows beyond ``rebuild_ratio``
+        times its cost when last built. Passing new ``indices`` always rebuilds. On CUDA devices the cost of a refit is
+        read back without synchronizing, the rebuild then happens in the first update after the read back has completed.
+
+        Args:
+            points (:class:`warp.array`): New vertex positions of type :class:`warp.vec3`, the vertex count may change
+            indices (:class:`warp.array`): New triangle indices of type :class:`warp.int32`
+            velocities (:class:`warp.array`): New vertex velocities of type :class:`warp.vec3`
+            rebuild_ratio (float): Refit quality threshold, a value <= 0 never rebuilds for updates that keep the topology
+            bvh_width (int): New branching factor of the BVH, 2 or 4, defaults to the current ``bvh_width``
+
+        Returns:
+            ``True`` if the BVH was rebuilt, ``False`` if it was refit.
+        """
+
+        from warp.context import runtime, ScopedDevice
+        from warp.profiler import ScopedProfile
+
+        topology_changed = indices is not None
+
+        if (bvh_width is None):
+            bvh_width = self.bvh_width
+        elif (bvh_width not in (2, 4)):
+            raise RuntimeError(f"Mesh bvh_width should be 2 or 4, got {bvh_width}")
+
+        if (points is None):
+            points = self.points
+
+        if (indices is None):
+            indices = self.indices
+
+        if (velocities is None):
+            velocities = self.velocities
+
+        for a in (points, indices, velocities):
+            if (a is not None and a.device != self.device):
+                raise RuntimeError(f"Mesh.update() array on device {a.device} but mesh on device {self.device}")
+
+        if (points.dtype != vec3):
+            raise RuntimeError("Mesh points should be an array of type wp.vec3")
+
+        if (velocities and velocities.dtype != vec3):
+            raise RuntimeError("Mesh velocities should be an array of type wp.vec3")
+
+        if (indices.dtype != int32):
+            raise RuntimeError("Mesh indices should be an array of type wp.int32")
+
+        # the wrapper only takes the new state once every argument has been validated,
+        # keep references to the new buffers alive
+        self.points = points
+        self.indices = indices
+        self.velocities = velocities
+        self.bvh_width = bvh_width
+
+        def get_data(array):
+            if (array):
+                return ctypes.c_void_p(array.ptr)
+            else:
+                return ctypes.c_void_p(0)
+
+        args = [self.id,
+                get_data(points),
+                get_data(velocities),
+                get_data(indices),
+                int(points.length),
+                int(indices.length/3),
+                topology_changed,
+                Mesh.bvh_builders[self.bvh_builder],
+                self.bvh_width,
+                rebuild_ratio]
+
+        with ScopedDevice(self.device), ScopedProfile("mesh_update", self.device, dim=int(indices.length/3), category="mesh"):
+
+            if (self.device == "cpu"):
+                rebuilt = runtime.core.mesh_update_host(*args)
+            else:
+                rebuilt = runtime.core.mesh_update_device(*args)
+                runtime.verify_device()
+
+        return rebuilt
+
+    def query_rays(self, starts, dirs, max_t=1.0e6, t=None, face=None, bary_u=None, bary_v=None, normal=None, any_hit=False, sort_rays=False):
+        """ Casts a batch of rays against the mesh, equivalent to calling :func:`mesh_query_ray` once per ray from a kernel.
+
+        Children are visited nearest first and subtrees beyond the closest hit so far are skipped. Rays that miss
+        write ``face = -1`` and ``t = max_t``, outputs that are ``None`` (other than ``t`` and ``face``) are not written.
+
+        Args:
+            starts (:class:`warp.array`): Ray origins of type :class:`warp.vec3`
+            dirs (:class:`warp.array`): Ray directions of type :class:`warp.vec3`, need not be normalized, ``t`` is measured in units of ``dir``
+            max_t (float): Maximum distance along each ray to search for hits
+            t, face, bary_u, bary_v, normal (:class:`warp.array`): Optional output arrays of type float32, int32, float32, float32 and vec3
+            any_hit (bool): Stop at the first hit found instead of the closest one, for occlusion / shadow rays.
+                            Only ``t`` and ``face`` are meaningful in this mode.
+            sort_rays (bool): Reorder rays by direction and origin before tracing so that rays processed
+                              together visit similar nodes, pays off for large incoherent batches on the GPU.
+
+        Returns:
+            A tuple ``(t, face)`` of the distance and face index arrays.
+        """
+
+        from warp.context import runtime, empty, ScopedDevice
+
+        num_rays = len(starts)
+
+        if (len(dirs) != num_rays):
+            raise RuntimeError(f"Mesh.query_rays() starts and dirs must have the same length, got {num_rays} and {len(dirs)}")
+
+        if (starts.dtype != vec3 or dirs.dtype != vec3):
+            raise RuntimeError("Mesh.query_rays() starts and dirs should be arrays of type wp.vec3")
+
+        if (t is None):
+            t = empty(num_rays, dtype=float32, device=self.device)
+
+        if (face is None):
+            face = empty(num_rays, dtype=int32, device=self.device)
+
+        outputs = [t, face, bary_u, bary_v, normal]
+
+        for a in [starts, dirs] + outputs:
+            if (a is not None and a.device != self.device):
+                raise RuntimeError(f"Mesh.query_rays() array on device {a.device} but mesh on device {self.device}")
+
+            if (a is not None and len(a) != num_rays):
+                raise RuntimeError(f"Mesh.query_rays() array length {len(a)} does not match the number of rays {num_rays}")
+
+        def get_data(array):
+            if (array):
+                return ctypes.c_void_p(array.ptr)
+            else:
+                return ctypes.c_void_p(0)
+
+        args = [self.id, get_data(starts), get_data(dirs), num_rays, max_t, any_hit, sort_rays] + [get_data(a) for a in outputs]
 
         if (self.device == "cpu"):
-            runtime.core.mesh_refit_host(self.id)
+            runtime.core.mesh_query_rays_host(*args)
         else:
-            runtime.core.mesh_refit_device(self.id)
-            runtime.verify_device()
+            with ScopedDevice(self.device):
+                runtime.core.mesh_query_rays_device(*args)
+                runtime.verify_device()
+
+        return (t, face)
 
 
 
@@ -636,7 +879,7 @@ class Volume:
     CLOSEST = constant(0)
     LINEAR = constant(1)
 
-    def __init__(self, data: array):
+    def __init__(self, data: array, copy: bool=True):
         """ Class representing a sparse grid.
 
         Attributes:
@@ -645,38 +888,125 @@ class Volume:
             
         Args:
             data (:class:`warp.array`): Array of bytes representing the volume in NanoVDB format
+            copy (bool): If False the volume references ``data`` directly instead of copying it, the volume keeps a reference to ``data`` so it stays alive
         """
 
         self.id = 0
 
-        from warp.context import runtime
+        from warp.context import runtime, ScopedDevice
         self.context = runtime
 
-        if data.device != "cpu" and data.device != "cuda":
-            raise RuntimeError(f"Unknown device type '{data.device}'")
-        self.device = data.device
+        # only referenced when the volume does not own a copy of its buffer
+        self.data = None
 
         if data is None:
             return
 
+        self.device = data.device
+
         if self.device == "cpu":
-            self.id = self.context.core.volume_create_host(ctypes.cast(data.ptr, ctypes.c_void_p), data.length)
+            self.id = self.context.core.volume_create_host(ctypes.cast(data.ptr, ctypes.c_void_p), data.length, copy)
         else:
-            self.id = self.context.core.volume_create_device(ctypes.cast(data.ptr, ctypes.c_void_p), data.length)
+            with ScopedDevice(self.device):
+                self.id = self.context.core.volume_create_device(ctypes.cast(data.ptr, ctypes.c_void_p), data.length, copy)
 
         if self.id == 0:
             raise RuntimeError("Failed to create volume from input array")
 
+        if not copy:
+            self.data = data
+
+    @classmethod
+    def load(cls, path: str, device: str="cpu", chunk_size: int=0):
+        """ Loads a volume from a raw NanoVDB grid file without first reading it into an array.
+
+        CPU volumes memory-map the file, so no copy is made and only the pages that are sampled are read from disk.
+        CUDA volumes are streamed in chunks through pinned staging buffers, overlapping file reads with uploads.
+
+        Args:
+            path (str): Path of a file containing a single NanoVDB grid
+            device (str): Device the volume is created on
+            chunk_size (int): Size in bytes of the staging buffers used for CUDA uploads, 0 selects the default (64MB)
+        """
+
+        from warp.context import get_device, ScopedDevice
+
+        device = get_device(device)
+
+        volume = cls(data=None)
+        volume.device = device
+
+        if device == "cpu":
+            volume.id = volume.context.core.volume_load_host(path.encode("utf-8"))
+        else:
+            with ScopedDevice(device):
+                volume.id = volume.context.core.volume_load_device(path.encode("utf-8"), chunk_size)
+
+        if volume.id == 0:
+            raise RuntimeError(f"Failed to load volume from '{path}'")
+
+        return volume
+
+    @classmethod
+    def bake_mesh(cls, mesh, voxel_size: float, band_width: float=3.0):
+        """ Bakes the signed distance field of a closed triangle mesh into a sparse narrow band level set.
+
+        Distances are evaluated from the mesh BVH on the mesh's device for the voxels of the 8^3 voxel leaves near the surface only,
+        the leaves are then assembled into a float NanoVDB grid of class level set that the volume references. Values are clamped to
+        +/- ``band_width*voxel_size``, inside of the band they are negative inside of the mesh, and space away from the surface takes the
+        sign of the nearest leaves. Sampling with :func:`volume_sample_world` or :func:`volume_sample_grad_world` then replaces closest point
+        queries, the baked grid can be cached with :meth:`save` and read back with :meth:`load`.
+
+        Args:
+            mesh (:class:`warp.Mesh`): A closed mesh, its points are the world space of the volume
+            voxel_size (float): Edge length of the voxels
+            band_width (float): Half width of the narrow band in voxels
+        """
+
+        import warp.sdf
+        from warp.context import ScopedDevice
+
+        background = band_width*voxel_size
+
+        volume = cls(data=None)
+        volume.device = mesh.device
+
+        with ScopedDevice(volume.device):
+
+            (leaves, values, num_leaves) = warp.sdf.mesh_level_set_leaves(mesh, voxel_size, background)
+
+            if volume.device == "cpu":
+                volume.id = volume.context.core.volume_create_level_set_host(ctypes.cast(leaves.ptr, ctypes.c_void_p), ctypes.cast(values.ptr, ctypes.c_void_p), num_leaves, voxel_size, 0.0, 0.0, 0.0, background)
+            else:
+                volume.id = volume.context.core.volume_create_level_set_device(ctypes.cast(leaves.ptr, ctypes.c_void_p), ctypes.cast(values.ptr, ctypes.c_void_p), num_leaves, voxel_size, 0.0, 0.0, 0.0, background)
+
+        if volume.id == 0:
+            raise RuntimeError("Failed to bake volume from mesh")
+
+        return volume
+
+    def save(self, path: str):
+        """ Writes the grid to a raw NanoVDB file that can be read back with :meth:`load`.
+
+        Args:
+            path (str): Path of the file, an existing file is overwritten
+        """
+
+        self.array().numpy().tofile(path)
+
     def __del__(self):
 
         if self.id == 0:
             return
         
-        self.context.verify_device()
+        from warp.context import ScopedDevice
+
         if self.device == "cpu":
             self.context.core.volume_destroy_host(self.id)
         else:
-            self.context.core.volume_destroy_device(self.id)
+            with ScopedDevice(self.device):
+                self.context.verify_device()
+                self.context.core.volume_destroy_device(self.id)
 
 
     def array(self):
@@ -692,7 +1022,7 @@ class Volume:
 
 class HashGrid:
 
-    def __init__(self, dim_x, dim_y, dim_z, device):
+    def __init__(self, dim_x, dim_y, dim_z, device, sparse=False):
         """ Class representing a triangle mesh.
 
         Attributes:
@@ -703,23 +1033,35 @@ class HashGrid:
             dim_x (int): Number of cells in x-axis
             dim_y (int): Number of cells in y-axis
             dim_z (int): Number of cells in z-axis
+            sparse (bool): Store only occupied cells in a hash table, memory and build time then scale with the number of points
+                           rather than the grid volume, and cells never alias. The grid dimensions are ignored in this mode.
         """
 
-        self.device = device
+        from warp.context import runtime, get_device, ScopedDevice
+
+        self.device = get_device(device)
+        self.sparse = sparse
+        self.num_points = 0
 
-        from warp.context import runtime
+        # true once reorder() has permuted arrays into the cell order of the last build
+        self.ordered = False
+
+        # incremented by every build() and reorder(), lets a NeighborList detect that it was made from an older grid
+        self.generation = 0
        
-        if (device == "cpu"):
-            self.id = runtime.core.hash_grid_create_host(dim_x, dim_y, dim_z)
-        elif (device == "cuda"):
-            self.id = runtime.core.hash_grid_create_device(dim_x, dim_y, dim_z)
+        if (self.device == "cpu"):
+            self.id = runtime.core.hash_grid_create_host(dim_x, dim_y, dim_z, sparse)
+        else:
+            with ScopedDevice(self.device):
+                self.id = runtime.core.hash_grid_create_device(dim_x, dim_y, dim_z, sparse)
 
 
     def build(self, points, radius):
         """ Updates the hash grid data structure.
 
         This method rebuilds the underlying datastructure and should be called any time the set
-        of points changes.
+        of points changes. Rebuilding discards any ordering established by :meth:`reorder`, queries
+        return indices into ``points`` again until the next call to :meth:`reorder`.
 
         Attributes:
             id: Unique identifier for this mesh object, can be passed to kernels.
@@ -732,34 +1074,265 @@ class HashGrid:
                             the radius used when performing queries.                          
         """
         
-        from warp.context import runtime
+        from warp.context import runtime, ScopedDevice
+        from warp.profiler import ScopedProfile
+
+        with ScopedDevice(self.device), ScopedProfile("hash_grid_build", self.device, dim=len(points), category="hash_grid"):
+
+            if (self.device == "cpu"):
+                runtime.core.hash_grid_update_host(self.id, radius, ctypes.cast(points.ptr, ctypes.c_void_p), len(points))
+            else:
+                runtime.core.hash_grid_update_device(self.id, radius, ctypes.cast(points.ptr, ctypes.c_void_p), len(points))
+
+        self.num_points = len(points)
+        self.ordered = False
+        self.generation += 1
+
+
+    def reorder(self, arrays, inverse=False):
+        """ Permutes per-point arrays into the cell order computed by the last :meth:`build`.
+
+        Points that share a cell are then contiguous in memory so neighbor queries read coalesced data.
+        After reordering, :func:`hash_grid_query_next` and :func:`hash_grid_point_id` return indices
+        into the reordered arrays directly, so every array a query kernel reads per-point data from
+        (positions, velocities, etc) must be passed here, in a single call since a grid can only be reordered
+        once per build. Arrays are permuted in-place.
+
+        Args:
+            arrays: A list of :class:`warp.array` with one element per point, any dtype
+            inverse (bool): Scatter arrays from cell order back to the order points were given to :meth:`build` in,
+                            e.g.: to write results back to arrays that were not reordered. Queries return
+                            indices into the build order again afterwards.
+        """
+
+        from warp.context import runtime, empty_like, copy, ScopedDevice
+
+        # permuting twice in the same direction would scramble the arrays
+        if (not inverse and self.ordered):
+            raise RuntimeError("HashGrid.reorder() grid is already in cell order, pass all arrays in a single call or rebuild the grid")
+
+        if (inverse and not self.ordered):
+            raise RuntimeError("HashGrid.reorder() with inverse=True requires a grid that has been reordered")
+
+        # nothing to permute, and queries of an empty grid return no indices either way
+        if (self.num_points == 0):
+            return
+
+        for a in arrays:
+
+            if (len(a) != self.num_points):
+                raise RuntimeError(f"HashGrid.reorder() array length {len(a)} does not match the number of points {self.num_points}")
+
+            if (a.device != self.device):
+                raise RuntimeError(f"HashGrid.reorder() array on device {a.device} but grid on device {self.device}")
+
+            # permutation cannot be done in-place, go through a temporary
+            tmp = empty_like(a)
+            elem_size = type_size_in_bytes(a.dtype)
+
+            if (self.device == "cpu"):
+                runtime.core.hash_grid_permute_host(self.id, ctypes.c_void_p(tmp.ptr), ctypes.c_void_p(a.ptr), elem_size, inverse)
+            else:
+                with ScopedDevice(self.device):
+                    runtime.core.hash_grid_permute_device(self.id, ctypes.c_void_p(tmp.ptr), ctypes.c_void_p(a.ptr), elem_size, inverse)
+
+            copy(a, tmp)
 
         if (self.device == "cpu"):
-            runtime.core.hash_grid_update_host(self.id, radius, ctypes.cast(points.ptr, ctypes.c_void_p), len(points))
+            runtime.core.hash_grid_set_ordered_host(self.id, not inverse)
         else:
-            runtime.core.hash_grid_update_device(self.id, radius, ctypes.cast(points.ptr, ctypes.c_void_p), len(points))
+            with ScopedDevice(self.device):
+                runtime.core.hash_grid_set_ordered_device(self.id, not inverse)
+
+        self.ordered = not inverse
+        self.generation += 1
 
 
     def reserve(self, num_points):
 
-        from warp.context import runtime
+        from warp.context import runtime, ScopedDevice
 
         if (self.device == "cpu"):
             runtime.core.hash_grid_reserve_host(self.id, num_points)
         else:
-            runtime.core.hash_grid_reserve_device(self.id, num_points)
+            with ScopedDevice(self.device):
+                runtime.core.hash_grid_reserve_device(self.id, num_points)
 
 
     def __del__(self):
 
         try:
 
-            from warp.context import runtime
+            from warp.context import runtime, ScopedDevice
 
             if (self.device == "cpu"):
                 runtime.core.hash_grid_destroy_host(self.id)
             else:
-                runtime.core.hash_grid_destroy_device(self.id)
+                with ScopedDevice(self.device):
+                    runtime.core.hash_grid_destroy_device(self.id)
+
+        except:
+            pass
+
+
+class NeighborList:
+
+    def __init__(self, device, max_neighbors=0):
+        """ Class representing fixed radius neighbors of a set of points in compressed sparse row format.
+
+        The list is built from a :class:`HashGrid` over the points, after which kernels iterate over the
+        neighbors of a point with :func:`neighbor_list_query` and :func:`neighbor_list_query_next`
+        without visiting grid cells or testing distances. Neighbors are found within ``radius + skin``,
+        so a list built with a skin stays valid until some point has moved further than half the skin,
+        see :meth:`needs_rebuild`.
+
+        Attributes:
+            id: Unique identifier for this neighbor list object, can be passed to kernels.
+            device: Device this object lives on, all buffers must live on the same device.
+
+        Args:
+            device (str): Device the list is stored on
+            max_neighbors (int): If greater than zero only the closest ``max_neighbors`` points are kept for each point, the list
+                                 is then sized up front and :meth:`build` can be captured in a CUDA graph. Otherwise all neighbors
+                                 are kept and building on a CUDA device synchronizes to read back their total number.
+        """
+
+        from warp.context import runtime, get_device, ScopedDevice
+
+        self.device = get_device(device)
+        self.max_neighbors = max_neighbors
+        self.num_points = 0
+        self.radius = 0.0
+        self.skin = 0.0
+
+        # the grid and grid generation of the last build, see is_current()
+        self.grid_id = None
+        self.grid_generation = 0
+
+        if (self.device == "cpu"):
+            self.id = runtime.core.neighbor_list_create_host(max_neighbors)
+        else:
+            with ScopedDevice(self.device):
+                self.id = runtime.core.neighbor_list_create_device(max_neighbors)
+
+
+    def build(self, grid, points, radius, skin=0.0):
+        """ Finds the neighbors of every point.
+
+        Args:
+            grid (:class:`warp.HashGrid`): A hash grid built over ``points``, if it has been reordered ``points`` must be the reordered array
+                                           and the neighbor indices refer to the reordered arrays as well
+            points (:class:`warp.array`): Array of points of type :class:`warp.vec3`
+            radius (float): Neighbors are all points closer than ``radius + skin``
+            skin (float): Extra distance that allows the list to be reused while points move less than ``skin/2``
+        """
+
+        from warp.context import runtime, ScopedDevice
+        from warp.profiler import ScopedProfile
+
+        if (points.device != self.device or grid.device != self.device):
+            raise RuntimeError(f"NeighborList.build() points on device {points.device} and grid on device {grid.device} but list on device {self.device}")
+
+        # neighbor offsets are 32-bit, a limited list reserves max_neighbors entries for every point
+        if (self.max_neighbors > 0 and len(points)*self.max_neighbors > 2**31 - 1):
+            raise RuntimeError(f"NeighborList.build() {len(points)} points with max_neighbors={self.max_neighbors} exceed the maximum of {2**31 - 1} neighbors")
+
+        with ScopedDevice(self.device), ScopedProfile("neighbor_list_build", self.device, dim=len(points), category="neighbor_list"):
+
+            if (self.device == "cpu"):
+                runtime.core.neighbor_list_build_host(self.id, grid.id, ctypes.cast(points.ptr, ctypes.c_void_p), len(points), radius, skin)
+            else:
+                runtime.core.neighbor_list_build_device(self.id, grid.id, ctypes.cast(points.ptr, ctypes.c_void_p), len(points), radius, skin)
+
+        self.num_points = len(points)
+        self.radius = radius
+        self.skin = skin
+
+        self.grid_id = grid.id
+        self.grid_generation = grid.generation
+
+
+    def is_current(self, grid):
+        """ Returns ``True`` if the list was built from the last :meth:`HashGrid.build` or :meth:`HashGrid.reorder` of ``grid``,
+        a grid rebuilt on its own leaves the list describing the old points.
+
+        Args:
+            grid (:class:`warp.HashGrid`): The grid the list is expected to be built from
+        """
+
+        return self.grid_id == grid.id and self.grid_generation == grid.generation
+
+
+    def max_displacement(self, points):
+        """ Returns the largest distance any point has moved since the last :meth:`build`, synchronizes with the device.
+
+        Args:
+            points (:class:`warp.array`): The current positions of the points the list was built over
+        """
+
+        from warp.context import runtime, ScopedDevice
+
+        if (self.device == "cpu"):
+            return runtime.core.neighbor_list_max_displacement_host(self.id, ctypes.cast(points.ptr, ctypes.c_void_p), len(points))
+        else:
+            with ScopedDevice(self.device):
+                return runtime.core.neighbor_list_max_displacement_device(self.id, ctypes.cast(points.ptr, ctypes.c_void_p), len(points))
+
+
+    def needs_rebuild(self, points, margin=0.0):
+        """ Returns ``True`` if the list may be missing neighbors within ``radius`` of some point.
+
+        This is the case once the number of points has changed, or some point has moved more than half the skin since the last build,
+        after which the hash grid and the list have to be rebuilt. Lists limited by ``max_neighbors`` may miss neighbors before then.
+        The check synchronizes with the device, when it is only made every few steps ``margin`` should bound the distance points move
+        until the next check, so that the list is rebuilt before it becomes invalid.
+
+        Args:
+            points (:class:`warp.array`): The current positions of the points the list was built over
+            margin (float): Distance points may move before the next check
+        """
+
+        if (len(points) != self.num_points):
+            return True
+
+        return self.max_displacement(points) > 0.5*self.skin - margin
+
+
+    def arrays(self):
+        """ Returns the ``(offsets, counts, indices)`` arrays of the list, the neighbors of point ``i`` are
+        ``indices[offsets[i]:offsets[i]+counts[i]]``. The arrays reference the list's memory and are invalidated by the next :meth:`build`.
+        """
+
+        from warp.context import runtime, ScopedDevice
+
+        offsets = ctypes.c_void_p(0)
+        counts = ctypes.c_void_p(0)
+        indices = ctypes.c_void_p(0)
+        num_points = ctypes.c_int(0)
+        num_neighbors = ctypes.c_int(0)
+
+        if (self.device == "cpu"):
+            runtime.core.neighbor_list_get_info_host(self.id, ctypes.byref(offsets), ctypes.byref(counts), ctypes.byref(indices), ctypes.byref(num_points), ctypes.byref(num_neighbors))
+        else:
+            with ScopedDevice(self.device):
+                runtime.core.neighbor_list_get_info_device(self.id, ctypes.byref(offsets), ctypes.byref(counts), ctypes.byref(indices), ctypes.byref(num_points), ctypes.byref(num_neighbors))
+
+        return (array(ptr=offsets.value, dtype=int32, length=num_points.value+1 if num_points.value else 0, device=self.device, owner=False),
+                array(ptr=counts.value, dtype=int32, length=num_points.value, device=self.device, owner=False),
+                array(ptr=indices.value, dtype=int32, length=num_neighbors.value, device=self.device, owner=False))
+
+
+    def __del__(self):
+
+        try:
+
+            from warp.context import runtime, ScopedDevice
+
+            if (self.device == "cpu"):
+                runtime.core.neighbor_list_destroy_host(self.id)
+            else:
+                with ScopedDevice(self.device):
+                    runtime.core.neighbor_list_destroy_device(self.id)
 
         except:
             pass